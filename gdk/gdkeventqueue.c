@@ -0,0 +1,86 @@
+/* GDK - The GIMP Drawing Kit
+ * Copyright (C) 1995-1997 Peter Mattis, Spencer Kimball and Josh MacDonald
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "config.h"
+
+#include "gdkeventqueueprivate.h"
+
+GList *
+_gdk_event_list_append (GList    **head,
+                        GList    **tail,
+                        gpointer   event)
+{
+  *tail = g_list_append (*tail, event);
+
+  if (!*head)
+    *head = *tail;
+  else
+    *tail = (*tail)->next;
+
+  return *tail;
+}
+
+/* Events get inserted relative to the event that is being processed,
+ * which is usually among the most recently queued ones, so search
+ * from the tail.
+ */
+static GList *
+gdk_event_list_find_link (GList    *tail,
+                          gpointer  event)
+{
+  GList *l;
+
+  for (l = tail; l; l = l->prev)
+    {
+      if (l->data == event)
+        return l;
+    }
+
+  return NULL;
+}
+
+GList *
+_gdk_event_list_insert_after (GList    **head,
+                              GList    **tail,
+                              gpointer   sibling,
+                              gpointer   event)
+{
+  GList *prev = gdk_event_list_find_link (*tail, sibling);
+  if (prev && prev->next)
+    {
+      *head = g_list_insert_before (*head, prev->next, event);
+      return prev->next;
+    }
+  else
+    return _gdk_event_list_append (head, tail, event);
+}
+
+GList *
+_gdk_event_list_insert_before (GList    **head,
+                               GList    **tail,
+                               gpointer   sibling,
+                               gpointer   event)
+{
+  GList *next = gdk_event_list_find_link (*tail, sibling);
+  if (next)
+    {
+      *head = g_list_insert_before (*head, next, event);
+      return next->prev;
+    }
+  else
+    return _gdk_event_list_append (head, tail, event);
+}
@@ -0,0 +1,42 @@
+/* GDK - The GIMP Drawing Kit
+ * Copyright (C) 1995-1997 Peter Mattis, Spencer Kimball and Josh MacDonald
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef __GDK_EVENT_QUEUE_PRIVATE_H__
+#define __GDK_EVENT_QUEUE_PRIVATE_H__
+
+#include <glib.h>
+
+G_BEGIN_DECLS
+
+/* List operations behind the _gdk_event_queue_*() functions. They
+ * only depend on GLib, so that the testsuite can build them directly.
+ */
+GList * _gdk_event_list_append        (GList    **head,
+                                       GList    **tail,
+                                       gpointer   event);
+GList * _gdk_event_list_insert_after  (GList    **head,
+                                       GList    **tail,
+                                       gpointer   sibling,
+                                       gpointer   event);
+GList * _gdk_event_list_insert_before (GList    **head,
+                                       GList    **tail,
+                                       gpointer   sibling,
+                                       gpointer   event);
+
+G_END_DECLS
+
+#endif /* __GDK_EVENT_QUEUE_PRIVATE_H__ */
@@ -26,6 +26,7 @@
 
 #include "gdkinternals.h"
 #include "gdkdisplayprivate.h"
+#include "gdkeventqueueprivate.h"
 
 #include <string.h>
 #include <math.h>
@@ -145,14 +146,9 @@ GList *
 _gdk_event_queue_append (GdkDisplay *display,
 			 GdkEvent   *event)
 {
-  display->queued_tail = g_list_append (display->queued_tail, event);
-  
-  if (!display->queued_events)
-    display->queued_events = display->queued_tail;
-  else
-    display->queued_tail = display->queued_tail->next;
-
-  return display->queued_tail;
+  return _gdk_event_list_append (&display->queued_events,
+                                 &display->queued_tail,
+                                 event);
 }
 
 /**
@@ -173,14 +169,9 @@ _gdk_event_queue_insert_after (GdkDisplay *display,
                                GdkEvent   *sibling,
                                GdkEvent   *event)
 {
-  GList *prev = g_list_find (display->queued_events, sibling);
-  if (prev && prev->next)
-    {
-      display->queued_events = g_list_insert_before (display->queued_events, prev->next, event);
-      return prev->next;
-    }
-  else
-    return _gdk_event_queue_append (display, event);
+  return _gdk_event_list_insert_after (&display->queued_events,
+                                       &display->queued_tail,
+                                       sibling, event);
 }
 
 /**
@@ -201,14 +192,9 @@ _gdk_event_queue_insert_before (GdkDisplay *display,
 				GdkEvent   *sibling,
 				GdkEvent   *event)
 {
-  GList *next = g_list_find (display->queued_events, sibling);
-  if (next)
-    {
-      display->queued_events = g_list_insert_before (display->queued_events, next, event);
-      return next->prev;
-    }
-  else
-    return _gdk_event_queue_append (display, event);
+  return _gdk_event_list_insert_before (&display->queued_events,
+                                        &display->queued_tail,
+                                        sibling, event);
 }
 
 
@@ -262,6 +248,83 @@ _gdk_event_unqueue (GdkDisplay *display)
   return event;
 }
 
+static gsize
+gdk_motion_time_coord_size (GdkDevice *device)
+{
+  gint n_axes;
+
+  n_axes = device ? gdk_device_get_n_axes (device) : 0;
+
+  /* Always leave room for x and y, see gdk_motion_time_coord_new() */
+  n_axes = CLAMP (n_axes, 2, GDK_MAX_TIMECOORD_AXES);
+
+  return sizeof (GdkTimeCoord) - sizeof (gdouble) * (GDK_MAX_TIMECOORD_AXES - n_axes);
+}
+
+static GdkTimeCoord *
+gdk_motion_time_coord_new (const GdkEventMotion *motion)
+{
+  GdkTimeCoord *coord;
+  gint i, n_axes;
+
+  coord = g_malloc0 (gdk_motion_time_coord_size (motion->device));
+  coord->time = motion->time;
+
+  n_axes = motion->device ? gdk_device_get_n_axes (motion->device) : 0;
+  n_axes = MIN (n_axes, GDK_MAX_TIMECOORD_AXES);
+
+  if (motion->axes)
+    memcpy (coord->axes, motion->axes, sizeof (gdouble) * n_axes);
+  else
+    {
+      for (i = 0; i < n_axes; i++)
+        {
+          GdkAxisUse use = gdk_device_get_axis_use (motion->device, i);
+
+          if (use == GDK_AXIS_X)
+            coord->axes[i] = motion->x;
+          else if (use == GDK_AXIS_Y)
+            coord->axes[i] = motion->y;
+        }
+    }
+
+  /* Devices without axes still get their position recorded */
+  if (n_axes < 2)
+    {
+      coord->axes[0] = motion->x;
+      coord->axes[1] = motion->y;
+    }
+
+  return coord;
+}
+
+/* Appends @from, and the history it carries itself, to the
+ * motion history of @to. @from is left without history.
+ */
+static void
+gdk_event_move_motion_history (GdkEventPrivate *from,
+                               GdkEventPrivate *to)
+{
+  guint i;
+
+  if (to->motion_history == NULL)
+    to->motion_history = g_ptr_array_new_with_free_func (g_free);
+
+  if (from->motion_history)
+    {
+      for (i = 0; i < from->motion_history->len; i++)
+        g_ptr_array_add (to->motion_history,
+                         g_ptr_array_index (from->motion_history, i));
+
+      g_ptr_array_set_free_func (from->motion_history, NULL);
+      g_ptr_array_unref (from->motion_history);
+      from->motion_history = NULL;
+    }
+
+  g_ptr_array_add (to->motion_history,
+                   gdk_motion_time_coord_new (&from->event.motion));
+}
+
 void
 _gdk_event_queue_handle_motion_compression (GdkDisplay *display)
 {
@@ -303,8 +366,17 @@ _gdk_event_queue_handle_motion_compression (GdkDisplay *display)
   while (pending_motions && pending_motions->next != NULL)
     {
       GList *next = pending_motions->next;
+      GdkEventPrivate *dropped = pending_motions->data;
+      GdkEventPrivate *last = display->queued_tail->data;
+
+      /* Keep the dropped motion around as history of the last
+       * one, so that e.g. drawing applications don't lose input
+       */
+      gdk_event_move_motion_history (dropped, last);
+
       display->queued_events = g_list_delete_link (display->queued_events,
                                                    pending_motions);
+      gdk_event_free ((GdkEvent *) dropped);
       pending_motions = next;
     }
 
@@ -489,6 +561,7 @@ gdk_event_new (GdkEventType type)
   GdkEventPrivate *new_private;
   GdkEvent *new_event;
   
+  /* Used as a set, which avoids allocating an array of values */
   if (!event_hash)
     event_hash = g_hash_table_new (g_direct_hash, NULL);
 
@@ -497,7 +570,7 @@ gdk_event_new (GdkEventType type)
   new_private->flags = 0;
   new_private->screen = NULL;
 
-  g_hash_table_insert (event_hash, new_private, GUINT_TO_POINTER (1));
+  g_hash_table_add (event_hash, new_private);
 
   new_event = (GdkEvent *) new_private;
 
@@ -561,7 +634,7 @@ static gboolean
 gdk_event_is_allocated (const GdkEvent *event)
 {
   if (event_hash)
-    return g_hash_table_lookup (event_hash, event) != NULL;
+    return g_hash_table_contains (event_hash, event);
 
   return FALSE;
 }
@@ -622,6 +695,20 @@ gdk_event_copy (const GdkEvent *event)
       new_private->screen = private->screen;
       new_private->device = private->device;
       new_private->source_device = private->source_device;
+
+      if (private->motion_history)
+        {
+          gsize size;
+          guint i;
+
+          size = gdk_motion_time_coord_size (event->motion.device);
+          new_private->motion_history =
+            g_ptr_array_new_full (private->motion_history->len, g_free);
+
+          for (i = 0; i < private->motion_history->len; i++)
+            g_ptr_array_add (new_private->motion_history,
+                             g_memdup (g_ptr_array_index (private->motion_history, i), size));
+        }
     }
 
   switch (event->any.type)
@@ -794,6 +881,9 @@ gdk_event_free (GdkEvent *event)
   if (display)
     _gdk_display_event_data_free (display, event);
 
+  if (((GdkEventPrivate *) event)->motion_history)
+    g_ptr_array_unref (((GdkEventPrivate *) event)->motion_history);
+
   g_hash_table_remove (event_hash, event);
   g_slice_free (GdkEventPrivate, (GdkEventPrivate*) event);
 }
@@ -1670,6 +1760,76 @@ gdk_event_request_motions (const GdkEventMotion *event)
     }
 }
 
+/**
+ * gdk_event_get_motion_history:
+ * @event: a #GdkEvent
+ * @events: (array length=n_events) (out) (transfer full) (allow-none):
+ *     location to store a newly-allocated array of #GdkTimeCoord, or %NULL
+ * @n_events: (out) (allow-none): location to store the length of
+ *     @events, or %NULL
+ *
+ * When several motion events for the same window and device are
+ * queued up, GDK only delivers the last one of them. This function
+ * retrieves the positions, axes and timestamps of the motion events
+ * that were coalesced into @event, oldest first. The position of
+ * @event itself is not included.
+ *
+ * This allows applications such as drawing programs to handle
+ * input at full resolution while still getting a single motion
+ * event per frame. The axes of the returned #GdkTimeCoord<!-- -->s
+ * can be interpreted with gdk_device_get_axis() on the device of
+ * @event.
+ *
+ * The returned array must be freed with gdk_device_free_history().
+ *
+ * Return value: %TRUE if @event is a %GDK_MOTION_NOTIFY event
+ *     that carries motion history
+ *
+ * Since: 3.10
+ **/
+gboolean
+gdk_event_get_motion_history (const GdkEvent   *event,
+                              GdkTimeCoord   ***events,
+                              gint             *n_events)
+{
+  GPtrArray *history;
+  GdkTimeCoord **coords;
+  gsize size;
+  guint i;
+
+  g_return_val_if_fail (event != NULL, FALSE);
+
+  if (events)
+    *events = NULL;
+  if (n_events)
+    *n_events = 0;
+
+  if (event->type != GDK_MOTION_NOTIFY ||
+      !gdk_event_is_allocated (event))
+    return FALSE;
+
+  history = ((GdkEventPrivate *) event)->motion_history;
+
+  if (history == NULL || history->len == 0)
+    return FALSE;
+
+  if (events)
+    {
+      size = gdk_motion_time_coord_size (event->motion.device);
+      coords = g_new (GdkTimeCoord *, history->len);
+
+      for (i = 0; i < history->len; i++)
+        coords[i] = g_memdup (g_ptr_array_index (history, i), size);
+
+      *events = coords;
+    }
+
+  if (n_events)
+    *n_events = history->len;
+
+  return TRUE;
+}
+
 /**
  * gdk_event_triggers_context_menu:
  * @event: a #GdkEvent, currently only button events are meaningful values
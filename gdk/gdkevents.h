@@ -1258,6 +1258,10 @@ GDK_AVAILABLE_IN_ALL
 GdkDevice* gdk_event_get_source_device  (const GdkEvent  *event);
 GDK_AVAILABLE_IN_ALL
 void       gdk_event_request_motions    (const GdkEventMotion *event);
+GDK_AVAILABLE_IN_3_10
+gboolean   gdk_event_get_motion_history (const GdkEvent  *event,
+                                         GdkTimeCoord  ***events,
+                                         gint            *n_events);
 GDK_AVAILABLE_IN_3_4
 gboolean   gdk_event_triggers_context_menu (const GdkEvent *event);
 
@@ -167,6 +167,11 @@ struct _GdkEventPrivate
   gpointer   windowing_data;
   GdkDevice *device;
   GdkDevice *source_device;
+
+  /* GdkTimeCoord's of motion events coalesced into this one,
+   * oldest first, see _gdk_event_queue_handle_motion_compression()
+   */
+  GPtrArray *motion_history;
 };
 
 typedef struct _GdkWindowPaint GdkWindowPaint;
@@ -31,6 +31,7 @@
 #include "gtkaccellabel.h"
 #include "gtkaccelmap.h"
 #include "gtkmain.h"
+#include "gtkpango.h"
 #include "gtksizerequest.h"
 #include "gtkprivate.h"
 #include "gtkintl.h"
@@ -347,14 +348,15 @@ gtk_accel_label_get_preferred_width (GtkWidget       *widget,
 {
   GtkAccelLabel *accel_label = GTK_ACCEL_LABEL (widget);
   PangoLayout   *layout;
-  gint           width;
+  PangoRectangle logical;
 
   GTK_WIDGET_CLASS (gtk_accel_label_parent_class)->get_preferred_width (widget, min_width, nat_width);
 
   layout = gtk_widget_create_pango_layout (GTK_WIDGET (widget), 
 					   gtk_accel_label_get_string (accel_label));
-  pango_layout_get_pixel_size (layout, &width, NULL);
-  accel_label->priv->accel_string_width = width;
+  _gtk_pango_layout_get_cached_extents (layout, &logical, NULL);
+  pango_extents_to_pixels (&logical, NULL);
+  accel_label->priv->accel_string_width = logical.width;
 
   g_object_unref (layout);
 }
@@ -30,8 +30,10 @@
 #include <stdarg.h>
 
 #include "gtkbindingsprivate.h"
+#include "gtkcssarrayvalueprivate.h"
+#include "gtkcssstringvalueprivate.h"
 #include "gtkkeyhash.h"
-#include "gtkstylecontext.h"
+#include "gtkstylecontextprivate.h"
 #include "gtkwidget.h"
 #include "gtkintl.h"
 
@@ -136,6 +138,12 @@
 /* --- defines --- */
 #define BINDING_MOD_MASK() (gtk_accelerator_get_default_mod_mask () | GDK_RELEASE_MASK)
 
+/* Dispatch tables kept for each type, one for each value of the
+ * gtk-key-bindings property and keymap; the most recently used first */
+#define MAX_DISPATCH_TABLES_PER_TYPE 4
+/* Keys remembered in each dispatch table */
+#define MAX_DISPATCH_KEYS 256
+
 
 #define GTK_TYPE_IDENTIFIER (gtk_identifier_get_type ())
 _GDK_EXTERN
@@ -150,6 +158,27 @@ typedef struct {
   guint         seq_id;
 } PatternSpec;
 
+/* A key press, either a keyval and modifiers given to
+ * gtk_bindings_activate() or the fields of a key event */
+typedef struct {
+  guint           keyval;
+  GdkModifierType modifiers;
+  GdkModifierType mask;
+  guint16         keycode;
+  guint8          group;
+  guint8          is_event;
+} BindingKey;
+
+/* Maps key presses to the entries they activate, in the order they are
+ * tried, for widgets of one type with the same gtk-key-bindings value.
+ */
+typedef struct {
+  GtkCssValue *css_bindings;
+  GdkKeymap   *keymap;
+  GPtrArray   *sets;            /* binding sets, in lookup order */
+  GHashTable  *keys;            /* BindingKey => GPtrArray of GtkBindingEntry */
+} BindingDispatch;
+
 typedef enum {
   GTK_BINDING_TOKEN_BIND,
   GTK_BINDING_TOKEN_UNBIND
@@ -158,7 +187,11 @@ typedef enum {
 /* --- variables --- */
 static GHashTable       *binding_entry_hash_table = NULL;
 static GSList           *binding_key_hashes = NULL;
-static GSList           *binding_set_list = NULL;
+static GHashTable       *binding_set_hash = NULL;
+static GHashTable       *binding_set_type_cache = NULL;
+static GHashTable       *binding_dispatch_cache = NULL;
+static guint             binding_dispatch_hits = 0;
+static guint             binding_dispatch_misses = 0;
 static const gchar       key_class_binding_set[] = "gtk-class-binding-set";
 static GQuark            key_id_class_binding_set = 0;
 
@@ -256,6 +289,37 @@ binding_key_hash_insert_entry (GtkKeyHash      *key_hash,
   _gtk_key_hash_add_entry (key_hash, keyval, entry->modifiers & ~GDK_RELEASE_MASK, entry);
 }
 
+static void
+binding_dispatch_free (BindingDispatch *dispatch)
+{
+  _gtk_css_value_unref (dispatch->css_bindings);
+  g_ptr_array_unref (dispatch->sets);
+  g_hash_table_destroy (dispatch->keys);
+  g_slice_free (BindingDispatch, dispatch);
+}
+
+static void
+binding_dispatch_list_free (GSList *list)
+{
+  g_slist_free_full (list, (GDestroyNotify) binding_dispatch_free);
+}
+
+/* Drops all dispatch tables, for when entries are added or removed
+ * or the keymap changes */
+static void
+binding_dispatch_cache_clear (void)
+{
+  if (binding_dispatch_cache)
+    g_hash_table_remove_all (binding_dispatch_cache);
+}
+
+static void
+binding_keys_changed (GdkKeymap *keymap,
+                      gpointer   data)
+{
+  binding_dispatch_cache_clear ();
+}
+
 static void
 binding_key_hash_destroy (gpointer data)
 {
@@ -263,6 +327,9 @@ binding_key_hash_destroy (gpointer data)
 
   binding_key_hashes = g_slist_remove (binding_key_hashes, key_hash);
   _gtk_key_hash_free (key_hash);
+
+  /* the keymap is going away, don't keep tables for it */
+  binding_dispatch_cache_clear ();
 }
 
 static void
@@ -292,6 +359,8 @@ binding_key_hash_for_keymap (GdkKeymap *keymap)
     {
       key_hash = _gtk_key_hash_new (keymap, NULL);
       g_object_set_qdata_full (G_OBJECT (keymap), key_hash_quark, key_hash, binding_key_hash_destroy);
+      g_signal_connect (keymap, "keys-changed",
+                        G_CALLBACK (binding_keys_changed), NULL);
 
       if (binding_entry_hash_table)
         g_hash_table_foreach (binding_entry_hash_table,
@@ -339,6 +408,8 @@ binding_entry_new (GtkBindingSet  *binding_set,
       binding_key_hash_insert_entry (key_hash, entry);
     }
 
+  binding_dispatch_cache_clear ();
+
   return entry;
 }
 
@@ -427,6 +498,8 @@ binding_entry_destroy (GtkBindingEntry *entry)
       _gtk_key_hash_remove_entry (key_hash, entry);
     }
 
+  binding_dispatch_cache_clear ();
+
   entry->destroyed = TRUE;
 
   if (!entry->in_emission)
@@ -702,7 +775,17 @@ gtk_binding_set_new (const gchar *set_name)
   binding_set->current = NULL;
   binding_set->parsed = FALSE;
 
-  binding_set_list = g_slist_prepend (binding_set_list, binding_set);
+  if (binding_set_hash == NULL)
+    binding_set_hash = g_hash_table_new (NULL, NULL);
+
+  /* set names are interned, so we can use them as direct keys. Later
+   * sets replace earlier ones with the same name. */
+  g_hash_table_insert (binding_set_hash, binding_set->set_name, binding_set);
+
+  /* the new set may belong to a class, so any cached chains are stale */
+  if (binding_set_type_cache)
+    g_hash_table_remove_all (binding_set_type_cache);
+  binding_dispatch_cache_clear ();
 
   return binding_set;
 }
@@ -743,18 +826,46 @@ gtk_binding_set_by_class (gpointer object_class)
 static GtkBindingSet*
 gtk_binding_set_find_interned (const gchar *set_name)
 {
-  GSList *slist;
+  if (binding_set_hash == NULL)
+    return NULL;
+
+  return g_hash_table_lookup (binding_set_hash, set_name);
+}
+
+/* Returns the binding sets named after @type and its ancestors, most
+ * derived first. The result is cached per type until the next binding
+ * set gets created, so key presses don't have to walk the type
+ * hierarchy and look up every type name again.
+ */
+static GPtrArray *
+gtk_binding_sets_for_type (GType type)
+{
+  GPtrArray *sets;
+  GType class_type;
 
-  for (slist = binding_set_list; slist; slist = slist->next)
+  if (binding_set_type_cache == NULL)
+    binding_set_type_cache = g_hash_table_new_full (NULL, NULL,
+                                                    NULL,
+                                                    (GDestroyNotify) g_ptr_array_unref);
+
+  sets = g_hash_table_lookup (binding_set_type_cache, GSIZE_TO_POINTER (type));
+  if (sets)
+    return sets;
+
+  sets = g_ptr_array_new ();
+
+  for (class_type = type; class_type; class_type = g_type_parent (class_type))
     {
       GtkBindingSet *binding_set;
 
-      binding_set = slist->data;
-      if (binding_set->set_name == set_name)
-        return binding_set;
+      binding_set = gtk_binding_set_find_interned (g_type_name (class_type));
+      if (binding_set)
+        g_ptr_array_add (sets, binding_set);
     }
 
-  return NULL;
+  g_hash_table_insert (binding_set_type_cache, GSIZE_TO_POINTER (type), sets);
+
+  return sets;
 }
 
 /**
@@ -1487,115 +1598,258 @@ gtk_binding_set_add_path (GtkBindingSet       *binding_set,
     }
 }
 
-static gint
-find_entry_with_binding (GtkBindingEntry *entry,
-                         GtkBindingSet   *binding_set)
+static guint
+binding_key_hash (gconstpointer data)
 {
-  return (entry->binding_set == binding_set) ? 0 : 1;
+  const BindingKey *key = data;
+
+  return key->keyval ^ (key->modifiers << 8) ^ (key->keycode << 20) ^ key->group;
 }
 
 static gboolean
-binding_activate (GtkBindingSet *binding_set,
-                  GSList        *entries,
-                  GObject       *object,
-                  gboolean       is_release,
-                  gboolean      *unbound)
+binding_key_equal (gconstpointer a,
+                   gconstpointer b)
 {
-  GtkBindingEntry *entry;
-  GSList *elem;
+  const BindingKey *key_a = a;
+  const BindingKey *key_b = b;
+
+  return key_a->keyval == key_b->keyval &&
+         key_a->modifiers == key_b->modifiers &&
+         key_a->mask == key_b->mask &&
+         key_a->keycode == key_b->keycode &&
+         key_a->group == key_b->group &&
+         key_a->is_event == key_b->is_event;
+}
 
-  elem = g_slist_find_custom (entries, binding_set,
-                              (GCompareFunc) find_entry_with_binding);
+static void
+binding_key_free (gpointer data)
+{
+  g_slice_free (BindingKey, data);
+}
 
-  if (!elem)
-    return FALSE;
+static BindingDispatch *
+binding_dispatch_new (GType        type,
+                      GtkCssValue *css_bindings,
+                      GdkKeymap   *keymap)
+{
+  BindingDispatch *dispatch;
+  GPtrArray *type_sets;
+  guint i;
 
-  entry = elem->data;
+  dispatch = g_slice_new (BindingDispatch);
+  dispatch->css_bindings = _gtk_css_value_ref (css_bindings);
+  dispatch->keymap = keymap;
+  dispatch->sets = g_ptr_array_new ();
+  dispatch->keys = g_hash_table_new_full (binding_key_hash, binding_key_equal,
+                                          binding_key_free,
+                                          (GDestroyNotify) g_ptr_array_unref);
 
-  if (is_release != ((entry->modifiers & GDK_RELEASE_MASK) != 0))
-    return FALSE;
-
-  if (entry->marks_unbound)
+  /* The sets from CSS come first, then those of the type's classes */
+  for (i = 0; i < _gtk_css_array_value_get_n_values (css_bindings); i++)
     {
-      *unbound = TRUE;
-      return FALSE;
+      GtkBindingSet *binding_set;
+      const char *name;
+
+      name = _gtk_css_string_value_get (_gtk_css_array_value_get_nth (css_bindings, i));
+      if (name == NULL)
+        continue;
+
+      binding_set = gtk_binding_set_find (name);
+      if (binding_set)
+        g_ptr_array_add (dispatch->sets, binding_set);
     }
 
-  if (gtk_binding_entry_activate (entry, object))
-    return TRUE;
+  type_sets = gtk_binding_sets_for_type (type);
+  for (i = 0; i < type_sets->len; i++)
+    g_ptr_array_add (dispatch->sets, g_ptr_array_index (type_sets, i));
 
-  return FALSE;
+  return dispatch;
 }
 
-static gboolean
-gtk_bindings_activate_list (GObject  *object,
-                            GSList   *entries,
-                            gboolean  is_release)
+/* Returns the dispatch table for @object, which is cached per type,
+ * value of the gtk-key-bindings property and keymap. Changes to the
+ * CSS show up as a different property value.
+ */
+static BindingDispatch *
+binding_dispatch_for_object (GObject   *object,
+                             GdkKeymap *keymap)
 {
-  GtkStyleContext *context;
-  GtkBindingSet *binding_set;
-  GtkStateFlags state;
-  gboolean handled = FALSE;
-  gboolean unbound = FALSE;
-  GPtrArray *array;
+  BindingDispatch *dispatch;
+  GtkCssValue *css_bindings;
+  GSList *list, *l, *last;
+  GType type;
+  guint n;
 
-  if (!entries)
-    return FALSE;
+  if (binding_dispatch_cache == NULL)
+    binding_dispatch_cache = g_hash_table_new_full (NULL, NULL,
+                                                    NULL,
+                                                    (GDestroyNotify) binding_dispatch_list_free);
+
+  css_bindings = _gtk_style_context_peek_property (gtk_widget_get_style_context (GTK_WIDGET (object)),
+                                                   GTK_CSS_PROPERTY_GTK_KEY_BINDINGS);
+  type = G_TYPE_FROM_INSTANCE (object);
 
-  context = gtk_widget_get_style_context (GTK_WIDGET (object));
-  state = gtk_widget_get_state_flags (GTK_WIDGET (object));
+  list = g_hash_table_lookup (binding_dispatch_cache, GSIZE_TO_POINTER (type));
 
-  gtk_style_context_get (context, state,
-                         "gtk-key-bindings", &array,
-                         NULL);
-  if (array)
+  for (l = list; l; l = l->next)
     {
-      gint i;
+      dispatch = l->data;
 
-      for (i = 0; i < array->len; i++)
+      if (dispatch->keymap == keymap &&
+          _gtk_css_value_equal (dispatch->css_bindings, css_bindings))
+        break;
+    }
+
+  if (l)
+    {
+      if (l == list)
+        return dispatch;
+
+      list = g_slist_remove_link (list, l);
+    }
+  else
+    {
+      l = g_slist_alloc ();
+      l->data = binding_dispatch_new (type, css_bindings, keymap);
+
+      for (last = list, n = 1; last && n < MAX_DISPATCH_TABLES_PER_TYPE - 1; last = last->next)
+        n++;
+      if (last && last->next)
         {
-          binding_set = g_ptr_array_index (array, i);
-          handled = binding_activate (binding_set, entries,
-                                      object, is_release,
-                                      &unbound);
-          if (handled || unbound)
-            break;
+          binding_dispatch_list_free (last->next);
+          last->next = NULL;
         }
+    }
 
-      g_ptr_array_unref (array);
+  l->next = list;
+  g_hash_table_steal (binding_dispatch_cache, GSIZE_TO_POINTER (type));
+  g_hash_table_insert (binding_dispatch_cache, GSIZE_TO_POINTER (type), l);
 
-      if (unbound)
-        return FALSE;
-    }
+  return l->data;
+}
 
-  if (!handled)
+/* Returns the entries to try for @key, in order: the first entry of
+ * each binding set of @dispatch among those the key hash finds.
+ */
+static GPtrArray *
+binding_dispatch_lookup (BindingDispatch *dispatch,
+                         GtkKeyHash      *key_hash,
+                         const BindingKey *key)
+{
+  GPtrArray *entries;
+  GSList *found, *l;
+  guint i;
+
+  entries = g_hash_table_lookup (dispatch->keys, key);
+  if (entries)
     {
-      GType class_type;
+      binding_dispatch_hits++;
+      return entries;
+    }
 
-      class_type = G_TYPE_FROM_INSTANCE (object);
+  binding_dispatch_misses++;
 
-      while (class_type && !handled)
-        {
-          binding_set = gtk_binding_set_find_interned (g_type_name (class_type));
-          class_type = g_type_parent (class_type);
+  if (key->is_event)
+    found = _gtk_key_hash_lookup (key_hash,
+                                  key->keycode,
+                                  key->modifiers,
+                                  key->mask,
+                                  key->group);
+  else
+    found = _gtk_key_hash_lookup_keyval (key_hash, key->keyval, key->modifiers);
 
-          if (!binding_set)
-            continue;
+  entries = g_ptr_array_new ();
+
+  for (i = 0; i < dispatch->sets->len && found; i++)
+    {
+      GtkBindingSet *binding_set = g_ptr_array_index (dispatch->sets, i);
 
-          handled = binding_activate (binding_set, entries,
-                                      object, is_release,
-                                      &unbound);
-          if (unbound)
-            break;
+      for (l = found; l; l = l->next)
+        {
+          GtkBindingEntry *entry = l->data;
+
+          if (entry->binding_set == binding_set)
+            {
+              g_ptr_array_add (entries, entry);
+              break;
+            }
         }
+    }
+
+  g_slist_free (found);
+
+  if (g_hash_table_size (dispatch->keys) >= MAX_DISPATCH_KEYS)
+    g_hash_table_remove_all (dispatch->keys);
+
+  g_hash_table_insert (dispatch->keys,
+                       g_slice_dup (BindingKey, key),
+                       entries);
 
-      if (unbound)
-        return FALSE;
+  return entries;
+}
+
+static gboolean
+gtk_bindings_activate_key (GObject          *object,
+                           GdkKeymap        *keymap,
+                           const BindingKey *key,
+                           gboolean          is_release)
+{
+  BindingDispatch *dispatch;
+  GPtrArray *entries;
+  gboolean handled = FALSE;
+  guint i;
+
+  dispatch = binding_dispatch_for_object (object, keymap);
+  entries = binding_dispatch_lookup (dispatch,
+                                     binding_key_hash_for_keymap (keymap),
+                                     key);
+  if (entries->len == 0)
+    return FALSE;
+
+  /* keep our own ref, emitting a binding may change the entries */
+  g_ptr_array_ref (entries);
+
+  for (i = 0; i < entries->len; i++)
+    {
+      GtkBindingEntry *entry = g_ptr_array_index (entries, i);
+
+      if (is_release != ((entry->modifiers & GDK_RELEASE_MASK) != 0))
+        continue;
+
+      if (entry->marks_unbound)
+        break;
+
+      if (gtk_binding_entry_activate (entry, object))
+        {
+          handled = TRUE;
+          break;
+        }
     }
 
+  g_ptr_array_unref (entries);
+
   return handled;
 }
 
+/*< private >
+ * _gtk_bindings_get_dispatch_stats:
+ * @hits: (out) (allow-none): return location for the number of key
+ *     presses found in a dispatch table
+ * @misses: (out) (allow-none): return location for the number of key
+ *     presses that had to be looked up
+ *
+ * Returns how well the key binding dispatch tables work, for testing.
+ */
+void
+_gtk_bindings_get_dispatch_stats (guint *hits,
+                                  guint *misses)
+{
+  if (hits)
+    *hits = binding_dispatch_hits;
+  if (misses)
+    *misses = binding_dispatch_misses;
+}
+
 /**
  * gtk_bindings_activate:
  * @object: object to activate when binding found
@@ -1612,28 +1866,23 @@ gtk_bindings_activate (GObject         *object,
                        guint            keyval,
                        GdkModifierType  modifiers)
 {
-  GSList *entries = NULL;
   GdkDisplay *display;
-  GtkKeyHash *key_hash;
-  gboolean handled = FALSE;
+  BindingKey key = { 0, };
   gboolean is_release;
 
   if (!GTK_IS_WIDGET (object))
     return FALSE;
 
   is_release = (modifiers & GDK_RELEASE_MASK) != 0;
-  modifiers = modifiers & BINDING_MOD_MASK () & ~GDK_RELEASE_MASK;
 
-  display = gtk_widget_get_display (GTK_WIDGET (object));
-  key_hash = binding_key_hash_for_keymap (gdk_keymap_get_for_display (display));
-
-  entries = _gtk_key_hash_lookup_keyval (key_hash, keyval, modifiers);
+  key.keyval = keyval;
+  key.modifiers = modifiers & BINDING_MOD_MASK () & ~GDK_RELEASE_MASK;
 
-  handled = gtk_bindings_activate_list (object, entries, is_release);
-
-  g_slist_free (entries);
+  display = gtk_widget_get_display (GTK_WIDGET (object));
 
-  return handled;
+  return gtk_bindings_activate_key (object,
+                                    gdk_keymap_get_for_display (display),
+                                    &key, is_release);
 }
 
 /**
@@ -1652,27 +1901,25 @@ gboolean
 gtk_bindings_activate_event (GObject     *object,
                              GdkEventKey *event)
 {
-  GSList *entries = NULL;
   GdkDisplay *display;
-  GtkKeyHash *key_hash;
-  gboolean handled = FALSE;
+  BindingKey key = { 0, };
 
   if (!GTK_IS_WIDGET (object))
     return FALSE;
 
-  display = gtk_widget_get_display (GTK_WIDGET (object));
-  key_hash = binding_key_hash_for_keymap (gdk_keymap_get_for_display (display));
-
-  entries = _gtk_key_hash_lookup (key_hash,
-                                  event->hardware_keycode,
-                                  event->state,
-                                  BINDING_MOD_MASK () & ~GDK_RELEASE_MASK,
-                                  event->group);
-
-  handled = gtk_bindings_activate_list (object, entries,
-                                        event->type == GDK_KEY_RELEASE);
+  /* The keyval is implied by the other fields, but keeps apart
+   * keys the keymap translates differently */
+  key.keyval = event->keyval;
+  key.modifiers = event->state;
+  key.mask = BINDING_MOD_MASK () & ~GDK_RELEASE_MASK;
+  key.keycode = event->hardware_keycode;
+  key.group = event->group;
+  key.is_event = TRUE;
 
-  g_slist_free (entries);
+  display = gtk_widget_get_display (GTK_WIDGET (object));
 
-  return handled;
+  return gtk_bindings_activate_key (object,
+                                    gdk_keymap_get_for_display (display),
+                                    &key,
+                                    event->type == GDK_KEY_RELEASE);
 }
@@ -29,6 +29,8 @@ void  _gtk_binding_entry_add_signall (GtkBindingSet   *binding_set,
                                       GdkModifierType  modifiers,
                                       const gchar     *signal_name,
                                       GSList          *binding_args);
+void  _gtk_bindings_get_dispatch_stats (guint         *hits,
+                                        guint         *misses);
 
 G_END_DECLS
 
@@ -44,6 +44,11 @@
  * renders that pixbuf, if the #GtkCellRenderer:is-expanded property is %FALSE
  * and the #GtkCellRendererPixbuf:pixbuf-expander-closed property is set to a
  * pixbuf, it renders that one.
+ *
+ * Icons that need to be loaded from a file or stream, like a #GFileIcon
+ * set via the #GtkCellRendererPixbuf:gicon property, can be loaded in a
+ * thread by setting #GtkCellRendererPixbuf:load-async. The cell then
+ * shows a placeholder until the icon is loaded.
  */
 
 
@@ -81,7 +86,8 @@ enum {
   PROP_STOCK_DETAIL,
   PROP_FOLLOW_STATE,
   PROP_ICON_NAME,
-  PROP_GICON
+  PROP_GICON,
+  PROP_LOAD_ASYNC
 };
 
 
@@ -94,10 +100,19 @@ struct _GtkCellRendererPixbufPrivate
   GdkPixbuf *pixbuf_expander_closed;
 
   gboolean follow_state;
+  gboolean load_async;
+
+  /* the icon infos being loaded in a thread */
+  GHashTable *pending_loads;
 
   gchar *stock_detail;
 };
 
+typedef struct {
+  GtkCellRendererPixbuf *cellpixbuf;
+  GtkWidget *widget;
+} AsyncLoad;
+
 G_DEFINE_TYPE_WITH_PRIVATE (GtkCellRendererPixbuf, gtk_cell_renderer_pixbuf, GTK_TYPE_CELL_RENDERER)
 
 static void
@@ -110,6 +125,8 @@ gtk_cell_renderer_pixbuf_init (GtkCellRendererPixbuf *cellpixbuf)
 
   priv->icon_helper = _gtk_icon_helper_new ();
   priv->icon_size = GTK_ICON_SIZE_MENU;
+  priv->pending_loads = g_hash_table_new_full (g_direct_hash, g_direct_equal,
+                                               g_object_unref, NULL);
 }
 
 static void
@@ -119,6 +136,7 @@ gtk_cell_renderer_pixbuf_finalize (GObject *object)
   GtkCellRendererPixbufPrivate *priv = cellpixbuf->priv;
 
   g_clear_object (&priv->icon_helper);
+  g_hash_table_destroy (priv->pending_loads);
 
   if (priv->pixbuf_expander_open)
     g_object_unref (priv->pixbuf_expander_open);
@@ -258,6 +276,25 @@ gtk_cell_renderer_pixbuf_class_init (GtkCellRendererPixbufClass *class)
                                                         G_TYPE_ICON,
                                                         GTK_PARAM_READWRITE));
 
+  /**
+   * GtkCellRendererPixbuf:load-async:
+   *
+   * Whether a #GtkCellRendererPixbuf:gicon that needs to be loaded,
+   * like a #GFileIcon, is loaded in a thread instead of while drawing.
+   * Until it is loaded, a placeholder is drawn and the cell keeps the
+   * size of #GtkCellRendererPixbuf:stock-size; the widget is redrawn
+   * when it is done.
+   *
+   * Since: 3.10
+   */
+  g_object_class_install_property (object_class,
+                                   PROP_LOAD_ASYNC,
+                                   g_param_spec_boolean ("load-async",
+                                                         P_("Load asynchronously"),
+                                                         P_("Whether icons from files are loaded in a thread"),
+                                                         FALSE,
+                                                         GTK_PARAM_READWRITE));
+
 
 
   gtk_cell_renderer_class_set_accessible_type (cell_class, GTK_TYPE_IMAGE_CELL_ACCESSIBLE);
@@ -304,6 +341,9 @@ gtk_cell_renderer_pixbuf_get_property (GObject        *object,
     case PROP_GICON:
       g_value_set_object (value, _gtk_icon_helper_peek_gicon (priv->icon_helper));
       break;
+    case PROP_LOAD_ASYNC:
+      g_value_set_boolean (value, priv->load_async);
+      break;
     default:
       G_OBJECT_WARN_INVALID_PROPERTY_ID (object, param_id, pspec);
       break;
@@ -393,6 +433,9 @@ gtk_cell_renderer_pixbuf_set_property (GObject      *object,
       gtk_cell_renderer_pixbuf_reset (cellpixbuf);
       _gtk_icon_helper_set_gicon (priv->icon_helper, g_value_get_object (value), priv->icon_size);
       break;
+    case PROP_LOAD_ASYNC:
+      priv->load_async = g_value_get_boolean (value);
+      break;
     default:
       G_OBJECT_WARN_INVALID_PROPERTY_ID (object, param_id, pspec);
       break;
@@ -418,6 +461,85 @@ gtk_cell_renderer_pixbuf_new (void)
   return g_object_new (GTK_TYPE_CELL_RENDERER_PIXBUF, NULL);
 }
 
+/* Returns whether the icon has to be loaded from a file or
+ * stream, which we do in a thread if we were asked to.
+ */
+static gboolean
+gtk_cell_renderer_pixbuf_loads_async (GtkCellRendererPixbuf *cellpixbuf)
+{
+  GtkCellRendererPixbufPrivate *priv = cellpixbuf->priv;
+
+  if (!priv->load_async ||
+      _gtk_icon_helper_get_storage_type (priv->icon_helper) != GTK_IMAGE_GICON)
+    return FALSE;
+
+  return G_IS_LOADABLE_ICON (_gtk_icon_helper_peek_gicon (priv->icon_helper));
+}
+
+static void
+gtk_cell_renderer_pixbuf_icon_loaded (GObject      *source,
+                                      GAsyncResult *result,
+                                      gpointer      user_data)
+{
+  GtkIconInfo *info = GTK_ICON_INFO (source);
+  AsyncLoad *load = user_data;
+  GdkPixbuf *pixbuf;
+
+  /* This keeps the pixbuf, or the error, in the info, which the
+   * icon theme hands out again when the row gets drawn */
+  pixbuf = gtk_icon_info_load_icon_finish (info, result, NULL);
+  if (pixbuf)
+    g_object_unref (pixbuf);
+
+  if (_gtk_icon_info_is_loaded (info))
+    gtk_widget_queue_draw (load->widget);
+
+  g_hash_table_remove (load->cellpixbuf->priv->pending_loads, info);
+
+  g_object_unref (load->cellpixbuf);
+  g_object_unref (load->widget);
+  g_slice_free (AsyncLoad, load);
+}
+
+/* Returns whether the icon can be drawn without blocking, and
+ * starts loading it in a thread otherwise.
+ */
+static gboolean
+gtk_cell_renderer_pixbuf_ensure_loaded (GtkCellRendererPixbuf *cellpixbuf,
+                                        GtkStyleContext       *context,
+                                        GtkWidget             *widget)
+{
+  GtkCellRendererPixbufPrivate *priv = cellpixbuf->priv;
+  GtkIconInfo *info;
+  AsyncLoad *load;
+
+  info = _gtk_icon_helper_lookup_icon_info (priv->icon_helper, context);
+  if (info == NULL)
+    return TRUE;
+
+  if (_gtk_icon_info_is_loaded (info))
+    {
+      g_object_unref (info);
+      return TRUE;
+    }
+
+  if (!g_hash_table_contains (priv->pending_loads, info))
+    {
+      load = g_slice_new (AsyncLoad);
+      load->cellpixbuf = g_object_ref (cellpixbuf);
+      load->widget = g_object_ref (widget);
+
+      g_hash_table_add (priv->pending_loads, g_object_ref (info));
+      gtk_icon_info_load_icon_async (info, NULL,
+                                     gtk_cell_renderer_pixbuf_icon_loaded,
+                                     load);
+    }
+
+  g_object_unref (info);
+
+  return FALSE;
+}
+
 static void
 gtk_cell_renderer_pixbuf_get_size (GtkCellRenderer    *cell,
 				   GtkWidget          *widget,
@@ -440,7 +562,12 @@ gtk_cell_renderer_pixbuf_get_size (GtkCellRenderer    *cell,
   gtk_style_context_save (context);
   gtk_style_context_add_class (context, GTK_STYLE_CLASS_IMAGE);
 
-  if (!_gtk_icon_helper_get_is_empty (priv->icon_helper))
+  /* Don't load the icon to find its size, it is at most this big */
+  if (gtk_cell_renderer_pixbuf_loads_async (cellpixbuf))
+    _gtk_icon_helper_get_icon_size_request (priv->icon_helper,
+                                            gtk_widget_get_style_context (widget),
+                                            &pixbuf_width, &pixbuf_height);
+  else if (!_gtk_icon_helper_get_is_empty (priv->icon_helper))
     _gtk_icon_helper_get_size (priv->icon_helper, 
                                gtk_widget_get_style_context (widget),
                                &pixbuf_width, &pixbuf_height);
@@ -568,6 +695,31 @@ gtk_cell_renderer_pixbuf_render (GtkCellRenderer      *cell,
 
   _gtk_icon_helper_set_window (icon_helper,
 			       gtk_widget_get_window (widget));
+
+  if (icon_helper == priv->icon_helper &&
+      gtk_cell_renderer_pixbuf_loads_async (cellpixbuf))
+    {
+      gint width, height;
+
+      if (!gtk_cell_renderer_pixbuf_ensure_loaded (cellpixbuf, context, widget))
+        {
+          g_object_unref (icon_helper);
+          icon_helper = _gtk_icon_helper_new ();
+
+          if (gtk_icon_theme_has_icon (gtk_icon_theme_get_default (), "image-loading"))
+            {
+              _gtk_icon_helper_set_icon_name (icon_helper, "image-loading", priv->icon_size);
+              _gtk_icon_helper_set_window (icon_helper,
+                                           gtk_widget_get_window (widget));
+            }
+        }
+
+      /* The cell has the size of the icon size, center what we got */
+      _gtk_icon_helper_get_size (icon_helper, context, &width, &height);
+      pix_rect.x += MAX (0, (pix_rect.width - width) / 2);
+      pix_rect.y += MAX (0, (pix_rect.height - height) / 2);
+    }
+
   _gtk_icon_helper_draw (icon_helper,
                          context, cr,
                          pix_rect.x, pix_rect.y);
@@ -25,6 +25,7 @@
 #include "gtkentry.h"
 #include "gtksizerequest.h"
 #include "gtkmarshalers.h"
+#include "gtkpango.h"
 #include "gtkintl.h"
 #include "gtkprivate.h"
 #include "gtktreeprivate.h"
@@ -2153,7 +2154,7 @@ gtk_cell_renderer_text_get_preferred_width (GtkCellRenderer *cell,
 
   /* Fetch the length of the complete unwrapped text */
   pango_layout_set_width (layout, -1);
-  pango_layout_get_extents (layout, NULL, &rect);
+  _gtk_pango_layout_get_cached_extents (layout, &rect, NULL);
   text_width = rect.width;
 
   /* Fetch the average size of a charachter */
@@ -2215,6 +2216,7 @@ gtk_cell_renderer_text_get_preferred_height_for_width (GtkCellRenderer *cell,
 {
   GtkCellRendererText *celltext;
   PangoLayout         *layout;
+  PangoRectangle       rect;
   gint                 text_height, xpad, ypad;
 
 
@@ -2225,7 +2227,9 @@ gtk_cell_renderer_text_get_preferred_height_for_width (GtkCellRenderer *cell,
   layout = get_layout (celltext, widget, NULL, 0);
 
   pango_layout_set_width (layout, (width - xpad * 2) * PANGO_SCALE);
-  pango_layout_get_pixel_size (layout, NULL, &text_height);
+  _gtk_pango_layout_get_cached_extents (layout, &rect, NULL);
+  pango_extents_to_pixels (&rect, NULL);
+  text_height = rect.height;
 
   if (minimum_height)
     *minimum_height = text_height + ypad * 2;
@@ -29,11 +29,16 @@ struct _GtkCssValue {
   GtkCssValue  *values[1];
 };
 
+/* Table of shared computed arrays, see _gtk_css_value_intern() */
+static GHashTable *array_values = NULL;
+
 static void
 gtk_css_value_array_free (GtkCssValue *value)
 {
   guint i;
 
+  _gtk_css_value_unintern (array_values, value);
+
   for (i = 0; i < value->n_values; i++)
     {
       _gtk_css_value_unref (value->values[i]);
@@ -42,6 +47,32 @@ gtk_css_value_array_free (GtkCssValue *value)
   g_slice_free1 (sizeof (GtkCssValue) + sizeof (GtkCssValue *) * (value->n_values - 1), value);
 }
 
+static guint
+gtk_css_value_array_hash (gconstpointer data)
+{
+  const GtkCssValue *value = data;
+  guint i, hash;
+
+  hash = value->n_values;
+  for (i = 0; i < value->n_values; i++)
+    hash = (hash << 5) - hash + g_direct_hash (value->values[i]);
+
+  return hash;
+}
+
+static gboolean
+gtk_css_value_array_intern_equal (gconstpointer data1,
+                                  gconstpointer data2)
+{
+  const GtkCssValue *value1 = data1;
+  const GtkCssValue *value2 = data2;
+
+  if (value1->n_values != value2->n_values)
+    return FALSE;
+
+  return memcmp (value1->values, value2->values, sizeof (GtkCssValue *) * value1->n_values) == 0;
+}
+
 static GtkCssValue *
 gtk_css_value_array_compute (GtkCssValue             *value,
                              guint                    property_id,
@@ -80,7 +111,11 @@ gtk_css_value_array_compute (GtkCssValue             *value,
   if (result == NULL)
     return _gtk_css_value_ref (value);
 
-  return result;
+  /* The array is only filled in above, so it can't be shared any earlier */
+  return _gtk_css_value_intern (&array_values,
+                                result,
+                                gtk_css_value_array_hash,
+                                gtk_css_value_array_intern_equal);
 }
 
 static gboolean
@@ -531,7 +531,7 @@ _gtk_css_computed_values_advance (GtkCssComputedValues *values,
   GtkBitmask *changed;
   GPtrArray *old_computed_values;
   GSList *list;
-  guint i;
+  guint i, n;
 
   gtk_internal_return_val_if_fail (GTK_IS_CSS_COMPUTED_VALUES (values), NULL);
   gtk_internal_return_val_if_fail (timestamp >= values->current_time, NULL);
@@ -558,16 +558,27 @@ _gtk_css_computed_values_advance (GtkCssComputedValues *values,
         }
     }
 
-  /* figure out changes */
+  /* figure out changes. Only properties that were or are animated can
+   * have changed, and the animated values arrays are only as long as
+   * needed for the highest of those. */
   changed = _gtk_bitmask_new ();
 
-  for (i = 0; i < GTK_CSS_PROPERTY_N_PROPERTIES; i++)
+  n = 0;
+  if (old_computed_values)
+    n = old_computed_values->len;
+  if (values->animated_values)
+    n = MAX (n, values->animated_values->len);
+
+  for (i = 0; i < n; i++)
     {
       GtkCssValue *old_animated, *new_animated;
 
       old_animated = old_computed_values && i < old_computed_values->len ? g_ptr_array_index (old_computed_values, i) : NULL;
       new_animated = values->animated_values && i < values->animated_values->len ? g_ptr_array_index (values->animated_values, i) : NULL;
 
+      if (old_animated == new_animated)
+        continue;
+
       if (!_gtk_css_value_equal0 (old_animated, new_animated))
         changed = _gtk_bitmask_set (changed, i, TRUE);
     }
@@ -19,6 +19,7 @@
 
 #include "gtkcsslookupprivate.h"
 
+#include "gtkcssinitialvalueprivate.h"
 #include "gtkcsstypesprivate.h"
 #include "gtkprivatetypebuiltins.h"
 #include "gtkcssstylepropertyprivate.h"
@@ -125,6 +126,65 @@ _gtk_css_lookup_set_computed (GtkCssLookup  *lookup,
   lookup->values[id].section = section;
 }
 
+/* Computed initial values of properties that are not inherited and
+ * whose computation does not depend on anything. Most properties are
+ * never set for most widgets, so this avoids recomputing the same
+ * initial values for every style computation.
+ * The "initial" value itself marks properties where this isn't possible.
+ */
+static GPtrArray *cached_initial_values = NULL;
+
+static GtkCssValue *
+gtk_css_lookup_get_cached_initial (guint                    id,
+                                   GtkStyleProviderPrivate *provider,
+                                   int                      scale,
+                                   GtkCssComputedValues    *values,
+                                   GtkCssComputedValues    *parent_values)
+{
+  GtkCssStyleProperty *prop;
+  GtkCssDependencies dependencies;
+  GtkCssValue *value;
+
+  if (G_UNLIKELY (cached_initial_values == NULL))
+    {
+      cached_initial_values = g_ptr_array_new ();
+      g_ptr_array_set_size (cached_initial_values, _gtk_css_style_property_get_n_properties ());
+    }
+
+  value = g_ptr_array_index (cached_initial_values, id);
+  if (value == _gtk_css_initial_value_get ())
+    return NULL;
+  else if (value != NULL)
+    return value;
+
+  prop = _gtk_css_style_property_lookup_by_id (id);
+  if (_gtk_css_style_property_is_inherit (prop))
+    {
+      g_ptr_array_index (cached_initial_values, id) = _gtk_css_initial_value_get ();
+      return NULL;
+    }
+
+  value = _gtk_css_value_compute (_gtk_css_initial_value_get (),
+                                  id,
+                                  provider,
+                                  scale,
+                                  values,
+                                  parent_values,
+                                  &dependencies);
+
+  if (dependencies != 0)
+    {
+      _gtk_css_value_unref (value);
+      g_ptr_array_index (cached_initial_values, id) = _gtk_css_initial_value_get ();
+      return NULL;
+    }
+
+  /* keeps the reference */
+  g_ptr_array_index (cached_initial_values, id) = value;
+
+  return value;
+}
+
 /**
  * _gtk_css_lookup_resolve:
  * @lookup: the lookup
@@ -161,8 +221,7 @@ _gtk_css_lookup_resolve (GtkCssLookup            *lookup,
                                             lookup->values[i].computed,
                                             0,
                                             lookup->values[i].section);
-      else if (lookup->values[i].value ||
-               _gtk_bitmask_get (lookup->missing, i))
+      else if (lookup->values[i].value)
         _gtk_css_computed_values_compute_value (values,
                                                 provider,
 						scale,
@@ -170,6 +229,22 @@ _gtk_css_lookup_resolve (GtkCssLookup            *lookup,
                                                 i,
                                                 lookup->values[i].value,
                                                 lookup->values[i].section);
+      else if (_gtk_bitmask_get (lookup->missing, i))
+        {
+          GtkCssValue *initial;
+
+          initial = gtk_css_lookup_get_cached_initial (i, provider, scale, values, parent_values);
+          if (initial)
+            _gtk_css_computed_values_set_value (values, i, initial, 0, NULL);
+          else
+            _gtk_css_computed_values_compute_value (values,
+                                                    provider,
+                                                    scale,
+                                                    parent_values,
+                                                    i,
+                                                    NULL,
+                                                    NULL);
+        }
       /* else not a relevant property */
     }
 }
@@ -203,6 +203,33 @@ _gtk_css_matcher_init (GtkCssMatcher       *matcher,
   return TRUE;
 }
 
+/**
+ * _gtk_css_matcher_get_widget_path:
+ * @matcher: a matcher
+ * @state: (out): return location for the state flags
+ *
+ * Checks if @matcher is a matcher as created by _gtk_css_matcher_init()
+ * and if so, returns the path and state it was created for. Matching
+ * results for such a matcher only depend on those.
+ *
+ * Returns: the widget path of @matcher or %NULL
+ **/
+const GtkWidgetPath *
+_gtk_css_matcher_get_widget_path (const GtkCssMatcher *matcher,
+                                  GtkStateFlags       *state)
+{
+  if (matcher->klass != &GTK_CSS_MATCHER_WIDGET_PATH)
+    return NULL;
+
+  if (matcher->path.index != gtk_widget_path_length (matcher->path.path) - 1 ||
+      matcher->path.sibling_index != gtk_widget_path_iter_get_sibling_index (matcher->path.path, matcher->path.index))
+    return NULL;
+
+  *state = matcher->path.state_flags;
+
+  return matcher->path.path;
+}
+
 /* GTK_CSS_MATCHER_WIDGET_ANY */
 
 static gboolean
@@ -77,6 +77,9 @@ gboolean          _gtk_css_matcher_init           (GtkCssMatcher          *match
                                                    const GtkWidgetPath    *path,
                                                    GtkStateFlags           state) G_GNUC_WARN_UNUSED_RESULT;
 void              _gtk_css_matcher_any_init       (GtkCssMatcher          *matcher);
+const GtkWidgetPath *
+                  _gtk_css_matcher_get_widget_path (const GtkCssMatcher   *matcher,
+                                                   GtkStateFlags          *state);
 void              _gtk_css_matcher_superset_init  (GtkCssMatcher          *matcher,
                                                    const GtkCssMatcher    *subset,
                                                    GtkCssChange            relevant);
@@ -29,9 +29,14 @@ struct _GtkCssValue {
   double value;
 };
 
+/* Table of shared number values, see _gtk_css_value_intern() */
+static GHashTable *number_values = NULL;
+
 static void
 gtk_css_value_number_free (GtkCssValue *value)
 {
+  _gtk_css_value_unintern (number_values, value);
+
   g_slice_free (GtkCssValue, value);
 }
 
@@ -132,6 +137,25 @@ gtk_css_value_number_equal (const GtkCssValue *number1,
          number1->value == number2->value;
 }
 
+static guint
+gtk_css_value_number_hash (gconstpointer data)
+{
+  const GtkCssValue *number = data;
+
+  /* 0.0 and -0.0 compare equal but have different bit patterns */
+  if (number->value == 0.0)
+    return number->unit;
+
+  return g_double_hash (&number->value) ^ number->unit;
+}
+
+static gboolean
+gtk_css_value_number_intern_equal (gconstpointer number1,
+                                   gconstpointer number2)
+{
+  return gtk_css_value_number_equal (number1, number2);
+}
+
 static GtkCssValue *
 gtk_css_value_number_transition (GtkCssValue *start,
                                  GtkCssValue *end,
@@ -220,7 +244,10 @@ _gtk_css_number_value_new (double     value,
   result->unit = unit;
   result->value = value;
 
-  return result;
+  return _gtk_css_value_intern (&number_values,
+                                result,
+                                gtk_css_value_number_hash,
+                                gtk_css_value_number_intern_equal);
 }
 
 GtkCssUnit
@@ -38,6 +38,7 @@
 #include "gtkstylecontextprivate.h"
 #include "gtkstylepropertiesprivate.h"
 #include "gtkstylepropertyprivate.h"
+#include "gtkwidgetpathprivate.h"
 #include "gtkstyleproviderprivate.h"
 #include "gtkbindings.h"
 #include "gtkmarshalers.h"
@@ -1017,6 +1018,26 @@ struct _GtkCssProviderPrivate
   GArray *rulesets;
   GtkCssSelectorTree *tree;
   GResource *resource;
+
+  GHashTable *match_cache;
+  GQueue match_cache_lru;
+  guint match_cache_hits;
+  guint match_cache_misses;
+};
+
+/* Number of (widget path, state) => rulesets results to keep around.
+ * Draw functions often save the style context, add a class and restore
+ * it again, so the same queries keep coming in. */
+#define MATCH_CACHE_SIZE 256
+
+typedef struct _GtkCssMatchCacheEntry GtkCssMatchCacheEntry;
+
+struct _GtkCssMatchCacheEntry {
+  GtkWidgetPath *path;
+  GtkStateFlags  state;
+  guint          hash;
+  GPtrArray     *tree_rules;
+  GList          link;
 };
 
 enum {
@@ -1032,6 +1053,9 @@ static void gtk_css_provider_finalize (GObject *object);
 static void gtk_css_style_provider_iface_init (GtkStyleProviderIface *iface);
 static void gtk_css_style_provider_private_iface_init (GtkStyleProviderPrivateInterface *iface);
 static void widget_property_value_list_free (WidgetPropertyValue *head);
+static void verify_tree_match_results (GtkCssProvider      *provider,
+                                       const GtkCssMatcher *matcher,
+                                       GPtrArray           *tree_rules);
 
 static gboolean
 gtk_css_provider_load_internal (GtkCssProvider *css_provider,
@@ -1381,6 +1405,108 @@ gtk_css_scanner_pop_section (GtkCssScanner *scanner,
   scanner->section = parent;
 }
 
+static guint
+gtk_css_match_cache_entry_hash (gconstpointer data)
+{
+  const GtkCssMatchCacheEntry *entry = data;
+
+  return entry->hash;
+}
+
+static gboolean
+gtk_css_match_cache_entry_equal (gconstpointer data1,
+                                 gconstpointer data2)
+{
+  const GtkCssMatchCacheEntry *entry1 = data1;
+  const GtkCssMatchCacheEntry *entry2 = data2;
+
+  return entry1->hash == entry2->hash &&
+         entry1->state == entry2->state &&
+         _gtk_widget_path_equal (entry1->path, entry2->path);
+}
+
+static void
+gtk_css_match_cache_entry_free (GtkCssMatchCacheEntry *entry)
+{
+  gtk_widget_path_unref (entry->path);
+  g_ptr_array_unref (entry->tree_rules);
+  g_slice_free (GtkCssMatchCacheEntry, entry);
+}
+
+static void
+gtk_css_provider_clear_match_cache (GtkCssProvider *css_provider)
+{
+  GtkCssProviderPrivate *priv = css_provider->priv;
+  GList *l;
+
+  g_hash_table_remove_all (priv->match_cache);
+
+  while ((l = g_queue_pop_head_link (&priv->match_cache_lru)))
+    gtk_css_match_cache_entry_free (l->data);
+}
+
+/* Returns the rulesets matching @matcher, in the same order as
+ * _gtk_css_selector_tree_match_all(). Free with g_ptr_array_unref().
+ */
+static GPtrArray *
+gtk_css_provider_match (GtkCssProvider      *css_provider,
+                        const GtkCssMatcher *matcher)
+{
+  GtkCssProviderPrivate *priv = css_provider->priv;
+  GtkCssMatchCacheEntry *entry, key;
+  const GtkWidgetPath *path;
+  GtkStateFlags state;
+  GPtrArray *tree_rules;
+
+  path = _gtk_css_matcher_get_widget_path (matcher, &state);
+  if (path == NULL)
+    {
+      tree_rules = _gtk_css_selector_tree_match_all (priv->tree, matcher);
+      verify_tree_match_results (css_provider, matcher, tree_rules);
+      return tree_rules;
+    }
+
+  key.path = (GtkWidgetPath *) path;
+  key.state = state;
+  key.hash = _gtk_widget_path_hash (path) ^ state;
+
+  entry = g_hash_table_lookup (priv->match_cache, &key);
+  if (entry)
+    {
+      priv->match_cache_hits++;
+      g_queue_unlink (&priv->match_cache_lru, &entry->link);
+      g_queue_push_head_link (&priv->match_cache_lru, &entry->link);
+      return g_ptr_array_ref (entry->tree_rules);
+    }
+
+  priv->match_cache_misses++;
+
+  tree_rules = _gtk_css_selector_tree_match_all (priv->tree, matcher);
+  verify_tree_match_results (css_provider, matcher, tree_rules);
+
+  if (priv->match_cache_lru.length >= MATCH_CACHE_SIZE)
+    {
+      GList *last = g_queue_pop_tail_link (&priv->match_cache_lru);
+
+      g_hash_table_remove (priv->match_cache, last->data);
+      gtk_css_match_cache_entry_free (last->data);
+    }
+
+  entry = g_slice_new (GtkCssMatchCacheEntry);
+  entry->path = gtk_widget_path_copy (path);
+  entry->state = state;
+  entry->hash = key.hash;
+  entry->tree_rules = g_ptr_array_ref (tree_rules);
+  entry->link.data = entry;
+  entry->link.prev = NULL;
+  entry->link.next = NULL;
+
+  g_hash_table_add (priv->match_cache, entry);
+  g_queue_push_head_link (&priv->match_cache_lru, &entry->link);
+
+  return tree_rules;
+}
+
 static void
 gtk_css_provider_init (GtkCssProvider *css_provider)
 {
@@ -1396,6 +1522,9 @@ gtk_css_provider_init (GtkCssProvider *css_provider)
   priv->keyframes = g_hash_table_new_full (g_str_hash, g_str_equal,
                                            (GDestroyNotify) g_free,
                                            (GDestroyNotify) _gtk_css_value_unref);
+  priv->match_cache = g_hash_table_new (gtk_css_match_cache_entry_hash,
+                                        gtk_css_match_cache_entry_equal);
+  g_queue_init (&priv->match_cache_lru);
 }
 
 static void
@@ -1581,8 +1710,7 @@ gtk_css_style_provider_lookup (GtkStyleProviderPrivate *provider,
   css_provider = GTK_CSS_PROVIDER (provider);
   priv = css_provider->priv;
 
-  tree_rules = _gtk_css_selector_tree_match_all (priv->tree, matcher);
-  verify_tree_match_results (css_provider, matcher, tree_rules);
+  tree_rules = gtk_css_provider_match (css_provider, matcher);
 
   for (i = tree_rules->len - 1; i >= 0; i--)
     {
@@ -1613,7 +1741,7 @@ gtk_css_style_provider_lookup (GtkStyleProviderPrivate *provider,
         break;
     }
 
-  g_ptr_array_free (tree_rules, TRUE);
+  g_ptr_array_unref (tree_rules);
 }
 
 static GtkCssChange
@@ -1659,6 +1787,9 @@ gtk_css_provider_finalize (GObject *object)
   g_array_free (priv->rulesets, TRUE);
   _gtk_css_selector_tree_free (priv->tree);
 
+  gtk_css_provider_clear_match_cache (css_provider);
+  g_hash_table_destroy (priv->match_cache);
+
   g_hash_table_destroy (priv->symbolic_colors);
   g_hash_table_destroy (priv->keyframes);
 
@@ -1798,6 +1929,8 @@ gtk_css_provider_reset (GtkCssProvider *css_provider)
   _gtk_css_selector_tree_free (priv->tree);
   priv->tree = NULL;
 
+  gtk_css_provider_clear_match_cache (css_provider);
+
 }
 
 static void
@@ -2435,6 +2568,9 @@ gtk_css_provider_postprocess (GtkCssProvider *css_provider)
   GtkCssSelectorTreeBuilder *builder;
   guint i;
 
+  /* Cached matches point into the rulesets array */
+  gtk_css_provider_clear_match_cache (css_provider);
+
   g_array_sort (priv->rulesets, gtk_css_provider_compare_rule);
 
   builder = _gtk_css_selector_tree_builder_new ();
@@ -2845,6 +2981,22 @@ _gtk_css_provider_load_named (GtkCssProvider *provider,
     }
 }
 
+/* For tests: the number of selector matches answered from the
+ * match cache, and the number that had to be computed.
+ */
+void
+_gtk_css_provider_get_match_cache_stats (GtkCssProvider *provider,
+                                         guint          *hits,
+                                         guint          *misses)
+{
+  g_return_if_fail (GTK_IS_CSS_PROVIDER (provider));
+
+  if (hits)
+    *hits = provider->priv->match_cache_hits;
+  if (misses)
+    *misses = provider->priv->match_cache_misses;
+}
+
 /**
  * gtk_css_provider_get_named:
  * @name: A theme name
@@ -28,6 +28,10 @@ void   _gtk_css_provider_load_named    (GtkCssProvider *provider,
                                         const gchar    *name,
                                         const gchar    *variant);
 
+void   _gtk_css_provider_get_match_cache_stats (GtkCssProvider *provider,
+                                                guint          *hits,
+                                                guint          *misses);
+
 G_END_DECLS
 
 #endif /* __GTK_CSS_PROVIDER_PRIVATE_H__ */
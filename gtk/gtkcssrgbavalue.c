@@ -27,9 +27,14 @@ struct _GtkCssValue {
   GdkRGBA rgba;
 };
 
+/* Table of shared color values, see _gtk_css_value_intern() */
+static GHashTable *rgba_values = NULL;
+
 static void
 gtk_css_value_rgba_free (GtkCssValue *value)
 {
+  _gtk_css_value_unintern (rgba_values, value);
+
   g_slice_free (GtkCssValue, value);
 }
 
@@ -52,6 +57,21 @@ gtk_css_value_rgba_equal (const GtkCssValue *rgba1,
   return gdk_rgba_equal (&rgba1->rgba, &rgba2->rgba);
 }
 
+static guint
+gtk_css_value_rgba_hash (gconstpointer data)
+{
+  const GtkCssValue *rgba = data;
+
+  return gdk_rgba_hash (&rgba->rgba);
+}
+
+static gboolean
+gtk_css_value_rgba_intern_equal (gconstpointer rgba1,
+                                 gconstpointer rgba2)
+{
+  return gtk_css_value_rgba_equal (rgba1, rgba2);
+}
+
 static GtkCssValue *
 gtk_css_value_rgba_transition (GtkCssValue *start,
                                GtkCssValue *end,
@@ -96,7 +116,10 @@ _gtk_css_rgba_value_new_from_rgba (const GdkRGBA *rgba)
   value = _gtk_css_value_new (GtkCssValue, &GTK_CSS_VALUE_RGBA);
   value->rgba = *rgba;
 
-  return value;
+  return _gtk_css_value_intern (&rgba_values,
+                                value,
+                                gtk_css_value_rgba_hash,
+                                gtk_css_value_rgba_intern_equal);
 }
 
 const GdkRGBA *
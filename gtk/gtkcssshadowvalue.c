@@ -54,9 +54,14 @@ static GtkCssValue *    gtk_css_shadow_value_new (GtkCssValue *hoffset,
                                                   gboolean     inset,
                                                   GtkCssValue *color);
 
+/* Table of shared shadow values, see _gtk_css_value_intern() */
+static GHashTable *shadow_values = NULL;
+
 static void
 gtk_css_value_shadow_free (GtkCssValue *shadow)
 {
+  _gtk_css_value_unintern (shadow_values, shadow);
+
   _gtk_css_value_unref (shadow->hoffset);
   _gtk_css_value_unref (shadow->voffset);
   _gtk_css_value_unref (shadow->radius);
@@ -158,6 +163,36 @@ gtk_css_value_shadow_print (const GtkCssValue *shadow,
 
 }
 
+/* Numbers and colors are interned themselves, so comparing the
+ * pointers of the components is enough for sharing shadows. */
+static guint
+gtk_css_value_shadow_hash (gconstpointer data)
+{
+  const GtkCssValue *shadow = data;
+
+  return g_direct_hash (shadow->hoffset)
+       ^ (g_direct_hash (shadow->voffset) << 3)
+       ^ (g_direct_hash (shadow->radius) << 6)
+       ^ (g_direct_hash (shadow->spread) << 9)
+       ^ (g_direct_hash (shadow->color) << 12)
+       ^ shadow->inset;
+}
+
+static gboolean
+gtk_css_value_shadow_intern_equal (gconstpointer data1,
+                                   gconstpointer data2)
+{
+  const GtkCssValue *shadow1 = data1;
+  const GtkCssValue *shadow2 = data2;
+
+  return shadow1->inset == shadow2->inset
+      && shadow1->hoffset == shadow2->hoffset
+      && shadow1->voffset == shadow2->voffset
+      && shadow1->radius == shadow2->radius
+      && shadow1->spread == shadow2->spread
+      && shadow1->color == shadow2->color;
+}
+
 static const GtkCssValueClass GTK_CSS_VALUE_SHADOW = {
   gtk_css_value_shadow_free,
   gtk_css_value_shadow_compute,
@@ -185,7 +220,10 @@ gtk_css_shadow_value_new (GtkCssValue *hoffset,
   retval->inset = inset;
   retval->color = color;
 
-  return retval;
+  return _gtk_css_value_intern (&shadow_values,
+                                retval,
+                                gtk_css_value_shadow_hash,
+                                gtk_css_value_shadow_intern_equal);
 }                  
 
 GtkCssValue *
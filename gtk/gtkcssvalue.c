@@ -29,6 +29,28 @@ struct _GtkCssValue {
 
 G_DEFINE_BOXED_TYPE (GtkCssValue, _gtk_css_value, _gtk_css_value_ref, _gtk_css_value_unref)
 
+/* Values may be created and freed outside of the main thread,
+ * so the intern tables are protected by a lock */
+G_LOCK_DEFINE_STATIC (intern_tables);
+
+/* Takes a reference on @value unless its last one is being dropped
+ * in another thread, which is then waiting to unintern it */
+static gboolean
+_gtk_css_value_try_ref (GtkCssValue *value)
+{
+  gint ref_count;
+
+  do
+    {
+      ref_count = g_atomic_int_get (&value->ref_count);
+      if (ref_count == 0)
+        return FALSE;
+    }
+  while (!g_atomic_int_compare_and_exchange (&value->ref_count, ref_count, ref_count + 1));
+
+  return TRUE;
+}
+
 GtkCssValue *
 _gtk_css_value_alloc (const GtkCssValueClass *klass,
                       gsize                   size)
@@ -65,6 +87,82 @@ _gtk_css_value_unref (GtkCssValue *value)
   value->class->free (value);
 }
 
+/**
+ * _gtk_css_value_intern:
+ * @table: (inout): location of the intern table for the value's class
+ * @value: (transfer full): a newly created value
+ * @hash_func: hash function for values in @table
+ * @equal_func: equality function for values in @table
+ *
+ * Looks up a value equal to @value in @table and returns it instead of
+ * @value if one exists, so that identical values are shared and can be
+ * compared by pointer. Otherwise @value is added to @table.
+ *
+ * Value classes using this function must call _gtk_css_value_unintern()
+ * from their free function.
+ *
+ * Returns: (transfer full): @value or an equal value from @table
+ **/
+GtkCssValue *
+_gtk_css_value_intern (GHashTable  **table,
+                       GtkCssValue  *value,
+                       GHashFunc     hash_func,
+                       GEqualFunc    equal_func)
+{
+  GtkCssValue *interned;
+
+  gtk_internal_return_val_if_fail (table != NULL, value);
+  gtk_internal_return_val_if_fail (value != NULL, NULL);
+
+  /* Values that aren't equal to themselves (think NaN) could never be
+   * found again to be removed from the table. */
+  if (!equal_func (value, value))
+    return value;
+
+  G_LOCK (intern_tables);
+
+  if (*table == NULL)
+    *table = g_hash_table_new (hash_func, equal_func);
+
+  interned = g_hash_table_lookup (*table, value);
+  if (interned != NULL && _gtk_css_value_try_ref (interned))
+    {
+      G_UNLOCK (intern_tables);
+      _gtk_css_value_unref (value);
+      return interned;
+    }
+
+  /* Replaces a value that is being freed */
+  g_hash_table_add (*table, value);
+
+  G_UNLOCK (intern_tables);
+
+  return value;
+}
+
+/**
+ * _gtk_css_value_unintern:
+ * @table: the intern table passed to _gtk_css_value_intern()
+ * @value: a value that is being freed
+ *
+ * Removes @value from @table if it is the interned instance.
+ * Equal values that were not interned are left alone.
+ **/
+void
+_gtk_css_value_unintern (GHashTable  *table,
+                         GtkCssValue *value)
+{
+  if (table == NULL)
+    return;
+
+  G_LOCK (intern_tables);
+
+  if (g_hash_table_lookup (table, value) == value)
+    g_hash_table_remove (table, value);
+
+  G_UNLOCK (intern_tables);
+}
+
 /**
  * _gtk_css_value_compute:
  * @value: the value to compute from
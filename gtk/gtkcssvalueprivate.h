@@ -66,6 +66,13 @@ GtkCssValue *_gtk_css_value_alloc                     (const GtkCssValueClass
 GtkCssValue *_gtk_css_value_ref                       (GtkCssValue                *value);
 void         _gtk_css_value_unref                     (GtkCssValue                *value);
 
+GtkCssValue *_gtk_css_value_intern                    (GHashTable                **table,
+                                                       GtkCssValue                *value,
+                                                       GHashFunc                   hash_func,
+                                                       GEqualFunc                  equal_func);
+void         _gtk_css_value_unintern                  (GHashTable                 *table,
+                                                       GtkCssValue                *value);
+
 GtkCssValue *_gtk_css_value_compute                   (GtkCssValue                *value,
                                                        guint                       property_id,
                                                        GtkStyleProviderPrivate    *provider,
@@ -6270,6 +6270,28 @@ search_engine_hits_added_cb (GtkSearchEngine *engine,
     search_add_hit (impl, (gchar*)l->data);
 }
 
+/* Callback used from GtkSearchEngine when hits went away, like when
+ * it found files reported from its index to be gone */
+static void
+search_engine_hits_subtracted_cb (GtkSearchEngine *engine,
+                                  GList           *hits,
+                                  gpointer         data)
+{
+  GtkFileChooserDefault *impl;
+  GList *l;
+
+  impl = GTK_FILE_CHOOSER_DEFAULT (data);
+
+  for (l = hits; l; l = l->next)
+    {
+      GFile *file;
+
+      file = g_file_new_for_uri (l->data);
+      _gtk_file_system_model_remove_file (impl->priv->search_model, file);
+      g_object_unref (file);
+    }
+}
+
 /* Callback used from GtkSearchEngine when the query is done running */
 static void
 search_engine_finished_cb (GtkSearchEngine *engine,
@@ -6426,6 +6448,8 @@ search_start_query (GtkFileChooserDefault *impl,
 
   g_signal_connect (priv->search_engine, "hits-added",
 		    G_CALLBACK (search_engine_hits_added_cb), impl);
+  g_signal_connect (priv->search_engine, "hits-subtracted",
+		    G_CALLBACK (search_engine_hits_subtracted_cb), impl);
   g_signal_connect (priv->search_engine, "finished",
 		    G_CALLBACK (search_engine_finished_cb), impl);
   g_signal_connect (priv->search_engine, "error",
@@ -115,6 +115,12 @@
  * freeze_updates()) during the intial population process.  When the model is
  * frozen, sorting will not happen.  The model will sort itself when the freeze
  * count goes back to zero, via corresponding calls to thaw_updates().
+ *
+ * The first model->n_nodes_sorted nodes are known to be in sorted order.  Files
+ * added while loading a folder are appended to the array, so when the model is
+ * thawed only these new nodes need to be sorted and are then merged with the
+ * existing ones.  Whenever a node's sort key may change, model->n_nodes_sorted is
+ * lowered to that node's index.
  */
 
 /*** DEFINES ***/
@@ -159,6 +165,7 @@ struct _GtkFileSystemModel
   GArray *              files;          /* array of FileModelNode containing all our files */
   gsize                 node_size;	/* Size of a FileModelNode structure once its ->values field has n_columns */
   guint                 n_nodes_valid;  /* count of valid nodes (i.e. those whose node->row is accurate) */
+  guint                 n_nodes_sorted; /* count of nodes known to be sorted, see "Sorting" above */
   GHashTable *          file_lookup;    /* mapping of GFile => array index in model->files
 					 * This hash table doesn't always have the same number of entries as the files array;
 					 * it can get cleared completely when we resort.
@@ -766,6 +773,62 @@ compare_array_element (gconstpointer a, gconstpointer b, gpointer user_data)
   return data->func (GTK_TREE_MODEL (data->model), &itera, &iterb, data->data) * data->order;
 }
 
+/* Sorts the nodes that were added or changed since the last sort and
+ * merges them into the already sorted nodes. */
+static void
+sort_nodes (GtkFileSystemModel *model,
+            SortData           *data)
+{
+  guint n_sorted, n_nodes, i, j;
+  gsize node_size = model->node_size;
+  char *merged, *dest;
+
+  /* don't sort the editable row */
+  n_sorted = MAX (model->n_nodes_sorted, 1);
+  n_nodes = model->files->len;
+
+  if (n_sorted >= n_nodes)
+    return;
+
+  g_qsort_with_data (get_node (model, n_sorted),
+                     n_nodes - n_sorted,
+                     node_size,
+                     compare_array_element,
+                     data);
+
+  if (n_sorted > 1)
+    {
+      /* The comparison function looks up nodes by their index in
+       * model->files, so merge into a separate buffer and copy back. */
+      merged = g_malloc ((n_nodes - 1) * node_size);
+      dest = merged;
+
+      for (i = 1, j = n_sorted; i < n_sorted && j < n_nodes; dest += node_size)
+        {
+          if (compare_array_element (get_node (model, j), get_node (model, i), data) < 0)
+            {
+              memcpy (dest, get_node (model, j), node_size);
+              j++;
+            }
+          else
+            {
+              memcpy (dest, get_node (model, i), node_size);
+              i++;
+            }
+        }
+
+      if (i < n_sorted)
+        memcpy (dest, get_node (model, i), (n_sorted - i) * node_size);
+      else if (j < n_nodes)
+        memcpy (dest, get_node (model, j), (n_nodes - j) * node_size);
+
+      memcpy (get_node (model, 1), merged, (n_nodes - 1) * node_size);
+      g_free (merged);
+    }
+
+  model->n_nodes_sorted = n_nodes;
+}
+
 static void
 gtk_file_system_model_sort (GtkFileSystemModel *model)
 {
@@ -787,11 +850,7 @@ gtk_file_system_model_sort (GtkFileSystemModel *model)
       n_visible_rows = node_get_tree_row (model, model->files->len - 1) + 1;
       model->n_nodes_valid = 0;
       g_hash_table_remove_all (model->file_lookup);
-      g_qsort_with_data (get_node (model, 1), /* start at index 1; don't sort the editable row */
-                         model->files->len - 1,
-                         model->node_size,
-                         compare_array_element,
-                         &data);
+      sort_nodes (model, &data);
       g_assert (model->n_nodes_valid == 0);
       g_assert (g_hash_table_size (model->file_lookup) == 0);
       if (n_visible_rows)
@@ -829,7 +888,17 @@ gtk_file_system_model_sort (GtkFileSystemModel *model)
 static void
 gtk_file_system_model_sort_node (GtkFileSystemModel *model, guint node)
 {
-  /* FIXME: improve */
+  model->n_nodes_sorted = MIN (model->n_nodes_sorted, node);
+
+  gtk_file_system_model_sort (model);
+}
+
+/* Sorts all nodes, for when the sort order changes */
+static void
+gtk_file_system_model_resort (GtkFileSystemModel *model)
+{
+  model->n_nodes_sorted = 0;
+
   gtk_file_system_model_sort (model);
 }
 
@@ -888,7 +957,7 @@ gtk_file_system_model_set_sort_column_id (GtkTreeSortable  *sortable,
 
   gtk_tree_sortable_sort_column_changed (sortable);
 
-  gtk_file_system_model_sort (model);
+  gtk_file_system_model_resort (model);
 }
 
 static void
@@ -905,7 +974,7 @@ gtk_file_system_model_set_sort_func (GtkTreeSortable        *sortable,
                                                      func, data, destroy);
 
   if (model->sort_column_id == sort_column_id)
-    gtk_file_system_model_sort (model);
+    gtk_file_system_model_resort (model);
 }
 
 static void
@@ -929,7 +998,7 @@ gtk_file_system_model_set_default_sort_func (GtkTreeSortable        *sortable,
   model->default_sort_destroy = destroy;
 
   if (model->sort_column_id == GTK_TREE_SORTABLE_DEFAULT_SORT_COLUMN_ID)
-    gtk_file_system_model_sort (model);
+    gtk_file_system_model_resort (model);
 }
 
 static gboolean
@@ -1906,12 +1975,29 @@ remove_file (GtkFileSystemModel *model,
     g_object_unref (node->info);
 
   g_array_remove_index (model->files, id);
+  if (id < model->n_nodes_sorted)
+    model->n_nodes_sorted--;
 
   /* We don't need to resort, as removing a row doesn't change the sorting order of the other rows */
 
   emit_row_deleted_for_row (model, row);
 }
 
+/**
+ * _gtk_file_system_model_remove_file:
+ * @model: the model
+ * @file: the file to remove
+ *
+ * Removes @file from the model, like when it was deleted. If the file
+ * is not part of @model, this function does nothing.
+ **/
+void
+_gtk_file_system_model_remove_file (GtkFileSystemModel *model,
+                                    GFile              *file)
+{
+  remove_file (model, file);
+}
+
 /**
  * _gtk_file_system_model_update_file:
  * @model: the model
@@ -1944,6 +2030,9 @@ _gtk_file_system_model_update_file (GtkFileSystemModel *model,
 
   node = get_node (model, id);
 
+  /* the new info may sort differently */
+  model->n_nodes_sorted = MIN (model->n_nodes_sorted, id);
+
   old_info = node->info;
   node->info = g_object_ref (info);
   if (old_info)
@@ -2134,6 +2223,7 @@ _gtk_file_system_model_clear_cache (GtkFileSystemModel *model,
     }
 
   /* FIXME: resort? */
+  model->n_nodes_sorted = 0;
 }
 
 /**
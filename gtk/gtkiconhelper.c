@@ -54,6 +54,139 @@ struct _GtkIconHelperPrivate {
 
 G_DEFINE_TYPE_WITH_PRIVATE (GtkIconHelper, _gtk_icon_helper, G_TYPE_OBJECT)
 
+/* Surfaces for icons looked up from the icon theme, shared between
+ * all icon helpers. The icon theme hands out the same pixbuf for the
+ * same icon, size and colors, so we key on that pixbuf and avoid
+ * converting it to a surface once per widget. The budget covers the
+ * surfaces and the pixbufs we keep alive for them.
+ */
+#define SURFACE_CACHE_MAX_SIZE (8 * 1024 * 1024)
+
+typedef struct {
+  GdkPixbuf *pixbuf;
+  GdkVisual *visual;
+  gint scale;
+  cairo_surface_t *surface;
+  gsize size;           /* of the surface and the pixbuf */
+  GList link;
+} SurfaceCacheEntry;
+
+static GHashTable *surface_cache = NULL;
+static GQueue surface_cache_lru = G_QUEUE_INIT;
+static gsize surface_cache_size = 0;
+static guint surface_cache_hits = 0;
+static guint surface_cache_misses = 0;
+
+static guint
+surface_cache_entry_hash (gconstpointer data)
+{
+  const SurfaceCacheEntry *entry = data;
+
+  return g_direct_hash (entry->pixbuf) ^ g_direct_hash (entry->visual) ^ entry->scale;
+}
+
+static gboolean
+surface_cache_entry_equal (gconstpointer a,
+                           gconstpointer b)
+{
+  const SurfaceCacheEntry *entry_a = a;
+  const SurfaceCacheEntry *entry_b = b;
+
+  return entry_a->pixbuf == entry_b->pixbuf &&
+         entry_a->visual == entry_b->visual &&
+         entry_a->scale == entry_b->scale;
+}
+
+static void
+surface_cache_entry_free (SurfaceCacheEntry *entry)
+{
+  g_object_unref (entry->pixbuf);
+  cairo_surface_destroy (entry->surface);
+  g_slice_free (SurfaceCacheEntry, entry);
+}
+
+static cairo_surface_t *
+get_cached_surface (GdkPixbuf *pixbuf,
+                    gint       scale,
+                    GdkWindow *window)
+{
+  SurfaceCacheEntry lookup, *entry;
+
+  if (surface_cache == NULL)
+    surface_cache = g_hash_table_new_full (surface_cache_entry_hash,
+                                           surface_cache_entry_equal,
+                                           (GDestroyNotify) surface_cache_entry_free,
+                                           NULL);
+
+  lookup.pixbuf = pixbuf;
+  lookup.visual = window ? gdk_window_get_visual (window) : NULL;
+  lookup.scale = scale;
+
+  entry = g_hash_table_lookup (surface_cache, &lookup);
+  if (entry)
+    {
+      surface_cache_hits++;
+      g_queue_unlink (&surface_cache_lru, &entry->link);
+      g_queue_push_head_link (&surface_cache_lru, &entry->link);
+
+      return cairo_surface_reference (entry->surface);
+    }
+
+  surface_cache_misses++;
+
+  entry = g_slice_new (SurfaceCacheEntry);
+  entry->pixbuf = g_object_ref (pixbuf);
+  entry->visual = lookup.visual;
+  entry->scale = scale;
+  entry->surface = gdk_cairo_surface_create_from_pixbuf (pixbuf, scale, window);
+  entry->size = (gsize) gdk_pixbuf_get_rowstride (pixbuf) * gdk_pixbuf_get_height (pixbuf);
+  if (cairo_surface_get_type (entry->surface) == CAIRO_SURFACE_TYPE_IMAGE)
+    entry->size += (gsize) cairo_image_surface_get_stride (entry->surface) *
+                   cairo_image_surface_get_height (entry->surface);
+  else
+    entry->size += (gsize) gdk_pixbuf_get_width (pixbuf) * gdk_pixbuf_get_height (pixbuf) * 4;
+  entry->link.data = entry;
+  entry->link.prev = entry->link.next = NULL;
+
+  g_hash_table_add (surface_cache, entry);
+  g_queue_push_head_link (&surface_cache_lru, &entry->link);
+  surface_cache_size += entry->size;
+
+  while (surface_cache_size > SURFACE_CACHE_MAX_SIZE &&
+         surface_cache_lru.length > 1)
+    {
+      SurfaceCacheEntry *oldest = surface_cache_lru.tail->data;
+
+      g_queue_unlink (&surface_cache_lru, &oldest->link);
+      surface_cache_size -= oldest->size;
+      g_hash_table_remove (surface_cache, oldest);
+    }
+
+  GTK_NOTE (ICONTHEME,
+            g_print ("icon surface cache: %u hits, %u misses, %u entries, %" G_GSIZE_FORMAT " bytes\n",
+                     surface_cache_hits, surface_cache_misses,
+                     surface_cache_lru.length, surface_cache_size));
+
+  return cairo_surface_reference (entry->surface);
+}
+
+/* For the test suite */
+void
+_gtk_icon_helper_get_surface_cache_stats (guint *hits,
+                                          guint *misses,
+                                          guint *n_entries,
+                                          gsize *size)
+{
+  if (hits)
+    *hits = surface_cache_hits;
+  if (misses)
+    *misses = surface_cache_misses;
+  if (n_entries)
+    *n_entries = surface_cache_lru.length;
+  if (size)
+    *size = surface_cache_size;
+}
+
 void
 _gtk_icon_helper_clear (GtkIconHelper *self)
 {
@@ -628,8 +761,10 @@ ensure_stated_surface_from_info (GtkIconHelper *self,
   GdkPixbuf *destination = NULL;
   cairo_surface_t *surface;
   gboolean symbolic;
+  gboolean cacheable;
 
   symbolic = FALSE;
+  cacheable = FALSE;
 
   if (info)
     destination =
@@ -638,6 +773,10 @@ ensure_stated_surface_from_info (GtkIconHelper *self,
 					       &symbolic,
 					       NULL);
 
+  /* Symbolic icons come from the icon info's cache for the given colors */
+  if (destination != NULL && symbolic)
+    cacheable = TRUE;
+
   if (destination == NULL)
     {
       GtkIconSet *icon_set;
@@ -673,6 +812,10 @@ ensure_stated_surface_from_info (GtkIconHelper *self,
 
       G_GNUC_END_IGNORE_DEPRECATIONS;
 
+      /* Unless the state changed the icon, this is the pixbuf owned
+       * by the icon info, which we can share */
+      cacheable = rendered == destination;
+
       g_object_unref (destination);
       destination = rendered;
     }
@@ -680,7 +823,10 @@ ensure_stated_surface_from_info (GtkIconHelper *self,
   surface = NULL;
   if (destination)
     {
-      surface = gdk_cairo_surface_create_from_pixbuf (destination, scale, self->priv->window);
+      if (cacheable)
+        surface = get_cached_surface (destination, scale, self->priv->window);
+      else
+        surface = gdk_cairo_surface_create_from_pixbuf (destination, scale, self->priv->window);
 
       self->priv->rendered_surface_width = 
 	(gdk_pixbuf_get_width (destination) + scale - 1) / scale;
@@ -691,46 +837,53 @@ ensure_stated_surface_from_info (GtkIconHelper *self,
   self->priv->rendered_surface = surface;
 }
 
-static void
-ensure_surface_for_icon_name_or_gicon (GtkIconHelper *self,
-				       GtkStyleContext *context)
+static GtkIconInfo *
+lookup_icon_info (GtkIconHelper *self,
+                  GtkStyleContext *context,
+                  gint scale)
 {
   GtkIconTheme *icon_theme;
-  gint width, height, scale;
-  GtkIconInfo *info;
+  gint width, height;
   GtkIconLookupFlags flags;
 
-  if (!check_invalidate_surface (self, context))
-    return;
-
   icon_theme = gtk_icon_theme_get_default ();
   flags = get_icon_lookup_flags (self);
 
   ensure_icon_size (self, context, &width, &height);
-  scale = get_scale_factor (self, context);
 
   if (self->priv->storage_type == GTK_IMAGE_ICON_NAME &&
       self->priv->icon_name != NULL)
     {
-      info = gtk_icon_theme_lookup_icon_for_scale (icon_theme,
-						   self->priv->icon_name,
-						   MIN (width, height),
-						   scale, flags);
+      return gtk_icon_theme_lookup_icon_for_scale (icon_theme,
+                                                   self->priv->icon_name,
+                                                   MIN (width, height),
+                                                   scale, flags);
     }
   else if (self->priv->storage_type == GTK_IMAGE_GICON &&
            self->priv->gicon != NULL)
     {
-      info = gtk_icon_theme_lookup_by_gicon_for_scale (icon_theme,
-						       self->priv->gicon,
-						       MIN (width, height),
-						       scale, flags);
-    }
-  else
-    {
-      g_assert_not_reached ();
-      return;
+      return gtk_icon_theme_lookup_by_gicon_for_scale (icon_theme,
+                                                       self->priv->gicon,
+                                                       MIN (width, height),
+                                                       scale, flags);
     }
 
+  return NULL;
+}
+
+static void
+ensure_surface_for_icon_name_or_gicon (GtkIconHelper *self,
+				       GtkStyleContext *context)
+{
+  gint scale;
+  GtkIconInfo *info;
+
+  if (!check_invalidate_surface (self, context))
+    return;
+
+  scale = get_scale_factor (self, context);
+  info = lookup_icon_info (self, context, scale);
+
   ensure_stated_surface_from_info (self, context, info, scale);
 
   if (info)
@@ -788,6 +941,28 @@ _gtk_icon_helper_ensure_surface (GtkIconHelper *self,
   return surface;
 }
 
+/* Returns the icon info that drawing an icon name or GIcon uses,
+ * so that it can be loaded asynchronously before.
+ */
+GtkIconInfo *
+_gtk_icon_helper_lookup_icon_info (GtkIconHelper *self,
+                                   GtkStyleContext *context)
+{
+  return lookup_icon_info (self, context, get_scale_factor (self, context));
+}
+
+/* Returns the size an icon name or GIcon is drawn at, without
+ * loading it; the icon itself may be smaller.
+ */
+void
+_gtk_icon_helper_get_icon_size_request (GtkIconHelper *self,
+                                        GtkStyleContext *context,
+                                        gint *width_out,
+                                        gint *height_out)
+{
+  ensure_icon_size (self, context, width_out, height_out);
+}
+
 void
 _gtk_icon_helper_get_size (GtkIconHelper *self,
                            GtkStyleContext *context,
@@ -127,6 +127,12 @@ void _gtk_icon_helper_get_size (GtkIconHelper *self,
                                 GtkStyleContext *context,
                                 gint *width_out,
                                 gint *height_out);
+void _gtk_icon_helper_get_icon_size_request (GtkIconHelper *self,
+                                             GtkStyleContext *context,
+                                             gint *width_out,
+                                             gint *height_out);
+GtkIconInfo *_gtk_icon_helper_lookup_icon_info (GtkIconHelper *self,
+                                                GtkStyleContext *context);
 
 void _gtk_icon_helper_draw (GtkIconHelper *self,
                             GtkStyleContext *context,
@@ -138,6 +144,11 @@ gboolean _gtk_icon_helper_get_force_scale_pixbuf (GtkIconHelper *self);
 void     _gtk_icon_helper_set_force_scale_pixbuf (GtkIconHelper *self,
                                                   gboolean       force_scale);
 
+void _gtk_icon_helper_get_surface_cache_stats (guint *hits,
+                                               guint *misses,
+                                               guint *n_entries,
+                                               gsize *size);
+
 
 G_END_DECLS
 
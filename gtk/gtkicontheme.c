@@ -166,6 +166,8 @@ typedef enum
 } IconSuffix;
 
 #define INFO_CACHE_LRU_SIZE 32
+#define LOADABLE_CACHE_SIZE 128
+#define LOADABLE_CACHE_MAX_BYTES (16 * 1024 * 1024)
 #if 0
 #define DEBUG_CACHE(args) g_print args
 #else
@@ -177,6 +179,14 @@ struct _GtkIconThemePrivate
   GHashTable *info_cache;
   GList *info_cache_lru;
 
+  /* Icon infos for GLoadableIcons, most recently used first, so
+   * that e.g. thumbnails shown in a cell renderer don't get loaded
+   * again for every redraw
+   */
+  GHashTable *loadable_cache;
+  GQueue loadable_cache_lru;
+  gsize loadable_cache_bytes;
+
   gchar *current_theme;
   gchar **search_path;
   gint search_path_len;
@@ -186,6 +196,7 @@ struct _GtkIconThemePrivate
   guint pixbuf_supports_svg : 1;
   guint themes_valid        : 1;
   guint loading_themes      : 1;
+  guint all_icons_complete  : 1;
 
   /* A list of all the themes needed to look up icons.
    * In search order, without duplicates
@@ -194,7 +205,9 @@ struct _GtkIconThemePrivate
   GHashTable *unthemed_icons;
 
   /* Note: The keys of this hashtable are owned by the
-   * themedir and unthemed hashtables.
+   * themedir and unthemed hashtables. Icons of uncached
+   * theme directories are only in it once all_icons_complete
+   * is set.
    */
   GHashTable *all_icons;
 
@@ -216,6 +229,22 @@ typedef struct {
   GtkIconLookupFlags flags;
 } IconInfoKey;
 
+typedef struct {
+  GIcon *icon;
+  gint size;
+  gint scale;
+  GtkIconLookupFlags flags;
+} LoadableInfoKey;
+
+typedef struct {
+  LoadableInfoKey key;
+  GtkIconInfo *info;
+  GtkIconTheme *icon_theme;
+  GFileMonitor *monitor; /* of the file of a GFileIcon */
+  gsize bytes;           /* of the pixbuf, estimated until it is loaded */
+  GList link;            /* in loadable_cache_lru */
+} LoadableCacheEntry;
+
 typedef struct _SymbolicPixbufCache SymbolicPixbufCache;
 
 struct _SymbolicPixbufCache {
@@ -367,6 +396,9 @@ static void load_icon_data             (IconThemeDir    *dir,
 static IconSuffix theme_dir_get_icon_suffix (IconThemeDir *dir,
 					     const gchar  *icon_name,
 					     gboolean     *has_icon_file);
+static void scan_directory                  (IconThemeDir *dir,
+                                             char         *full_dir);
+static void theme_dir_ensure_scanned        (IconThemeDir *dir);
 
 
 static GtkIconInfo *icon_info_new             (void);
@@ -405,6 +437,56 @@ icon_info_key_hash (gconstpointer _key)
   return h;
 }
 
+static guint
+loadable_info_key_hash (gconstpointer _key)
+{
+  const LoadableInfoKey *key = _key;
+  guint h;
+
+  h = g_icon_hash ((gpointer) key->icon);
+  h ^= key->size * 0x10001;
+  h ^= key->scale * 0x1000010;
+  h ^= key->flags * 0x10000100;
+
+  return h;
+}
+
+static gboolean
+loadable_info_key_equal (gconstpointer _a,
+                         gconstpointer _b)
+{
+  const LoadableInfoKey *a = _a;
+  const LoadableInfoKey *b = _b;
+
+  return a->size == b->size &&
+         a->scale == b->scale &&
+         a->flags == b->flags &&
+         g_icon_equal (a->icon, b->icon);
+}
+
+static void loadable_cache_file_changed (GFileMonitor      *monitor,
+                                         GFile             *file,
+                                         GFile             *other_file,
+                                         GFileMonitorEvent  event_type,
+                                         gpointer           user_data);
+
+static void
+loadable_cache_entry_free (LoadableCacheEntry *entry)
+{
+  if (entry->monitor)
+    {
+      g_signal_handlers_disconnect_by_func (entry->monitor,
+                                            loadable_cache_file_changed,
+                                            entry);
+      g_file_monitor_cancel (entry->monitor);
+      g_object_unref (entry->monitor);
+    }
+
+  g_object_unref (entry->key.icon);
+  g_object_unref (entry->info);
+  g_slice_free (LoadableCacheEntry, entry);
+}
+
 static gboolean
 icon_info_key_equal (gconstpointer  _a,
 		     gconstpointer  _b)
@@ -744,6 +826,10 @@ gtk_icon_theme_init (GtkIconTheme *icon_theme)
 
   priv->info_cache = g_hash_table_new_full (icon_info_key_hash, icon_info_key_equal, NULL,
 					    (GDestroyNotify)icon_info_uncached);
+  priv->loadable_cache = g_hash_table_new_full (loadable_info_key_hash, loadable_info_key_equal,
+                                                NULL,
+                                                (GDestroyNotify)loadable_cache_entry_free);
+  g_queue_init (&priv->loadable_cache_lru);
 
   priv->custom_theme = FALSE;
 
@@ -812,12 +898,24 @@ queue_theme_changed (GtkIconTheme *icon_theme)
                                  theme_changed_idle, icon_theme, NULL);
 }
 
+static void
+clear_loadable_cache (GtkIconTheme *icon_theme)
+{
+  GtkIconThemePrivate *priv = icon_theme->priv;
+
+  /* the links are part of the entries */
+  g_queue_init (&priv->loadable_cache_lru);
+  g_hash_table_remove_all (priv->loadable_cache);
+  priv->loadable_cache_bytes = 0;
+}
+
 static void
 do_theme_change (GtkIconTheme *icon_theme)
 {
   GtkIconThemePrivate *priv = icon_theme->priv;
 
   g_hash_table_remove_all (priv->info_cache);
+  clear_loadable_cache (icon_theme);
 
   if (!priv->themes_valid)
     return;
@@ -846,6 +944,7 @@ blow_themes (GtkIconTheme *icon_theme)
   priv->unthemed_icons = NULL;
   priv->dir_mtimes = NULL;
   priv->all_icons = NULL;
+  priv->all_icons_complete = FALSE;
   priv->themes_valid = FALSE;
 }
 
@@ -862,6 +961,9 @@ gtk_icon_theme_finalize (GObject *object)
   g_hash_table_destroy (priv->info_cache);
   g_assert (priv->info_cache_lru == NULL);
 
+  clear_loadable_cache (icon_theme);
+  g_hash_table_destroy (priv->loadable_cache);
+
   if (priv->theme_changed_idle)
     {
       g_source_remove (priv->theme_changed_idle);
@@ -2175,6 +2277,8 @@ gtk_icon_theme_has_icon (GtkIconTheme *icon_theme,
 	return TRUE;
     }
 
+  ensure_all_icons (icon_theme);
+
   if (g_hash_table_lookup_extended (priv->all_icons,
 				    icon_name, NULL, NULL))
     return TRUE;
@@ -2306,6 +2410,39 @@ add_key_to_hash (gpointer  key,
   g_hash_table_insert (hash, key, NULL);
 }
 
+/* Adds the icons of all theme directories without a cache to
+ * all_icons, so that questions for icons that don't exist can be
+ * answered without going through every directory each time.
+ */
+static void
+ensure_all_icons (GtkIconTheme *icon_theme)
+{
+  GtkIconThemePrivate *priv = icon_theme->priv;
+  GList *l, *d;
+
+  if (priv->all_icons_complete)
+    return;
+
+  for (l = priv->themes; l; l = l->next)
+    {
+      IconTheme *theme = l->data;
+
+      for (d = theme->dirs; d; d = d->next)
+        {
+          IconThemeDir *dir = d->data;
+
+          /* those are in the caches of dir_mtimes */
+          if (dir->cache)
+            continue;
+
+          theme_dir_ensure_scanned (dir);
+          g_hash_table_foreach (dir->icons, add_key_to_hash, priv->all_icons);
+        }
+    }
+
+  priv->all_icons_complete = TRUE;
+}
+
 static void
 add_key_to_list (gpointer  key,
 		 gpointer  value,
@@ -2550,7 +2687,7 @@ theme_dir_destroy (IconThemeDir *dir)
 {
   if (dir->cache)
       _gtk_icon_cache_unref (dir->cache);
-  else
+  else if (dir->icons)
     g_hash_table_destroy (dir->icons);
   
   if (dir->icon_data)
@@ -2649,6 +2786,17 @@ best_suffix (IconSuffix suffix,
 }
 
 
+/* Most lookups are satisfied by the first theme (or by the icon
+ * caches), so uncached directories are only read from disk once an
+ * icon is actually searched for in them.
+ */
+static void
+theme_dir_ensure_scanned (IconThemeDir *dir)
+{
+  if (dir->cache == NULL && dir->icons == NULL)
+    scan_directory (dir, dir->dir);
+}
+
 static IconSuffix
 theme_dir_get_icon_suffix (IconThemeDir *dir,
 			   const gchar  *icon_name,
@@ -2668,7 +2816,10 @@ theme_dir_get_icon_suffix (IconThemeDir *dir,
       suffix = suffix & ~HAS_ICON_FILE;
     }
   else
-    suffix = GPOINTER_TO_UINT (g_hash_table_lookup (dir->icons, icon_name));
+    {
+      theme_dir_ensure_scanned (dir);
+      suffix = GPOINTER_TO_UINT (g_hash_table_lookup (dir->icons, icon_name));
+    }
 
   GTK_NOTE (ICONTHEME, 
 	    g_print ("get_icon_suffix%s %u\n", dir->cache ? " (cached)" : "", suffix));
@@ -2907,6 +3058,7 @@ theme_list_icons (IconTheme  *theme,
 	    }
 	  else
 	    {
+	      theme_dir_ensure_scanned (dir);
 	      g_hash_table_foreach (dir->icons,
 				    add_key_to_hash,
 				    icons);
@@ -3018,13 +3170,23 @@ load_icon_data (IconThemeDir *dir, const char *path, const char *name)
     }
 }
 
+/* For the test suite */
+static guint n_directory_scans = 0;
+
+guint
+_gtk_icon_theme_get_n_directory_scans (void)
+{
+  return n_directory_scans;
+}
+
 static void
-scan_directory (GtkIconThemePrivate *icon_theme,
-		IconThemeDir *dir, char *full_dir)
+scan_directory (IconThemeDir *dir, char *full_dir)
 {
   GDir *gdir;
   const char *name;
 
+  n_directory_scans++;
+
   GTK_NOTE (ICONTHEME, 
 	    g_print ("scanning directory %s\n", full_dir));
   dir->icons = g_hash_table_new_full (g_str_hash, g_str_equal,
@@ -3063,7 +3225,6 @@ scan_directory (GtkIconThemePrivate *icon_theme,
       base_name = strip_suffix (name);
 
       hash_suffix = GPOINTER_TO_INT (g_hash_table_lookup (dir->icons, base_name));
-      g_hash_table_replace (icon_theme->all_icons, base_name, NULL);
       /* takes ownership of base_name */
       g_hash_table_replace (dir->icons, base_name, GUINT_TO_POINTER (hash_suffix| suffix));
     }
@@ -3180,9 +3341,12 @@ theme_subdir_load (GtkIconTheme *icon_theme,
             }
 	  else
 	    {
+	      /* Directories without a cache get scanned on first use,
+	       * see theme_dir_ensure_scanned()
+	       */
 	      dir->cache = NULL;
               dir->subdir_index = -1;
-	      scan_directory (icon_theme->priv, dir, full_dir);
+	      dir->icons = NULL;
 	    }
 
 	  theme->dirs = g_list_prepend (theme->dirs, dir);
@@ -4022,6 +4186,17 @@ gtk_icon_info_load_icon_finish (GtkIconInfo          *icon_info,
   return gtk_icon_info_load_icon (icon_info, error);
 }
 
+/* Returns whether gtk_icon_info_load_icon() can return without
+ * blocking, because the icon has been loaded already, or failed to.
+ */
+gboolean
+_gtk_icon_info_is_loaded (GtkIconInfo *icon_info)
+{
+  g_return_val_if_fail (GTK_IS_ICON_INFO (icon_info), FALSE);
+
+  return icon_info_get_pixbuf_ready (icon_info);
+}
+
 static gchar *
 gdk_color_to_css (GdkColor *color)
 {
@@ -5153,6 +5328,81 @@ gtk_icon_theme_lookup_by_gicon (GtkIconTheme       *icon_theme,
 }
 
 
+/* Returns whether lookups of @icon can be cached. File icons are
+ * only cached for local files, and get a monitor so that a rewritten
+ * file isn't taken from the cache; remote files may not be watched.
+ */
+static gboolean
+loadable_cache_is_cacheable (GIcon *icon)
+{
+  GFile *file;
+
+  if (!G_IS_FILE_ICON (icon))
+    return TRUE;
+
+  file = g_file_icon_get_file (G_FILE_ICON (icon));
+
+  return file != NULL && g_file_is_native (file);
+}
+
+/* Updates the size of an entry once its pixbuf got loaded, the
+ * estimate it was inserted with is only right for square icons.
+ */
+static void
+loadable_cache_entry_update_bytes (GtkIconThemePrivate *priv,
+                                   LoadableCacheEntry  *entry)
+{
+  GdkPixbuf *pixbuf = entry->info->pixbuf;
+  gsize bytes;
+
+  if (pixbuf == NULL)
+    return;
+
+  bytes = (gsize) gdk_pixbuf_get_rowstride (pixbuf) * gdk_pixbuf_get_height (pixbuf);
+
+  priv->loadable_cache_bytes += bytes - entry->bytes;
+  entry->bytes = bytes;
+}
+
+static void
+loadable_cache_entry_remove (GtkIconThemePrivate *priv,
+                             LoadableCacheEntry  *entry)
+{
+  g_queue_unlink (&priv->loadable_cache_lru, &entry->link);
+  priv->loadable_cache_bytes -= entry->bytes;
+  g_hash_table_remove (priv->loadable_cache, &entry->key);
+}
+
+static void
+loadable_cache_file_changed (GFileMonitor      *monitor,
+                             GFile             *file,
+                             GFile             *other_file,
+                             GFileMonitorEvent  event_type,
+                             gpointer           user_data)
+{
+  LoadableCacheEntry *entry = user_data;
+
+  if (event_type == G_FILE_MONITOR_EVENT_ATTRIBUTE_CHANGED ||
+      event_type == G_FILE_MONITOR_EVENT_PRE_UNMOUNT)
+    return;
+
+  DEBUG_CACHE (("loadable cache: dropping %s\n", entry->info->filename));
+
+  loadable_cache_entry_remove (entry->icon_theme->priv, entry);
+}
+
+/* Drops the least recently used entries until the cache fits both
+ * its entry and its pixbuf budget again, keeping the newest one.
+ */
+static void
+loadable_cache_trim (GtkIconThemePrivate *priv)
+{
+  while (priv->loadable_cache_lru.length > 1 &&
+         (priv->loadable_cache_lru.length > LOADABLE_CACHE_SIZE ||
+          priv->loadable_cache_bytes > LOADABLE_CACHE_MAX_BYTES))
+    loadable_cache_entry_remove (priv, priv->loadable_cache_lru.tail->data);
+}
+
 /**
  * gtk_icon_theme_lookup_by_gicon_for_scale:
  * @icon_theme: a #GtkIconTheme
@@ -5219,6 +5469,39 @@ gtk_icon_theme_lookup_by_gicon_for_scale (GtkIconTheme       *icon_theme,
     }
   else if (G_IS_LOADABLE_ICON (icon))
     {
+      GtkIconThemePrivate *priv = icon_theme->priv;
+      LoadableCacheEntry *entry;
+      LoadableInfoKey key;
+      GFileMonitor *monitor = NULL;
+      gboolean cacheable;
+
+      cacheable = loadable_cache_is_cacheable (icon);
+
+      if (cacheable)
+        {
+          key.icon = icon;
+          key.size = size;
+          key.scale = scale;
+          key.flags = flags;
+
+          entry = g_hash_table_lookup (priv->loadable_cache, &key);
+          if (entry != NULL)
+            {
+              /* don't keep failures around, the file may show up later */
+              if (entry->info->load_error == NULL)
+                {
+                  loadable_cache_entry_update_bytes (priv, entry);
+                  g_queue_unlink (&priv->loadable_cache_lru, &entry->link);
+                  g_queue_push_head_link (&priv->loadable_cache_lru, &entry->link);
+                  loadable_cache_trim (priv);
+
+                  return g_object_ref (entry->info);
+                }
+
+              loadable_cache_entry_remove (priv, entry);
+            }
+        }
+
       info = icon_info_new ();
       info->loadable = G_LOADABLE_ICON (g_object_ref (icon));
 
@@ -5239,6 +5522,42 @@ gtk_icon_theme_lookup_by_gicon_for_scale (GtkIconTheme       *icon_theme,
       info->threshold = 2;
       info->forced_size = (flags & GTK_ICON_LOOKUP_FORCE_SIZE) != 0;
 
+      /* files that can't be watched could change behind our back */
+      if (cacheable && info->icon_file != NULL)
+        {
+          monitor = g_file_monitor_file (info->icon_file, G_FILE_MONITOR_NONE, NULL, NULL);
+          cacheable = monitor != NULL;
+        }
+
+      if (cacheable)
+        {
+          entry = g_slice_new0 (LoadableCacheEntry);
+          entry->key.icon = g_object_ref (icon);
+          entry->key.size = size;
+          entry->key.scale = scale;
+          entry->key.flags = flags;
+          entry->info = g_object_ref (info);
+          entry->icon_theme = icon_theme;
+          entry->link.data = entry;
+
+          /* the icon gets loaded at about this size, count it now
+           * so that a burst of lookups can't overrun the budget */
+          entry->bytes = (gsize) 4 * size * scale * size * scale;
+          priv->loadable_cache_bytes += entry->bytes;
+
+          if (monitor)
+            {
+              entry->monitor = monitor;
+              g_signal_connect (monitor, "changed",
+                                G_CALLBACK (loadable_cache_file_changed), entry);
+            }
+
+          g_hash_table_insert (priv->loadable_cache, &entry->key, entry);
+          g_queue_push_head_link (&priv->loadable_cache_lru, &entry->link);
+
+          loadable_cache_trim (priv);
+        }
+
       return info;
     }
   else if (G_IS_THEMED_ICON (icon))
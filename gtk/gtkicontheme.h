@@ -343,6 +343,8 @@ const gchar *         gtk_icon_info_get_display_name  (GtkIconInfo    *icon_info
 
 /* Non-public methods */
 void _gtk_icon_theme_ensure_builtin_cache             (void);
+gboolean _gtk_icon_info_is_loaded                     (GtkIconInfo *icon_info);
+guint    _gtk_icon_theme_get_n_directory_scans        (void);
 
 G_END_DECLS
 
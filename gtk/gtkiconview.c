@@ -989,6 +989,7 @@ gtk_icon_view_init (GtkIconView *icon_view)
 
   icon_view->priv->row_contexts = 
     g_ptr_array_new_with_free_func ((GDestroyNotify)g_object_unref);
+  icon_view->priv->row_sizes = g_array_new (FALSE, FALSE, sizeof (GtkRequestedSize));
 
   gtk_style_context_add_class (gtk_widget_get_style_context (GTK_WIDGET (icon_view)),
                                GTK_STYLE_CLASS_VIEW);
@@ -1034,6 +1035,18 @@ gtk_icon_view_dispose (GObject *object)
       priv->row_contexts = NULL;
     }
 
+  if (priv->row_sizes)
+    {
+      g_array_free (priv->row_sizes, TRUE);
+      priv->row_sizes = NULL;
+    }
+
+  if (priv->height_context)
+    {
+      g_object_unref (priv->height_context);
+      priv->height_context = NULL;
+    }
+
   if (priv->cell_area)
     {
       gtk_cell_area_stop_editing (icon_view->priv->cell_area, TRUE);
@@ -1371,6 +1384,7 @@ gtk_icon_view_style_updated (GtkWidget *widget)
   GTK_WIDGET_CLASS (gtk_icon_view_parent_class)->style_updated (widget);
 
   _gtk_icon_view_update_background (GTK_ICON_VIEW (widget));
+  GTK_ICON_VIEW (widget)->priv->item_width_valid = FALSE;
   gtk_widget_queue_resize (widget);
 }
 
@@ -1478,6 +1492,111 @@ gtk_icon_view_is_empty (GtkIconView *icon_view)
   return icon_view->priv->items == NULL;
 }
 
+/* Makes the cell area context hold the preferred widths of all items.
+ * Only items that changed since are measured, so the widths can only
+ * grow until all items get measured again after item_width_valid was
+ * cleared.
+ */
+static gboolean
+gtk_icon_view_ensure_item_widths (GtkIconView *icon_view)
+{
+  GtkIconViewPrivate *priv = icon_view->priv;
+  gint old_minimum, old_natural, minimum, natural;
+  GList *items;
+
+  if (!priv->item_width_valid)
+    {
+      gtk_cell_area_context_reset (priv->cell_area_context);
+
+      for (items = priv->items; items; items = items->next)
+        ((GtkIconViewItem *) items->data)->width_valid = FALSE;
+
+      if (priv->items)
+        {
+          _gtk_icon_view_set_cell_data (icon_view, priv->items->data);
+          adjust_wrap_width (icon_view);
+        }
+    }
+
+  gtk_cell_area_context_get_preferred_width (priv->cell_area_context,
+                                             &old_minimum, &old_natural);
+
+  for (items = priv->items; items; items = items->next)
+    {
+      GtkIconViewItem *item = items->data;
+
+      if (item->width_valid)
+        continue;
+
+      _gtk_icon_view_set_cell_data (icon_view, item);
+      gtk_cell_area_get_preferred_width (priv->cell_area,
+                                         priv->cell_area_context,
+                                         GTK_WIDGET (icon_view),
+                                         NULL, NULL);
+      item->width_valid = TRUE;
+    }
+
+  /* The rows' contexts are copies of this one */
+  gtk_cell_area_context_get_preferred_width (priv->cell_area_context,
+                                             &minimum, &natural);
+  if (!priv->item_width_valid || minimum != old_minimum || natural != old_natural)
+    {
+      priv->rows_valid = FALSE;
+      priv->item_width_valid = TRUE;
+      return TRUE;
+    }
+
+  return FALSE;
+}
+
+/* Makes the height context hold the preferred heights of all items
+ * for @for_size, measuring only the items that changed if the widths
+ * stayed the same.
+ */
+static void
+gtk_icon_view_ensure_item_heights (GtkIconView *icon_view,
+                                   gint         for_size)
+{
+  GtkIconViewPrivate *priv = icon_view->priv;
+  gboolean widths_changed;
+  GList *items;
+
+  widths_changed = gtk_icon_view_ensure_item_widths (icon_view);
+
+  if (widths_changed ||
+      priv->height_context == NULL ||
+      priv->height_context_width != for_size)
+    {
+      if (priv->height_context)
+        g_object_unref (priv->height_context);
+
+      /* This has the widths of all items, which the context
+       * needs to work properly */
+      priv->height_context = gtk_cell_area_copy_context (priv->cell_area,
+                                                         priv->cell_area_context);
+      priv->height_context_width = for_size;
+
+      for (items = priv->items; items; items = items->next)
+        ((GtkIconViewItem *) items->data)->height_valid = FALSE;
+    }
+
+  for (items = priv->items; items; items = items->next)
+    {
+      GtkIconViewItem *item = items->data;
+
+      if (item->height_valid)
+        continue;
+
+      _gtk_icon_view_set_cell_data (icon_view, item);
+      gtk_cell_area_get_preferred_height_for_width (priv->cell_area,
+                                                    priv->height_context,
+                                                    GTK_WIDGET (icon_view),
+                                                    for_size,
+                                                    NULL, NULL);
+      item->height_valid = TRUE;
+    }
+}
+
 static void
 gtk_icon_view_get_preferred_item_size (GtkIconView    *icon_view,
                                        GtkOrientation  orientation,
@@ -1491,11 +1610,27 @@ gtk_icon_view_get_preferred_item_size (GtkIconView    *icon_view,
 
   g_assert (!gtk_icon_view_is_empty (icon_view));
 
-  context = gtk_cell_area_create_context (priv->cell_area);
-
   for_size -= 2 * priv->item_padding;
 
-  if (for_size > 0)
+  /* The unconstrained item width is needed for every width we get
+   * asked about and every allocation, but only changes when the items
+   * do. It is what the layout starts from as well, so it comes from
+   * the context kept for that.
+   */
+  if (orientation == GTK_ORIENTATION_HORIZONTAL && for_size <= 0)
+    {
+      gtk_icon_view_ensure_item_widths (icon_view);
+      context = g_object_ref (priv->cell_area_context);
+    }
+  else if (orientation == GTK_ORIENTATION_VERTICAL && for_size > 0)
+    {
+      gtk_icon_view_ensure_item_heights (icon_view, for_size);
+      context = g_object_ref (priv->height_context);
+    }
+  else
+    context = gtk_cell_area_create_context (priv->cell_area);
+
+  if (context != priv->cell_area_context && context != priv->height_context && for_size > 0)
     {
       /* This is necessary for the context to work properly */
       for (items = priv->items; items; items = items->next)
@@ -1507,7 +1642,9 @@ gtk_icon_view_get_preferred_item_size (GtkIconView    *icon_view,
         }
     }
 
-  for (items = priv->items; items; items = items->next)
+  for (items = priv->items;
+       items && context != priv->cell_area_context && context != priv->height_context;
+       items = items->next)
     {
       GtkIconViewItem *item = items->data;
 
@@ -1652,6 +1789,16 @@ gtk_icon_view_get_preferred_width (GtkWidget *widget,
   GtkIconViewPrivate *priv = icon_view->priv;
   int item_min, item_nat;
 
+  /* GtkWidget only asks us again after a resize was queued, which
+   * is also how changes to the cells packed into our area (new
+   * renderers, attributes, renderer properties) get to us. So
+   * measure the items again, unless the resize was for changed rows
+   * which were invalidated on their own.
+   */
+  if (!priv->items_changed_only)
+    priv->item_width_valid = FALSE;
+  priv->items_changed_only = FALSE;
+
   if (gtk_icon_view_is_empty (icon_view))
     {
       *minimum = *natural = 2 * priv->margin;
@@ -2937,7 +3084,7 @@ gtk_icon_view_layout (GtkIconView *icon_view)
   gint n_columns, n_rows, n_items;
   gint col, row;
   GtkRequestedSize *sizes;
-  gboolean rtl;
+  gboolean rtl, reuse_rows;
 
   if (gtk_icon_view_is_empty (icon_view))
     return;
@@ -2956,20 +3103,20 @@ gtk_icon_view_layout (GtkIconView *icon_view)
   priv->width += 2 * priv->margin;
   priv->width = MAX (priv->width, gtk_widget_get_allocated_width (widget));
 
-  /* Clear the per row contexts */
-  g_ptr_array_set_size (icon_view->priv->row_contexts, 0);
+  /* Rows are only measured again if one of their items changed,
+   * or if the items got a different width */
+  gtk_icon_view_ensure_item_widths (icon_view);
 
-  gtk_cell_area_context_reset (priv->cell_area_context);
-  /* because layouting is complicated. We designed an API
-   * that is O(N²) and nonsensical.
-   * And we're proud of it. */
-  for (items = priv->items; items; items = items->next)
+  reuse_rows = priv->rows_valid &&
+               priv->layout_item_width == item_width &&
+               priv->layout_n_columns == n_columns &&
+               priv->row_contexts->len == n_rows &&
+               priv->row_sizes->len == n_rows;
+
+  if (!reuse_rows)
     {
-      _gtk_icon_view_set_cell_data (icon_view, items->data);
-      gtk_cell_area_get_preferred_width (priv->cell_area,
-                                         priv->cell_area_context,
-                                         widget,
-                                         NULL, NULL);
+      g_ptr_array_set_size (priv->row_contexts, 0);
+      g_array_set_size (priv->row_sizes, 0);
     }
 
   sizes = g_newa (GtkRequestedSize, n_rows);
@@ -2979,29 +3126,65 @@ gtk_icon_view_layout (GtkIconView *icon_view)
   /* Collect the heights for all rows */
   for (row = 0; row < n_rows; row++)
     {
-      GtkCellAreaContext *context = gtk_cell_area_copy_context (priv->cell_area, priv->cell_area_context);
-      g_ptr_array_add (priv->row_contexts, context);
+      GtkCellAreaContext *context;
+      GList *row_items = items;
+      gboolean row_valid = reuse_rows;
 
       for (col = 0; col < n_columns && items; col++, items = items->next)
         {
           GtkIconViewItem *item = items->data;
 
-          _gtk_icon_view_set_cell_data (icon_view, item);
-          gtk_cell_area_get_preferred_height_for_width (priv->cell_area,
-                                                        context,
-                                                        widget,
-                                                        item_width, 
-                                                        NULL, NULL);
+          if (item->measured_width != item_width)
+            row_valid = FALSE;
         }
-      
+
+      if (row_valid)
+        {
+          sizes[row] = g_array_index (priv->row_sizes, GtkRequestedSize, row);
+        }
+      else
+        {
+          context = gtk_cell_area_copy_context (priv->cell_area, priv->cell_area_context);
+
+          for (col = 0; col < n_columns && row_items; col++, row_items = row_items->next)
+            {
+              GtkIconViewItem *item = row_items->data;
+
+              _gtk_icon_view_set_cell_data (icon_view, item);
+              gtk_cell_area_get_preferred_height_for_width (priv->cell_area,
+                                                            context,
+                                                            widget,
+                                                            item_width, 
+                                                            NULL, NULL);
+              item->measured_width = item_width;
+            }
+
+          gtk_cell_area_context_get_preferred_height_for_width (context,
+                                                                item_width,
+                                                                &sizes[row].minimum_size,
+                                                                &sizes[row].natural_size);
+
+          if (reuse_rows)
+            {
+              g_object_unref (g_ptr_array_index (priv->row_contexts, row));
+              g_ptr_array_index (priv->row_contexts, row) = context;
+              g_array_index (priv->row_sizes, GtkRequestedSize, row) = sizes[row];
+            }
+          else
+            {
+              g_ptr_array_add (priv->row_contexts, context);
+              g_array_append_val (priv->row_sizes, sizes[row]);
+            }
+        }
+
       sizes[row].data = GINT_TO_POINTER (row);
-      gtk_cell_area_context_get_preferred_height_for_width (context,
-                                                            item_width,
-                                                            &sizes[row].minimum_size,
-                                                            &sizes[row].natural_size);
       priv->height += sizes[row].minimum_size + 2 * priv->item_padding + priv->row_spacing;
     }
 
+  priv->layout_item_width = item_width;
+  priv->layout_n_columns = n_columns;
+  priv->rows_valid = TRUE;
+
   priv->height -= priv->row_spacing;
   priv->height += priv->margin;
   priv->height = MIN (priv->height, gtk_widget_get_allocated_height (widget));
@@ -3054,6 +3237,7 @@ gtk_icon_view_invalidate_sizes (GtkIconView *icon_view)
   /* Clear all item sizes */
   g_list_foreach (icon_view->priv->items,
 		  (GFunc)gtk_icon_view_item_invalidate_size, NULL);
+  icon_view->priv->item_width_valid = FALSE;
 
   /* Re-layout the items */
   gtk_widget_queue_resize (GTK_WIDGET (icon_view));
@@ -3064,6 +3248,9 @@ gtk_icon_view_item_invalidate_size (GtkIconViewItem *item)
 {
   item->cell_area.width = -1;
   item->cell_area.height = -1;
+  item->measured_width = -1;
+  item->width_valid = FALSE;
+  item->height_valid = FALSE;
 }
 
 static void
@@ -3273,6 +3460,7 @@ gtk_icon_view_item_new (void)
 
   item->cell_area.width  = -1;
   item->cell_area.height = -1;
+  item->measured_width = -1;
   
   return item;
 }
@@ -3407,6 +3595,7 @@ gtk_icon_view_row_changed (GtkTreeModel *model,
                            gpointer      data)
 {
   GtkIconView *icon_view = GTK_ICON_VIEW (data);
+  GtkIconViewItem *item;
 
   /* ignore changes in branches */
   if (gtk_tree_path_get_depth (path) > 1)
@@ -3419,15 +3608,20 @@ gtk_icon_view_row_changed (GtkTreeModel *model,
   if (icon_view->priv->cell_area)
     gtk_cell_area_stop_editing (icon_view->priv->cell_area, TRUE);
 
-  /* Here we can use a "grow-only" strategy for optimization
-   * and only invalidate a single item and queue a relayout
-   * instead of invalidating the whole thing.
-   *
-   * For now GtkIconView still cant deal with huge models
-   * so just invalidate the whole thing when the model
-   * changes.
+  /* Use a "grow-only" strategy: only the changed item is measured
+   * again, and only its row gets a new height in the next layout.
+   * The width of the items can grow, but doesn't shrink until all
+   * items are measured again for some other reason.
    */
-  gtk_icon_view_invalidate_sizes (icon_view);
+  item = g_list_nth_data (icon_view->priv->items, gtk_tree_path_get_indices (path)[0]);
+  if (item)
+    {
+      gtk_icon_view_item_invalidate_size (item);
+      icon_view->priv->items_changed_only = TRUE;
+      gtk_widget_queue_resize (GTK_WIDGET (icon_view));
+    }
+  else
+    gtk_icon_view_invalidate_sizes (icon_view);
 
   verify_items (icon_view);
 }
@@ -3470,6 +3664,7 @@ gtk_icon_view_row_inserted (GtkTreeModel *model,
     
   verify_items (icon_view);
 
+  icon_view->priv->item_width_valid = FALSE;
   gtk_widget_queue_resize (GTK_WIDGET (icon_view));
 }
 
@@ -3521,6 +3716,7 @@ gtk_icon_view_row_deleted (GtkTreeModel *model,
 
   verify_items (icon_view);  
   
+  icon_view->priv->item_width_valid = FALSE;
   gtk_widget_queue_resize (GTK_WIDGET (icon_view));
 
   if (emit)
@@ -5027,6 +5223,7 @@ gtk_icon_view_set_model (GtkIconView *icon_view,
       icon_view->priv->last_prelight = NULL;
       icon_view->priv->width = 0;
       icon_view->priv->height = 0;
+      icon_view->priv->item_width_valid = FALSE;
     }
 
   icon_view->priv->model = model;
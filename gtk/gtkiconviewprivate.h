@@ -29,10 +29,19 @@ struct _GtkIconViewItem
   
   gint row, col;
 
+  /* item width the cells were measured for in the last layout,
+   * -1 if they need to be measured again */
+  gint measured_width;
+
   guint prelight : 1;
   guint selected : 1;
   guint selected_before_rubberbanding : 1;
 
+  /* the preferred width is part of the cell area context */
+  guint width_valid : 1;
+  /* the preferred height is part of the height context */
+  guint height_valid : 1;
+
 };
 
 struct _GtkIconViewPrivate
@@ -85,6 +94,16 @@ struct _GtkIconViewPrivate
   gint margin;
   gint item_padding;
 
+  /* the previous layout; rows whose items were measured for the same
+   * item width are not measured again */
+  GArray *row_sizes;
+  gint layout_item_width;
+  gint layout_n_columns;
+
+  /* the preferred heights of all items for height_context_width */
+  GtkCellAreaContext *height_context;
+  gint height_context_width;
+
   gint text_column;
   gint markup_column;
   gint pixbuf_column;
@@ -129,6 +148,10 @@ struct _GtkIconViewPrivate
 
   guint doing_rubberband : 1;
 
+  guint item_width_valid : 1;
+  guint rows_valid : 1;
+  guint items_changed_only : 1;
+
 };
 
 void                 _gtk_icon_view_set_cell_data                  (GtkIconView            *icon_view,
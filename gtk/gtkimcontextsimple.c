@@ -222,6 +222,38 @@ compare_seq (const void *key, const void *value)
   return 0;
 }
 
+/* Returns the first sequence in @table that has @keysyms as a prefix.
+ * Custom tables often have thousands of sequences starting with the
+ * same keysym (usually Multi_key), so we do a lower bound search
+ * instead of backing up linearly from whatever bsearch() found.
+ */
+static const guint16 *
+find_first_seq (const GtkComposeTable *table,
+                const guint           *keysyms)
+{
+  gint row_stride = table->max_seq_len + 2;
+  gint lo, hi, mid;
+
+  lo = 0;
+  hi = table->n_seqs;
+
+  while (lo < hi)
+    {
+      mid = lo + (hi - lo) / 2;
+
+      if (compare_seq (keysyms, table->data + mid * row_stride) > 0)
+        lo = mid + 1;
+      else
+        hi = mid;
+    }
+
+  if (lo < table->n_seqs &&
+      compare_seq (keysyms, table->data + lo * row_stride) == 0)
+    return table->data + lo * row_stride;
+
+  return NULL;
+}
+
 static gboolean
 check_table (GtkIMContextSimple    *context_simple,
 	     const GtkComposeTable *table,
@@ -229,7 +261,7 @@ check_table (GtkIMContextSimple    *context_simple,
 {
   GtkIMContextSimplePrivate *priv = context_simple->priv;
   gint row_stride = table->max_seq_len + 2; 
-  guint16 *seq; 
+  const guint16 *seq; 
   
   /* Will never match, if the sequence in the compose buffer is longer
    * than the sequences in the table.  Further, compare_seq (key, val)
@@ -237,30 +269,17 @@ check_table (GtkIMContextSimple    *context_simple,
   if (n_compose > table->max_seq_len)
     return FALSE;
   
-  seq = bsearch (priv->compose_buffer,
-		 table->data, table->n_seqs,
-		 sizeof (guint16) *  row_stride, 
-		 compare_seq);
+  /* Find the first sequence that matches to make sure
+   * we find the exact match if there is one.
+   */
+  seq = find_first_seq (table, priv->compose_buffer);
 
   if (seq)
     {
-      guint16 *prev_seq;
-
-      /* Back up to the first sequence that matches to make sure
-       * we find the exact match if there is one.
-       */
-      while (seq > table->data)
-	{
-	  prev_seq = seq - row_stride;
-	  if (compare_seq (priv->compose_buffer, prev_seq) != 0)
-	    break;
-	  seq = prev_seq;
-	}
-      
       if (n_compose == table->max_seq_len ||
 	  seq[n_compose] == 0) /* complete sequence */
 	{
-	  guint16 *next_seq;
+	  const guint16 *next_seq;
 	  gunichar value = 
 	    0x10000 * seq[table->max_seq_len] + seq[table->max_seq_len + 1];
 
@@ -3462,11 +3462,14 @@ get_size_for_allocation (GtkLabel        *label,
                          gint            *natural_baseline)
 {
   PangoLayout *layout;
+  PangoRectangle logical;
   gint text_height, baseline;
 
   layout = gtk_label_get_measuring_layout (label, NULL, allocation * PANGO_SCALE);
 
-  pango_layout_get_pixel_size (layout, NULL, &text_height);
+  _gtk_pango_layout_get_cached_extents (layout, &logical, &baseline);
+  pango_extents_to_pixels (&logical, NULL);
+  text_height = logical.height;
 
   if (minimum_size)
     *minimum_size = text_height;
@@ -3476,7 +3479,7 @@ get_size_for_allocation (GtkLabel        *label,
 
   if (minimum_baseline || natural_baseline)
     {
-      baseline = pango_layout_get_baseline (layout) / PANGO_SCALE;
+      baseline = baseline / PANGO_SCALE;
       if (minimum_baseline)
 	*minimum_baseline = baseline;
 
@@ -3539,7 +3542,7 @@ gtk_label_get_preferred_layout_size (GtkLabel *label,
   else
     char_pixels = 0;
       
-  pango_layout_get_extents (layout, NULL, widest);
+  _gtk_pango_layout_get_cached_extents (layout, widest, NULL);
   widest->width = MAX (widest->width, char_pixels * priv->width_chars);
   widest->x = widest->y = 0;
 
@@ -3551,7 +3554,7 @@ gtk_label_get_preferred_layout_size (GtkLabel *label,
                                                priv->width_chars > -1 ? char_pixels * priv->width_chars
                                                                       : 0);
 
-      pango_layout_get_extents (layout, NULL, smallest);
+      _gtk_pango_layout_get_cached_extents (layout, smallest, NULL);
       smallest->width = MAX (smallest->width, char_pixels * priv->width_chars);
       smallest->x = smallest->y = 0;
 
@@ -3560,7 +3563,7 @@ gtk_label_get_preferred_layout_size (GtkLabel *label,
           layout = gtk_label_get_measuring_layout (label,
                                                    layout,
                                                    MAX (smallest->width, char_pixels * priv->max_width_chars));
-          pango_layout_get_extents (layout, NULL, widest);
+          _gtk_pango_layout_get_cached_extents (layout, widest, NULL);
           widest->width = MAX (widest->width, char_pixels * priv->width_chars);
           widest->x = widest->y = 0;
         }
@@ -25,6 +25,7 @@
 #include "config.h"
 #include "gtkpango.h"
 #include <pango/pangocairo.h>
+#include <string.h>
 #include "gtkintl.h"
 
 #define GTK_TYPE_FILL_LAYOUT_RENDERER            (_gtk_fill_layout_renderer_get_type())
@@ -233,6 +234,376 @@ _gtk_pango_fill_layout (cairo_t     *cr,
     cairo_move_to (cr, current_x, current_y);
 }
 
+/* Layout extents cache
+ *
+ * Size negotiation measures the same text over and over: identical
+ * labels and cells shape the same strings, and height-for-width
+ * queries measure wrapping paragraphs at the same widths many times
+ * per allocation. The cache below remembers the logical extents and
+ * baseline of layouts, keyed by everything that influences shaping,
+ * so that only the first measurement has to shape the text.
+ */
+
+#define LAYOUT_CACHE_MAX_SIZE (512 * 1024)
+
+typedef struct {
+  gchar *text;
+  PangoAttrList *attrs;
+  PangoFontDescription *font_desc;
+  PangoFontDescription *layout_font_desc;
+  PangoFontMap *font_map;
+  guint font_map_serial;
+  PangoLanguage *language;
+  cairo_font_options_t *font_options;
+  gdouble resolution;
+  PangoDirection base_dir;
+  PangoGravity base_gravity;
+  PangoGravityHint gravity_hint;
+  gint width;
+  gint height;
+  gint indent;
+  gint spacing;
+  PangoWrapMode wrap;
+  PangoEllipsizeMode ellipsize;
+  PangoAlignment alignment;
+  guint justify          : 1;
+  guint auto_dir         : 1;
+  guint single_paragraph : 1;
+  guint hash;
+} LayoutCacheKey;
+
+typedef struct {
+  LayoutCacheKey key;
+  PangoRectangle logical_rect;
+  gint baseline;
+  gsize size;
+  GList link;
+} LayoutCacheEntry;
+
+static GHashTable *layout_cache = NULL;
+static GQueue layout_cache_lru = G_QUEUE_INIT;
+static gsize layout_cache_size = 0;
+static guint layout_cache_hits = 0;
+static guint layout_cache_misses = 0;
+
+static gboolean
+collect_attribute (PangoAttribute *attr,
+                   gpointer        data)
+{
+  GSList **list = data;
+
+  *list = g_slist_prepend (*list, attr);
+
+  return FALSE;
+}
+
+static GSList *
+attr_list_get_attributes (PangoAttrList *attrs)
+{
+  GSList *list = NULL;
+
+  if (attrs)
+    pango_attr_list_filter (attrs, collect_attribute, &list);
+
+  return list;
+}
+
+static gboolean
+attr_list_equal (PangoAttrList *a,
+                 PangoAttrList *b)
+{
+  GSList *list_a, *list_b, *l, *m;
+  gboolean equal = TRUE;
+
+  if (a == b)
+    return TRUE;
+
+  list_a = attr_list_get_attributes (a);
+  list_b = attr_list_get_attributes (b);
+
+  for (l = list_a, m = list_b; l && m; l = l->next, m = m->next)
+    {
+      PangoAttribute *attr_a = l->data;
+      PangoAttribute *attr_b = m->data;
+
+      if (attr_a->start_index != attr_b->start_index ||
+          attr_a->end_index != attr_b->end_index ||
+          !pango_attribute_equal (attr_a, attr_b))
+        {
+          equal = FALSE;
+          break;
+        }
+    }
+
+  if (l != NULL || m != NULL)
+    equal = FALSE;
+
+  g_slist_free (list_a);
+  g_slist_free (list_b);
+
+  return equal;
+}
+
+static gboolean
+font_desc_equal (const PangoFontDescription *a,
+                 const PangoFontDescription *b)
+{
+  if (a == NULL || b == NULL)
+    return a == b;
+
+  return pango_font_description_equal (a, b);
+}
+
+static guint
+layout_cache_key_hash (gconstpointer data)
+{
+  const LayoutCacheKey *key = data;
+
+  return key->hash;
+}
+
+static gboolean
+layout_cache_key_equal (gconstpointer a,
+                        gconstpointer b)
+{
+  const LayoutCacheKey *ka = a;
+  const LayoutCacheKey *kb = b;
+
+  return ka->hash == kb->hash &&
+         ka->width == kb->width &&
+         ka->height == kb->height &&
+         ka->indent == kb->indent &&
+         ka->spacing == kb->spacing &&
+         ka->wrap == kb->wrap &&
+         ka->ellipsize == kb->ellipsize &&
+         ka->alignment == kb->alignment &&
+         ka->justify == kb->justify &&
+         ka->auto_dir == kb->auto_dir &&
+         ka->single_paragraph == kb->single_paragraph &&
+         ka->base_dir == kb->base_dir &&
+         ka->base_gravity == kb->base_gravity &&
+         ka->gravity_hint == kb->gravity_hint &&
+         ka->resolution == kb->resolution &&
+         ka->font_map == kb->font_map &&
+         ka->font_map_serial == kb->font_map_serial &&
+         ka->language == kb->language &&
+         strcmp (ka->text, kb->text) == 0 &&
+         font_desc_equal (ka->font_desc, kb->font_desc) &&
+         font_desc_equal (ka->layout_font_desc, kb->layout_font_desc) &&
+         (ka->font_options == kb->font_options ||
+          (ka->font_options && kb->font_options &&
+           cairo_font_options_equal (ka->font_options, kb->font_options))) &&
+         attr_list_equal (ka->attrs, kb->attrs);
+}
+
+/* Fills in @key from @layout without copying anything,
+ * returns %FALSE if the layout can't be cached
+ */
+static gboolean
+layout_cache_key_init (LayoutCacheKey *key,
+                       PangoLayout    *layout)
+{
+  PangoContext *context;
+  const cairo_font_options_t *font_options;
+
+  context = pango_layout_get_context (layout);
+
+  /* Transformed and tabbed layouts are rare, don't bother */
+  if (pango_context_get_matrix (context) != NULL ||
+      pango_layout_get_tabs (layout) != NULL)
+    return FALSE;
+
+  key->text = (gchar *) pango_layout_get_text (layout);
+  key->attrs = pango_layout_get_attributes (layout);
+  key->font_desc = (PangoFontDescription *) pango_context_get_font_description (context);
+  key->layout_font_desc = (PangoFontDescription *) pango_layout_get_font_description (layout);
+  key->font_map = pango_context_get_font_map (context);
+  /* Changes when the fonts are reloaded, e.g. after a fontconfig update */
+  key->font_map_serial = key->font_map ? pango_font_map_get_serial (key->font_map) : 0;
+  key->language = pango_context_get_language (context);
+  font_options = pango_cairo_context_get_font_options (context);
+  key->font_options = (cairo_font_options_t *) font_options;
+  key->resolution = pango_cairo_context_get_resolution (context);
+  key->base_dir = pango_context_get_base_dir (context);
+  key->base_gravity = pango_context_get_base_gravity (context);
+  key->gravity_hint = pango_context_get_gravity_hint (context);
+  key->width = pango_layout_get_width (layout);
+  key->height = pango_layout_get_height (layout);
+  key->indent = pango_layout_get_indent (layout);
+  key->spacing = pango_layout_get_spacing (layout);
+  key->wrap = pango_layout_get_wrap (layout);
+  key->ellipsize = pango_layout_get_ellipsize (layout);
+  key->alignment = pango_layout_get_alignment (layout);
+  key->justify = pango_layout_get_justify (layout);
+  key->auto_dir = pango_layout_get_auto_dir (layout);
+  key->single_paragraph = pango_layout_get_single_paragraph_mode (layout);
+
+  key->hash = g_str_hash (key->text);
+  key->hash ^= key->width * 31 + key->wrap * 7 + key->ellipsize;
+  if (key->font_desc)
+    key->hash ^= pango_font_description_hash (key->font_desc) << 1;
+  if (key->layout_font_desc)
+    key->hash ^= pango_font_description_hash (key->layout_font_desc) << 2;
+
+  return TRUE;
+}
+
+static void
+layout_cache_entry_free (gpointer data)
+{
+  LayoutCacheEntry *entry = data;
+  LayoutCacheKey *key = &entry->key;
+
+  g_free (key->text);
+  if (key->attrs)
+    pango_attr_list_unref (key->attrs);
+  if (key->font_desc)
+    pango_font_description_free (key->font_desc);
+  if (key->layout_font_desc)
+    pango_font_description_free (key->layout_font_desc);
+  if (key->font_map)
+    g_object_unref (key->font_map);
+  if (key->font_options)
+    cairo_font_options_destroy (key->font_options);
+
+  g_slice_free (LayoutCacheEntry, entry);
+}
+
+static LayoutCacheEntry *
+layout_cache_entry_new (const LayoutCacheKey *key)
+{
+  LayoutCacheEntry *entry;
+  GSList *attributes;
+
+  entry = g_slice_new0 (LayoutCacheEntry);
+  entry->key = *key;
+  entry->key.text = g_strdup (key->text);
+  entry->key.attrs = key->attrs ? pango_attr_list_copy (key->attrs) : NULL;
+  entry->key.font_desc = key->font_desc ? pango_font_description_copy (key->font_desc) : NULL;
+  entry->key.layout_font_desc = key->layout_font_desc ? pango_font_description_copy (key->layout_font_desc) : NULL;
+  entry->key.font_map = key->font_map ? g_object_ref (key->font_map) : NULL;
+  entry->key.font_options = key->font_options ? cairo_font_options_copy (key->font_options) : NULL;
+  entry->link.data = entry;
+
+  /* A rough estimate, it only needs to keep the cache bounded */
+  attributes = attr_list_get_attributes (entry->key.attrs);
+  entry->size = sizeof (LayoutCacheEntry) + strlen (key->text) + 1 +
+                g_slist_length (attributes) * 64 + 128;
+  g_slist_free (attributes);
+
+  return entry;
+}
+
+static void
+layout_cache_remove (LayoutCacheEntry *entry)
+{
+  g_queue_unlink (&layout_cache_lru, &entry->link);
+  layout_cache_size -= entry->size;
+  g_hash_table_remove (layout_cache, &entry->key);
+}
+
+/*
+ * _gtk_pango_layout_get_cached_extents:
+ * @layout: a #PangoLayout
+ * @logical_rect: (allow-none): return location for the logical extents
+ * @baseline: (allow-none): return location for the baseline
+ *
+ * Like pango_layout_get_extents() and pango_layout_get_baseline(),
+ * but avoids shaping @layout if a layout with identical text,
+ * attributes, fonts and settings has been measured before.
+ */
+void
+_gtk_pango_layout_get_cached_extents (PangoLayout    *layout,
+                                      PangoRectangle *logical_rect,
+                                      gint           *baseline)
+{
+  LayoutCacheEntry *entry;
+  LayoutCacheKey key;
+
+  if (!layout_cache_key_init (&key, layout))
+    {
+      pango_layout_get_extents (layout, NULL, logical_rect);
+      if (baseline)
+        *baseline = pango_layout_get_baseline (layout);
+      return;
+    }
+
+  if (layout_cache == NULL)
+    layout_cache = g_hash_table_new_full (layout_cache_key_hash,
+                                          layout_cache_key_equal,
+                                          NULL,
+                                          layout_cache_entry_free);
+
+  entry = g_hash_table_lookup (layout_cache, &key);
+
+  if (entry)
+    {
+      layout_cache_hits++;
+      g_queue_unlink (&layout_cache_lru, &entry->link);
+      g_queue_push_head_link (&layout_cache_lru, &entry->link);
+    }
+  else
+    {
+      layout_cache_misses++;
+      entry = layout_cache_entry_new (&key);
+      pango_layout_get_extents (layout, NULL, &entry->logical_rect);
+      entry->baseline = pango_layout_get_baseline (layout);
+
+      /* Huge paragraphs would just flush everything else */
+      if (entry->size > LAYOUT_CACHE_MAX_SIZE / 4)
+        {
+          if (logical_rect)
+            *logical_rect = entry->logical_rect;
+          if (baseline)
+            *baseline = entry->baseline;
+
+          layout_cache_entry_free (entry);
+          return;
+        }
+
+      while (layout_cache_size + entry->size > LAYOUT_CACHE_MAX_SIZE &&
+             layout_cache_lru.tail != NULL)
+        layout_cache_remove (layout_cache_lru.tail->data);
+
+      g_hash_table_insert (layout_cache, &entry->key, entry);
+      g_queue_push_head_link (&layout_cache_lru, &entry->link);
+      layout_cache_size += entry->size;
+    }
+
+  if (logical_rect)
+    *logical_rect = entry->logical_rect;
+  if (baseline)
+    *baseline = entry->baseline;
+}
+
+/*
+ * _gtk_pango_layout_cache_clear:
+ *
+ * Drops all cached layout extents, e.g. because the set
+ * of available fonts changed.
+ */
+void
+_gtk_pango_layout_cache_clear (void)
+{
+  if (layout_cache == NULL)
+    return;
+
+  g_queue_init (&layout_cache_lru);
+  layout_cache_size = 0;
+  g_hash_table_remove_all (layout_cache);
+}
+
+/* For the testsuite */
+void
+_gtk_pango_layout_cache_get_stats (guint *hits,
+                                   guint *misses)
+{
+  if (hits)
+    *hits = layout_cache_hits;
+  if (misses)
+    *misses = layout_cache_misses;
+}
+
 static AtkAttributeSet *
 add_attribute (AtkAttributeSet  *attributes,
                AtkTextAttribute  attr,
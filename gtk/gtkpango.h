@@ -34,6 +34,13 @@ G_BEGIN_DECLS
 void             _gtk_pango_fill_layout            (cairo_t         *cr,
                                                     PangoLayout     *layout);
 
+void             _gtk_pango_layout_get_cached_extents (PangoLayout    *layout,
+                                                       PangoRectangle *logical_rect,
+                                                       gint           *baseline);
+void             _gtk_pango_layout_cache_clear        (void);
+void             _gtk_pango_layout_cache_get_stats    (guint          *hits,
+                                                       guint          *misses);
+
 
 AtkAttributeSet *_gtk_pango_get_default_attributes (AtkAttributeSet *attributes,
                                                     PangoLayout     *layout);
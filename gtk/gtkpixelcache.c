@@ -23,15 +23,36 @@
 #define BLOW_CACHE_TIMEOUT_SEC 20
 
 /* The extra size of the offscreen surface we allocate
-   to make scrolling more efficient */
+   to make scrolling more efficient. This is the minimum,
+   while scrolling we grow it in steps of this size so
+   that it covers what will be scrolled in next */
 #define EXTRA_SIZE 64
+#define MAX_EXTRA_SIZE 1024
+
+/* How far ahead of the current scroll velocity we
+   try to have rendered */
+#define LOOKAHEAD_USEC (G_USEC_PER_SEC / 8)
+
+/* If the view hasn't moved for this long we're not
+   scrolling anymore */
+#define SCROLL_IDLE_USEC (G_USEC_PER_SEC / 4)
 
 /* When resizing viewport to smaller we allow this extra
    size to avoid constantly reallocating when resizing */
 #define ALLOW_LARGER_SIZE 32
 
+/* Memory budget for the surfaces of all pixel caches, the
+   least recently drawn ones get dropped first. It is this many
+   screenfuls of pixels, but never less than MIN_TOTAL_BYTES */
+#define BUDGET_SCREENS 4
+#define MIN_TOTAL_BYTES (32 * 1024 * 1024)
+
 struct _GtkPixelCache {
   cairo_surface_t *surface;
+  gsize surface_bytes;
+
+  /* Link in lru_caches, valid if surface != NULL */
+  GList link;
 
   /* Valid if surface != NULL */
   int surface_x;
@@ -44,18 +65,79 @@ struct _GtkPixelCache {
   cairo_region_t *surface_dirty;
 
   guint timeout_tag;
+
+  /* The frame we were last drawn in, our surface is never
+     evicted while that frame is still being drawn */
+  GdkFrameClock *frame_clock;
+  gint64 frame_counter;
+
+  /* Never use an opaque surface, the owner draws below the
+     cached contents */
+  guint always_alpha : 1;
+
+  /* Scroll tracking, in canvas coordinates */
+  gboolean have_view_pos;
+  int view_x;
+  int view_y;
+  gint64 last_move_time;
+  double velocity_x;       /* pixels per second */
+  double velocity_y;
+  int extra_w;
+  int extra_h;
 };
 
+/* Caches that have a surface, most recently drawn first */
+static GQueue lru_caches = G_QUEUE_INIT;
+static GtkPixelCacheStats stats;
+
 GtkPixelCache *
 _gtk_pixel_cache_new ()
 {
   GtkPixelCache *cache;
 
   cache = g_new0 (GtkPixelCache, 1);
+  cache->link.data = cache;
+  cache->extra_w = EXTRA_SIZE;
+  cache->extra_h = EXTRA_SIZE;
 
   return cache;
 }
 
+static void
+_gtk_pixel_cache_destroy_surface (GtkPixelCache *cache)
+{
+  if (cache->surface == NULL)
+    return;
+
+  g_queue_unlink (&lru_caches, &cache->link);
+  stats.bytes -= cache->surface_bytes;
+  stats.n_surfaces--;
+
+  cairo_surface_destroy (cache->surface);
+  cache->surface = NULL;
+  cache->surface_bytes = 0;
+
+  if (cache->surface_dirty)
+    cairo_region_destroy (cache->surface_dirty);
+  cache->surface_dirty = NULL;
+}
+
+#ifdef G_ENABLE_DEBUG
+static void
+_gtk_pixel_cache_print_stats (void)
+{
+  g_print ("pixel cache: %" G_GUINT64_FORMAT " draws, %.1f%% hits, "
+	   "%" G_GUINT64_FORMAT " px blitted, %" G_GUINT64_FORMAT " px redrawn, "
+	   "%" G_GUINT64_FORMAT " evictions, %u surfaces, "
+	   "%" G_GSIZE_FORMAT " bytes (peak %" G_GSIZE_FORMAT
+	   ", budget %" G_GSIZE_FORMAT ")\n",
+	   stats.n_draws,
+	   stats.n_draws ? 100.0 * stats.n_hits / stats.n_draws : 0.0,
+	   stats.blit_area, stats.redraw_area, stats.n_evictions,
+	   stats.n_surfaces, stats.bytes, stats.peak_bytes, stats.budget);
+}
+#endif
+
 void
 _gtk_pixel_cache_free (GtkPixelCache *cache)
 {
@@ -65,13 +147,170 @@ _gtk_pixel_cache_free (GtkPixelCache *cache)
   if (cache->timeout_tag)
     g_source_remove (cache->timeout_tag);
 
-  if (cache->surface != NULL)
-    cairo_surface_destroy (cache->surface);
+  _gtk_pixel_cache_destroy_surface (cache);
 
-  if (cache->surface_dirty != NULL)
-    cairo_region_destroy (cache->surface_dirty);
+  if (cache->frame_clock)
+    g_object_unref (cache->frame_clock);
 
   g_free (cache);
+
+  GTK_NOTE (PIXEL_CACHE, _gtk_pixel_cache_print_stats ());
+}
+
+static gsize
+_gtk_pixel_cache_get_budget (GdkWindow *window)
+{
+  GdkScreen *screen;
+  gsize screen_bytes;
+  int scale;
+
+  screen = gdk_window_get_screen (window);
+  scale = gdk_window_get_scale_factor (window);
+  screen_bytes = (gsize) gdk_screen_get_width (screen) *
+    gdk_screen_get_height (screen) * 4 * scale * scale;
+
+  return MAX (screen_bytes * BUDGET_SCREENS, MIN_TOTAL_BYTES);
+}
+
+static gboolean
+_gtk_pixel_cache_drawn_in_current_frame (GtkPixelCache *cache)
+{
+  return cache->frame_clock != NULL &&
+    cache->frame_counter == gdk_frame_clock_get_frame_counter (cache->frame_clock);
+}
+
+/* Drops the surfaces of the least recently drawn caches until
+   we're within the budget again, sparing @keep and all caches
+   that are part of the frame being drawn, as we'd only have to
+   render them again right away */
+static void
+_gtk_pixel_cache_enforce_budget (GtkPixelCache *keep,
+				 GdkWindow     *window)
+{
+  GList *l, *prev;
+
+  stats.budget = _gtk_pixel_cache_get_budget (window);
+
+  for (l = g_queue_peek_tail_link (&lru_caches);
+       l != NULL && stats.bytes > stats.budget;
+       l = prev)
+    {
+      GtkPixelCache *cache = l->data;
+
+      prev = l->prev;
+
+      if (cache == keep ||
+	  _gtk_pixel_cache_drawn_in_current_frame (cache))
+	continue;
+
+      _gtk_pixel_cache_destroy_surface (cache);
+      stats.n_evictions++;
+
+      GTK_NOTE (PIXEL_CACHE,
+                g_print ("pixel cache: evicted %p, %" G_GSIZE_FORMAT " bytes in %u surfaces\n",
+                         cache, stats.bytes, stats.n_surfaces));
+    }
+}
+
+static int
+extra_size_for_velocity (double velocity)
+{
+  int extra;
+
+  extra = ABS (velocity) * LOOKAHEAD_USEC / G_USEC_PER_SEC;
+  extra = (extra + EXTRA_SIZE - 1) / EXTRA_SIZE * EXTRA_SIZE;
+
+  return CLAMP (extra, EXTRA_SIZE, MAX_EXTRA_SIZE);
+}
+
+/* Tracks how fast the view moves over the canvas and sizes
+   the overscan so that a fast flick finds the area it scrolls
+   into already rendered */
+static void
+_gtk_pixel_cache_update_velocity (GtkPixelCache         *cache,
+				  cairo_rectangle_int_t *canvas_rect)
+{
+  gint64 now;
+  int view_x, view_y;
+
+  now = g_get_monotonic_time ();
+  view_x = -canvas_rect->x;
+  view_y = -canvas_rect->y;
+
+  if (cache->have_view_pos &&
+      (view_x != cache->view_x || view_y != cache->view_y))
+    {
+      gint64 dt = now - cache->last_move_time;
+
+      if (dt > 0 && dt < SCROLL_IDLE_USEC)
+	{
+	  /* Smooth out uneven frame times a bit */
+	  cache->velocity_x = (cache->velocity_x +
+			       (double) (view_x - cache->view_x) * G_USEC_PER_SEC / dt) / 2;
+	  cache->velocity_y = (cache->velocity_y +
+			       (double) (view_y - cache->view_y) * G_USEC_PER_SEC / dt) / 2;
+	}
+      else
+	{
+	  cache->velocity_x = 0;
+	  cache->velocity_y = 0;
+	}
+
+      cache->last_move_time = now;
+
+      /* Only grow while scrolling, so a flick that slows down
+	 doesn't make us reallocate the surface on every step */
+      cache->extra_w = MAX (cache->extra_w, extra_size_for_velocity (cache->velocity_x));
+      cache->extra_h = MAX (cache->extra_h, extra_size_for_velocity (cache->velocity_y));
+    }
+  else if (now - cache->last_move_time >= SCROLL_IDLE_USEC)
+    {
+      /* Keep the overscan though, it only shrinks when the
+	 cache gets blown, as that would cost a new surface */
+      cache->velocity_x = 0;
+      cache->velocity_y = 0;
+    }
+
+  cache->view_x = view_x;
+  cache->view_y = view_y;
+  cache->have_view_pos = TRUE;
+}
+
+static guint64
+region_area (cairo_region_t *region)
+{
+  cairo_rectangle_int_t r;
+  guint64 area = 0;
+  int i;
+
+  for (i = 0; i < cairo_region_num_rectangles (region); i++)
+    {
+      cairo_region_get_rectangle (region, i, &r);
+      area += (guint64) r.width * r.height;
+    }
+
+  return area;
+}
+
+/* By default the surface is opaque if the window background is,
+   which makes blitting cheaper but covers anything drawn below */
+void
+_gtk_pixel_cache_set_always_alpha (GtkPixelCache *cache,
+				   gboolean       always_alpha)
+{
+  always_alpha = always_alpha != FALSE;
+
+  if (cache->always_alpha == always_alpha)
+    return;
+
+  cache->always_alpha = always_alpha;
+  _gtk_pixel_cache_destroy_surface (cache);
+}
+
+void
+_gtk_pixel_cache_get_stats (GtkPixelCacheStats *stats_out)
+{
+  *stats_out = stats;
 }
 
 /* Region is in canvas coordinates */
@@ -126,6 +365,56 @@ _gtk_pixel_cache_invalidate (GtkPixelCache *cache,
   cairo_region_intersect_rectangle (cache->surface_dirty, &r);
 }
 
+/* Copies the valid parts of @old_surface, positioned at @old_x,
+   @old_y in canvas coordinates, into the new surface of @cache and
+   leaves the rest of it dirty */
+static void
+_gtk_pixel_cache_copy_surface (GtkPixelCache   *cache,
+			       cairo_surface_t *old_surface,
+			       cairo_region_t  *old_dirty,
+			       int              old_x,
+			       int              old_y,
+			       int              old_w,
+			       int              old_h)
+{
+  cairo_rectangle_int_t r;
+  cairo_region_t *copy_region;
+  cairo_t *backing_cr;
+
+  r.x = 0;
+  r.y = 0;
+  r.width = old_w;
+  r.height = old_h;
+  copy_region = cairo_region_create_rectangle (&r);
+  if (old_dirty)
+    cairo_region_subtract (copy_region, old_dirty);
+
+  cairo_region_translate (copy_region,
+			  old_x - cache->surface_x,
+			  old_y - cache->surface_y);
+
+  r.width = cache->surface_w;
+  r.height = cache->surface_h;
+  cairo_region_intersect_rectangle (copy_region, &r);
+
+  if (!cairo_region_is_empty (copy_region))
+    {
+      backing_cr = cairo_create (cache->surface);
+      gdk_cairo_region (backing_cr, copy_region);
+      cairo_clip (backing_cr);
+      cairo_set_operator (backing_cr, CAIRO_OPERATOR_SOURCE);
+      cairo_set_source_surface (backing_cr, old_surface,
+				old_x - cache->surface_x,
+				old_y - cache->surface_y);
+      cairo_paint (backing_cr);
+      cairo_destroy (backing_cr);
+    }
+
+  cairo_region_xor_rectangle (copy_region, &r);
+  cairo_region_destroy (cache->surface_dirty);
+  cache->surface_dirty = copy_region;
+}
+
 static void
 _gtk_pixel_cache_create_surface_if_needed (GtkPixelCache         *cache,
 					   GdkWindow             *window,
@@ -137,10 +426,16 @@ _gtk_pixel_cache_create_surface_if_needed (GtkPixelCache         *cache,
   cairo_content_t content;
   cairo_pattern_t *bg;
   double red, green, blue, alpha;
+  cairo_surface_t *old_surface = NULL;
+  cairo_region_t *old_dirty = NULL;
+  gsize old_bytes = 0;
+  int old_x = 0, old_y = 0, old_w = 0, old_h = 0;
+  gboolean created = FALSE;
 
   content = CAIRO_CONTENT_COLOR_ALPHA;
   bg = gdk_window_get_background_pattern (window);
-  if (bg != NULL &&
+  if (!cache->always_alpha &&
+      bg != NULL &&
       cairo_pattern_get_type (bg) == CAIRO_PATTERN_TYPE_SOLID &&
       cairo_pattern_get_rgba (bg, &red, &green, &blue, &alpha) == CAIRO_STATUS_SUCCESS &&
       alpha == 1.0)
@@ -148,26 +443,41 @@ _gtk_pixel_cache_create_surface_if_needed (GtkPixelCache         *cache,
 
   surface_w = view_rect->width;
   if (canvas_rect->width > surface_w)
-    surface_w = MIN (surface_w + EXTRA_SIZE, canvas_rect->width);
+    surface_w = MIN (surface_w + cache->extra_w, canvas_rect->width);
 
   surface_h = view_rect->height;
   if (canvas_rect->height > surface_h)
-    surface_h = MIN (surface_h + EXTRA_SIZE, canvas_rect->height);
+    surface_h = MIN (surface_h + cache->extra_h, canvas_rect->height);
 
-  /* If current surface can't fit view_rect or is too large, kill it */
+  /* If the current surface has the wrong format, kill it */
   if (cache->surface != NULL &&
       (cairo_surface_get_content (cache->surface) != content ||
-       cache->surface_w < view_rect->width ||
+       cache->surface_scale != gdk_window_get_scale_factor (window)))
+    _gtk_pixel_cache_destroy_surface (cache);
+
+  /* If it can't fit view_rect, is a whole step short of the
+     overscan we want or is too large, replace it, keeping
+     what it has rendered */
+  if (cache->surface != NULL &&
+      (cache->surface_w < view_rect->width ||
+       cache->surface_w + EXTRA_SIZE <= surface_w ||
        cache->surface_w > surface_w + ALLOW_LARGER_SIZE ||
        cache->surface_h < view_rect->height ||
-       cache->surface_h > surface_h + ALLOW_LARGER_SIZE ||
-       cache->surface_scale != gdk_window_get_scale_factor (window)))
+       cache->surface_h + EXTRA_SIZE <= surface_h ||
+       cache->surface_h > surface_h + ALLOW_LARGER_SIZE))
     {
-      cairo_surface_destroy (cache->surface);
+      old_surface = cache->surface;
+      old_dirty = cache->surface_dirty;
+      old_bytes = cache->surface_bytes;
+      old_x = cache->surface_x;
+      old_y = cache->surface_y;
+      old_w = cache->surface_w;
+      old_h = cache->surface_h;
+
+      g_queue_unlink (&lru_caches, &cache->link);
       cache->surface = NULL;
-      if (cache->surface_dirty)
-	cairo_region_destroy (cache->surface_dirty);
       cache->surface_dirty = NULL;
+      cache->surface_bytes = 0;
     }
 
   /* Don't allocate a surface if view >= canvas, as we won't
@@ -178,6 +488,13 @@ _gtk_pixel_cache_create_surface_if_needed (GtkPixelCache         *cache,
     {
       cache->surface_x = -canvas_rect->x;
       cache->surface_y = -canvas_rect->y;
+
+      /* Put the overscan on the side we're scrolling towards */
+      if (cache->velocity_x < 0)
+	cache->surface_x = MAX (cache->surface_x + view_rect->width - surface_w, 0);
+      if (cache->velocity_y < 0)
+	cache->surface_y = MAX (cache->surface_y + view_rect->height - surface_h, 0);
+
       cache->surface_w = surface_w;
       cache->surface_h = surface_h;
       cache->surface_scale = gdk_window_get_scale_factor (window);
@@ -191,6 +508,33 @@ _gtk_pixel_cache_create_surface_if_needed (GtkPixelCache         *cache,
       rect.height = surface_h;
       cache->surface_dirty =
 	cairo_region_create_rectangle (&rect);
+
+      if (old_surface)
+	_gtk_pixel_cache_copy_surface (cache, old_surface, old_dirty,
+				       old_x, old_y, old_w, old_h);
+
+      cache->surface_bytes = (gsize) surface_w * surface_h * 4 *
+	cache->surface_scale * cache->surface_scale;
+      g_queue_push_head_link (&lru_caches, &cache->link);
+      stats.bytes += cache->surface_bytes;
+      stats.n_surfaces++;
+      created = TRUE;
+    }
+
+  if (old_surface)
+    {
+      stats.bytes -= old_bytes;
+      stats.n_surfaces--;
+
+      cairo_surface_destroy (old_surface);
+      if (old_dirty)
+	cairo_region_destroy (old_dirty);
+    }
+
+  if (created)
+    {
+      stats.peak_bytes = MAX (stats.peak_bytes, stats.bytes);
+      _gtk_pixel_cache_enforce_budget (cache, window);
     }
 }
 
@@ -287,6 +631,8 @@ _gtk_pixel_cache_repaint (GtkPixelCache *cache,
       cache->surface_dirty &&
       !cairo_region_is_empty (cache->surface_dirty))
     {
+      stats.redraw_area += region_area (cache->surface_dirty);
+
       backing_cr = cairo_create (cache->surface);
       gdk_cairo_region (backing_cr, cache->surface_dirty);
       cairo_clip (backing_cr);
@@ -339,14 +685,11 @@ blow_cache_cb  (gpointer user_data)
 
   cache->timeout_tag = 0;
 
-  if (cache->surface)
-    {
-      cairo_surface_destroy (cache->surface);
-      cache->surface = NULL;
-      if (cache->surface_dirty)
-	cairo_region_destroy (cache->surface_dirty);
-      cache->surface_dirty = NULL;
-    }
+  /* Start over with the minimum overscan next time */
+  cache->extra_w = EXTRA_SIZE;
+  cache->extra_h = EXTRA_SIZE;
+
+  _gtk_pixel_cache_destroy_surface (cache);
 
   return G_SOURCE_REMOVE;
 }
@@ -363,21 +706,54 @@ _gtk_pixel_cache_draw (GtkPixelCache *cache,
 		       GtkPixelCacheDrawFunc draw,
 		       gpointer user_data)
 {
+  GdkFrameClock *frame_clock;
+
   if (cache->timeout_tag)
     g_source_remove (cache->timeout_tag);
 
+  frame_clock = gdk_window_get_frame_clock (window);
+  if (cache->frame_clock != frame_clock)
+    {
+      if (cache->frame_clock)
+	g_object_unref (cache->frame_clock);
+      cache->frame_clock = frame_clock ? g_object_ref (frame_clock) : NULL;
+    }
+  if (frame_clock)
+    cache->frame_counter = gdk_frame_clock_get_frame_counter (frame_clock);
+
   cache->timeout_tag = g_timeout_add_seconds (BLOW_CACHE_TIMEOUT_SEC,
 					      blow_cache_cb, cache);
 
+  stats.n_draws++;
+
+  _gtk_pixel_cache_update_velocity (cache, canvas_rect);
   _gtk_pixel_cache_create_surface_if_needed (cache, window,
 					     view_rect, canvas_rect);
   _gtk_pixel_cache_set_position (cache, view_rect, canvas_rect);
+
+  if (cache->surface)
+    {
+      /* Most recently drawn caches are the last to be evicted */
+      g_queue_unlink (&lru_caches, &cache->link);
+      g_queue_push_head_link (&lru_caches, &cache->link);
+
+      if (cache->surface_dirty == NULL ||
+	  cairo_region_is_empty (cache->surface_dirty))
+	stats.n_hits++;
+    }
+
   _gtk_pixel_cache_repaint (cache, draw, view_rect, canvas_rect, user_data);
 
   if (cache->surface &&
       /* Don't use backing surface if rendering elsewhere */
       cairo_surface_get_type (cache->surface) == cairo_surface_get_type (cairo_get_target (cr)))
     {
+      cairo_rectangle_int_t clip;
+
+      if (gdk_cairo_get_clip_rectangle (cr, &clip) &&
+	  gdk_rectangle_intersect (&clip, view_rect, &clip))
+	stats.blit_area += (guint64) clip.width * clip.height;
+
       cairo_save (cr);
       cairo_set_source_surface (cr, cache->surface,
 				cache->surface_x + view_rect->x + canvas_rect->x,
@@ -26,6 +26,21 @@
 G_BEGIN_DECLS
 
 typedef struct _GtkPixelCache           GtkPixelCache;
+typedef struct _GtkPixelCacheStats      GtkPixelCacheStats;
+
+/* Totals over all pixel caches, for profiling */
+struct _GtkPixelCacheStats {
+  guint64 n_draws;
+  guint64 n_hits;         /* draws that didn't need to render anything */
+  guint64 blit_area;      /* pixels drawn from a cache surface */
+  guint64 redraw_area;    /* pixels rendered into a cache surface */
+  guint64 n_evictions;    /* surfaces dropped to stay in the budget */
+  guint   n_surfaces;
+  gsize   bytes;
+  gsize   peak_bytes;
+  gsize   budget;         /* bytes allowed for all surfaces, 0 until
+                             the first surface got created */
+};
 
 typedef void (*GtkPixelCacheDrawFunc) (cairo_t *cr,
 				       gpointer user_data);
@@ -41,6 +56,9 @@ void           _gtk_pixel_cache_draw       (GtkPixelCache         *cache,
 					    cairo_rectangle_int_t *canvas_rect,
 					    GtkPixelCacheDrawFunc  draw,
 					    gpointer               user_data);
+void           _gtk_pixel_cache_set_always_alpha (GtkPixelCache *cache,
+						  gboolean       always_alpha);
+void           _gtk_pixel_cache_get_stats  (GtkPixelCacheStats    *stats);
 
 
 G_END_DECLS
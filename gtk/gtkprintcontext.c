@@ -125,6 +125,7 @@ struct _GtkPrintContext
   gdouble hard_margin_left;
   gdouble hard_margin_right;
 
+  PangoFontMap *fontmap;
 };
 
 struct _GtkPrintContextClass
@@ -144,6 +145,9 @@ gtk_print_context_finalize (GObject *object)
 
   if (context->cr)
     cairo_destroy (context->cr);
+
+  if (context->fontmap)
+    g_object_unref (context->fontmap);
   
   G_OBJECT_CLASS (gtk_print_context_parent_class)->finalize (object);
 }
@@ -176,9 +180,80 @@ _gtk_print_context_new (GtkPrintOperation *op)
   return context;
 }
 
+/* Creates a context for drawing a page into the recording
+ * surface @surface. It uses the same resolution, units and
+ * margins as @context, so that the recording can be replayed
+ * into @context with _gtk_print_context_replay_recording().
+ */
+GtkPrintContext *
+_gtk_print_context_new_for_recording (GtkPrintContext *context,
+                                      cairo_surface_t *surface)
+{
+  GtkPrintContext *recording_context;
+  cairo_t *cr;
+
+  recording_context = _gtk_print_context_new (context->op);
+
+  if (context->page_setup)
+    _gtk_print_context_set_page_setup (recording_context, context->page_setup);
+
+  recording_context->has_hard_margins = context->has_hard_margins;
+  recording_context->hard_margin_top = context->hard_margin_top;
+  recording_context->hard_margin_bottom = context->hard_margin_bottom;
+  recording_context->hard_margin_left = context->hard_margin_left;
+  recording_context->hard_margin_right = context->hard_margin_right;
+
+  cr = cairo_create (surface);
+  gtk_print_context_set_cairo_context (recording_context, cr,
+                                       context->surface_dpi_x,
+                                       context->surface_dpi_y);
+  cairo_destroy (cr);
+
+  return recording_context;
+}
+
+/* Paints a page recorded with a context from
+ * _gtk_print_context_new_for_recording() in the current user
+ * space of @context, as if it had been drawn there directly.
+ */
+void
+_gtk_print_context_replay_recording (GtkPrintContext *context,
+                                     cairo_surface_t *surface)
+{
+  cairo_t *cr = context->cr;
+
+  /* The recording is in device units, undo the unit scale */
+  cairo_save (cr);
+  cairo_scale (cr,
+               1.0 / context->pixels_per_unit_x,
+               1.0 / context->pixels_per_unit_y);
+  cairo_set_source_surface (cr, surface, 0, 0);
+  cairo_paint (cr);
+  cairo_restore (cr);
+}
+
+/* Makes @context create its Pango contexts and layouts with
+ * @fontmap instead of the default font map, which belongs to
+ * the main thread.
+ */
+void
+_gtk_print_context_set_fontmap (GtkPrintContext *context,
+                                PangoFontMap    *fontmap)
+{
+  if (fontmap)
+    g_object_ref (fontmap);
+  if (context->fontmap)
+    g_object_unref (context->fontmap);
+
+  context->fontmap = fontmap;
+}
+
 static PangoFontMap *
 _gtk_print_context_get_fontmap (GtkPrintContext *context)
 {
+  if (context->fontmap)
+    return context->fontmap;
+
   return pango_cairo_font_map_get_default ();
 }
 
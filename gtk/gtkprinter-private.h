@@ -49,6 +49,9 @@ GHashTable *         _gtk_printer_get_custom_widgets        (GtkPrinter
 GDK_AVAILABLE_IN_ALL
 void gtk_print_job_set_status (GtkPrintJob   *job,
 			       GtkPrintStatus status);
+GDK_AVAILABLE_IN_3_10
+void gtk_print_job_set_bytes_written (GtkPrintJob *job,
+                                      guint64      bytes_written);
 
 G_END_DECLS
 #endif /* __GTK_PRINT_OPERATION_PRIVATE_H__ */
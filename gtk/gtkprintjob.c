@@ -63,6 +63,7 @@ struct _GtkPrintJobPrivate
   cairo_surface_t *surface;
 
   GtkPrintStatus status;
+  guint64 bytes_written;
   GtkPrintBackend *backend;
   GtkPrinter *printer;
   GtkPrintSettings *settings;
@@ -110,7 +111,8 @@ enum {
   PROP_PRINTER,
   PROP_PAGE_SETUP,
   PROP_SETTINGS,
-  PROP_TRACK_PRINT_STATUS
+  PROP_TRACK_PRINT_STATUS,
+  PROP_BYTES_WRITTEN
 };
 
 static guint signals[LAST_SIGNAL] = { 0 };
@@ -173,6 +175,25 @@ gtk_print_job_class_init (GtkPrintJobClass *class)
 							    "has been sent to the printer or print server."),
 							 FALSE,
 							 GTK_PARAM_READWRITE));
+
+  /**
+   * GtkPrintJob:bytes-written:
+   *
+   * The number of bytes of print data that have been written to
+   * the destination of the job so far. Print backends that write
+   * the data while the pages are being rendered, like the file
+   * backend, update it regularly; others may only set it once the
+   * data has been sent.
+   *
+   * Since: 3.10
+   */
+  g_object_class_install_property (object_class,
+				   PROP_BYTES_WRITTEN,
+				   g_param_spec_uint64 ("bytes-written",
+							P_("Bytes written"),
+							P_("The number of bytes of print data written so far"),
+							0, G_MAXUINT64, 0,
+							GTK_PARAM_READABLE));
   
 
   /**
@@ -212,6 +233,7 @@ gtk_print_job_init (GtkPrintJob *job)
   priv->settings_set = FALSE;
   priv->page_setup_set = FALSE;
   priv->status = GTK_PRINT_STATUS_INITIAL;
+  priv->bytes_written = 0;
   priv->track_print_status = FALSE;
 
   priv->print_pages = GTK_PRINT_PAGES_ALL;
@@ -412,6 +434,44 @@ gtk_print_job_set_status (GtkPrintJob   *job,
   g_signal_emit (job, signals[STATUS_CHANGED], 0);
 }
 
+void
+gtk_print_job_set_bytes_written (GtkPrintJob *job,
+                                 guint64      bytes_written)
+{
+  GtkPrintJobPrivate *priv;
+
+  g_return_if_fail (GTK_IS_PRINT_JOB (job));
+
+  priv = job->priv;
+
+  if (priv->bytes_written == bytes_written)
+    return;
+
+  priv->bytes_written = bytes_written;
+  g_object_notify (G_OBJECT (job), "bytes-written");
+}
+
+/**
+ * gtk_print_job_get_bytes_written:
+ * @job: a #GtkPrintJob
+ *
+ * Gets the number of bytes of print data that have been
+ * written to the destination of @job so far. Connect to
+ * #GObject::notify for #GtkPrintJob:bytes-written to
+ * track the progress of large jobs.
+ *
+ * Return value: the number of bytes written
+ *
+ * Since: 3.10
+ **/
+guint64
+gtk_print_job_get_bytes_written (GtkPrintJob *job)
+{
+  g_return_val_if_fail (GTK_IS_PRINT_JOB (job), 0);
+
+  return job->priv->bytes_written;
+}
+
 /**
  * gtk_print_job_set_source_file:
  * @job: a #GtkPrintJob
@@ -664,6 +724,9 @@ gtk_print_job_get_property (GObject    *object,
     case PROP_TRACK_PRINT_STATUS:
       g_value_set_boolean (value, priv->track_print_status);
       break;
+    case PROP_BYTES_WRITTEN:
+      g_value_set_uint64 (value, priv->bytes_written);
+      break;
     default:
       G_OBJECT_WARN_INVALID_PROPERTY_ID (object, prop_id, pspec);
       break;
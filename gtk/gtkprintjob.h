@@ -103,6 +103,8 @@ void                     gtk_print_job_set_track_print_status (GtkPrintJob
 							       gboolean                  track_status);
 GDK_AVAILABLE_IN_ALL
 gboolean                 gtk_print_job_get_track_print_status (GtkPrintJob              *job);
+GDK_AVAILABLE_IN_3_10
+guint64                  gtk_print_job_get_bytes_written      (GtkPrintJob              *job);
 GDK_AVAILABLE_IN_ALL
 void                     gtk_print_job_send                   (GtkPrintJob              *job,
 							       GtkPrintJobCompleteFunc   callback,
@@ -46,6 +46,8 @@ struct _GtkPrintOperationPrivate
   gint current_page;
   GtkUnit unit;
   gchar *export_filename;
+  guint64 bytes_written;
+  guint64 bytes_reported;
   guint use_full_page      : 1;
   guint track_print_status : 1;
   guint show_progress      : 1;
@@ -55,6 +57,7 @@ struct _GtkPrintOperationPrivate
   guint support_selection  : 1;
   guint has_selection      : 1;
   guint embed_page_setup   : 1;
+  guint threaded_drawing   : 1;
 
   GtkPageDrawingState      page_drawing_state;
 
@@ -144,6 +147,12 @@ void             _gtk_print_context_set_hard_margins                (GtkPrintCon
 								     gdouble            bottom,
 								     gdouble            left,
 								     gdouble            right);
+GtkPrintContext *_gtk_print_context_new_for_recording               (GtkPrintContext   *context,
+								     cairo_surface_t   *surface);
+void             _gtk_print_context_replay_recording                (GtkPrintContext   *context,
+								     cairo_surface_t   *surface);
+void             _gtk_print_context_set_fontmap                     (GtkPrintContext   *context,
+								     PangoFontMap      *fontmap);
 
 G_END_DECLS
 
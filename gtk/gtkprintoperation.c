@@ -24,6 +24,7 @@
 #include <string.h>
 
 #include <cairo-pdf.h>
+#include <glib/gstdio.h>
 
 #include "gtkprintoperation-private.h"
 #include "gtkmarshalers.h"
@@ -141,7 +142,9 @@ enum
   PROP_EMBED_PAGE_SETUP,
   PROP_HAS_SELECTION,
   PROP_SUPPORT_SELECTION,
-  PROP_N_PAGES_TO_PRINT
+  PROP_N_PAGES_TO_PRINT,
+  PROP_THREADED_DRAWING,
+  PROP_BYTES_WRITTEN
 };
 
 static guint signals[LAST_SIGNAL] = { 0 };
@@ -155,6 +158,9 @@ static void          common_render_page      (GtkPrintOperation             *op,
 static void          increment_page_sequence (PrintPagesData *data);
 static void          prepare_data            (PrintPagesData *data);
 static void          clamp_page_ranges       (PrintPagesData *data);
+static gboolean      print_pages_idle        (gpointer        user_data);
+static gboolean      replay_rendered_page    (PrintPagesData *data);
+static void          stop_threaded_drawing   (PrintPagesData *data);
 
 
 G_DEFINE_TYPE_WITH_CODE (GtkPrintOperation, gtk_print_operation, G_TYPE_OBJECT,
@@ -425,6 +431,9 @@ gtk_print_operation_set_property (GObject      *object,
     case PROP_SUPPORT_SELECTION:
       gtk_print_operation_set_support_selection (op, g_value_get_boolean (value));
       break;
+    case PROP_THREADED_DRAWING:
+      gtk_print_operation_set_threaded_drawing (op, g_value_get_boolean (value));
+      break;
     default:
       G_OBJECT_WARN_INVALID_PROPERTY_ID (object, prop_id, pspec);
       break;
@@ -496,6 +505,12 @@ gtk_print_operation_get_property (GObject    *object,
     case PROP_N_PAGES_TO_PRINT:
       g_value_set_int (value, priv->nr_of_pages_to_print);
       break;
+    case PROP_THREADED_DRAWING:
+      g_value_set_boolean (value, priv->threaded_drawing);
+      break;
+    case PROP_BYTES_WRITTEN:
+      g_value_set_uint64 (value, priv->bytes_written);
+      break;
     default:
       G_OBJECT_WARN_INVALID_PROPERTY_ID (object, prop_id, pspec);
       break;
@@ -525,6 +540,13 @@ struct _PrintPagesData
   gboolean initialized;
   gboolean is_preview;
   gboolean done;
+
+  /* threaded drawing, see render_pages_ahead() */
+  GThreadPool *render_pool;
+  GQueue render_queue;
+  gint render_position;
+  GCancellable *render_cancellable;
+  gboolean waiting_for_page;
 };
 
 typedef struct
@@ -1424,6 +1446,41 @@ gtk_print_operation_class_init (GtkPrintOperationClass *class)
 						     G_MAXINT,
 						     -1,
 						     GTK_PARAM_READABLE));
+
+  /**
+   * GtkPrintOperation:threaded-drawing:
+   *
+   * If %TRUE, the #GtkPrintOperation::draw-page signal may be emitted
+   * from worker threads, for several pages at the same time.
+   * See gtk_print_operation_set_threaded_drawing().
+   *
+   * Since: 3.10
+   */
+  g_object_class_install_property (gobject_class,
+				   PROP_THREADED_DRAWING,
+				   g_param_spec_boolean ("threaded-drawing",
+							 P_("Threaded drawing"),
+							 P_("TRUE if draw-page may be emitted from worker threads"),
+							 FALSE,
+							 GTK_PARAM_READWRITE));
+
+  /**
+   * GtkPrintOperation:bytes-written:
+   *
+   * The number of bytes written to the export file so far, when
+   * running with %GTK_PRINT_OPERATION_ACTION_EXPORT. It is updated
+   * as pages are written, and can be used to track the progress of
+   * large exports. When printing, see #GtkPrintJob:bytes-written.
+   *
+   * Since: 3.10
+   */
+  g_object_class_install_property (gobject_class,
+				   PROP_BYTES_WRITTEN,
+				   g_param_spec_uint64 ("bytes-written",
+							P_("Bytes written"),
+							P_("The number of bytes written to the export file"),
+							0, G_MAXUINT64, 0,
+							GTK_PARAM_READABLE));
 }
 
 /**
@@ -2070,6 +2127,55 @@ pdf_end_page (GtkPrintOperation *op,
     cairo_show_page (cr);
 }
 
+/* Granularity of GtkPrintOperation:bytes-written updates */
+#define EXPORT_PROGRESS_STEP (64 * 1024)
+
+typedef struct
+{
+  GtkPrintOperation *op;
+  FILE *file;
+} ExportStream;
+
+static cairo_user_data_key_t export_stream_key;
+
+static void
+export_stream_report_progress (GtkPrintOperation *op)
+{
+  GtkPrintOperationPrivate *priv = op->priv;
+
+  if (priv->bytes_reported == priv->bytes_written)
+    return;
+
+  priv->bytes_reported = priv->bytes_written;
+  g_object_notify (G_OBJECT (op), "bytes-written");
+}
+
+static cairo_status_t
+export_stream_write (void                *closure,
+                     const unsigned char *data,
+                     unsigned int         length)
+{
+  ExportStream *stream = closure;
+  GtkPrintOperationPrivate *priv = stream->op->priv;
+
+  if (fwrite (data, 1, length, stream->file) != length)
+    return CAIRO_STATUS_WRITE_ERROR;
+
+  priv->bytes_written += length;
+
+  if (priv->bytes_written - priv->bytes_reported >= EXPORT_PROGRESS_STEP)
+    export_stream_report_progress (stream->op);
+
+  return CAIRO_STATUS_SUCCESS;
+}
+
+static void
+export_stream_free (ExportStream *stream)
+{
+  fclose (stream->file);
+  g_slice_free (ExportStream, stream);
+}
+
 static void
 pdf_end_run (GtkPrintOperation *op,
 	     gboolean           wait,
@@ -2079,8 +2185,15 @@ pdf_end_run (GtkPrintOperation *op,
   cairo_surface_t *surface = priv->platform_data;
 
   cairo_surface_finish (surface);
+  if (cairo_surface_status (surface) != CAIRO_STATUS_SUCCESS && priv->error == NULL)
+    g_set_error_literal (&priv->error,
+                         GTK_PRINT_ERROR,
+                         GTK_PRINT_ERROR_GENERAL,
+                         cairo_status_to_string (cairo_surface_status (surface)));
   cairo_surface_destroy (surface);
 
+  export_stream_report_progress (op);
+
   priv->platform_data = NULL;
   priv->free_platform_data = NULL;
 }
@@ -2093,9 +2206,28 @@ run_pdf (GtkPrintOperation  *op,
   GtkPrintOperationPrivate *priv = op->priv;
   GtkPageSetup *page_setup;
   cairo_surface_t *surface;
+  ExportStream *stream;
+  FILE *file;
   cairo_t *cr;
   gdouble width, height;
-  
+
+  file = g_fopen (priv->export_filename, "wb");
+  if (file == NULL)
+    {
+      int errsv = errno;
+
+      g_set_error_literal (&priv->error,
+                           GTK_PRINT_ERROR,
+                           GTK_PRINT_ERROR_GENERAL,
+                           g_strerror (errsv));
+      *do_print = FALSE;
+      return GTK_PRINT_OPERATION_RESULT_ERROR;
+    }
+
+  priv->bytes_written = 0;
+  priv->bytes_reported = 0;
+  g_object_notify (G_OBJECT (op), "bytes-written");
+
   priv->print_context = _gtk_print_context_new (op);
   
   page_setup = create_page_setup (op);
@@ -2107,8 +2239,17 @@ run_pdf (GtkPrintOperation  *op,
   height = gtk_page_setup_get_paper_height (page_setup, GTK_UNIT_POINTS);
   g_object_unref (page_setup);
   
-  surface = cairo_pdf_surface_create (priv->export_filename,
-				      width, height);
+  /* Written through a stream to count the bytes */
+  stream = g_slice_new (ExportStream);
+  stream->op = op;
+  stream->file = file;
+
+  surface = cairo_pdf_surface_create_for_stream (export_stream_write, stream,
+                                                 width, height);
+  if (cairo_surface_set_user_data (surface, &export_stream_key, stream,
+                                   (cairo_destroy_func_t) export_stream_free) != CAIRO_STATUS_SUCCESS)
+    export_stream_free (stream);
+
   if (cairo_surface_status (surface) != CAIRO_STATUS_SUCCESS)
     {
       g_set_error_literal (&priv->error,
@@ -2299,6 +2440,12 @@ print_pages_idle_done (gpointer user_data)
 
   priv->print_pages_idle_id = 0;
 
+  /* Paused until the next page is drawn, see page_rendered_idle() */
+  if (data->waiting_for_page)
+    return;
+
+  stop_threaded_drawing (data);
+
   if (priv->show_progress_timeout_id > 0)
     {
       g_source_remove (priv->show_progress_timeout_id);
@@ -2426,6 +2573,101 @@ gtk_print_operation_get_embed_page_setup (GtkPrintOperation *op)
   return op->priv->embed_page_setup;
 }
 
+/**
+ * gtk_print_operation_set_threaded_drawing:
+ * @op: a #GtkPrintOperation
+ * @threaded_drawing: %TRUE if the #GtkPrintOperation::draw-page
+ *     handlers are thread-safe
+ *
+ * Declares that the handlers of the #GtkPrintOperation::draw-page
+ * signal can safely be run from other threads, concurrently for
+ * different pages. GTK+ then renders several pages at once into
+ * recordings on a pool of worker threads, and replays them in
+ * order into the output. This can speed up printing and exporting
+ * documents with many pages considerably.
+ *
+ * In this mode the #GtkPrintContext passed to the
+ * #GtkPrintOperation::draw-page handler is specific to the page
+ * being drawn, and #GtkPrintOperation::request-page-setup may be
+ * emitted for pages ahead of the page currently being output.
+ *
+ * The #GtkPrintOperation::draw-page handlers may only call these
+ * GTK+ functions, on the #GtkPrintContext they are passed:
+ * gtk_print_context_get_cairo_context(),
+ * gtk_print_context_get_page_setup(), gtk_print_context_get_width(),
+ * gtk_print_context_get_height(), gtk_print_context_get_dpi_x(),
+ * gtk_print_context_get_dpi_y(), gtk_print_context_get_hard_margins(),
+ * gtk_print_context_get_pango_fontmap(),
+ * gtk_print_context_create_pango_context() and
+ * gtk_print_context_create_pango_layout(). They may draw with cairo
+ * and with the Pango contexts and layouts they create from the
+ * context; each worker thread has its own font map, so these must
+ * not be kept across pages or shared with other threads. All other
+ * GTK+ and GDK functions, including
+ * gtk_print_operation_set_defer_drawing(), must not be called, and
+ * the handlers must protect data of their own that they share.
+ *
+ * Threaded drawing is only used when each page is printed once
+ * and in order; otherwise pages are drawn in the main thread
+ * as usual.
+ *
+ * Since: 3.10
+ **/
+void
+gtk_print_operation_set_threaded_drawing (GtkPrintOperation *op,
+                                          gboolean           threaded_drawing)
+{
+  GtkPrintOperationPrivate *priv;
+
+  g_return_if_fail (GTK_IS_PRINT_OPERATION (op));
+
+  priv = op->priv;
+
+  threaded_drawing = threaded_drawing != FALSE;
+  if (priv->threaded_drawing != threaded_drawing)
+    {
+      priv->threaded_drawing = threaded_drawing;
+      g_object_notify (G_OBJECT (op), "threaded-drawing");
+    }
+}
+
+/**
+ * gtk_print_operation_get_bytes_written:
+ * @op: a #GtkPrintOperation
+ *
+ * Gets the value of #GtkPrintOperation:bytes-written property.
+ *
+ * Returns: the number of bytes written to the export file so far
+ *
+ * Since: 3.10
+ */
+guint64
+gtk_print_operation_get_bytes_written (GtkPrintOperation *op)
+{
+  g_return_val_if_fail (GTK_IS_PRINT_OPERATION (op), 0);
+
+  return op->priv->bytes_written;
+}
+
+/**
+ * gtk_print_operation_get_threaded_drawing:
+ * @op: a #GtkPrintOperation
+ *
+ * Gets the value of #GtkPrintOperation:threaded-drawing property.
+ *
+ * Returns: whether #GtkPrintOperation::draw-page may be emitted
+ *     from worker threads
+ *
+ * Since: 3.10
+ */
+gboolean
+gtk_print_operation_get_threaded_drawing (GtkPrintOperation *op)
+{
+  g_return_val_if_fail (GTK_IS_PRINT_OPERATION (op), FALSE);
+
+  return op->priv->threaded_drawing;
+}
+
 /**
  * gtk_print_operation_draw_page_finish:
  * @op: a #GtkPrintOperation
@@ -2462,26 +2704,19 @@ gtk_print_operation_draw_page_finish (GtkPrintOperation *op)
   priv->page_drawing_state = GTK_PAGE_DRAWING_STATE_READY;
 }
 
+/* Sets up the cairo context of the print context for drawing
+ * the current page, according to the manual print settings.
+ * The transformation is undone in gtk_print_operation_draw_page_finish().
+ */
 static void
-common_render_page (GtkPrintOperation *op,
-		    gint               page_nr)
+prepare_page_cairo_context (GtkPrintOperation *op)
 {
   GtkPrintOperationPrivate *priv = op->priv;
-  GtkPageSetup *page_setup;
   GtkPrintContext *print_context;
   cairo_t *cr;
 
   print_context = priv->print_context;
-  
-  page_setup = create_page_setup (op);
-  
-  g_signal_emit (op, signals[REQUEST_PAGE_SETUP], 0, 
-		 print_context, page_nr, page_setup);
-  
-  _gtk_print_context_set_page_setup (print_context, page_setup);
-  
-  priv->start_page (op, print_context, page_setup);
-  
+
   cr = gtk_print_context_get_cairo_context (print_context);
   
   cairo_save (cr);
@@ -2678,7 +2913,29 @@ common_render_page (GtkPrintOperation *op,
   else
     if (!priv->use_full_page)
       _gtk_print_context_translate_into_margin (print_context);
+}
+
+static void
+common_render_page (GtkPrintOperation *op,
+		    gint               page_nr)
+{
+  GtkPrintOperationPrivate *priv = op->priv;
+  GtkPageSetup *page_setup;
+  GtkPrintContext *print_context;
+
+  print_context = priv->print_context;
+  
+  page_setup = create_page_setup (op);
+  
+  g_signal_emit (op, signals[REQUEST_PAGE_SETUP], 0, 
+		 print_context, page_nr, page_setup);
+  
+  _gtk_print_context_set_page_setup (print_context, page_setup);
   
+  priv->start_page (op, print_context, page_setup);
+  
+  prepare_page_cairo_context (op);
+
   priv->page_drawing_state = GTK_PAGE_DRAWING_STATE_DRAWING;
 
   g_signal_emit (op, signals[DRAW_PAGE], 0, 
@@ -2688,6 +2945,236 @@ common_render_page (GtkPrintOperation *op,
     gtk_print_operation_draw_page_finish (op);
 }
 
+/* Threaded drawing
+ *
+ * Pages are drawn ahead of time into recording surfaces by a
+ * pool of worker threads, and replayed into the print context
+ * in order from print_pages_idle().
+ */
+
+#define RENDER_AHEAD_PER_THREAD 2
+
+typedef struct
+{
+  GtkPrintContext *print_context;
+  cairo_surface_t *surface;
+  gint page_nr;
+  volatile gint done;
+} PageRender;
+
+typedef struct
+{
+  PrintPagesData *data;
+  GCancellable *cancellable;
+} PageRendered;
+
+static void
+page_render_free (PageRender *render)
+{
+  g_object_unref (render->print_context);
+  cairo_surface_destroy (render->surface);
+  g_slice_free (PageRender, render);
+}
+
+static gboolean
+use_threaded_drawing (PrintPagesData *data)
+{
+  GtkPrintOperationPrivate *priv = data->op->priv;
+
+  /* render_pages_ahead() assumes that every page is printed
+   * exactly once, in the order of data->pages
+   */
+  return priv->threaded_drawing &&
+         !data->is_preview &&
+         priv->manual_num_copies == 1 &&
+         priv->manual_page_set == GTK_PAGE_SET_ALL &&
+         !priv->manual_reverse;
+}
+
+/* The default font map is not thread-safe, so every worker
+ * thread creates the Pango contexts and layouts for its pages
+ * with a font map of its own.
+ */
+static PangoFontMap *
+get_thread_fontmap (void)
+{
+  static GPrivate thread_fontmap = G_PRIVATE_INIT (g_object_unref);
+  PangoFontMap *fontmap;
+
+  fontmap = g_private_get (&thread_fontmap);
+  if (fontmap == NULL)
+    {
+      fontmap = pango_cairo_font_map_new ();
+      g_private_set (&thread_fontmap, fontmap);
+    }
+
+  return fontmap;
+}
+
+static void
+page_rendered_free (gpointer user_data)
+{
+  PageRendered *rendered = user_data;
+
+  g_object_unref (rendered->cancellable);
+  g_slice_free (PageRendered, rendered);
+}
+
+/* Runs in the main thread after a worker finished a page. If
+ * print_pages_idle() is waiting for that page, outputs it and
+ * lets print_pages_idle() go on.
+ */
+static gboolean
+page_rendered_idle (gpointer user_data)
+{
+  PageRendered *rendered = user_data;
+  PrintPagesData *data = rendered->data;
+  GtkPrintOperationPrivate *priv;
+
+  /* Printing stopped, @data may be gone */
+  if (g_cancellable_is_cancelled (rendered->cancellable))
+    return FALSE;
+
+  if (!data->waiting_for_page)
+    return FALSE;
+
+  data->waiting_for_page = FALSE;
+  if (!replay_rendered_page (data))
+    return FALSE;
+
+  priv = data->op->priv;
+  priv->print_pages_idle_id = gdk_threads_add_idle_full (G_PRIORITY_DEFAULT_IDLE + 10,
+                                                         print_pages_idle,
+                                                         data,
+                                                         print_pages_idle_done);
+
+  return FALSE;
+}
+
+static void
+render_page_thread (gpointer task_data,
+                    gpointer user_data)
+{
+  PageRender *render = task_data;
+  PrintPagesData *data = user_data;
+  PageRendered *rendered;
+
+  _gtk_print_context_set_fontmap (render->print_context, get_thread_fontmap ());
+
+  g_signal_emit (data->op, signals[DRAW_PAGE], 0,
+                 render->print_context, render->page_nr);
+
+  g_atomic_int_set (&render->done, TRUE);
+
+  rendered = g_slice_new (PageRendered);
+  rendered->data = data;
+  rendered->cancellable = g_object_ref (data->render_cancellable);
+  gdk_threads_add_idle_full (G_PRIORITY_DEFAULT_IDLE + 10,
+                             page_rendered_idle,
+                             rendered,
+                             page_rendered_free);
+}
+
+static void
+render_pages_ahead (PrintPagesData *data)
+{
+  GtkPrintOperationPrivate *priv = data->op->priv;
+  GtkPageSetup *page_setup;
+  PageRender *render;
+  guint max_threads;
+
+  if (data->render_pool == NULL)
+    {
+      data->render_cancellable = g_cancellable_new ();
+
+      max_threads = MAX (g_get_num_processors (), 1);
+      data->render_pool = g_thread_pool_new (render_page_thread, data,
+                                             max_threads, FALSE, NULL);
+    }
+
+  max_threads = g_thread_pool_get_max_threads (data->render_pool);
+
+  while (data->render_queue.length < max_threads * RENDER_AHEAD_PER_THREAD &&
+         data->render_position < priv->nr_of_pages_to_print)
+    {
+      render = g_slice_new0 (PageRender);
+      render->page_nr = data->pages[data->render_position++];
+      render->surface = cairo_recording_surface_create (CAIRO_CONTENT_COLOR_ALPHA, NULL);
+      render->print_context = _gtk_print_context_new_for_recording (priv->print_context,
+                                                                    render->surface);
+
+      page_setup = create_page_setup (data->op);
+      g_signal_emit (data->op, signals[REQUEST_PAGE_SETUP], 0,
+                     render->print_context, render->page_nr, page_setup);
+      _gtk_print_context_set_page_setup (render->print_context, page_setup);
+      g_object_unref (page_setup);
+
+      g_queue_push_tail (&data->render_queue, render);
+      g_thread_pool_push (data->render_pool, render, NULL);
+    }
+}
+
+/* Outputs the page data->page if a worker has drawn it. If not,
+ * returns %FALSE and sets data->waiting_for_page, and
+ * page_rendered_idle() outputs it once it is drawn.
+ */
+static gboolean
+replay_rendered_page (PrintPagesData *data)
+{
+  GtkPrintOperation *op = data->op;
+  GtkPrintOperationPrivate *priv = op->priv;
+  GtkPageSetup *page_setup;
+  PageRender *render;
+
+  render_pages_ahead (data);
+
+  render = g_queue_peek_head (&data->render_queue);
+  g_assert (render->page_nr == data->page);
+
+  if (!g_atomic_int_get (&render->done))
+    {
+      data->waiting_for_page = TRUE;
+      return FALSE;
+    }
+
+  g_queue_pop_head (&data->render_queue);
+
+  /* The reference is dropped in gtk_print_operation_draw_page_finish() */
+  page_setup = g_object_ref (gtk_print_context_get_page_setup (render->print_context));
+  _gtk_print_context_set_page_setup (priv->print_context, page_setup);
+
+  priv->start_page (op, priv->print_context, page_setup);
+
+  prepare_page_cairo_context (op);
+
+  _gtk_print_context_replay_recording (priv->print_context, render->surface);
+
+  priv->page_drawing_state = GTK_PAGE_DRAWING_STATE_DRAWING;
+  gtk_print_operation_draw_page_finish (op);
+
+  page_render_free (render);
+
+  return TRUE;
+}
+
+static void
+stop_threaded_drawing (PrintPagesData *data)
+{
+  if (data->render_pool == NULL)
+    return;
+
+  /* Waits for the pages being drawn, and drops the others */
+  g_thread_pool_free (data->render_pool, TRUE, TRUE);
+  data->render_pool = NULL;
+
+  g_queue_foreach (&data->render_queue, (GFunc) page_render_free, NULL);
+  g_queue_clear (&data->render_queue);
+
+  /* Tells the pending page_rendered_idle() calls that @data is gone */
+  g_cancellable_cancel (data->render_cancellable);
+  g_clear_object (&data->render_cancellable);
+}
+
 static void
 prepare_data (PrintPagesData *data)
 {
@@ -2889,7 +3376,12 @@ print_pages_idle (gpointer user_data)
 
       increment_page_sequence (data);
 
-      if (!data->done)
+      if (!data->done && use_threaded_drawing (data))
+        {
+          if (!replay_rendered_page (data))
+            return FALSE;
+        }
+      else if (!data->done)
         common_render_page (data->op, data->page);
       else
         done = priv->page_drawing_state == GTK_PAGE_DRAWING_STATE_READY;
@@ -2904,6 +3396,9 @@ print_pages_idle (gpointer user_data)
           done = TRUE;
         }
 
+      if (done)
+        stop_threaded_drawing (data);
+
       if (done && !data->is_preview)
         {
           g_signal_emit (data->op, signals[END_PRINT], 0, priv->print_context);
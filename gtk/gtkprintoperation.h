@@ -281,6 +281,13 @@ GDK_AVAILABLE_IN_ALL
 gboolean                gtk_print_operation_get_embed_page_setup   (GtkPrintOperation  *op);
 GDK_AVAILABLE_IN_ALL
 gint                    gtk_print_operation_get_n_pages_to_print   (GtkPrintOperation  *op);
+GDK_AVAILABLE_IN_3_10
+void                    gtk_print_operation_set_threaded_drawing   (GtkPrintOperation  *op,
+                                                                    gboolean            threaded_drawing);
+GDK_AVAILABLE_IN_3_10
+gboolean                gtk_print_operation_get_threaded_drawing   (GtkPrintOperation  *op);
+GDK_AVAILABLE_IN_3_10
+guint64                 gtk_print_operation_get_bytes_written      (GtkPrintOperation  *op);
 
 GDK_AVAILABLE_IN_ALL
 GtkPageSetup           *gtk_print_run_page_setup_dialog            (GtkWindow          *parent,
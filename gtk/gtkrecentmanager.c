@@ -168,9 +168,18 @@ struct _GtkRecentManagerPrivate
   gchar *filename;
 
   guint is_dirty : 1;
+  guint has_file_stamp : 1;
   
   gint size;
 
+  /* identity of the file as we last read or wrote it; the
+   * entity tag of a local file carries the modification time
+   * with microsecond precision
+   */
+  gchar *file_etag;
+  goffset file_size;
+  guint64 file_inode;
+
   GBookmarkFile *recent_items;
 
   GFileMonitor *monitor;
@@ -216,6 +225,9 @@ static void     gtk_recent_manager_enabled_changed     (GtkRecentManager  *manag
 
 
 static void build_recent_items_list (GtkRecentManager  *manager);
+static gboolean update_file_stamp   (GtkRecentManager  *manager);
+static gboolean write_recent_items  (GtkRecentManager  *manager,
+                                     GError           **error);
 static void purge_recent_items_list (GtkRecentManager  *manager,
                                      GError           **error);
 
@@ -399,6 +411,7 @@ gtk_recent_manager_finalize (GObject *object)
   GtkRecentManagerPrivate *priv = manager->priv;
 
   g_free (priv->filename);
+  g_free (priv->file_etag);
 
   if (priv->recent_items != NULL)
     g_bookmark_file_free (priv->recent_items);
@@ -490,24 +503,16 @@ gtk_recent_manager_real_changed (GtkRecentManager *manager)
         }
 
       write_error = NULL;
-      g_bookmark_file_to_file (priv->recent_items, priv->filename, &write_error);
-      if (write_error)
+      if (!write_recent_items (manager, &write_error))
         {
           filename_warning ("Attempting to store changes into `%s', "
 			    "but failed: %s",
 			    priv->filename,
 			    write_error->message);
 	  g_error_free (write_error);
+	  priv->has_file_stamp = FALSE;
 	}
 
-      if (g_chmod (priv->filename, 0600) < 0)
-        {
-          filename_warning ("Attempting to set the permissions of `%s', "
-                            "but failed: %s",
-                            priv->filename,
-                            g_strerror (errno));
-        }
-
       /* mark us as clean */
       priv->is_dirty = FALSE;
     }
@@ -636,9 +641,165 @@ gtk_recent_manager_set_filename (GtkRecentManager *manager,
   g_object_unref (file);
 
   priv->is_dirty = FALSE;
+  priv->has_file_stamp = FALSE;
   build_recent_items_list (manager);
 }
 
+/* queries the entity tag, size and inode of @path */
+static gboolean
+query_file_stamp (const gchar  *path,
+                  gchar       **etag,
+                  goffset      *size,
+                  guint64      *inode)
+{
+  GFile *file;
+  GFileInfo *info;
+
+  file = g_file_new_for_path (path);
+  info = g_file_query_info (file,
+                            G_FILE_ATTRIBUTE_ETAG_VALUE ","
+                            G_FILE_ATTRIBUTE_STANDARD_SIZE ","
+                            G_FILE_ATTRIBUTE_UNIX_INODE,
+                            G_FILE_QUERY_INFO_NONE,
+                            NULL, NULL);
+  g_object_unref (file);
+
+  if (info == NULL)
+    return FALSE;
+
+  if (g_file_info_get_etag (info) == NULL)
+    {
+      g_object_unref (info);
+      return FALSE;
+    }
+
+  *etag = g_strdup (g_file_info_get_etag (info));
+  *size = g_file_info_get_size (info);
+  *inode = g_file_info_get_attribute_uint64 (info, G_FILE_ATTRIBUTE_UNIX_INODE);
+
+  g_object_unref (info);
+
+  return TRUE;
+}
+
+/* queries the recently used resources file and stores its entity
+ * tag, size and inode; returns TRUE if the file is unchanged since
+ * the last time this function was called or we wrote it.
+ */
+static gboolean
+update_file_stamp (GtkRecentManager *manager)
+{
+  GtkRecentManagerPrivate *priv = manager->priv;
+  gchar *etag;
+  goffset size;
+  guint64 inode;
+  gboolean unchanged;
+
+  if (!query_file_stamp (priv->filename, &etag, &size, &inode))
+    {
+      priv->has_file_stamp = FALSE;
+      return FALSE;
+    }
+
+  unchanged = priv->has_file_stamp &&
+              g_strcmp0 (priv->file_etag, etag) == 0 &&
+              priv->file_size == size &&
+              priv->file_inode == inode;
+
+  g_free (priv->file_etag);
+  priv->file_etag = etag;
+  priv->file_size = size;
+  priv->file_inode = inode;
+  priv->has_file_stamp = TRUE;
+
+  return unchanged;
+}
+
+/* writes the items list to a temporary file next to the recently
+ * used resources file and moves it in place. The stamp is taken
+ * from the temporary file, which nobody else writes to, so that
+ * a write from another process right after ours is never mistaken
+ * for our own when the file monitor tells us about it.
+ */
+static gboolean
+write_recent_items (GtkRecentManager  *manager,
+                    GError           **error)
+{
+  GtkRecentManagerPrivate *priv = manager->priv;
+  gchar *data, *tmp_filename, *etag;
+  gsize length;
+  goffset size;
+  guint64 inode;
+  gboolean has_stamp;
+  gint fd, saved_errno;
+
+  data = g_bookmark_file_to_data (priv->recent_items, &length, error);
+  if (data == NULL)
+    return FALSE;
+
+  tmp_filename = g_strconcat (priv->filename, ".XXXXXX", NULL);
+
+  /* reserve a name only we use; the file is created with mode 0600 */
+  fd = g_mkstemp (tmp_filename);
+  if (fd == -1)
+    {
+      saved_errno = errno;
+      g_set_error (error, G_FILE_ERROR, g_file_error_from_errno (saved_errno),
+                   "%s", g_strerror (saved_errno));
+      g_free (tmp_filename);
+      g_free (data);
+      return FALSE;
+    }
+  g_close (fd, NULL);
+
+  if (!g_file_set_contents (tmp_filename, data, length, error))
+    {
+      g_unlink (tmp_filename);
+      g_free (tmp_filename);
+      g_free (data);
+      return FALSE;
+    }
+
+  g_free (data);
+
+  if (g_chmod (tmp_filename, 0600) < 0)
+    {
+      filename_warning ("Attempting to set the permissions of `%s', "
+                        "but failed: %s",
+                        tmp_filename,
+                        g_strerror (errno));
+    }
+
+  /* renaming keeps the inode and modification time */
+  has_stamp = query_file_stamp (tmp_filename, &etag, &size, &inode);
+
+  if (g_rename (tmp_filename, priv->filename) < 0)
+    {
+      saved_errno = errno;
+      g_set_error (error, G_FILE_ERROR, g_file_error_from_errno (saved_errno),
+                   "%s", g_strerror (saved_errno));
+      g_unlink (tmp_filename);
+      g_free (tmp_filename);
+      if (has_stamp)
+        g_free (etag);
+      return FALSE;
+    }
+
+  g_free (tmp_filename);
+
+  /* remember what we wrote, so that the file monitor
+   * notifying us about our own changes does not make
+   * us parse the file again
+   */
+  g_free (priv->file_etag);
+  priv->file_etag = has_stamp ? etag : NULL;
+  priv->file_size = has_stamp ? size : 0;
+  priv->file_inode = has_stamp ? inode : 0;
+  priv->has_file_stamp = has_stamp;
+
+  return TRUE;
+}
+
 /* reads the recently used resources file and builds the items list.
  * we keep the items list inside the parser object, and build the
  * RecentInfo object only on user's demand to avoid useless replication.
@@ -652,6 +813,17 @@ build_recent_items_list (GtkRecentManager *manager)
   gint size;
 
   g_assert (priv->filename != NULL);
+
+  /* the file monitor fires multiple times for a single save, and
+   * also when we are the ones who saved; skip parsing the whole
+   * file again if it has not been replaced or modified since we
+   * last read or wrote it
+   */
+  if (update_file_stamp (manager) && priv->recent_items)
+    {
+      priv->is_dirty = FALSE;
+      return;
+    }
   
   if (!priv->recent_items)
     {
@@ -21,65 +21,507 @@
 
 #include "config.h"
 
-/* these must be defined even when HAVE_GNU_FTW is not defined
- * because (really) old versions of GNU libc have ftw.h but do
- * export ftw() and friends only if _XOPEN_SOURCE and _GNU_SOURCE
- * are defined. see bug #444097.
- */
-#define _XOPEN_SOURCE 600
-#define _GNU_SOURCE
-
-#ifdef HAVE_FTW_H
-#include <ftw.h>
-#endif
-
 #include <gdk/gdk.h>
+#include <glib/gstdio.h>
 
 #include "gtksearchenginesimple.h"
 #include "gtkprivate.h"
 
 #include <string.h>
 
+#ifndef S_ISDIR
+#define S_ISDIR(mode) ((mode)&_S_IFDIR)
+#endif
+
 #define BATCH_SIZE 500
 
-typedef struct 
+/* Directories are searched by a pool of threads, so that
+ * waiting for one directory (think NFS) doesn't block all
+ * of the search. */
+#define MAX_SEARCH_THREADS 8
+
+/* The names found while crawling a directory tree are kept in an
+ * index, so that later queries are answered from memory. The index
+ * is brought up to date by another crawl if it is older than this,
+ * which only needs to read the directories whose mtime changed. */
+#define INDEX_REFRESH_INTERVAL_SEC 60
+
+/* Indexes nobody searched for this long are dropped from memory */
+#define INDEX_DROP_TIMEOUT_SEC 300
+
+/* Optionally the index is saved below the user cache dir, see the
+ * search-index key of org.gtk.Settings.FileChooser */
+#define INDEX_FILE_VERSION 1
+#define INDEX_FILE_TYPE "(uxaya(ayxayay))"
+
+/* Each directory has a bit set for every trigram of its lowercased
+ * names, so most directories are skipped without looking at the
+ * names when answering a query */
+#define TRIGRAM_FILTER_BITS 512
+
+typedef struct
+{
+  volatile gint ref_count;
+
+  gchar *path;
+  gint64 mtime;           /* -1 if it may have changed after reading */
+  gchar *names;           /* NUL separated, in the filename encoding */
+  gsize names_len;
+  guint8 *is_dir;         /* one for each name */
+  guint n_names;
+  guint32 trigrams[TRIGRAM_FILTER_BITS / 32];
+
+  /* protected by the index lock */
+  guint generation;       /* of the last crawl that saw the directory */
+} IndexDir;
+
+typedef struct
+{
+  gchar *root;
+
+  /* protected by indexes_lock */
+  guint n_users;
+
+  /* protected by lock: */
+  GMutex lock;
+  GHashTable *dirs;       /* path => IndexDir */
+  gint64 refresh_time;    /* of the last complete crawl, 0 if none */
+  guint generation;
+  gboolean refreshing;
+  gboolean loaded;
+  gboolean changed;
+} SearchIndex;
+
+typedef struct
 {
   GtkSearchEngineSimple *engine;
-  
+
   gchar *path;
   gchar **words;
-  GList *found_list;
-  
+  guint32 trigrams[TRIGRAM_FILTER_BITS / 32];
+
+  SearchIndex *index;
+  gboolean persistent;
+  gboolean answered;      /* all indexed directories were searched */
+  gboolean owner;         /* we may update the index */
+  guint generation;
+
+  /* accessed by all search threads, protected by lock: */
+  GMutex lock;
+  GCond cond;
+  GQueue directories;
+  guint n_busy;
+  guint n_threads;
   gint n_processed_files;
   GList *uri_hits;
-  
-  /* accessed on both threads: */
+  GList *uri_removed;
+
+  /* accessed on all threads: */
   volatile gboolean cancelled;
 } SearchThreadData;
 
 
-struct _GtkSearchEngineSimplePrivate 
+struct _GtkSearchEngineSimplePrivate
 {
   GtkQuery *query;
-  
+
   SearchThreadData *active_search;
-  
+
   gboolean query_finished;
 };
 
+static GMutex indexes_lock;
+static GHashTable *indexes;     /* root => SearchIndex */
+static guint drop_indexes_id;
+
 
 G_DEFINE_TYPE_WITH_PRIVATE (GtkSearchEngineSimple, _gtk_search_engine_simple, GTK_TYPE_SEARCH_ENGINE)
 
+static guint
+trigram_bit (const gchar *s)
+{
+  guint32 t;
+
+  t = ((guchar) s[0] << 16) | ((guchar) s[1] << 8) | (guchar) s[2];
+
+  return ((t * 2654435761u) >> 16) % TRIGRAM_FILTER_BITS;
+}
+
+/* Sets the bits of the trigrams of the lowercased @name */
+static void
+add_trigrams (guint32     *trigrams,
+              const gchar *name,
+              gsize        len)
+{
+  gchar t[3];
+  gsize i;
+
+  if (len < 3)
+    return;
+
+  t[0] = g_ascii_tolower (name[0]);
+  t[1] = g_ascii_tolower (name[1]);
+
+  for (i = 2; i < len; i++)
+    {
+      guint bit;
+
+      t[2] = g_ascii_tolower (name[i]);
+      bit = trigram_bit (t);
+      trigrams[bit / 32] |= 1u << (bit % 32);
+
+      t[0] = t[1];
+      t[1] = t[2];
+    }
+}
+
+static IndexDir *
+index_dir_new (const gchar *path,
+               gint64       mtime,
+               GString     *names,
+               GByteArray  *is_dir)
+{
+  IndexDir *dir;
+  const gchar *name;
+
+  dir = g_slice_new0 (IndexDir);
+  dir->ref_count = 1;
+  dir->path = g_strdup (path);
+  dir->mtime = mtime;
+  dir->names_len = names->len;
+  dir->names = g_memdup (names->str, names->len);
+  dir->n_names = is_dir->len;
+  dir->is_dir = g_memdup (is_dir->data, is_dir->len);
+
+  for (name = dir->names; name < dir->names + dir->names_len; name += strlen (name) + 1)
+    add_trigrams (dir->trigrams, name, strlen (name));
+
+  return dir;
+}
+
+static IndexDir *
+index_dir_ref (IndexDir *dir)
+{
+  g_atomic_int_inc (&dir->ref_count);
+
+  return dir;
+}
+
+static void
+index_dir_unref (IndexDir *dir)
+{
+  if (!g_atomic_int_dec_and_test (&dir->ref_count))
+    return;
+
+  g_free (dir->path);
+  g_free (dir->names);
+  g_free (dir->is_dir);
+  g_slice_free (IndexDir, dir);
+}
+
+/* Whether @path is @root or below it */
+static gboolean
+path_is_below (const gchar *path,
+               const gchar *root)
+{
+  gsize len = strlen (root);
+
+  if (strncmp (path, root, len) != 0)
+    return FALSE;
+
+  return path[len] == '\0' ||
+         path[len] == G_DIR_SEPARATOR ||
+         (len > 0 && root[len - 1] == G_DIR_SEPARATOR);
+}
+
+static gchar *
+search_index_get_filename (const gchar *root)
+{
+  gchar *checksum, *basename, *filename;
+
+  checksum = g_compute_checksum_for_string (G_CHECKSUM_MD5, root, -1);
+  basename = g_strconcat (checksum, ".index", NULL);
+  filename = g_build_filename (g_get_user_cache_dir (), "gtk-3.0", "file-search",
+                               basename, NULL);
+  g_free (basename);
+  g_free (checksum);
+
+  return filename;
+}
+
+/* Must be called with index->lock held */
+static void
+search_index_load (SearchIndex *index)
+{
+  GVariant *variant, *dirs, *root;
+  gchar *filename, *contents;
+  gsize length, i;
+  guint32 version;
+  gint64 refresh_time;
+
+  filename = search_index_get_filename (index->root);
+  if (!g_file_get_contents (filename, &contents, &length, NULL))
+    {
+      g_free (filename);
+      return;
+    }
+  g_free (filename);
+
+  variant = g_variant_new_from_data (G_VARIANT_TYPE (INDEX_FILE_TYPE),
+                                     contents, length, FALSE,
+                                     g_free, contents);
+  g_variant_ref_sink (variant);
+  g_variant_get (variant, "(ux@ay@a(ayxayay))", &version, &refresh_time, &root, &dirs);
+
+  if (version == INDEX_FILE_VERSION &&
+      g_strcmp0 (g_variant_get_bytestring (root), index->root) == 0)
+    {
+      for (i = 0; i < g_variant_n_children (dirs); i++)
+        {
+          GVariant *names_v, *is_dir_v;
+          const gchar *path, *names_data;
+          gsize names_len, n_names;
+          const guint8 *is_dir_data;
+          GString names;
+          GByteArray is_dir;
+          gint64 mtime;
+
+          g_variant_get_child (dirs, i, "(^&ayx@ay@ay)", &path, &mtime, &names_v, &is_dir_v);
+          names_data = g_variant_get_fixed_array (names_v, &names_len, 1);
+          is_dir_data = g_variant_get_fixed_array (is_dir_v, &n_names, 1);
+
+          /* Every name has to be NUL terminated */
+          if (names_len == 0 || names_data[names_len - 1] == '\0')
+            {
+              const gchar *p;
+              gsize count = 0;
+
+              for (p = names_data; p < names_data + names_len; p += strlen (p) + 1)
+                count++;
+
+              if (count == n_names && path_is_below (path, index->root))
+                {
+                  names.str = (gchar *) names_data;
+                  names.len = names_len;
+                  is_dir.data = (guint8 *) is_dir_data;
+                  is_dir.len = n_names;
+
+                  g_hash_table_insert (index->dirs, g_strdup (path),
+                                       index_dir_new (path, mtime, &names, &is_dir));
+                }
+            }
+
+          g_variant_unref (names_v);
+          g_variant_unref (is_dir_v);
+        }
+
+      index->refresh_time = refresh_time;
+    }
+
+  g_variant_unref (root);
+  g_variant_unref (dirs);
+  g_variant_unref (variant);
+}
+
+static void
+search_index_save (SearchIndex *index)
+{
+  GVariantBuilder builder;
+  GHashTableIter iter;
+  GVariant *variant;
+  gpointer value;
+  gchar *filename, *dirname;
+
+  g_mutex_lock (&index->lock);
+
+  g_variant_builder_init (&builder, G_VARIANT_TYPE ("a(ayxayay)"));
+
+  g_hash_table_iter_init (&iter, index->dirs);
+  while (g_hash_table_iter_next (&iter, NULL, &value))
+    {
+      IndexDir *dir = value;
+
+      g_variant_builder_add (&builder, "(^ayx@ay@ay)",
+                             dir->path, dir->mtime,
+                             g_variant_new_fixed_array (G_VARIANT_TYPE_BYTE,
+                                                        dir->names, dir->names_len, 1),
+                             g_variant_new_fixed_array (G_VARIANT_TYPE_BYTE,
+                                                        dir->is_dir, dir->n_names, 1));
+    }
+
+  variant = g_variant_new ("(ux^ay@a(ayxayay))",
+                           INDEX_FILE_VERSION, index->refresh_time, index->root,
+                           g_variant_builder_end (&builder));
+  g_variant_ref_sink (variant);
+
+  index->changed = FALSE;
+
+  g_mutex_unlock (&index->lock);
+
+  filename = search_index_get_filename (index->root);
+  dirname = g_path_get_dirname (filename);
+
+  if (g_mkdir_with_parents (dirname, 0700) == 0)
+    g_file_set_contents (filename,
+                         g_variant_get_data (variant),
+                         g_variant_get_size (variant),
+                         NULL);
+
+  g_free (dirname);
+  g_free (filename);
+  g_variant_unref (variant);
+}
+
+static void
+search_index_free (SearchIndex *index)
+{
+  g_hash_table_destroy (index->dirs);
+  g_mutex_clear (&index->lock);
+  g_free (index->root);
+  g_free (index);
+}
+
+static gboolean
+drop_indexes_cb (gpointer user_data)
+{
+  GHashTableIter iter;
+  gpointer value;
+
+  g_mutex_lock (&indexes_lock);
+
+  g_hash_table_iter_init (&iter, indexes);
+  while (g_hash_table_iter_next (&iter, NULL, &value))
+    {
+      SearchIndex *index = value;
+
+      if (index->n_users == 0)
+        {
+          g_hash_table_iter_remove (&iter);
+          search_index_free (index);
+        }
+    }
+
+  drop_indexes_id = 0;
+
+  g_mutex_unlock (&indexes_lock);
+
+  return G_SOURCE_REMOVE;
+}
+
+/* Returns the index to use for searching @path, which is a complete
+ * index of @path or one of its parents if there is one */
+static SearchIndex *
+search_index_acquire (const gchar *path)
+{
+  SearchIndex *index = NULL;
+  GHashTableIter iter;
+  gpointer value;
+
+  g_mutex_lock (&indexes_lock);
+
+  if (indexes == NULL)
+    indexes = g_hash_table_new (g_str_hash, g_str_equal);
+
+  g_hash_table_iter_init (&iter, indexes);
+  while (g_hash_table_iter_next (&iter, NULL, &value))
+    {
+      SearchIndex *candidate = value;
+      gboolean complete;
+
+      if (!path_is_below (path, candidate->root))
+        continue;
+
+      g_mutex_lock (&candidate->lock);
+      complete = candidate->refresh_time != 0;
+      g_mutex_unlock (&candidate->lock);
+
+      if (complete || strcmp (candidate->root, path) == 0)
+        {
+          index = candidate;
+          if (complete)
+            break;
+        }
+    }
+
+  if (index == NULL)
+    {
+      index = g_new0 (SearchIndex, 1);
+      index->root = g_strdup (path);
+      index->dirs = g_hash_table_new_full (g_str_hash, g_str_equal,
+                                           g_free, (GDestroyNotify) index_dir_unref);
+      g_mutex_init (&index->lock);
+
+      g_hash_table_insert (indexes, index->root, index);
+    }
+
+  index->n_users++;
+
+  g_mutex_unlock (&indexes_lock);
+
+  return index;
+}
+
+static void
+search_index_release (SearchIndex *index)
+{
+  g_mutex_lock (&indexes_lock);
+
+  index->n_users--;
+
+  if (drop_indexes_id != 0)
+    g_source_remove (drop_indexes_id);
+  drop_indexes_id = gdk_threads_add_timeout_seconds (INDEX_DROP_TIMEOUT_SEC,
+                                                     drop_indexes_cb, NULL);
+
+  g_mutex_unlock (&indexes_lock);
+}
+
+static gboolean
+search_index_is_persistent (void)
+{
+  GSettingsSchema *schema;
+  GSettings *settings;
+  gboolean persistent = FALSE;
+  gchar **keys;
+  guint i;
+
+  schema = g_settings_schema_source_lookup (g_settings_schema_source_get_default (),
+                                            "org.gtk.Settings.FileChooser", TRUE);
+  if (schema == NULL)
+    return FALSE;
+  g_settings_schema_unref (schema);
+
+  settings = g_settings_new ("org.gtk.Settings.FileChooser");
+
+  /* Older installed schemas may lack the key */
+  G_GNUC_BEGIN_IGNORE_DEPRECATIONS
+  keys = g_settings_list_keys (settings);
+  G_GNUC_END_IGNORE_DEPRECATIONS
+  for (i = 0; keys[i] != NULL; i++)
+    {
+      if (strcmp (keys[i], "search-index") == 0)
+        {
+          persistent = g_settings_get_boolean (settings, "search-index");
+          break;
+        }
+    }
+
+  g_strfreev (keys);
+  g_object_unref (settings);
+
+  return persistent;
+}
+
 static void
 gtk_search_engine_simple_dispose (GObject *object)
 {
   GtkSearchEngineSimple *simple;
   GtkSearchEngineSimplePrivate *priv;
-  
+
   simple = GTK_SEARCH_ENGINE_SIMPLE (object);
   priv = simple->priv;
-  
-  if (priv->query) 
+
+  if (priv->query)
     {
       g_object_unref (priv->query);
       priv->query = NULL;
@@ -90,7 +532,7 @@ gtk_search_engine_simple_dispose (GObject *object)
       priv->active_search->cancelled = TRUE;
       priv->active_search = NULL;
     }
-  
+
   G_OBJECT_CLASS (_gtk_search_engine_simple_parent_class)->dispose (object);
 }
 
@@ -100,34 +542,50 @@ search_thread_data_new (GtkSearchEngineSimple *engine,
 {
   SearchThreadData *data;
   char *text, *lower, *uri;
-  
+  guint i;
+
   data = g_new0 (SearchThreadData, 1);
-  
+
   data->engine = g_object_ref (engine);
   uri = _gtk_query_get_location (query);
-  if (uri != NULL) 
+  if (uri != NULL)
     {
       data->path = g_filename_from_uri (uri, NULL, NULL);
       g_free (uri);
     }
   if (data->path == NULL)
     data->path = g_strdup (g_get_home_dir ());
-	
+
   text = _gtk_query_get_text (query);
   lower = g_ascii_strdown (text, -1);
   data->words = g_strsplit (lower, " ", -1);
   g_free (text);
   g_free (lower);
-  
+
+  for (i = 0; data->words[i] != NULL; i++)
+    add_trigrams (data->trigrams, data->words[i], strlen (data->words[i]));
+
+  data->index = search_index_acquire (data->path);
+  data->persistent = search_index_is_persistent ();
+
+  g_mutex_init (&data->lock);
+  g_cond_init (&data->cond);
+  g_queue_init (&data->directories);
+
   return data;
 }
 
-static void 
+static void
 search_thread_data_free (SearchThreadData *data)
 {
+  search_index_release (data->index);
   g_object_unref (data->engine);
   g_free (data->path);
   g_strfreev (data->words);
+  g_queue_foreach (&data->directories, (GFunc) g_free, NULL);
+  g_queue_clear (&data->directories);
+  g_cond_clear (&data->cond);
+  g_mutex_clear (&data->lock);
   g_free (data);
 }
 
@@ -137,19 +595,20 @@ search_thread_done_idle (gpointer user_data)
   SearchThreadData *data;
 
   data = user_data;
-  
+
   if (!data->cancelled)
     _gtk_search_engine_finished (GTK_SEARCH_ENGINE (data->engine));
-     
+
   data->engine->priv->active_search = NULL;
   search_thread_data_free (data);
-  
+
   return FALSE;
 }
 
-typedef struct 
+typedef struct
 {
   GList *uris;
+  GList *removed;
   SearchThreadData *thread_data;
 } SearchHits;
 
@@ -161,153 +620,547 @@ search_thread_add_hits_idle (gpointer user_data)
 
   hits = user_data;
 
-  if (!hits->thread_data->cancelled) 
+  if (!hits->thread_data->cancelled)
     {
-      _gtk_search_engine_hits_added (GTK_SEARCH_ENGINE (hits->thread_data->engine),
-				    hits->uris);
+      if (hits->removed)
+        _gtk_search_engine_hits_subtracted (GTK_SEARCH_ENGINE (hits->thread_data->engine),
+                                            hits->removed);
+      if (hits->uris)
+        _gtk_search_engine_hits_added (GTK_SEARCH_ENGINE (hits->thread_data->engine),
+                                       hits->uris);
     }
 
   g_list_free_full (hits->uris, g_free);
+  g_list_free_full (hits->removed, g_free);
   g_free (hits);
-	
+
   return FALSE;
 }
 
+/* Must be called with data->lock held */
 static void
 send_batch (SearchThreadData *data)
 {
   SearchHits *hits;
-  
+
   data->n_processed_files = 0;
-  
-  if (data->uri_hits) 
+
+  if (data->uri_hits || data->uri_removed)
     {
       hits = g_new (SearchHits, 1);
       hits->uris = data->uri_hits;
+      hits->removed = data->uri_removed;
       hits->thread_data = data;
-      
+
       gdk_threads_add_idle (search_thread_add_hits_idle, hits);
     }
 
   data->uri_hits = NULL;
+  data->uri_removed = NULL;
 }
 
-static GPrivate search_thread_data;
-
-#ifdef HAVE_FTW_H
-static int
-search_visit_func (const char        *fpath,
-		   const struct stat *sb,
-		   int                typeflag,
-		   struct FTW        *ftwbuf)
+static gboolean
+name_matches (const char  *name,
+              gchar      **words)
 {
-  SearchThreadData *data;
-  gint i;
-  const gchar *name;
+  gchar buffer[256];
   gchar *lower_name;
-  gchar *uri;
   gboolean hit;
-  gboolean is_hidden;
+  gsize i, len;
+
+  /* Avoid allocating for every file name, they're usually short */
+  len = strlen (name);
+  if (len < sizeof (buffer))
+    {
+      for (i = 0; i < len; i++)
+        buffer[i] = g_ascii_tolower (name[i]);
+      buffer[len] = '\0';
+      lower_name = buffer;
+    }
+  else
+    lower_name = g_ascii_strdown (name, len);
 
-  data = (SearchThreadData*)g_private_get (&search_thread_data);
+  hit = TRUE;
+  for (i = 0; words[i] != NULL; i++)
+    {
+      if (strstr (lower_name, words[i]) == NULL)
+        {
+          hit = FALSE;
+          break;
+        }
+    }
 
-  if (data->cancelled)
-#ifdef HAVE_GNU_FTW
-    return FTW_STOP;
-#else
-    return 1;
-#endif /* HAVE_GNU_FTW */
+  if (lower_name != buffer)
+    g_free (lower_name);
 
-  name = strrchr (fpath, '/');
-  if (name)
-    name++;
-  else
-    name = fpath;
-
-  is_hidden = *name == '.';
-	
-  hit = FALSE;
-  
-  if (!is_hidden) 
-    {
-      lower_name = g_ascii_strdown (name, -1);
-      
-      hit = TRUE;
-      for (i = 0; data->words[i] != NULL; i++) 
-	{
-	  if (strstr (lower_name, data->words[i]) == NULL) 
-	    {
-	      hit = FALSE;
-	      break;
-	    }
-	}
-      g_free (lower_name);
-    }
-
-  if (hit) 
-    {
-      uri = g_filename_to_uri (fpath, NULL, NULL);
-      data->uri_hits = g_list_prepend (data->uri_hits, uri);
-    }
-
-  data->n_processed_files++;
-  
-  if (data->n_processed_files > BATCH_SIZE)
-    send_batch (data);
-
-#ifdef HAVE_GNU_FTW
-  if (is_hidden)
-    return FTW_SKIP_SUBTREE;
+  return hit;
+}
+
+static void
+add_uri (GList       **uris,
+         const gchar  *dir_path,
+         const gchar  *name)
+{
+  gchar *path, *uri;
+
+  path = g_build_filename (dir_path, name, NULL);
+  uri = g_filename_to_uri (path, NULL, NULL);
+  if (uri)
+    *uris = g_list_prepend (*uris, uri);
+  g_free (path);
+}
+
+/* Returns the names in @dir matching the query, pointing into @dir */
+static GPtrArray *
+index_dir_match (SearchThreadData *data,
+                 IndexDir         *dir)
+{
+  GPtrArray *matches;
+  const gchar *name;
+  guint i;
+
+  matches = g_ptr_array_new ();
+
+  for (i = 0; i < G_N_ELEMENTS (data->trigrams); i++)
+    {
+      if ((dir->trigrams[i] & data->trigrams[i]) != data->trigrams[i])
+        return matches;
+    }
+
+  for (name = dir->names; name < dir->names + dir->names_len; name += strlen (name) + 1)
+    {
+      if (name_matches (name, data->words))
+        g_ptr_array_add (matches, (gpointer) name);
+    }
+
+  return matches;
+}
+
+/* Adds the matches in @dir that are not in @other to @uris */
+static void
+index_dir_diff_matches (SearchThreadData  *data,
+                        IndexDir          *dir,
+                        IndexDir          *other,
+                        GList            **uris)
+{
+  GPtrArray *matches, *other_matches;
+  GHashTable *other_names = NULL;
+  guint i;
+
+  matches = index_dir_match (data, dir);
+  if (matches->len == 0)
+    {
+      g_ptr_array_free (matches, TRUE);
+      return;
+    }
+
+  if (other)
+    {
+      other_matches = index_dir_match (data, other);
+      other_names = g_hash_table_new (g_str_hash, g_str_equal);
+      for (i = 0; i < other_matches->len; i++)
+        g_hash_table_add (other_names, other_matches->pdata[i]);
+      g_ptr_array_free (other_matches, TRUE);
+    }
+
+  for (i = 0; i < matches->len; i++)
+    {
+      if (other_names == NULL || !g_hash_table_contains (other_names, matches->pdata[i]))
+        add_uri (uris, dir->path, matches->pdata[i]);
+    }
+
+  if (other_names)
+    g_hash_table_destroy (other_names);
+  g_ptr_array_free (matches, TRUE);
+}
+
+/* The directory searched is a hit too, as long as it's not hidden */
+static void
+search_root (SearchThreadData *data)
+{
+  gchar *basename;
+
+  basename = g_path_get_basename (data->path);
+
+  if (*basename != '.' && *basename != G_DIR_SEPARATOR &&
+      name_matches (basename, data->words))
+    {
+      gchar *uri = g_filename_to_uri (data->path, NULL, NULL);
+
+      if (uri)
+        data->uri_hits = g_list_prepend (data->uri_hits, uri);
+    }
+
+  g_free (basename);
+}
+
+/* Answers the query from the index, without touching the filesystem.
+ * Called before the search threads are started.
+ */
+static void
+search_index (SearchThreadData *data)
+{
+  GHashTableIter iter;
+  GPtrArray *dirs;
+  gpointer value;
+  guint i;
+
+  dirs = g_ptr_array_new_with_free_func ((GDestroyNotify) index_dir_unref);
+
+  g_mutex_lock (&data->index->lock);
+
+  g_hash_table_iter_init (&iter, data->index->dirs);
+  while (g_hash_table_iter_next (&iter, NULL, &value))
+    {
+      IndexDir *dir = value;
+
+      if (path_is_below (dir->path, data->path))
+        g_ptr_array_add (dirs, index_dir_ref (dir));
+    }
+
+  g_mutex_unlock (&data->index->lock);
+
+  for (i = 0; i < dirs->len && !data->cancelled; i++)
+    {
+      index_dir_diff_matches (data, dirs->pdata[i], NULL, &data->uri_hits);
+      data->n_processed_files += ((IndexDir *) dirs->pdata[i])->n_names;
+
+      if (data->n_processed_files > BATCH_SIZE)
+        send_batch (data);
+    }
+
+  g_ptr_array_free (dirs, TRUE);
+}
+
+/* Reads the names in @dir_path. Hidden files are skipped,
+ * symlinks are not followed.
+ */
+static IndexDir *
+index_dir_read (SearchThreadData *data,
+                const gchar      *dir_path,
+                gint64            mtime)
+{
+  GString *names;
+  GByteArray *is_dir;
+  const gchar *name;
+  IndexDir *result;
+  GDir *dir;
+
+  dir = g_dir_open (dir_path, 0, NULL);
+  if (dir == NULL)
+    return NULL;
+
+  names = g_string_new (NULL);
+  is_dir = g_byte_array_new ();
+
+  while (!data->cancelled && (name = g_dir_read_name (dir)) != NULL)
+    {
+      GStatBuf buf;
+      gchar *path;
+      guint8 dir_flag;
+
+      if (*name == '.')
+        continue;
+
+      path = g_build_filename (dir_path, name, NULL);
+      dir_flag = g_lstat (path, &buf) == 0 && S_ISDIR (buf.st_mode);
+      g_free (path);
+
+      g_string_append_len (names, name, strlen (name) + 1);
+      g_byte_array_append (is_dir, &dir_flag, 1);
+    }
+
+  g_dir_close (dir);
+
+  result = NULL;
+  if (!data->cancelled)
+    result = index_dir_new (dir_path, mtime, names, is_dir);
+
+  g_string_free (names, TRUE);
+  g_byte_array_free (is_dir, TRUE);
+
+  return result;
+}
+
+/* Searches @dir_path without holding data->lock, reusing the
+ * indexed names if the directory didn't change since.
+ */
+static void
+search_directory (SearchThreadData  *data,
+                  const gchar       *dir_path,
+                  GList            **hits,
+                  GList            **removed,
+                  GList            **subdirs,
+                  gint              *n_files)
+{
+  IndexDir *old, *dir;
+  const gchar *name;
+  GStatBuf buf;
+  gint64 mtime;
+  guint i;
+
+  if (g_stat (dir_path, &buf) != 0 || !S_ISDIR (buf.st_mode))
+    return;
+
+  mtime = buf.st_mtime;
+
+  /* Changes within the second we read the directory in
+   * wouldn't change its mtime, so read it again next time */
+  if (mtime >= g_get_real_time () / G_USEC_PER_SEC - 1)
+    mtime = -1;
+
+  g_mutex_lock (&data->index->lock);
+  old = g_hash_table_lookup (data->index->dirs, dir_path);
+  if (old)
+    index_dir_ref (old);
+  g_mutex_unlock (&data->index->lock);
+
+  if (old && old->mtime != -1 && old->mtime == mtime)
+    dir = index_dir_ref (old);
   else
-    return FTW_CONTINUE;
-#else
-  return 0;
-#endif /* HAVE_GNU_FTW */
+    dir = index_dir_read (data, dir_path, mtime);
+
+  if (dir == NULL)
+    {
+      if (old)
+        index_dir_unref (old);
+      return;
+    }
+
+  /* Everything in the index was reported already */
+  if (!data->answered)
+    index_dir_diff_matches (data, dir, NULL, hits);
+  else if (dir != old)
+    {
+      index_dir_diff_matches (data, dir, old, hits);
+      if (old)
+        index_dir_diff_matches (data, old, dir, removed);
+    }
+
+  *n_files += dir->n_names;
+
+  for (name = dir->names, i = 0; i < dir->n_names; name += strlen (name) + 1, i++)
+    {
+      if (dir->is_dir[i])
+        *subdirs = g_list_prepend (*subdirs, g_build_filename (dir_path, name, NULL));
+    }
+
+  if (data->owner)
+    {
+      g_mutex_lock (&data->index->lock);
+      dir->generation = data->generation;
+      if (dir != old)
+        {
+          g_hash_table_replace (data->index->dirs, g_strdup (dir_path), index_dir_ref (dir));
+          data->index->changed = TRUE;
+        }
+      g_mutex_unlock (&data->index->lock);
+    }
+
+  if (old)
+    index_dir_unref (old);
+  index_dir_unref (dir);
+}
+
+/* Called by the last search thread to finish. Drops the directories
+ * that went away from the index and reports their hits as removed.
+ */
+static void
+search_finish_refresh (SearchThreadData *data)
+{
+  SearchIndex *index = data->index;
+  GHashTableIter iter;
+  gpointer value;
+  gboolean save;
+
+  g_mutex_lock (&index->lock);
+
+  if (!data->cancelled)
+    {
+      g_hash_table_iter_init (&iter, index->dirs);
+      while (g_hash_table_iter_next (&iter, NULL, &value))
+        {
+          IndexDir *dir = value;
+
+          if (dir->generation != data->generation &&
+              path_is_below (dir->path, data->path))
+            {
+              if (data->answered)
+                index_dir_diff_matches (data, dir, NULL, &data->uri_removed);
+
+              g_hash_table_iter_remove (&iter);
+              index->changed = TRUE;
+            }
+        }
+
+      if (strcmp (data->path, index->root) == 0)
+        index->refresh_time = g_get_real_time ();
+    }
+
+  index->refreshing = FALSE;
+  save = data->persistent && index->changed && index->refresh_time != 0;
+
+  g_mutex_unlock (&index->lock);
+
+  if (save && !data->cancelled)
+    search_index_save (index);
 }
-#endif /* HAVE_FTW_H */
 
-static gpointer 
+static gpointer
 search_thread_func (gpointer user_data)
 {
-#ifdef HAVE_FTW_H
   SearchThreadData *data;
-  
+  gboolean last;
+
   data = user_data;
-  
-  g_private_set (&search_thread_data, data);
 
-  nftw (data->path, search_visit_func, 20,
-#ifdef HAVE_GNU_FTW
-        FTW_ACTIONRETVAL |
-#endif
-        FTW_PHYS);
+  g_mutex_lock (&data->lock);
+
+  while (TRUE)
+    {
+      GList *hits = NULL, *removed = NULL, *subdirs = NULL, *l;
+      gint n_files = 0;
+      gchar *dir_path;
+
+      /* Other threads may still find more directories to search */
+      while (g_queue_is_empty (&data->directories) &&
+             data->n_busy > 0 &&
+             !data->cancelled)
+        g_cond_wait (&data->cond, &data->lock);
+
+      if (data->cancelled || g_queue_is_empty (&data->directories))
+        break;
+
+      dir_path = g_queue_pop_head (&data->directories);
+      data->n_busy++;
+
+      g_mutex_unlock (&data->lock);
+
+      search_directory (data, dir_path, &hits, &removed, &subdirs, &n_files);
+      g_free (dir_path);
+
+      g_mutex_lock (&data->lock);
+
+      data->n_busy--;
+
+      for (l = subdirs; l; l = l->next)
+        g_queue_push_tail (&data->directories, l->data);
+      g_list_free (subdirs);
+
+      data->uri_hits = g_list_concat (hits, data->uri_hits);
+      data->uri_removed = g_list_concat (removed, data->uri_removed);
+      data->n_processed_files += n_files;
+
+      if (data->n_processed_files > BATCH_SIZE)
+        send_batch (data);
+
+      g_cond_broadcast (&data->cond);
+    }
+
+  data->n_threads--;
+  last = data->n_threads == 0;
+  g_cond_broadcast (&data->cond);
+
+  g_mutex_unlock (&data->lock);
+
+  if (last)
+    {
+      if (data->owner)
+        search_finish_refresh (data);
+
+      g_mutex_lock (&data->lock);
+      send_batch (data);
+      g_mutex_unlock (&data->lock);
+
+      gdk_threads_add_idle (search_thread_done_idle, data);
+    }
 
-  send_batch (data);
-  
-  gdk_threads_add_idle (search_thread_done_idle, data);
-#endif /* HAVE_FTW_H */
-  
   return NULL;
 }
 
+/* Answers from the index first, then starts the crawl that brings
+ * it up to date, unless it was refreshed recently.
+ */
+static gpointer
+search_thread_main (gpointer user_data)
+{
+  SearchThreadData *data = user_data;
+  SearchIndex *index = data->index;
+  gboolean refresh;
+  guint i, n_threads;
+
+  g_mutex_lock (&index->lock);
+
+  if (data->persistent && !index->loaded)
+    search_index_load (index);
+  index->loaded = TRUE;
+
+  data->answered = index->refresh_time != 0;
+  refresh = !data->answered ||
+            g_get_real_time () - index->refresh_time > INDEX_REFRESH_INTERVAL_SEC * G_USEC_PER_SEC;
+
+  if (refresh && !index->refreshing)
+    {
+      index->refreshing = TRUE;
+      data->owner = TRUE;
+      data->generation = ++index->generation;
+    }
+
+  g_mutex_unlock (&index->lock);
+
+  g_mutex_lock (&data->lock);
+
+  search_root (data);
+
+  if (data->answered)
+    search_index (data);
+
+  if (!refresh || data->cancelled)
+    {
+      send_batch (data);
+      g_mutex_unlock (&data->lock);
+
+      if (data->owner)
+        search_finish_refresh (data);
+
+      gdk_threads_add_idle (search_thread_done_idle, data);
+
+      return NULL;
+    }
+
+  g_queue_push_tail (&data->directories, g_strdup (data->path));
+
+  n_threads = CLAMP (g_get_num_processors (), 2, MAX_SEARCH_THREADS);
+
+  /* Set before starting any thread, so none of them can finish early */
+  data->n_threads = n_threads;
+
+  g_mutex_unlock (&data->lock);
+
+  for (i = 1; i < n_threads; i++)
+    g_thread_unref (g_thread_new ("file-search", search_thread_func, data));
+
+  return search_thread_func (data);
+}
+
 static void
 gtk_search_engine_simple_start (GtkSearchEngine *engine)
 {
   GtkSearchEngineSimple *simple;
   SearchThreadData *data;
-  
+
   simple = GTK_SEARCH_ENGINE_SIMPLE (engine);
-  
+
   if (simple->priv->active_search != NULL)
     return;
-  
+
   if (simple->priv->query == NULL)
     return;
-	
+
   data = search_thread_data_new (simple, simple->priv->query);
-  
-  g_thread_unref (g_thread_new ("file-search", search_thread_func, data));
-  
+
+  g_thread_unref (g_thread_new ("file-search", search_thread_main, data));
+
   simple->priv->active_search = data;
 }
 
@@ -315,10 +1168,10 @@ static void
 gtk_search_engine_simple_stop (GtkSearchEngine *engine)
 {
   GtkSearchEngineSimple *simple;
-  
+
   simple = GTK_SEARCH_ENGINE_SIMPLE (engine);
-  
-  if (simple->priv->active_search != NULL) 
+
+  if (simple->priv->active_search != NULL)
     {
       simple->priv->active_search->cancelled = TRUE;
       simple->priv->active_search = NULL;
@@ -332,17 +1185,17 @@ gtk_search_engine_simple_is_indexed (GtkSearchEngine *engine)
 }
 
 static void
-gtk_search_engine_simple_set_query (GtkSearchEngine *engine, 
+gtk_search_engine_simple_set_query (GtkSearchEngine *engine,
 				    GtkQuery        *query)
 {
   GtkSearchEngineSimple *simple;
-  
+
   simple = GTK_SEARCH_ENGINE_SIMPLE (engine);
-  
+
   if (query)
     g_object_ref (query);
 
-  if (simple->priv->query) 
+  if (simple->priv->query)
     g_object_unref (simple->priv->query);
 
   simple->priv->query = query;
@@ -353,10 +1206,10 @@ _gtk_search_engine_simple_class_init (GtkSearchEngineSimpleClass *class)
 {
   GObjectClass *gobject_class;
   GtkSearchEngineClass *engine_class;
-  
+
   gobject_class = G_OBJECT_CLASS (class);
   gobject_class->dispose = gtk_search_engine_simple_dispose;
-  
+
   engine_class = GTK_SEARCH_ENGINE_CLASS (class);
   engine_class->set_query = gtk_search_engine_simple_set_query;
   engine_class->start = gtk_search_engine_simple_start;
@@ -373,9 +1226,5 @@ _gtk_search_engine_simple_init (GtkSearchEngineSimple *engine)
 GtkSearchEngine *
 _gtk_search_engine_simple_new (void)
 {
-#ifdef HAVE_FTW_H
   return g_object_new (GTK_TYPE_SEARCH_ENGINE_SIMPLE, NULL);
-#else
-  return NULL;
-#endif
 }
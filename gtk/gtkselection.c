@@ -115,6 +115,10 @@
 
 #define IDLE_ABORT_TIME 30
 
+/* Upper limit for preallocating the receive buffer of an INCR
+ * transfer from the size announced by the selection owner */
+#define INCR_PREALLOC_MAX (64 * 1024 * 1024)
+
 enum {
   INCR,
   MULTIPLE,
@@ -174,6 +178,7 @@ struct _GtkRetrievalInfo
   guchar   *buffer;		/* Buffer in which to accumulate results */
   gint	   offset;		/* Current offset in buffer, -1 indicates
 				   not yet started */
+  gint	   buffer_size;		/* Allocated size of buffer */
   guint32 notify_time;		/* Timestamp from SelectionNotify */
 };
 
@@ -1084,6 +1089,7 @@ gtk_selection_convert (GtkWidget *widget,
   info->idle_time = 0;
   info->buffer = NULL;
   info->offset = -1;
+  info->buffer_size = 0;
   
   /* Check if this process has current owner. If so, call handler
      procedure directly to avoid deadlocks with INCR. */
@@ -2773,6 +2779,21 @@ _gtk_selection_notify (GtkWidget	 *widget,
       info->notify_time = event->time;
       info->idle_time = 0;
       info->offset = 0;		/* Mark as OK to proceed */
+
+      /* The INCR property holds a lower bound for the size of the
+         data. Use it to avoid reallocating for every chunk. */
+      if (format == 32 && length >= (gint) sizeof (long))
+        {
+          long size = *(long *) buffer;
+
+          if (size > 0)
+            {
+              info->buffer_size = MIN (size, INCR_PREALLOC_MAX) + 1;
+              info->buffer = g_malloc (info->buffer_size);
+              info->buffer[0] = '\0';
+            }
+        }
+
       gdk_window_set_events (window,
                              gdk_window_get_events (window)
 			     | GDK_PROPERTY_CHANGE_MASK);
@@ -2858,10 +2879,9 @@ _gtk_selection_property_notify (GtkWidget	*widget,
 				       &type, &format);
   gdk_property_delete (window, event->atom);
 
-  /* We could do a lot better efficiency-wise by paying attention to
-     what length was sent in the initial INCR transaction, instead of
-     doing memory allocation at every step. But its only guaranteed to
-     be a _lower bound_ (pretty useless!) */
+  /* The buffer starts out with the lower bound sent in the initial
+     INCR transaction and grows geometrically from there, so large
+     transfers don't reallocate and copy everything for every chunk. */
   
   if (length == 0 || type == GDK_NONE)		/* final zero length portion */
     {
@@ -2884,6 +2904,7 @@ _gtk_selection_property_notify (GtkWidget	*widget,
 #endif
 	  info->buffer = new_buffer;
 	  info->offset = length;
+	  info->buffer_size = length + 1;
 	}
       else
 	{
@@ -2892,8 +2913,14 @@ _gtk_selection_property_notify (GtkWidget	*widget,
 	  g_message ("Appending %d bytes at offset %d",
 		     length,info->offset);
 #endif
+	  if (info->offset + length + 1 > info->buffer_size)
+	    {
+	      info->buffer_size = MAX (info->offset + length + 1,
+				       MIN (info->buffer_size, G_MAXINT / 2) * 2);
+	      info->buffer = g_realloc (info->buffer, info->buffer_size);
+	    }
+
 	  /* We copy length+1 bytes to preserve guaranteed null termination */
-	  info->buffer = g_realloc (info->buffer, info->offset+length+1);
 	  memcpy (info->buffer + info->offset, new_buffer, length+1);
 	  info->offset += length;
 	  g_free (new_buffer);
@@ -28,6 +28,7 @@
 #include "gtkmodulesprivate.h"
 #include "gtksettingsprivate.h"
 #include "gtkintl.h"
+#include "gtkpango.h"
 #include "gtkwidget.h"
 #include "gtkprivate.h"
 #include "gtkcssproviderprivate.h"
@@ -2818,6 +2819,7 @@ settings_update_fontconfig (GtkSettings *settings)
       if (PANGO_IS_FC_FONT_MAP (fontmap) && !FcConfigUptoDate (NULL))
         {
           pango_fc_font_map_cache_clear (PANGO_FC_FONT_MAP (fontmap));
+          _gtk_pango_layout_cache_clear ();
           if (FcInitReinitialize ())
             update_needed = TRUE;
         }
@@ -125,8 +125,17 @@ typedef struct Summary {
                                          * the subtree rooted at this node. */
   struct Summary *next;         /* Next in list of all tags for same
                                  * node, or NULL if at end of list. */
+  struct Summary *prev;         /* Previous in list of all tags for same
+                                 * node, or NULL if at start of list. */
 } Summary;
 
+/* Nodes with more summaries than this get a hash table to look up
+ * the summary for a tag, instead of walking the list. With many tags
+ * (e.g. syntax highlighting) the lists of the upper nodes get long,
+ * and every toggle change looks up a summary on each level.
+ */
+#define SUMMARY_INDEX_THRESHOLD 8
+
 /*
  * The data structure below defines a node in the B-tree.
  */
@@ -140,6 +149,10 @@ struct _GtkTextBTreeNode {
   Summary *summary;             /* First in malloc-ed list of info
                                  * about tags in this subtree (NULL if
                                  * no tag info in the subtree). */
+  GHashTable *summary_index;    /* Maps GtkTextTagInfo to Summary, only
+                                 * if there are more than
+                                 * SUMMARY_INDEX_THRESHOLD summaries. */
+  int num_summaries;            /* Length of the summary list. */
   int level;                            /* Level of this node in the B-tree.
                                          * 0 refers to the bottom of the tree
                                          * (children are lines, not nodes). */
@@ -183,6 +196,7 @@ struct _GtkTextBTree {
   GtkTextBuffer *buffer;
   BTreeView *views;
   GSList *tag_infos;
+  GHashTable *tag_info_table;   /* Maps GtkTextTag to GtkTextTagInfo */
   gulong tag_changed_handler;
 
   /* Incremented when a segment with a byte size > 0
@@ -260,7 +274,7 @@ static void              gtk_text_btree_node_adjust_toggle_count (GtkTextBTreeNo
                                                                   GtkTextTagInfo   *info,
                                                                   gint              adjust);
 static gboolean          gtk_text_btree_node_has_tag             (GtkTextBTreeNode *node,
-                                                                  GtkTextTag       *tag);
+                                                                  GtkTextTagInfo   *info);
 
 static void             segments_changed                (GtkTextBTree     *tree);
 static void             chars_changed                   (GtkTextBTree     *tree);
@@ -324,7 +338,14 @@ static void inc_count             (GtkTextTag       *tag,
                                    int               inc,
                                    TagInfo          *tagInfoPtr);
 
-static void summary_destroy       (Summary          *summary);
+static void     summary_destroy    (Summary          *summary);
+static Summary *summary_find       (GtkTextBTreeNode *node,
+                                    GtkTextTagInfo   *info);
+static Summary *summary_add        (GtkTextBTreeNode *node,
+                                    GtkTextTagInfo   *info,
+                                    gint              toggle_count);
+static void     summary_remove     (GtkTextBTreeNode *node,
+                                    Summary          *summary);
 
 static void gtk_text_btree_link_segment   (GtkTextLineSegment *seg,
                                            const GtkTextIter  *iter);
@@ -390,7 +411,6 @@ _gtk_text_btree_new (GtkTextTagTable *table,
 
   root_node->parent = NULL;
   root_node->next = NULL;
-  root_node->summary = NULL;
   root_node->level = 0;
   root_node->children.line = line;
   root_node->num_children = 2;
@@ -438,6 +458,7 @@ _gtk_text_btree_new (GtkTextTagTable *table,
 
   tree->mark_table = g_hash_table_new (g_str_hash, g_str_equal);
   tree->child_anchor_table = NULL;
+  tree->tag_info_table = g_hash_table_new (NULL, NULL);
   
   /* We don't ref the buffer, since the buffer owns us;
    * we'd have some circularity issues. The buffer always
@@ -526,6 +547,9 @@ _gtk_text_btree_unref (GtkTextBTree *tree)
       g_object_unref (tree->selection_bound_mark);
       tree->selection_bound_mark = NULL;
 
+      g_hash_table_destroy (tree->tag_info_table);
+      tree->tag_info_table = NULL;
+
       g_free (tree);
     }
 }
@@ -1695,20 +1719,6 @@ iter_stack_push (IterStack         *stack,
   stack->iters[stack->count-1] = *iter;
 }
 
-static gboolean
-iter_stack_pop (IterStack   *stack, 
-		GtkTextIter *iter)
-{
-  if (stack->count == 0)
-    return FALSE;
-  else
-    {
-      stack->count -= 1;
-      *iter = stack->iters[stack->count];
-      return TRUE;
-    }
-}
-
 static void
 iter_stack_free (IterStack *stack)
 {
@@ -1716,27 +1726,6 @@ iter_stack_free (IterStack *stack)
   g_slice_free (IterStack, stack);
 }
 
-static void
-iter_stack_invert (IterStack *stack)
-{
-  if (stack->count > 0)
-    {
-      guint i = 0;
-      guint j = stack->count - 1;
-      while (i < j)
-        {
-          GtkTextIter tmp;
-
-          tmp = stack->iters[i];
-          stack->iters[i] = stack->iters[j];
-          stack->iters[j] = tmp;
-
-          ++i;
-          --j;
-        }
-    }
-}
-
 static void
 queue_tag_redisplay (GtkTextBTree      *tree,
                      GtkTextTag        *tag,
@@ -1757,61 +1746,19 @@ queue_tag_redisplay (GtkTextBTree      *tree,
   /* We don't need to do anything if the tag doesn't affect display */
 }
 
-void
-_gtk_text_btree_tag (const GtkTextIter *start_orig,
-                     const GtkTextIter *end_orig,
-                     GtkTextTag        *tag,
-                     gboolean           add)
+/* Pushes the toggles of @tag after @start and before @end onto
+ * @stack, in order. Returns the number of toggles found.
+ */
+static guint
+iter_stack_push_toggles (IterStack         *stack,
+                         const GtkTextIter *start,
+                         const GtkTextIter *end,
+                         GtkTextTag        *tag)
 {
-  GtkTextLineSegment *seg, *prev;
-  GtkTextLine *cleanupline;
-  gboolean toggled_on;
-  GtkTextLine *start_line;
-  GtkTextLine *end_line;
   GtkTextIter iter;
-  GtkTextIter start, end;
-  GtkTextBTree *tree;
-  IterStack *stack;
-  GtkTextTagInfo *info;
+  guint count = stack->count;
 
-  g_return_if_fail (start_orig != NULL);
-  g_return_if_fail (end_orig != NULL);
-  g_return_if_fail (GTK_IS_TEXT_TAG (tag));
-  g_return_if_fail (_gtk_text_iter_get_btree (start_orig) ==
-                    _gtk_text_iter_get_btree (end_orig));
-  g_return_if_fail (tag->priv->table == _gtk_text_iter_get_btree (start_orig)->table);
-  
-#if 0
-  printf ("%s tag %s from %d to %d\n",
-          add ? "Adding" : "Removing",
-          tag->name,
-          gtk_text_buffer_get_offset (start_orig),
-          gtk_text_buffer_get_offset (end_orig));
-#endif
-
-  if (gtk_text_iter_equal (start_orig, end_orig))
-    return;
-
-  start = *start_orig;
-  end = *end_orig;
-
-  gtk_text_iter_order (&start, &end);
-
-  tree = _gtk_text_iter_get_btree (&start);
-
-  queue_tag_redisplay (tree, tag, &start, &end);
-
-  info = gtk_text_btree_get_tag_info (tree, tag);
-
-  start_line = _gtk_text_iter_get_text_line (&start);
-  end_line = _gtk_text_iter_get_text_line (&end);
-
-  /* Find all tag toggles in the region; we are going to delete them.
-     We need to find them in advance, because
-     forward_find_tag_toggle () won't work once we start playing around
-     with the tree. */
-  stack = iter_stack_new ();
-  iter = start;
+  iter = *start;
 
   /* forward_to_tag_toggle() skips a toggle at the start iterator,
    * which is deliberate - we don't want to delete a toggle at the
@@ -1819,14 +1766,41 @@ _gtk_text_btree_tag (const GtkTextIter *start_orig,
    */
   while (gtk_text_iter_forward_to_tag_toggle (&iter, tag))
     {
-      if (gtk_text_iter_compare (&iter, &end) >= 0)
+      if (gtk_text_iter_compare (&iter, end) >= 0)
         break;
       else
         iter_stack_push (stack, &iter);
     }
 
-  /* We need to traverse the toggles in order. */
-  iter_stack_invert (stack);
+  return stack->count - count;
+}
+
+/* Adds or removes the tag of @info between @start and @end, which
+ * must be in order. @toggles are the toggles of the tag after
+ * @start and before @end, in order, as found by
+ * iter_stack_push_toggles() before the tree was changed.
+ * Does not queue a redisplay.
+ */
+static void
+gtk_text_btree_tag_range (GtkTextBTree      *tree,
+                          GtkTextTagInfo    *info,
+                          const GtkTextIter *start,
+                          const GtkTextIter *end,
+                          const GtkTextIter *toggles,
+                          guint              n_toggles,
+                          gboolean           add)
+{
+  GtkTextLineSegment *seg, *prev;
+  GtkTextLine *cleanupline;
+  gboolean toggled_on;
+  GtkTextLine *start_line;
+  GtkTextLine *end_line;
+  GtkTextIter iter;
+  GtkTextTag *tag = info->tag;
+  guint i;
+
+  start_line = _gtk_text_iter_get_text_line (start);
+  end_line = _gtk_text_iter_get_text_line (end);
 
   /*
    * See whether the tag is present at the start of the range.  If
@@ -1834,7 +1808,7 @@ _gtk_text_btree_tag (const GtkTextIter *start_orig,
    * there.
    */
 
-  toggled_on = gtk_text_iter_has_tag (&start, tag);
+  toggled_on = gtk_text_iter_has_tag (start, tag);
   if ( (add && !toggled_on) ||
        (!add && toggled_on) )
     {
@@ -1842,7 +1816,7 @@ _gtk_text_btree_tag (const GtkTextIter *start_orig,
          cleanup_line () will remove it if so. */
       seg = _gtk_toggle_segment_new (info, add);
 
-      prev = gtk_text_line_segment_split (&start);
+      prev = gtk_text_line_segment_split (start);
       if (prev == NULL)
         {
           seg->next = start_line->segments;
@@ -1873,11 +1847,12 @@ _gtk_text_btree_tag (const GtkTextIter *start_orig,
    */
 
   cleanupline = start_line;
-  while (iter_stack_pop (stack, &iter))
+  for (i = 0; i < n_toggles; i++)
     {
       GtkTextLineSegment *indexable_seg;
       GtkTextLine *line;
 
+      iter = toggles[i];
       line = _gtk_text_iter_get_text_line (&iter);
       seg = _gtk_text_iter_get_any_segment (&iter);
       indexable_seg = _gtk_text_iter_get_indexable_segment (&iter);
@@ -1964,8 +1939,6 @@ _gtk_text_btree_tag (const GtkTextIter *start_orig,
         }
     }
 
-  iter_stack_free (stack);
-
   /* toggled_on now reflects the toggle state _just before_ the
      end iterator. The end iterator could already have a toggle
      on or a toggle off. */
@@ -1977,7 +1950,7 @@ _gtk_text_btree_tag (const GtkTextIter *start_orig,
 
       seg = _gtk_toggle_segment_new (info, !add);
 
-      prev = gtk_text_line_segment_split (&end);
+      prev = gtk_text_line_segment_split (end);
       if (prev == NULL)
         {
           seg->next = end_line->segments;
@@ -2007,6 +1980,59 @@ _gtk_text_btree_tag (const GtkTextIter *start_orig,
     }
 
   segments_changed (tree);
+}
+
+void
+_gtk_text_btree_tag (const GtkTextIter *start_orig,
+                     const GtkTextIter *end_orig,
+                     GtkTextTag        *tag,
+                     gboolean           add)
+{
+  GtkTextIter start, end;
+  GtkTextBTree *tree;
+  GtkTextTagInfo *info;
+  IterStack *stack;
+
+  g_return_if_fail (start_orig != NULL);
+  g_return_if_fail (end_orig != NULL);
+  g_return_if_fail (GTK_IS_TEXT_TAG (tag));
+  g_return_if_fail (_gtk_text_iter_get_btree (start_orig) ==
+                    _gtk_text_iter_get_btree (end_orig));
+  g_return_if_fail (tag->priv->table == _gtk_text_iter_get_btree (start_orig)->table);
+  
+#if 0
+  printf ("%s tag %s from %d to %d\n",
+          add ? "Adding" : "Removing",
+          tag->name,
+          gtk_text_buffer_get_offset (start_orig),
+          gtk_text_buffer_get_offset (end_orig));
+#endif
+
+  if (gtk_text_iter_equal (start_orig, end_orig))
+    return;
+
+  start = *start_orig;
+  end = *end_orig;
+
+  gtk_text_iter_order (&start, &end);
+
+  tree = _gtk_text_iter_get_btree (&start);
+
+  queue_tag_redisplay (tree, tag, &start, &end);
+
+  info = gtk_text_btree_get_tag_info (tree, tag);
+
+  /* Find all tag toggles in the region; we are going to delete them.
+     We need to find them in advance, because
+     forward_find_tag_toggle () won't work once we start playing around
+     with the tree. */
+  stack = iter_stack_new ();
+  iter_stack_push_toggles (stack, &start, &end, tag);
+
+  gtk_text_btree_tag_range (tree, info, &start, &end,
+                            stack->iters, stack->count, add);
+
+  iter_stack_free (stack);
 
   queue_tag_redisplay (tree, tag, &start, &end);
 
@@ -2014,6 +2040,93 @@ _gtk_text_btree_tag (const GtkTextIter *start_orig,
     _gtk_text_btree_check (tree);
 }
 
+/*
+ * _gtk_text_btree_tag_ranges:
+ * @tree: a #GtkTextBTree
+ * @tag: the tag to add or remove
+ * @offsets: pairs of start and end character offsets, sorted and
+ *   not overlapping
+ * @n_ranges: number of ranges in @offsets
+ * @add: whether to add or remove @tag
+ *
+ * Like _gtk_text_btree_tag() for many ranges. The toggles of @tag
+ * in all of them are found in a single scan from the first start to
+ * the last end, which skips the subtrees without toggles of @tag,
+ * instead of one scan per range. Each range is redisplayed once
+ * instead of twice, and the tree is checked once at the end.
+ */
+void
+_gtk_text_btree_tag_ranges (GtkTextBTree *tree,
+                            GtkTextTag   *tag,
+                            const gint   *offsets,
+                            gint          n_ranges,
+                            gboolean      add)
+{
+  GtkTextTagInfo *info;
+  GtkTextIter start, end;
+  IterStack *stack;
+  gint *toggle_offsets;
+  guint first, last, j;
+  gint i;
+
+  g_return_if_fail (GTK_IS_TEXT_TAG (tag));
+  g_return_if_fail (tag->priv->table == tree->table);
+
+  if (n_ranges == 0)
+    return;
+
+  info = gtk_text_btree_get_tag_info (tree, tag);
+
+  /* Tagging doesn't add or remove any characters, so the offsets of
+   * the toggles we find now stay valid while we change the tree, and
+   * the iterators can be revalidated from their position.
+   */
+  _gtk_text_btree_get_iter_at_char (tree, &start, offsets[0]);
+  _gtk_text_btree_get_iter_at_char (tree, &end, offsets[2 * n_ranges - 1]);
+
+  stack = iter_stack_new ();
+  iter_stack_push_toggles (stack, &start, &end, tag);
+
+  toggle_offsets = g_new (gint, stack->count + 1);
+  for (j = 0; j < stack->count; j++)
+    toggle_offsets[j] = gtk_text_iter_get_offset (&stack->iters[j]);
+
+  first = 0;
+  for (i = 0; i < n_ranges; i++)
+    {
+      if (offsets[2 * i] >= offsets[2 * i + 1])
+        continue;
+
+      _gtk_text_btree_get_iter_at_char (tree, &start, offsets[2 * i]);
+      _gtk_text_btree_get_iter_at_char (tree, &end, offsets[2 * i + 1]);
+
+      /* Skip the toggles between the ranges and at the start of
+       * this one, which stay
+       */
+      while (first < stack->count && toggle_offsets[first] <= offsets[2 * i])
+        first++;
+
+      last = first;
+      while (last < stack->count && toggle_offsets[last] < offsets[2 * i + 1])
+        last++;
+
+      gtk_text_btree_tag_range (tree, info, &start, &end,
+                                stack->iters + first, last - first, add);
+
+      /* Tagging doesn't move any text, so redisplaying
+       * afterwards covers the old appearance as well
+       */
+      queue_tag_redisplay (tree, tag, &start, &end);
+
+      first = last;
+    }
+
+  g_free (toggle_offsets);
+  iter_stack_free (stack);
+
+  if (gtk_get_debug_flags () & GTK_DEBUG_TEXT)
+    _gtk_text_btree_check (tree);
+}
 
 /*
  * "Getters"
@@ -3067,7 +3180,7 @@ _gtk_text_btree_first_could_contain_tag (GtkTextBTree *tree,
           node = node->children.node;
           while (node != NULL)
             {
-              if (gtk_text_btree_node_has_tag (node, tag))
+              if (gtk_text_btree_node_has_tag (node, info))
                 goto continue_outer_loop;
 
               node = node->next;
@@ -3121,7 +3234,7 @@ _gtk_text_btree_last_could_contain_tag (GtkTextBTree *tree,
           node = node->children.node;
           while (node != NULL)
             {
-              if (gtk_text_btree_node_has_tag (node, tag))
+              if (gtk_text_btree_node_has_tag (node, info))
                 last_node = node;
               node = node->next;
             }
@@ -3314,14 +3427,9 @@ find_toggle_outside_current_line (GtkTextLine *line,
         {
           Summary *summary;
 
-          summary = sibling_node->summary;
-          while (summary != NULL)
-            {
-              if (summary->info == info)
-                toggles += summary->toggle_count;
-
-              summary = summary->next;
-            }
+          summary = summary_find (sibling_node, info);
+          if (summary != NULL)
+            toggles += summary->toggle_count;
 
           sibling_node = sibling_node->next;
         }
@@ -4393,7 +4501,7 @@ _gtk_text_line_next_could_contain_tag (GtkTextLine  *line,
             {
               node = node->next;
 
-              if (gtk_text_btree_node_has_tag (node, tag))
+              if (gtk_text_btree_node_has_tag (node, info))
                 goto found;
             }
         }
@@ -4439,7 +4547,7 @@ _gtk_text_line_next_could_contain_tag (GtkTextLine  *line,
       node = node->children.node;
       while (node != NULL)
         {
-          if (gtk_text_btree_node_has_tag (node, tag))
+          if (gtk_text_btree_node_has_tag (node, info))
             break;
           node = node->next;
         }
@@ -4574,7 +4682,7 @@ _gtk_text_line_previous_could_contain_tag (GtkTextLine  *line,
 
               g_assert (this_node != line_ancestor);
 
-              if (gtk_text_btree_node_has_tag (this_node, tag))
+              if (gtk_text_btree_node_has_tag (this_node, info))
                 {
                   found_node = this_node;
                   g_slist_free (child_nodes);
@@ -4649,7 +4757,7 @@ _gtk_text_line_previous_could_contain_tag (GtkTextLine  *line,
       iter = child_nodes;
       while (iter != NULL)
         {
-          if (gtk_text_btree_node_has_tag (iter->data, tag))
+          if (gtk_text_btree_node_has_tag (iter->data, info))
             {
               /* recurse into this node. */
               node = iter->data;
@@ -4854,9 +4962,85 @@ summary_destroy (Summary *summary)
   summary->info = (void*)0x1;
   summary->toggle_count = 567;
   summary->next = (void*)0x1;
+  summary->prev = (void*)0x1;
   g_slice_free (Summary, summary);
 }
 
+static Summary *
+summary_find (GtkTextBTreeNode *node,
+              GtkTextTagInfo   *info)
+{
+  Summary *summary;
+
+  if (node->summary_index)
+    return g_hash_table_lookup (node->summary_index, info);
+
+  for (summary = node->summary; summary != NULL; summary = summary->next)
+    {
+      if (summary->info == info)
+        return summary;
+    }
+
+  return NULL;
+}
+
+static Summary *
+summary_add (GtkTextBTreeNode *node,
+             GtkTextTagInfo   *info,
+             gint              toggle_count)
+{
+  Summary *summary;
+
+  summary = g_slice_new (Summary);
+  summary->info = info;
+  summary->toggle_count = toggle_count;
+  summary->prev = NULL;
+  summary->next = node->summary;
+  if (node->summary)
+    node->summary->prev = summary;
+  node->summary = summary;
+  node->num_summaries += 1;
+
+  if (node->summary_index)
+    g_hash_table_insert (node->summary_index, info, summary);
+  else if (node->num_summaries > SUMMARY_INDEX_THRESHOLD)
+    {
+      Summary *s;
+
+      node->summary_index = g_hash_table_new (NULL, NULL);
+      for (s = node->summary; s != NULL; s = s->next)
+        g_hash_table_insert (node->summary_index, s->info, s);
+    }
+
+  return summary;
+}
+
+static void
+summary_remove (GtkTextBTreeNode *node,
+                Summary          *summary)
+{
+  if (summary->prev)
+    summary->prev->next = summary->next;
+  else
+    node->summary = summary->next;
+  if (summary->next)
+    summary->next->prev = summary->prev;
+  node->num_summaries -= 1;
+
+  if (node->summary_index)
+    {
+      if (node->num_summaries == 0)
+        {
+          g_hash_table_destroy (node->summary_index);
+          node->summary_index = NULL;
+        }
+      else
+        g_hash_table_remove (node->summary_index, summary->info);
+    }
+
+  summary_destroy (summary);
+}
+
 static GtkTextBTreeNode*
 gtk_text_btree_node_new (void)
 {
@@ -4864,6 +5048,9 @@ gtk_text_btree_node_new (void)
 
   node = g_slice_new (GtkTextBTreeNode);
 
+  node->summary = NULL;
+  node->summary_index = NULL;
+  node->num_summaries = 0;
   node->node_data = NULL;
 
   return node;
@@ -4876,27 +5063,15 @@ gtk_text_btree_node_adjust_toggle_count (GtkTextBTreeNode  *node,
 {
   Summary *summary;
 
-  summary = node->summary;
-  while (summary != NULL)
-    {
-      if (summary->info == info)
-        {
-          summary->toggle_count += adjust;
-          break;
-        }
+  summary = summary_find (node, info);
 
-      summary = summary->next;
-    }
-
-  if (summary == NULL)
+  if (summary != NULL)
+    summary->toggle_count += adjust;
+  else
     {
       /* didn't find a summary for our tag. */
       g_return_if_fail (adjust > 0);
-      summary = g_slice_new (Summary);
-      summary->info = info;
-      summary->toggle_count = adjust;
-      summary->next = node->summary;
-      node->summary = summary;
+      summary_add (node, info, adjust);
     }
 }
 
@@ -4904,21 +5079,12 @@ gtk_text_btree_node_adjust_toggle_count (GtkTextBTreeNode  *node,
    for the tag; only nodes below the tag root have
    the summaries. */
 static gboolean
-gtk_text_btree_node_has_tag (GtkTextBTreeNode *node, GtkTextTag *tag)
+gtk_text_btree_node_has_tag (GtkTextBTreeNode *node, GtkTextTagInfo *info)
 {
-  Summary *summary;
-
-  summary = node->summary;
-  while (summary != NULL)
-    {
-      if (tag == NULL ||
-          summary->info->tag == tag)
-        return TRUE;
-
-      summary = summary->next;
-    }
+  if (info == NULL)
+    return node->summary != NULL;
 
-  return FALSE;
+  return summary_find (node, info) != NULL;
 }
 
 /* Add node and all children to the damage region. */
@@ -5512,6 +5678,8 @@ gtk_text_btree_node_free_empty (GtkTextBTree *tree,
                     (node->level == 0 && node->children.line == NULL));
 
   summary_list_destroy (node->summary);
+  if (node->summary_index)
+    g_hash_table_destroy (node->summary_index);
   node_data_list_destroy (node->node_data);
   g_slice_free (GtkTextBTreeNode, node);
 }
@@ -5980,21 +6148,7 @@ static GtkTextTagInfo*
 gtk_text_btree_get_existing_tag_info (GtkTextBTree *tree,
                                       GtkTextTag   *tag)
 {
-  GtkTextTagInfo *info;
-  GSList *list;
-
-
-  list = tree->tag_infos;
-  while (list != NULL)
-    {
-      info = list->data;
-      if (info->tag == tag)
-        return info;
-
-      list = g_slist_next (list);
-    }
-
-  return NULL;
+  return g_hash_table_lookup (tree->tag_info_table, tag);
 }
 
 static GtkTextTagInfo*
@@ -6017,6 +6171,7 @@ gtk_text_btree_get_tag_info (GtkTextBTree *tree,
       info->toggle_count = 0;
 
       tree->tag_infos = g_slist_prepend (tree->tag_infos, info);
+      g_hash_table_insert (tree->tag_info_table, tag, info);
 
 #if 0
       g_print ("Created tag info %p for tag %s(%p)\n",
@@ -6060,6 +6215,7 @@ gtk_text_btree_remove_tag_info (GtkTextBTree *tree,
           list->next = NULL;
           g_slist_free (list);
 
+          g_hash_table_remove (tree->tag_info_table, tag);
           g_object_unref (info->tag);
 
           g_slice_free (GtkTextTagInfo, info);
@@ -6177,7 +6333,7 @@ static void
 recompute_node_counts (GtkTextBTree *tree, GtkTextBTreeNode *node)
 {
   BTreeView *view;
-  Summary *summary, *summary2;
+  Summary *summary, *next;
 
   /*
    * Zero out all the existing counts for the GtkTextBTreeNode, but don't delete
@@ -6220,9 +6376,10 @@ recompute_node_counts (GtkTextBTree *tree, GtkTextBTreeNode *node)
    * have no summary information, and they become the tag_root for the tag.
    */
 
-  summary2 = NULL;
-  for (summary = node->summary; summary != NULL; )
+  for (summary = node->summary; summary != NULL; summary = next)
     {
+      next = summary->next;
+
       if (summary->toggle_count > 0 &&
           summary->toggle_count < summary->info->toggle_count)
         {
@@ -6234,8 +6391,6 @@ recompute_node_counts (GtkTextBTree *tree, GtkTextBTreeNode *node)
                */
               summary->info->tag_root = node->parent;
             }
-          summary2 = summary;
-          summary = summary->next;
           continue;
         }
       if (summary->toggle_count == summary->info->toggle_count)
@@ -6246,18 +6401,7 @@ recompute_node_counts (GtkTextBTree *tree, GtkTextBTreeNode *node)
            */
           summary->info->tag_root = node;
         }
-      if (summary2 != NULL)
-        {
-          summary2->next = summary->next;
-          summary_destroy (summary);
-          summary = summary2->next;
-        }
-      else
-        {
-          node->summary = summary->next;
-          summary_destroy (summary);
-          summary = node->summary;
-        }
+      summary_remove (node, summary);
     }
 }
 
@@ -6266,7 +6410,7 @@ _gtk_change_node_toggle_count (GtkTextBTreeNode *node,
                                GtkTextTagInfo   *info,
                                gint              delta) /* may be negative */
 {
-  Summary *summary, *prevPtr;
+  Summary *summary;
   GtkTextBTreeNode *node2Ptr;
   int rootLevel;                        /* Level of original tag root */
 
@@ -6298,15 +6442,7 @@ _gtk_change_node_toggle_count (GtkTextBTreeNode *node,
        * perhaps all we have to do is adjust its count.
        */
 
-      for (prevPtr = NULL, summary = node->summary;
-           summary != NULL;
-           prevPtr = summary, summary = summary->next)
-        {
-          if (summary->info == info)
-            {
-              break;
-            }
-        }
+      summary = summary_find (node, info);
       if (summary != NULL)
         {
           summary->toggle_count += delta;
@@ -6331,15 +6467,7 @@ _gtk_change_node_toggle_count (GtkTextBTreeNode *node,
            * Zero toggle count;  must remove this tag from the list.
            */
 
-          if (prevPtr == NULL)
-            {
-              node->summary = summary->next;
-            }
-          else
-            {
-              prevPtr->next = summary->next;
-            }
-          summary_destroy (summary);
+          summary_remove (node, summary);
         }
       else
         {
@@ -6362,20 +6490,12 @@ _gtk_change_node_toggle_count (GtkTextBTreeNode *node,
                */
 
               GtkTextBTreeNode *rootnode = info->tag_root;
-              summary = g_slice_new (Summary);
-              summary->info = info;
-              summary->toggle_count = info->toggle_count - delta;
-              summary->next = rootnode->summary;
-              rootnode->summary = summary;
+              summary_add (rootnode, info, info->toggle_count - delta);
               rootnode = rootnode->parent;
               rootLevel = rootnode->level;
               info->tag_root = rootnode;
             }
-          summary = g_slice_new (Summary);
-          summary->info = info;
-          summary->toggle_count = delta;
-          summary->next = node->summary;
-          node->summary = summary;
+          summary_add (node, info, delta);
         }
     }
 
@@ -6405,15 +6525,7 @@ _gtk_change_node_toggle_count (GtkTextBTreeNode *node,
            node2Ptr != (GtkTextBTreeNode *)NULL ;
            node2Ptr = node2Ptr->next)
         {
-          for (prevPtr = NULL, summary = node2Ptr->summary;
-               summary != NULL;
-               prevPtr = summary, summary = summary->next)
-            {
-              if (summary->info == info)
-                {
-                  break;
-                }
-            }
+          summary = summary_find (node2Ptr, info);
           if (summary == NULL)
             {
               continue;
@@ -6431,15 +6543,7 @@ _gtk_change_node_toggle_count (GtkTextBTreeNode *node,
            * This GtkTextBTreeNode has all the toggles, so push down the root.
            */
 
-          if (prevPtr == NULL)
-            {
-              node2Ptr->summary = summary->next;
-            }
-          else
-            {
-              prevPtr->next = summary->next;
-            }
-          summary_destroy (summary);
+          summary_remove (node2Ptr, summary);
           info->tag_root = node2Ptr;
           break;
         }
@@ -6692,6 +6796,7 @@ gtk_text_btree_node_check_consistency (GtkTextBTree     *tree,
   GtkTextLine *line;
   GtkTextLineSegment *segPtr;
   int num_children, num_lines, num_chars, toggle_count, min_children;
+  int num_summaries;
   GtkTextLineData *ld;
   NodeData *nd;
 
@@ -6893,6 +6998,42 @@ gtk_text_btree_node_check_consistency (GtkTextBTree     *tree,
             }
         }
     }
+
+  /* Summaries are looked up through the index, so it has to agree
+   * with the list.
+   */
+  num_summaries = 0;
+  summary2 = NULL;
+  for (summary = node->summary; summary != NULL;
+       summary = summary->next)
+    {
+      if (summary->prev != summary2)
+        g_error ("gtk_text_btree_node_check_consistency: bad prev link in summary list");
+
+      if (node->summary_index &&
+          g_hash_table_lookup (node->summary_index, summary->info) != summary)
+        g_error ("gtk_text_btree_node_check_consistency: summary for \"%s\" not in the index",
+                 summary->info->tag->priv->name);
+
+      num_summaries++;
+      summary2 = summary;
+    }
+  if (num_summaries != node->num_summaries)
+    {
+      g_error ("gtk_text_btree_node_check_consistency: mismatch in num_summaries (%d %d)",
+               num_summaries, node->num_summaries);
+    }
+  if (node->summary_index)
+    {
+      if (g_hash_table_size (node->summary_index) != (guint) num_summaries)
+        g_error ("gtk_text_btree_node_check_consistency: mismatch in summary index size (%u %d)",
+                 g_hash_table_size (node->summary_index), num_summaries);
+    }
+  else if (num_summaries > SUMMARY_INDEX_THRESHOLD)
+    {
+      g_error ("gtk_text_btree_node_check_consistency: %d summaries without an index",
+               num_summaries);
+    }
 }
 
 static void
@@ -114,6 +114,11 @@ void _gtk_text_btree_tag (const GtkTextIter *start,
                           const GtkTextIter *end,
                           GtkTextTag        *tag,
                           gboolean           apply);
+void _gtk_text_btree_tag_ranges (GtkTextBTree *tree,
+                                 GtkTextTag   *tag,
+                                 const gint   *offsets,
+                                 gint          n_ranges,
+                                 gboolean      apply);
 
 /* "Getters" */
 
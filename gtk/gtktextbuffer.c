@@ -2624,6 +2624,158 @@ gtk_text_buffer_apply_tag (GtkTextBuffer     *buffer,
   gtk_text_buffer_emit_tag (buffer, tag, TRUE, start, end);
 }
 
+static gint
+range_compare (gconstpointer a,
+               gconstpointer b,
+               gpointer      user_data)
+{
+  const gint *range_a = a;
+  const gint *range_b = b;
+
+  if (range_a[0] != range_b[0])
+    return range_a[0] < range_b[0] ? -1 : 1;
+
+  return range_a[1] < range_b[1] ? -1 : (range_a[1] > range_b[1] ? 1 : 0);
+}
+
+static void
+gtk_text_buffer_tag_ranges (GtkTextBuffer *buffer,
+                            GtkTextTag    *tag,
+                            const gint    *offsets,
+                            gint           n_offsets,
+                            gboolean       apply)
+{
+  gint *ranges;
+  gint n_ranges, n_merged, n_chars, i;
+  gboolean default_handler;
+
+  n_ranges = n_offsets / 2;
+  if (n_ranges == 0)
+    return;
+
+  n_chars = gtk_text_buffer_get_char_count (buffer);
+
+  ranges = g_new (gint, n_offsets);
+  for (i = 0; i < n_ranges; i++)
+    {
+      gint start = CLAMP (offsets[2 * i], 0, n_chars);
+      gint end = CLAMP (offsets[2 * i + 1], 0, n_chars);
+
+      ranges[2 * i] = MIN (start, end);
+      ranges[2 * i + 1] = MAX (start, end);
+    }
+
+  g_qsort_with_data (ranges, n_ranges, 2 * sizeof (gint), range_compare, NULL);
+
+  n_merged = 0;
+  for (i = 0; i < n_ranges; i++)
+    {
+      if (n_merged > 0 && ranges[2 * i] <= ranges[2 * n_merged - 1])
+        ranges[2 * n_merged - 1] = MAX (ranges[2 * n_merged - 1], ranges[2 * i + 1]);
+      else
+        {
+          ranges[2 * n_merged] = ranges[2 * i];
+          ranges[2 * n_merged + 1] = ranges[2 * i + 1];
+          n_merged++;
+        }
+    }
+
+  /* Only skip the signal emission if nobody could tell the difference */
+  if (apply)
+    default_handler = GTK_TEXT_BUFFER_GET_CLASS (buffer)->apply_tag == gtk_text_buffer_real_apply_tag &&
+                      !g_signal_has_handler_pending (buffer, signals[APPLY_TAG], 0, FALSE);
+  else
+    default_handler = GTK_TEXT_BUFFER_GET_CLASS (buffer)->remove_tag == gtk_text_buffer_real_remove_tag &&
+                      !g_signal_has_handler_pending (buffer, signals[REMOVE_TAG], 0, FALSE);
+
+  if (default_handler)
+    {
+      _gtk_text_btree_tag_ranges (get_btree (buffer), tag, ranges, n_merged, apply);
+    }
+  else
+    {
+      for (i = 0; i < n_merged; i++)
+        {
+          GtkTextIter start, end;
+
+          if (ranges[2 * i] == ranges[2 * i + 1])
+            continue;
+
+          gtk_text_buffer_get_iter_at_offset (buffer, &start, ranges[2 * i]);
+          gtk_text_buffer_get_iter_at_offset (buffer, &end, ranges[2 * i + 1]);
+
+          gtk_text_buffer_emit_tag (buffer, tag, apply, &start, &end);
+        }
+    }
+
+  g_free (ranges);
+}
+
+/**
+ * gtk_text_buffer_apply_tag_to_ranges:
+ * @buffer: a #GtkTextBuffer
+ * @tag: a #GtkTextTag
+ * @offsets: (array length=n_offsets): pairs of character offsets
+ *   delimiting the ranges to be tagged
+ * @n_offsets: number of elements in @offsets, twice the number of ranges
+ *
+ * Applies @tag to many ranges of @buffer at once, e.g. when
+ * highlighting the syntax of a large file. Unless the
+ * #GtkTextBuffer::apply-tag signal has handlers connected, the
+ * existing toggles of @tag are found in one pass over all the ranges
+ * instead of one pass per range.
+ *
+ * The ranges can be given in any order and may overlap; the bounds of
+ * each range do not have to be in order either. Overlapping and adjacent
+ * ranges are merged, and the #GtkTextBuffer::apply-tag signal is emitted
+ * for each of the merged ranges if it has handlers connected.
+ *
+ * Since: 3.10
+ **/
+void
+gtk_text_buffer_apply_tag_to_ranges (GtkTextBuffer *buffer,
+                                     GtkTextTag    *tag,
+                                     const gint    *offsets,
+                                     gint           n_offsets)
+{
+  g_return_if_fail (GTK_IS_TEXT_BUFFER (buffer));
+  g_return_if_fail (GTK_IS_TEXT_TAG (tag));
+  g_return_if_fail (offsets != NULL || n_offsets == 0);
+  g_return_if_fail (n_offsets % 2 == 0);
+  g_return_if_fail (tag->priv->table == buffer->priv->tag_table);
+
+  gtk_text_buffer_tag_ranges (buffer, tag, offsets, n_offsets, TRUE);
+}
+
+/**
+ * gtk_text_buffer_remove_tag_from_ranges:
+ * @buffer: a #GtkTextBuffer
+ * @tag: a #GtkTextTag
+ * @offsets: (array length=n_offsets): pairs of character offsets
+ *   delimiting the ranges to be untagged
+ * @n_offsets: number of elements in @offsets, twice the number of ranges
+ *
+ * Removes @tag from many ranges of @buffer at once. This is the
+ * counterpart of gtk_text_buffer_apply_tag_to_ranges(), and treats
+ * the ranges and the #GtkTextBuffer::remove-tag signal the same way.
+ *
+ * Since: 3.10
+ **/
+void
+gtk_text_buffer_remove_tag_from_ranges (GtkTextBuffer *buffer,
+                                        GtkTextTag    *tag,
+                                        const gint    *offsets,
+                                        gint           n_offsets)
+{
+  g_return_if_fail (GTK_IS_TEXT_BUFFER (buffer));
+  g_return_if_fail (GTK_IS_TEXT_TAG (tag));
+  g_return_if_fail (offsets != NULL || n_offsets == 0);
+  g_return_if_fail (n_offsets % 2 == 0);
+  g_return_if_fail (tag->priv->table == buffer->priv->tag_table);
+
+  gtk_text_buffer_tag_ranges (buffer, tag, offsets, n_offsets, FALSE);
+}
+
 /**
  * gtk_text_buffer_remove_tag:
  * @buffer: a #GtkTextBuffer
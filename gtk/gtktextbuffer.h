@@ -313,6 +313,16 @@ void gtk_text_buffer_remove_tag            (GtkTextBuffer     *buffer,
                                             GtkTextTag        *tag,
                                             const GtkTextIter *start,
                                             const GtkTextIter *end);
+GDK_AVAILABLE_IN_3_10
+void gtk_text_buffer_apply_tag_to_ranges   (GtkTextBuffer     *buffer,
+                                            GtkTextTag        *tag,
+                                            const gint        *offsets,
+                                            gint               n_offsets);
+GDK_AVAILABLE_IN_3_10
+void gtk_text_buffer_remove_tag_from_ranges (GtkTextBuffer    *buffer,
+                                            GtkTextTag        *tag,
+                                            const gint        *offsets,
+                                            gint               n_offsets);
 GDK_AVAILABLE_IN_ALL
 void gtk_text_buffer_apply_tag_by_name     (GtkTextBuffer     *buffer,
                                             const gchar       *name,
@@ -36,6 +36,15 @@ typedef struct
   GDestroyNotify  user_data_destroy;
 } GtkRichTextFormat;
 
+typedef struct
+{
+  GSList         *tags;
+  GtkTextMark    *left_end;
+  GtkTextMark    *right_start;
+  GSList         *left_start_list;
+  GSList         *right_end_list;
+} SplitTags;
+
 
 static GList   * register_format   (GList             *formats,
                                     const gchar       *mime_type,
@@ -51,6 +60,11 @@ static void      free_format       (GtkRichTextFormat *format);
 static void      free_format_list  (GList             *formats);
 static GQuark    serialize_quark   (void);
 static GQuark    deserialize_quark (void);
+static void      split_tags_at_iter (GtkTextBuffer    *buffer,
+                                     GtkTextIter      *iter,
+                                     SplitTags        *split);
+static void      restore_split_tags (GtkTextBuffer    *buffer,
+                                     SplitTags        *split);
 
 
 /**
@@ -565,78 +579,9 @@ gtk_text_buffer_deserialize (GtkTextBuffer  *register_buffer,
         {
           GtkTextBufferDeserializeFunc function = fmt->function;
           gboolean                     success;
-          GSList                      *split_tags;
-          GSList                      *list;
-          GtkTextMark                 *left_end        = NULL;
-          GtkTextMark                 *right_start     = NULL;
-          GSList                      *left_start_list = NULL;
-          GSList                      *right_end_list  = NULL;
-
-          /*  We don't want the tags that are effective at the insertion
-           *  point to affect the pasted text, therefore we remove and
-           *  remember them, so they can be re-applied left and right of
-           *  the inserted text after pasting
-           */
-          split_tags = gtk_text_iter_get_tags (iter);
-
-          list = split_tags;
-          while (list)
-            {
-              GtkTextTag *tag = list->data;
-
-              list = g_slist_next (list);
-
-              /*  If a tag begins at the insertion point, ignore it
-               *  because it doesn't affect the pasted text
-               */
-              if (gtk_text_iter_begins_tag (iter, tag))
-                split_tags = g_slist_remove (split_tags, tag);
-            }
-
-          if (split_tags)
-            {
-              /*  Need to remember text marks, because text iters
-               *  don't survive pasting
-               */
-              left_end = gtk_text_buffer_create_mark (content_buffer,
-                                                      NULL, iter, TRUE);
-              right_start = gtk_text_buffer_create_mark (content_buffer,
-                                                         NULL, iter, FALSE);
-
-              for (list = split_tags; list; list = g_slist_next (list))
-                {
-                  GtkTextTag  *tag             = list->data;
-                  GtkTextIter *backward_toggle = gtk_text_iter_copy (iter);
-                  GtkTextIter *forward_toggle  = gtk_text_iter_copy (iter);
-                  GtkTextMark *left_start      = NULL;
-                  GtkTextMark *right_end       = NULL;
-
-                  gtk_text_iter_backward_to_tag_toggle (backward_toggle, tag);
-                  left_start = gtk_text_buffer_create_mark (content_buffer,
-                                                            NULL,
-                                                            backward_toggle,
-                                                            FALSE);
-
-                  gtk_text_iter_forward_to_tag_toggle (forward_toggle, tag);
-                  right_end = gtk_text_buffer_create_mark (content_buffer,
-                                                           NULL,
-                                                           forward_toggle,
-                                                           TRUE);
-
-                  left_start_list = g_slist_prepend (left_start_list, left_start);
-                  right_end_list = g_slist_prepend (right_end_list, right_end);
-
-                  gtk_text_buffer_remove_tag (content_buffer, tag,
-                                              backward_toggle,
-                                              forward_toggle);
-
-                  gtk_text_iter_free (forward_toggle);
-                  gtk_text_iter_free (backward_toggle);
-                }
-
-              left_start_list = g_slist_reverse (left_start_list);
-              right_end_list = g_slist_reverse (right_end_list);
-            }
+          SplitTags                    split;
+
+          split_tags_at_iter (content_buffer, iter, &split);
 
           success = function (register_buffer, content_buffer,
                               iter, data, length,
@@ -649,56 +594,7 @@ gtk_text_buffer_deserialize (GtkTextBuffer  *register_buffer,
                          _("Unknown error when trying to deserialize %s"),
                          gdk_atom_name (format));
 
-          if (split_tags)
-            {
-              GSList      *left_list;
-              GSList      *right_list;
-              GtkTextIter  left_e;
-              GtkTextIter  right_s;
-
-              /*  Turn the remembered marks back into iters so they
-               *  can by used to re-apply the remembered tags
-               */
-              gtk_text_buffer_get_iter_at_mark (content_buffer,
-                                                &left_e, left_end);
-              gtk_text_buffer_get_iter_at_mark (content_buffer,
-                                                &right_s, right_start);
-
-              for (list = split_tags,
-                     left_list = left_start_list,
-                     right_list = right_end_list;
-                   list && left_list && right_list;
-                   list = g_slist_next (list),
-                     left_list = g_slist_next (left_list),
-                     right_list = g_slist_next (right_list))
-                {
-                  GtkTextTag  *tag        = list->data;
-                  GtkTextMark *left_start = left_list->data;
-                  GtkTextMark *right_end  = right_list->data;
-                  GtkTextIter  left_s;
-                  GtkTextIter  right_e;
-
-                  gtk_text_buffer_get_iter_at_mark (content_buffer,
-                                                    &left_s, left_start);
-                  gtk_text_buffer_get_iter_at_mark (content_buffer,
-                                                    &right_e, right_end);
-
-                  gtk_text_buffer_apply_tag (content_buffer, tag,
-                                             &left_s, &left_e);
-                  gtk_text_buffer_apply_tag (content_buffer, tag,
-                                             &right_s, &right_e);
-
-                  gtk_text_buffer_delete_mark (content_buffer, left_start);
-                  gtk_text_buffer_delete_mark (content_buffer, right_end);
-                }
-
-              gtk_text_buffer_delete_mark (content_buffer, left_end);
-              gtk_text_buffer_delete_mark (content_buffer, right_start);
-
-              g_slist_free (split_tags);
-              g_slist_free (left_start_list);
-              g_slist_free (right_end_list);
-            }
+          restore_split_tags (content_buffer, &split);
 
           return success;
         }
@@ -712,8 +608,239 @@ gtk_text_buffer_deserialize (GtkTextBuffer  *register_buffer,
 }
 
 
+/**
+ * gtk_text_buffer_serialize_to_stream:
+ * @buffer: a #GtkTextBuffer
+ * @start: start of block of text to serialize
+ * @end: end of block of text to serialize
+ * @stream: the #GOutputStream to write to
+ * @cancellable: (allow-none): optional #GCancellable object, %NULL to ignore
+ * @error: return location for a #GError
+ *
+ * Writes the text between @start and @end, including tags and
+ * pixbufs, to @stream in a compact binary format that can be read
+ * back with gtk_text_buffer_deserialize_from_stream().
+ *
+ * Unlike gtk_text_buffer_serialize(), this does not build the
+ * serialized data in memory, which makes it suitable for saving
+ * large documents. @stream is not closed.
+ *
+ * Return value: %TRUE on success, %FALSE if an error occurred
+ *
+ * Since: 3.10
+ **/
+gboolean
+gtk_text_buffer_serialize_to_stream (GtkTextBuffer      *buffer,
+                                     const GtkTextIter  *start,
+                                     const GtkTextIter  *end,
+                                     GOutputStream      *stream,
+                                     GCancellable       *cancellable,
+                                     GError            **error)
+{
+  g_return_val_if_fail (GTK_IS_TEXT_BUFFER (buffer), FALSE);
+  g_return_val_if_fail (start != NULL, FALSE);
+  g_return_val_if_fail (end != NULL, FALSE);
+  g_return_val_if_fail (G_IS_OUTPUT_STREAM (stream), FALSE);
+  g_return_val_if_fail (error == NULL || *error == NULL, FALSE);
+
+  return _gtk_text_buffer_serialize_binary (buffer, start, end, stream,
+                                            cancellable, error);
+}
+
+/**
+ * gtk_text_buffer_deserialize_from_stream:
+ * @buffer: a #GtkTextBuffer
+ * @iter: insertion point for the deserialized text
+ * @stream: the #GInputStream to read from
+ * @create_tags: whether tags used by the serialized text may be
+ *   created in @buffer
+ * @cancellable: (allow-none): optional #GCancellable object, %NULL to ignore
+ * @error: return location for a #GError
+ *
+ * Reads text written by gtk_text_buffer_serialize_to_stream() from
+ * @stream and inserts it at @iter. @iter is revalidated to point to
+ * the end of the inserted text.
+ *
+ * The text is inserted piece by piece while it is being read, so the
+ * serialized data never needs to be held in memory as a whole. If an
+ * error occurs, the text that has been read up to that point remains
+ * in @buffer. @stream may be read beyond the end of the serialized
+ * data, and it is not closed.
+ *
+ * If @create_tags is %FALSE, all tags used by the serialized text
+ * must exist in the tag table of @buffer under the same name;
+ * otherwise new tags are created, see
+ * gtk_text_buffer_deserialize_set_can_create_tags().
+ *
+ * Return value: %TRUE on success, %FALSE if an error occurred
+ *
+ * Since: 3.10
+ **/
+gboolean
+gtk_text_buffer_deserialize_from_stream (GtkTextBuffer  *buffer,
+                                         GtkTextIter    *iter,
+                                         GInputStream   *stream,
+                                         gboolean        create_tags,
+                                         GCancellable   *cancellable,
+                                         GError        **error)
+{
+  SplitTags split;
+  gboolean success;
+
+  g_return_val_if_fail (GTK_IS_TEXT_BUFFER (buffer), FALSE);
+  g_return_val_if_fail (iter != NULL, FALSE);
+  g_return_val_if_fail (G_IS_INPUT_STREAM (stream), FALSE);
+  g_return_val_if_fail (error == NULL || *error == NULL, FALSE);
+
+  split_tags_at_iter (buffer, iter, &split);
+
+  success = _gtk_text_buffer_deserialize_binary (buffer, iter, stream,
+                                                 create_tags,
+                                                 cancellable, error);
+
+  restore_split_tags (buffer, &split);
+
+  return success;
+}
+
+
 /*  private functions  */
 
+/*  We don't want the tags that are effective at the insertion
+ *  point to affect the pasted text, therefore we remove and
+ *  remember them, so they can be re-applied left and right of
+ *  the inserted text after pasting
+ */
+static void
+split_tags_at_iter (GtkTextBuffer *buffer,
+                    GtkTextIter   *iter,
+                    SplitTags     *split)
+{
+  GSList *list;
+
+  split->tags = gtk_text_iter_get_tags (iter);
+  split->left_end = NULL;
+  split->right_start = NULL;
+  split->left_start_list = NULL;
+  split->right_end_list = NULL;
+
+  list = split->tags;
+  while (list)
+    {
+      GtkTextTag *tag = list->data;
+
+      list = g_slist_next (list);
+
+      /*  If a tag begins at the insertion point, ignore it
+       *  because it doesn't affect the pasted text
+       */
+      if (gtk_text_iter_begins_tag (iter, tag))
+        split->tags = g_slist_remove (split->tags, tag);
+    }
+
+  if (!split->tags)
+    return;
+
+  /*  Need to remember text marks, because text iters
+   *  don't survive pasting
+   */
+  split->left_end = gtk_text_buffer_create_mark (buffer,
+                                                 NULL, iter, TRUE);
+  split->right_start = gtk_text_buffer_create_mark (buffer,
+                                                    NULL, iter, FALSE);
+
+  for (list = split->tags; list; list = g_slist_next (list))
+    {
+      GtkTextTag  *tag             = list->data;
+      GtkTextIter *backward_toggle = gtk_text_iter_copy (iter);
+      GtkTextIter *forward_toggle  = gtk_text_iter_copy (iter);
+      GtkTextMark *left_start      = NULL;
+      GtkTextMark *right_end       = NULL;
+
+      gtk_text_iter_backward_to_tag_toggle (backward_toggle, tag);
+      left_start = gtk_text_buffer_create_mark (buffer,
+                                                NULL,
+                                                backward_toggle,
+                                                FALSE);
+
+      gtk_text_iter_forward_to_tag_toggle (forward_toggle, tag);
+      right_end = gtk_text_buffer_create_mark (buffer,
+                                               NULL,
+                                               forward_toggle,
+                                               TRUE);
+
+      split->left_start_list = g_slist_prepend (split->left_start_list, left_start);
+      split->right_end_list = g_slist_prepend (split->right_end_list, right_end);
+
+      gtk_text_buffer_remove_tag (buffer, tag,
+                                  backward_toggle,
+                                  forward_toggle);
+
+      gtk_text_iter_free (forward_toggle);
+      gtk_text_iter_free (backward_toggle);
+    }
+
+  split->left_start_list = g_slist_reverse (split->left_start_list);
+  split->right_end_list = g_slist_reverse (split->right_end_list);
+}
+
+static void
+restore_split_tags (GtkTextBuffer *buffer,
+                    SplitTags     *split)
+{
+  GSList      *list;
+  GSList      *left_list;
+  GSList      *right_list;
+  GtkTextIter  left_e;
+  GtkTextIter  right_s;
+
+  if (!split->tags)
+    return;
+
+  /*  Turn the remembered marks back into iters so they
+   *  can by used to re-apply the remembered tags
+   */
+  gtk_text_buffer_get_iter_at_mark (buffer,
+                                    &left_e, split->left_end);
+  gtk_text_buffer_get_iter_at_mark (buffer,
+                                    &right_s, split->right_start);
+
+  for (list = split->tags,
+         left_list = split->left_start_list,
+         right_list = split->right_end_list;
+       list && left_list && right_list;
+       list = g_slist_next (list),
+         left_list = g_slist_next (left_list),
+         right_list = g_slist_next (right_list))
+    {
+      GtkTextTag  *tag        = list->data;
+      GtkTextMark *left_start = left_list->data;
+      GtkTextMark *right_end  = right_list->data;
+      GtkTextIter  left_s;
+      GtkTextIter  right_e;
+
+      gtk_text_buffer_get_iter_at_mark (buffer,
+                                        &left_s, left_start);
+      gtk_text_buffer_get_iter_at_mark (buffer,
+                                        &right_e, right_end);
+
+      gtk_text_buffer_apply_tag (buffer, tag,
+                                 &left_s, &left_e);
+      gtk_text_buffer_apply_tag (buffer, tag,
+                                 &right_s, &right_e);
+
+      gtk_text_buffer_delete_mark (buffer, left_start);
+      gtk_text_buffer_delete_mark (buffer, right_end);
+    }
+
+  gtk_text_buffer_delete_mark (buffer, split->left_end);
+  gtk_text_buffer_delete_mark (buffer, split->right_start);
+
+  g_slist_free (split->tags);
+  g_slist_free (split->left_start_list);
+  g_slist_free (split->right_end_list);
+}
+
 static GList *
 register_format (GList          *formats,
                  const gchar    *mime_type,
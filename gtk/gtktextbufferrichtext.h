@@ -133,6 +133,21 @@ gboolean  gtk_text_buffer_deserialize                 (GtkTextBuffer
                                                        gsize                         length,
                                                        GError                      **error);
 
+GDK_AVAILABLE_IN_3_10
+gboolean  gtk_text_buffer_serialize_to_stream         (GtkTextBuffer                *buffer,
+                                                       const GtkTextIter            *start,
+                                                       const GtkTextIter            *end,
+                                                       GOutputStream                *stream,
+                                                       GCancellable                 *cancellable,
+                                                       GError                      **error);
+GDK_AVAILABLE_IN_3_10
+gboolean  gtk_text_buffer_deserialize_from_stream     (GtkTextBuffer                *buffer,
+                                                       GtkTextIter                  *iter,
+                                                       GInputStream                 *stream,
+                                                       gboolean                      create_tags,
+                                                       GCancellable                 *cancellable,
+                                                       GError                      **error);
+
 G_END_DECLS
 
 #endif /* __GTK_TEXT_BUFFER_RICH_TEXT_H__ */
@@ -48,7 +48,7 @@ typedef struct
 } SerializationContext;
 
 static gchar *
-serialize_value (GValue *value)
+value_to_string (GValue *value)
 {
   if (g_value_type_transformable (value->g_type, G_TYPE_STRING))
     {
@@ -58,7 +58,7 @@ serialize_value (GValue *value)
       g_value_init (&text_value, G_TYPE_STRING);
       g_value_transform (value, &text_value);
 
-      tmp = g_markup_escape_text (g_value_get_string (&text_value), -1);
+      tmp = g_value_dup_string (&text_value);
       g_value_unset (&text_value);
 
       return tmp;
@@ -77,6 +77,21 @@ serialize_value (GValue *value)
   return NULL;
 }
 
+static gchar *
+serialize_value (GValue *value)
+{
+  gchar *str, *tmp;
+
+  str = value_to_string (value);
+  if (str == NULL)
+    return NULL;
+
+  tmp = g_markup_escape_text (str, -1);
+  g_free (str);
+
+  return tmp;
+}
+
 static gboolean
 deserialize_value (const gchar *str,
                    GValue      *value)
@@ -1880,3 +1895,847 @@ _gtk_text_buffer_deserialize_rich_text (GtkTextBuffer *register_buffer,
 
   return retval;
 }
+
+/* Binary stream format
+ *
+ * Unlike the rich text format above, which is built and parsed as a
+ * whole, the binary format is a sequence of self-contained records
+ * that is written and read incrementally, so that documents of any
+ * size can be saved and loaded with bounded memory.
+ *
+ * The stream starts with BINARY_HEADER, followed by records that
+ * consist of a one byte type, a 32 bit payload length and the payload.
+ * All integers are stored in network byte order, strings are stored
+ * as a 32 bit length followed by the UTF-8 data.
+ *
+ * RECORD_TAG defines the tag with the next free id: its priority, a
+ * flags byte (BINARY_TAG_NAMED), the name of named tags and a list of
+ * (property name, type name, value) triples. All tags are defined up
+ * front, in order of increasing priority.
+ *
+ * RECORD_TEXT and RECORD_PIXBUF contain a list of tag ids, followed
+ * by UTF-8 text or serialized GdkPixdata respectively.
+ *
+ * RECORD_END terminates the stream.
+ */
+
+#define BINARY_HEADER          "GTKTEXTBUFFERBINARY-0001"
+#define BINARY_HEADER_LENGTH   (sizeof (BINARY_HEADER) - 1)
+#define BINARY_TAG_NAMED       (1 << 0)
+#define BINARY_CHUNK_CHARS     (16 * 1024)
+#define BINARY_FLUSH_SIZE      (64 * 1024)
+#define BINARY_MAX_RECORD_SIZE (256 * 1024 * 1024)
+
+enum {
+  RECORD_END    = 'E',
+  RECORD_TAG    = 'T',
+  RECORD_TEXT   = 'X',
+  RECORD_PIXBUF = 'P'
+};
+
+typedef struct
+{
+  GOutputStream *stream;
+  GCancellable *cancellable;
+
+  /* Data that has not been written to the stream yet */
+  GString *pending;
+
+  /* Payload of the record that is being built */
+  GString *record;
+
+  GHashTable *tag_ids;
+} BinaryWriter;
+
+static void
+append_uint32 (GString *str,
+               guint32  value)
+{
+  value = GUINT32_TO_BE (value);
+  g_string_append_len (str, (const gchar *) &value, 4);
+}
+
+static void
+append_string (GString     *str,
+               const gchar *text)
+{
+  gsize len = strlen (text);
+
+  append_uint32 (str, len);
+  g_string_append_len (str, text, len);
+}
+
+static gboolean
+binary_writer_flush (BinaryWriter  *writer,
+                     gboolean       force,
+                     GError       **error)
+{
+  gboolean retval;
+
+  if (writer->pending->len == 0 ||
+      (!force && writer->pending->len < BINARY_FLUSH_SIZE))
+    return TRUE;
+
+  retval = g_output_stream_write_all (writer->stream,
+                                      writer->pending->str,
+                                      writer->pending->len,
+                                      NULL,
+                                      writer->cancellable,
+                                      error);
+  g_string_truncate (writer->pending, 0);
+
+  return retval;
+}
+
+static gboolean
+binary_writer_end_record (BinaryWriter  *writer,
+                          guint8         type,
+                          GError       **error)
+{
+  /* The reader refuses larger records, so don't write them */
+  if (writer->record->len > BINARY_MAX_RECORD_SIZE)
+    {
+      g_string_truncate (writer->record, 0);
+      g_set_error_literal (error,
+                           G_IO_ERROR,
+                           G_IO_ERROR_INVALID_DATA,
+                           type == RECORD_PIXBUF ?
+                           _("Image is too large to be serialized") :
+                           _("Data is too large to be serialized"));
+      return FALSE;
+    }
+
+  g_string_append_c (writer->pending, type);
+  append_uint32 (writer->pending, writer->record->len);
+  g_string_append_len (writer->pending, writer->record->str, writer->record->len);
+  g_string_truncate (writer->record, 0);
+
+  return binary_writer_flush (writer, FALSE, error);
+}
+
+static void
+add_tags (GPtrArray  *tags,
+          GHashTable *seen,
+          GSList     *list)
+{
+  GSList *l;
+
+  for (l = list; l; l = l->next)
+    {
+      if (g_hash_table_lookup (seen, l->data))
+        continue;
+
+      g_hash_table_insert (seen, l->data, l->data);
+      g_ptr_array_add (tags, l->data);
+    }
+
+  g_slist_free (list);
+}
+
+static gint
+compare_tag_priority (gconstpointer a,
+                      gconstpointer b)
+{
+  GtkTextTag *tag_a = *(GtkTextTag **) a;
+  GtkTextTag *tag_b = *(GtkTextTag **) b;
+
+  return tag_a->priv->priority - tag_b->priv->priority;
+}
+
+/* Finds the tags used between @start and @end by only
+ * visiting tag toggles, sorted by priority
+ */
+static GPtrArray *
+collect_tags (const GtkTextIter *start,
+              const GtkTextIter *end)
+{
+  GPtrArray *tags;
+  GHashTable *seen;
+  GtkTextIter iter;
+
+  tags = g_ptr_array_new ();
+  seen = g_hash_table_new (NULL, NULL);
+
+  iter = *start;
+  add_tags (tags, seen, gtk_text_iter_get_tags (&iter));
+
+  while (gtk_text_iter_forward_to_tag_toggle (&iter, NULL) &&
+         gtk_text_iter_compare (&iter, end) < 0)
+    add_tags (tags, seen, gtk_text_iter_get_toggled_tags (&iter, TRUE));
+
+  g_hash_table_destroy (seen);
+
+  g_ptr_array_sort (tags, compare_tag_priority);
+
+  return tags;
+}
+
+static gboolean
+write_tag (BinaryWriter  *writer,
+           GtkTextTag    *tag,
+           GError       **error)
+{
+  GParamSpec **pspecs;
+  guint n_pspecs, n_attrs, i;
+  GString *attrs;
+
+  append_uint32 (writer->record, tag->priv->priority);
+
+  if (tag->priv->name)
+    {
+      g_string_append_c (writer->record, BINARY_TAG_NAMED);
+      append_string (writer->record, tag->priv->name);
+    }
+  else
+    g_string_append_c (writer->record, 0);
+
+  attrs = g_string_new (NULL);
+  n_attrs = 0;
+
+  pspecs = g_object_class_list_properties (G_OBJECT_GET_CLASS (tag), &n_pspecs);
+
+  for (i = 0; i < n_pspecs; i++)
+    {
+      GValue value = G_VALUE_INIT;
+      gchar *str;
+
+      if (!(pspecs[i]->flags & G_PARAM_READABLE) ||
+	  !(pspecs[i]->flags & G_PARAM_WRITABLE))
+	continue;
+
+      if (!is_param_set (G_OBJECT (tag), pspecs[i], &value))
+	continue;
+
+      str = value_to_string (&value);
+
+      if (str)
+        {
+          append_string (attrs, pspecs[i]->name);
+          append_string (attrs, g_type_name (pspecs[i]->value_type));
+          append_string (attrs, str);
+          n_attrs++;
+
+          g_free (str);
+        }
+
+      g_value_unset (&value);
+    }
+
+  g_free (pspecs);
+
+  append_uint32 (writer->record, n_attrs);
+  g_string_append_len (writer->record, attrs->str, attrs->len);
+  g_string_free (attrs, TRUE);
+
+  return binary_writer_end_record (writer, RECORD_TAG, error);
+}
+
+static gboolean
+write_text (BinaryWriter  *writer,
+            GString       *run_tags,
+            const gchar   *text,
+            gsize          len,
+            GError       **error)
+{
+  if (len == 0)
+    return TRUE;
+
+  g_string_append_len (writer->record, run_tags->str, run_tags->len);
+  g_string_append_len (writer->record, text, len);
+
+  return binary_writer_end_record (writer, RECORD_TEXT, error);
+}
+
+static gboolean
+write_pixbuf (BinaryWriter  *writer,
+              GString       *run_tags,
+              GdkPixbuf     *pixbuf,
+              GError       **error)
+{
+  GdkPixdata pixdata;
+  guint8 *data;
+  guint len;
+
+  gdk_pixdata_from_pixbuf (&pixdata, pixbuf, FALSE);
+  data = gdk_pixdata_serialize (&pixdata, &len);
+
+  g_string_append_len (writer->record, run_tags->str, run_tags->len);
+  g_string_append_len (writer->record, (gchar *) data, len);
+  g_free (data);
+
+  return binary_writer_end_record (writer, RECORD_PIXBUF, error);
+}
+
+/* Writes the text between @start and @end, which all carries
+ * the same tags, splitting it into chunks and pixbufs
+ */
+static gboolean
+write_run (BinaryWriter       *writer,
+           const GtkTextIter  *start,
+           const GtkTextIter  *end,
+           GError            **error)
+{
+  GtkTextIter iter, chunk_end;
+  GString *run_tags;
+  GSList *tags, *l;
+  gboolean retval = TRUE;
+
+  run_tags = g_string_new (NULL);
+  tags = gtk_text_iter_get_tags (start);
+  append_uint32 (run_tags, g_slist_length (tags));
+  for (l = tags; l; l = l->next)
+    append_uint32 (run_tags, GPOINTER_TO_UINT (g_hash_table_lookup (writer->tag_ids, l->data)));
+  g_slist_free (tags);
+
+  iter = *start;
+
+  while (retval && gtk_text_iter_compare (&iter, end) < 0)
+    {
+      GtkTextIter object_iter;
+      const gchar *segment, *object, *last, *object_ptr;
+      gchar *text;
+
+      chunk_end = iter;
+      gtk_text_iter_forward_chars (&chunk_end, BINARY_CHUNK_CHARS);
+      if (gtk_text_iter_compare (&chunk_end, end) > 0)
+        chunk_end = *end;
+
+      text = gtk_text_iter_get_slice (&iter, &chunk_end);
+
+      /* Pixbufs and child anchors both show up as U+FFFC,
+       * only pixbufs are written as such
+       */
+      segment = last = object_ptr = text;
+      object_iter = iter;
+      while (retval && (object = strstr (last, "\xef\xbf\xbc")) != NULL)
+        {
+          GdkPixbuf *pixbuf;
+
+          gtk_text_iter_forward_chars (&object_iter, g_utf8_pointer_to_offset (object_ptr, object));
+          object_ptr = object;
+          last = object + 3;
+
+          pixbuf = gtk_text_iter_get_pixbuf (&object_iter);
+          if (pixbuf == NULL)
+            continue;
+
+          retval = write_text (writer, run_tags, segment, object - segment, error) &&
+                   write_pixbuf (writer, run_tags, pixbuf, error);
+          segment = last;
+        }
+
+      if (retval)
+        retval = write_text (writer, run_tags, segment, strlen (segment), error);
+
+      g_free (text);
+      iter = chunk_end;
+    }
+
+  g_string_free (run_tags, TRUE);
+
+  return retval;
+}
+
+gboolean
+_gtk_text_buffer_serialize_binary (GtkTextBuffer      *buffer,
+                                   const GtkTextIter  *start,
+                                   const GtkTextIter  *end,
+                                   GOutputStream      *stream,
+                                   GCancellable       *cancellable,
+                                   GError            **error)
+{
+  BinaryWriter writer;
+  GPtrArray *tags;
+  GtkTextIter iter, run_end;
+  gboolean retval = TRUE;
+  guint i;
+
+  writer.stream = stream;
+  writer.cancellable = cancellable;
+  writer.pending = g_string_sized_new (BINARY_FLUSH_SIZE);
+  writer.record = g_string_new (NULL);
+  writer.tag_ids = g_hash_table_new (NULL, NULL);
+
+  g_string_append_len (writer.pending, BINARY_HEADER, BINARY_HEADER_LENGTH);
+
+  tags = collect_tags (start, end);
+  for (i = 0; retval && i < tags->len; i++)
+    {
+      GtkTextTag *tag = g_ptr_array_index (tags, i);
+
+      g_hash_table_insert (writer.tag_ids, tag, GUINT_TO_POINTER (i));
+      retval = write_tag (&writer, tag, error);
+    }
+  g_ptr_array_free (tags, TRUE);
+
+  iter = *start;
+  while (retval && gtk_text_iter_compare (&iter, end) < 0)
+    {
+      run_end = iter;
+      gtk_text_iter_forward_to_tag_toggle (&run_end, NULL);
+      if (gtk_text_iter_compare (&run_end, end) > 0)
+        run_end = *end;
+
+      retval = write_run (&writer, &iter, &run_end, error);
+      iter = run_end;
+    }
+
+  if (retval)
+    retval = binary_writer_end_record (&writer, RECORD_END, error) &&
+             binary_writer_flush (&writer, TRUE, error);
+
+  g_string_free (writer.pending, TRUE);
+  g_string_free (writer.record, TRUE);
+  g_hash_table_destroy (writer.tag_ids);
+
+  return retval;
+}
+
+typedef struct
+{
+  GInputStream *stream;
+  GCancellable *cancellable;
+  GtkTextBuffer *buffer;
+  gboolean create_tags;
+
+  GByteArray *record;
+
+  /* Tags indexed by their id */
+  GPtrArray *tags;
+
+  /* Consecutive records with the same tags are tagged at once */
+  GPtrArray *run_tags;
+  GtkTextMark *run_start;
+} BinaryReader;
+
+static void
+set_malformed_error (GError **error)
+{
+  g_set_error_literal (error,
+                       G_IO_ERROR,
+                       G_IO_ERROR_INVALID_DATA,
+                       _("Serialized data is malformed"));
+}
+
+static gboolean
+read_uint32 (const guint8 **data,
+             const guint8  *end,
+             guint32       *value)
+{
+  guint32 tmp;
+
+  if (end - *data < 4)
+    return FALSE;
+
+  memcpy (&tmp, *data, 4);
+  *value = GUINT32_FROM_BE (tmp);
+  *data += 4;
+
+  return TRUE;
+}
+
+static gchar *
+read_string (const guint8 **data,
+             const guint8  *end)
+{
+  guint32 len;
+  gchar *str;
+
+  if (!read_uint32 (data, end, &len) || (gsize) (end - *data) < len)
+    return NULL;
+
+  if (!g_utf8_validate ((const gchar *) *data, len, NULL))
+    return NULL;
+
+  str = g_strndup ((const gchar *) *data, len);
+  *data += len;
+
+  return str;
+}
+
+static gboolean
+binary_reader_read (BinaryReader  *reader,
+                    gpointer       buffer,
+                    gsize          count,
+                    GError       **error)
+{
+  gsize bytes_read;
+
+  if (!g_input_stream_read_all (reader->stream, buffer, count, &bytes_read,
+                                reader->cancellable, error))
+    return FALSE;
+
+  if (bytes_read != count)
+    {
+      set_malformed_error (error);
+      return FALSE;
+    }
+
+  return TRUE;
+}
+
+static gchar *
+binary_reader_get_tag_name (BinaryReader *reader,
+                            const gchar  *tag_name)
+{
+  GtkTextTagTable *tag_table;
+  gchar *name;
+  gint i;
+
+  tag_table = gtk_text_buffer_get_tag_table (reader->buffer);
+  name = g_strdup (tag_name);
+  i = 0;
+
+  while (gtk_text_tag_table_lookup (tag_table, name) != NULL)
+    {
+      g_free (name);
+      name = g_strdup_printf ("%s-%d", tag_name, ++i);
+    }
+
+  return name;
+}
+
+static gboolean
+read_tag_attributes (GtkTextTag    *tag,
+                     const guint8  *data,
+                     const guint8  *end,
+                     GError       **error)
+{
+  guint32 n_attrs, i;
+
+  if (!read_uint32 (&data, end, &n_attrs))
+    {
+      set_malformed_error (error);
+      return FALSE;
+    }
+
+  for (i = 0; i < n_attrs; i++)
+    {
+      gchar *name, *type, *value;
+      GValue gvalue = G_VALUE_INIT;
+      GParamSpec *pspec;
+      GType gtype;
+      gboolean valid = FALSE;
+
+      name = read_string (&data, end);
+      type = read_string (&data, end);
+      value = read_string (&data, end);
+
+      if (!name || !type || !value)
+        set_malformed_error (error);
+      else if ((gtype = g_type_from_name (type)) == G_TYPE_INVALID)
+        g_set_error (error, G_IO_ERROR, G_IO_ERROR_INVALID_DATA,
+                     _("\"%s\" is not a valid attribute type"), type);
+      else if (!(pspec = g_object_class_find_property (G_OBJECT_GET_CLASS (tag), name)))
+        g_set_error (error, G_IO_ERROR, G_IO_ERROR_INVALID_DATA,
+                     _("\"%s\" is not a valid attribute name"), name);
+      else
+        {
+          g_value_init (&gvalue, gtype);
+
+          if (!deserialize_value (value, &gvalue))
+            g_set_error (error, G_IO_ERROR, G_IO_ERROR_INVALID_DATA,
+                         _("\"%s\" could not be converted to a value of type \"%s\" for attribute \"%s\""),
+                         value, type, name);
+          else if (g_param_value_validate (pspec, &gvalue))
+            g_set_error (error, G_IO_ERROR, G_IO_ERROR_INVALID_DATA,
+                         _("\"%s\" is not a valid value for attribute \"%s\""),
+                         value, name);
+          else
+            {
+              g_object_set_property (G_OBJECT (tag), name, &gvalue);
+              valid = TRUE;
+            }
+
+          g_value_unset (&gvalue);
+        }
+
+      g_free (name);
+      g_free (type);
+      g_free (value);
+
+      if (!valid)
+        return FALSE;
+    }
+
+  return TRUE;
+}
+
+static gboolean
+read_tag (BinaryReader  *reader,
+          const guint8  *data,
+          const guint8  *end,
+          GError       **error)
+{
+  GtkTextTag *tag;
+  guint32 priority;
+  gchar *name = NULL;
+  guint8 flags;
+
+  if (!read_uint32 (&data, end, &priority) || data == end)
+    {
+      set_malformed_error (error);
+      return FALSE;
+    }
+
+  flags = *data++;
+
+  if ((flags & BINARY_TAG_NAMED) &&
+      (name = read_string (&data, end)) == NULL)
+    {
+      set_malformed_error (error);
+      return FALSE;
+    }
+
+  if (!reader->create_tags)
+    {
+      if (!name)
+        {
+          g_set_error_literal (error, G_IO_ERROR, G_IO_ERROR_INVALID_DATA,
+                               _("Anonymous tag found and tags can not be created."));
+          return FALSE;
+        }
+
+      tag = gtk_text_tag_table_lookup (gtk_text_buffer_get_tag_table (reader->buffer), name);
+      if (!tag)
+        {
+          g_set_error (error, G_IO_ERROR, G_IO_ERROR_INVALID_DATA,
+                       _("Tag \"%s\" does not exist in buffer and tags can not be created."), name);
+          g_free (name);
+          return FALSE;
+        }
+
+      g_free (name);
+      g_ptr_array_add (reader->tags, tag);
+
+      return TRUE;
+    }
+
+  if (name)
+    {
+      gchar *tag_name = binary_reader_get_tag_name (reader, name);
+      tag = gtk_text_tag_new (tag_name);
+      g_free (tag_name);
+      g_free (name);
+    }
+  else
+    tag = gtk_text_tag_new (NULL);
+
+  if (!read_tag_attributes (tag, data, end, error))
+    {
+      g_object_unref (tag);
+      return FALSE;
+    }
+
+  /* Tags come in order of priority, so adding them
+   * keeps their relative priorities
+   */
+  gtk_text_tag_table_add (gtk_text_buffer_get_tag_table (reader->buffer), tag);
+  g_ptr_array_add (reader->tags, tag);
+  g_object_unref (tag);
+
+  return TRUE;
+}
+
+static void
+binary_reader_flush_run (BinaryReader *reader,
+                         GtkTextIter  *iter)
+{
+  GtkTextIter start;
+  guint i;
+
+  gtk_text_buffer_get_iter_at_mark (reader->buffer, &start, reader->run_start);
+
+  for (i = 0; i < reader->run_tags->len; i++)
+    gtk_text_buffer_apply_tag (reader->buffer,
+                               g_ptr_array_index (reader->run_tags, i),
+                               &start, iter);
+
+  gtk_text_buffer_move_mark (reader->buffer, reader->run_start, iter);
+}
+
+static gboolean
+read_run_tags (BinaryReader  *reader,
+               const guint8 **data,
+               const guint8  *end,
+               GtkTextIter   *iter,
+               GError       **error)
+{
+  guint32 n_tags, id, i;
+  GPtrArray *tags;
+  gboolean changed;
+
+  if (!read_uint32 (data, end, &n_tags) || n_tags > reader->tags->len)
+    {
+      set_malformed_error (error);
+      return FALSE;
+    }
+
+  tags = g_ptr_array_sized_new (n_tags);
+  changed = n_tags != reader->run_tags->len;
+
+  for (i = 0; i < n_tags; i++)
+    {
+      if (!read_uint32 (data, end, &id) || id >= reader->tags->len)
+        {
+          set_malformed_error (error);
+          g_ptr_array_free (tags, TRUE);
+          return FALSE;
+        }
+
+      g_ptr_array_add (tags, g_ptr_array_index (reader->tags, id));
+
+      if (!changed && g_ptr_array_index (tags, i) != g_ptr_array_index (reader->run_tags, i))
+        changed = TRUE;
+    }
+
+  if (changed)
+    {
+      binary_reader_flush_run (reader, iter);
+      g_ptr_array_free (reader->run_tags, TRUE);
+      reader->run_tags = tags;
+    }
+  else
+    g_ptr_array_free (tags, TRUE);
+
+  return TRUE;
+}
+
+static gboolean
+read_text (BinaryReader  *reader,
+           const guint8  *data,
+           const guint8  *end,
+           GtkTextIter   *iter,
+           GError       **error)
+{
+  if (!read_run_tags (reader, &data, end, iter, error))
+    return FALSE;
+
+  if (!g_utf8_validate ((const gchar *) data, end - data, NULL))
+    {
+      set_malformed_error (error);
+      return FALSE;
+    }
+
+  gtk_text_buffer_insert (reader->buffer, iter, (const gchar *) data, end - data);
+
+  return TRUE;
+}
+
+static gboolean
+read_pixbuf (BinaryReader  *reader,
+             const guint8  *data,
+             const guint8  *end,
+             GtkTextIter   *iter,
+             GError       **error)
+{
+  GdkPixdata pixdata;
+  GdkPixbuf *pixbuf;
+
+  if (!read_run_tags (reader, &data, end, iter, error))
+    return FALSE;
+
+  if (!gdk_pixdata_deserialize (&pixdata, end - data, data, error))
+    return FALSE;
+
+  pixbuf = gdk_pixbuf_from_pixdata (&pixdata, TRUE, error);
+  if (!pixbuf)
+    return FALSE;
+
+  gtk_text_buffer_insert_pixbuf (reader->buffer, iter, pixbuf);
+  g_object_unref (pixbuf);
+
+  return TRUE;
+}
+
+static gboolean
+read_record (BinaryReader  *reader,
+             GtkTextIter   *iter,
+             gboolean      *done,
+             GError       **error)
+{
+  guint8 header[5];
+  const guint8 *data, *end;
+  guint32 length;
+
+  if (!binary_reader_read (reader, header, sizeof (header), error))
+    return FALSE;
+
+  data = header + 1;
+  read_uint32 (&data, header + sizeof (header), &length);
+
+  if (length > BINARY_MAX_RECORD_SIZE)
+    {
+      set_malformed_error (error);
+      return FALSE;
+    }
+
+  g_byte_array_set_size (reader->record, length);
+  if (!binary_reader_read (reader, reader->record->data, length, error))
+    return FALSE;
+
+  data = reader->record->data;
+  end = data + length;
+
+  switch (header[0])
+    {
+    case RECORD_TAG:
+      return read_tag (reader, data, end, error);
+    case RECORD_TEXT:
+      return read_text (reader, data, end, iter, error);
+    case RECORD_PIXBUF:
+      return read_pixbuf (reader, data, end, iter, error);
+    case RECORD_END:
+      *done = TRUE;
+      return TRUE;
+    default:
+      set_malformed_error (error);
+      return FALSE;
+    }
+}
+
+gboolean
+_gtk_text_buffer_deserialize_binary (GtkTextBuffer  *buffer,
+                                     GtkTextIter    *iter,
+                                     GInputStream   *stream,
+                                     gboolean        create_tags,
+                                     GCancellable   *cancellable,
+                                     GError        **error)
+{
+  BinaryReader reader;
+  gchar header[BINARY_HEADER_LENGTH];
+  gboolean done = FALSE;
+  gboolean retval;
+
+  reader.stream = g_buffered_input_stream_new_sized (stream, BINARY_FLUSH_SIZE);
+  g_filter_input_stream_set_close_base_stream (G_FILTER_INPUT_STREAM (reader.stream), FALSE);
+  reader.cancellable = cancellable;
+  reader.buffer = buffer;
+  reader.create_tags = create_tags;
+  reader.record = g_byte_array_new ();
+  reader.tags = g_ptr_array_new ();
+  reader.run_tags = g_ptr_array_new ();
+  reader.run_start = gtk_text_buffer_create_mark (buffer, NULL, iter, TRUE);
+
+  retval = binary_reader_read (&reader, header, BINARY_HEADER_LENGTH, error);
+
+  if (retval && memcmp (header, BINARY_HEADER, BINARY_HEADER_LENGTH) != 0)
+    {
+      set_malformed_error (error);
+      retval = FALSE;
+    }
+
+  while (retval && !done)
+    retval = read_record (&reader, iter, &done, error);
+
+  /* Text that made it into the buffer keeps its tags, even on error */
+  binary_reader_flush_run (&reader, iter);
+
+  gtk_text_buffer_delete_mark (buffer, reader.run_start);
+  g_ptr_array_free (reader.run_tags, TRUE);
+  g_ptr_array_free (reader.tags, TRUE);
+  g_byte_array_free (reader.record, TRUE);
+  g_object_unref (reader.stream);
+
+  return retval;
+}
@@ -49,6 +49,7 @@
 #include "gtkscrollable.h"
 #include "gtktypebuiltins.h"
 #include "gtktexthandleprivate.h"
+#include "gtkpixelcacheprivate.h"
 #include "gtkstylecontextprivate.h"
 #include "gtkcssstylepropertyprivate.h"
 #include "gtkbubblewindowprivate.h"
@@ -146,6 +147,11 @@ struct _GtkTextViewPrivate
   GtkTextWindow *top_window;
   GtkTextWindow *bottom_window;
 
+  /* Offscreen copy of the text window contents in buffer
+   * coordinates, so scrolling only renders the exposed lines.
+   */
+  GtkPixelCache *pixel_cache;
+
   GtkAdjustment *hadjustment;
   GtkAdjustment *vadjustment;
 
@@ -197,8 +203,26 @@ struct _GtkTextViewPrivate
   gint drag_start_x;
   gint drag_start_y;
 
+  /* Children placed at fixed coordinates in one of our windows */
   GSList *children;
 
+  /* Children placed at a GtkTextChildAnchor, sorted by the buffer
+   * position of the anchor. Anchors never reorder relative to each
+   * other, so the order stays valid across buffer edits and we can
+   * binary search for the children inside the visible area.
+   */
+  GSequence *anchored_children;
+
+  /* The anchored children that are currently mapped, i.e. the ones
+   * near the visible area plus the focus child.
+   */
+  GSList *onscreen_children;
+
+  /* Bumped whenever the layout changes in a way that may move
+   * anchored children, see gtk_text_view_allocate_anchored_child().
+   */
+  guint children_layout_stamp;
+
   GtkTextPendingScroll *pending_scroll;
 
   /* Default style settings */
@@ -239,6 +263,7 @@ struct _GtkTextViewPrivate
   guint cursor_handle_dragged : 1;
   guint selection_handle_dragged : 1;
   guint populate_all   : 1;
+  guint in_scroll : 1;
 };
 
 struct _GtkTextPendingScroll
@@ -347,6 +372,8 @@ static gint gtk_text_view_draw                 (GtkWidget        *widget,
                                                 cairo_t          *cr);
 static void gtk_text_view_draw_focus           (GtkWidget        *widget,
                                                 cairo_t          *cr);
+static void gtk_text_view_queue_draw_region    (GtkWidget            *widget,
+                                                const cairo_region_t *region);
 static gboolean gtk_text_view_focus            (GtkWidget        *widget,
                                                 GtkDirectionType  direction);
 static void gtk_text_view_select_all           (GtkWidget        *widget,
@@ -509,6 +536,8 @@ static void gtk_text_view_forall (GtkContainer *container,
                                   gboolean      include_internals,
                                   GtkCallback   callback,
                                   gpointer      callback_data);
+static void gtk_text_view_set_focus_child (GtkContainer *container,
+                                           GtkWidget    *child);
 
 /* GtkTextHandle handlers */
 static void gtk_text_view_handle_dragged       (GtkTextHandle         *handle,
@@ -538,7 +567,15 @@ struct _GtkTextViewChild
 
   gint from_top_of_line;
   gint from_left_of_buffer;
-  
+
+  /* These are ignored if anchor == NULL */
+  GSequenceIter *seq_iter;
+  gint alloc_xoffset;      /* scroll offsets the allocation was made for */
+  gint alloc_yoffset;
+  guint layout_stamp;
+  GtkRequisition requisition;  /* last request seen, to notice resizes */
+  guint onscreen : 1;
+
   /* These are ignored if anchor != NULL */
   GtkTextWindowType type;
   gint x;
@@ -556,6 +593,10 @@ static void              text_view_child_free              (GtkTextViewChild   *
 static void              text_view_child_set_parent_window (GtkTextView        *text_view,
 							    GtkTextViewChild   *child);
 
+static void adjust_allocation (GtkWidget *widget,
+                               int        dx,
+                               int        dy);
+
 struct _GtkTextWindow
 {
   GtkTextWindowType type;
@@ -650,6 +691,7 @@ gtk_text_view_class_init (GtkTextViewClass *klass)
   widget_class->focus_out_event = gtk_text_view_focus_out_event;
   widget_class->motion_notify_event = gtk_text_view_motion_event;
   widget_class->draw = gtk_text_view_draw;
+  widget_class->queue_draw_region = gtk_text_view_queue_draw_region;
   widget_class->focus = gtk_text_view_focus;
   widget_class->drag_begin = gtk_text_view_drag_begin;
   widget_class->drag_end = gtk_text_view_drag_end;
@@ -666,6 +708,7 @@ gtk_text_view_class_init (GtkTextViewClass *klass)
   container_class->add = gtk_text_view_add;
   container_class->remove = gtk_text_view_remove;
   container_class->forall = gtk_text_view_forall;
+  container_class->set_focus_child = gtk_text_view_set_focus_child;
 
   klass->move_cursor = gtk_text_view_move_cursor;
   klass->set_anchor = gtk_text_view_set_anchor;
@@ -1510,6 +1553,10 @@ gtk_text_view_init (GtkTextView *text_view)
 
   priv->pending_place_cursor_button = 0;
 
+  priv->anchored_children = g_sequence_new (NULL);
+
+  priv->pixel_cache = _gtk_pixel_cache_new ();
+
   /* We handle all our own redrawing */
   gtk_widget_set_redraw_on_allocate (widget, FALSE);
 
@@ -1591,20 +1638,24 @@ gtk_text_view_set_buffer (GtkTextView   *text_view,
   if (priv->buffer != NULL)
     {
       /* Destroy all anchored children */
+      GSequenceIter *seq_iter;
       GSList *tmp_list;
-      GSList *copy;
+      GSList *copy = NULL;
+
+      seq_iter = g_sequence_get_begin_iter (priv->anchored_children);
+      while (!g_sequence_iter_is_end (seq_iter))
+        {
+          copy = g_slist_prepend (copy, g_sequence_get (seq_iter));
+          seq_iter = g_sequence_iter_next (seq_iter);
+        }
 
-      copy = g_slist_copy (priv->children);
       tmp_list = copy;
       while (tmp_list != NULL)
         {
           GtkTextViewChild *vc = tmp_list->data;
 
-          if (vc->anchor)
-            {
-              gtk_widget_destroy (vc->widget);
-              /* vc may now be invalid! */
-            }
+          gtk_widget_destroy (vc->widget);
+          /* vc may now be invalid! */
 
           tmp_list = g_slist_next (tmp_list);
         }
@@ -3164,6 +3215,10 @@ gtk_text_view_finalize (GObject *object)
 
   text_window_free (priv->text_window);
 
+  g_sequence_free (priv->anchored_children);
+
+  _gtk_pixel_cache_free (priv->pixel_cache);
+
   if (priv->left_window)
     text_window_free (priv->left_window);
 
@@ -3415,6 +3470,7 @@ gtk_text_view_size_request (GtkWidget      *widget,
   GtkTextView *text_view;
   GtkTextViewPrivate *priv;
   GSList *tmp_list;
+  GSequenceIter *seq_iter;
   gint focus_edge_width;
   gint focus_width;
   guint border_width;
@@ -3467,32 +3523,40 @@ gtk_text_view_size_request (GtkWidget      *widget,
   while (tmp_list != NULL)
     {
       GtkTextViewChild *child = tmp_list->data;
+      GtkRequisition child_req;
 
-      if (child->anchor)
-        {
-          GtkRequisition child_req;
-          GtkRequisition old_req;
+      gtk_widget_get_preferred_size (child->widget,
+                                     &child_req, NULL);
+
+      tmp_list = g_slist_next (tmp_list);
+    }
 
-          gtk_widget_get_preferred_size (child->widget, &old_req, NULL);
+  /* A child queueing a resize always ends up here, as it invalidates
+   * our request too. Its line has to be measured again even if the
+   * child is offscreen, or the scroll range would be off until it
+   * gets scrolled into view. Unchanged children are answered from
+   * their request cache.
+   */
+  seq_iter = g_sequence_get_begin_iter (priv->anchored_children);
+  while (!g_sequence_iter_is_end (seq_iter))
+    {
+      GtkTextViewChild *child = g_sequence_get (seq_iter);
+      GtkRequisition child_req;
 
-          gtk_widget_get_preferred_size (child->widget, &child_req, NULL);
+      gtk_widget_get_preferred_size (child->widget, &child_req, NULL);
 
-          /* Invalidate layout lines if required */
-          if (priv->layout &&
-              (old_req.width != child_req.width ||
-               old_req.height != child_req.height))
+      /* Invalidate layout lines if required */
+      if (child->requisition.width != child_req.width ||
+          child->requisition.height != child_req.height)
+        {
+          if (priv->layout)
             gtk_text_child_anchor_queue_resize (child->anchor,
                                                 priv->layout);
-        }
-      else
-        {
-          GtkRequisition child_req;
 
-          gtk_widget_get_preferred_size (child->widget,
-                                         &child_req, NULL);
+          child->requisition = child_req;
         }
 
-      tmp_list = g_slist_next (tmp_list);
+      seq_iter = g_sequence_iter_next (seq_iter);
     }
 
   /* Cache the requested size of the text view so we can 
@@ -3558,9 +3622,13 @@ gtk_text_view_update_child_allocation (GtkTextView      *text_view,
   GtkAllocation allocation;
 
   gtk_text_view_compute_child_allocation (text_view, vc, &allocation);
-  
+
   gtk_widget_size_allocate (vc->widget, &allocation);
 
+  vc->alloc_xoffset = text_view->priv->xoffset;
+  vc->alloc_yoffset = text_view->priv->yoffset;
+  vc->layout_stamp = text_view->priv->children_layout_stamp;
+
 #if 0
   g_print ("allocation for %p allocated to %d,%d yoffset = %d\n",
            vc->widget,
@@ -3570,6 +3638,87 @@ gtk_text_view_update_child_allocation (GtkTextView      *text_view,
 #endif
 }
 
+static gint
+text_view_child_get_offset (GtkTextView      *text_view,
+                            GtkTextViewChild *vc)
+{
+  GtkTextIter iter;
+
+  gtk_text_buffer_get_iter_at_child_anchor (get_buffer (text_view),
+                                            &iter,
+                                            vc->anchor);
+
+  return gtk_text_iter_get_offset (&iter);
+}
+
+/* Returns the first anchored child whose anchor is at or after
+ * @offset, or the end iter if there is none.
+ */
+static GSequenceIter *
+gtk_text_view_search_anchored_child (GtkTextView *text_view,
+                                     gint         offset)
+{
+  GSequence *seq = text_view->priv->anchored_children;
+  gint lo, hi;
+
+  lo = 0;
+  hi = g_sequence_get_length (seq);
+
+  while (lo < hi)
+    {
+      gint mid = (lo + hi) / 2;
+      GtkTextViewChild *vc;
+
+      vc = g_sequence_get (g_sequence_get_iter_at_pos (seq, mid));
+
+      if (text_view_child_get_offset (text_view, vc) < offset)
+        lo = mid + 1;
+      else
+        hi = mid;
+    }
+
+  return g_sequence_get_iter_at_pos (seq, lo);
+}
+
+/* Finds the range of anchored children that are onscreen, or close
+ * enough to it that they may get scrolled in soon. Children outside
+ * of this range are neither allocated nor drawn until they come
+ * into view.
+ */
+static void
+gtk_text_view_get_visible_children (GtkTextView    *text_view,
+                                    GSequenceIter **begin,
+                                    GSequenceIter **end)
+{
+  GtkTextViewPrivate *priv = text_view->priv;
+  GtkTextIter first, last;
+  gint height;
+
+  if (priv->layout == NULL || priv->buffer == NULL ||
+      g_sequence_get_length (priv->anchored_children) == 0)
+    {
+      *begin = *end = g_sequence_get_end_iter (priv->anchored_children);
+      return;
+    }
+
+  height = SCREEN_HEIGHT (text_view);
+
+  gtk_text_layout_get_line_at_y (priv->layout, &first,
+                                 priv->yoffset - height, NULL);
+  gtk_text_layout_get_line_at_y (priv->layout, &last,
+                                 priv->yoffset + 2 * height, NULL);
+  gtk_text_iter_forward_line (&last);
+
+  *begin = gtk_text_view_search_anchored_child (text_view,
+                                                gtk_text_iter_get_offset (&first));
+
+  if (gtk_text_iter_is_end (&last))
+    *end = g_sequence_get_end_iter (priv->anchored_children);
+  else
+    *end = gtk_text_view_search_anchored_child (text_view,
+                                                gtk_text_iter_get_offset (&last));
+}
+
 static void
 gtk_text_view_child_allocated (GtkTextLayout *layout,
                                GtkWidget     *child,
@@ -3595,9 +3744,153 @@ gtk_text_view_child_allocated (GtkTextLayout *layout,
   vc->from_left_of_buffer = x;
   vc->from_top_of_line = y;
 
+  /* Unmapped children are allocated when they get scrolled into view */
+  if (!vc->onscreen)
+    {
+      vc->layout_stamp = text_view->priv->children_layout_stamp - 1;
+      return;
+    }
+
   gtk_text_view_update_child_allocation (text_view, vc);
 }
 
+/* Makes sure an anchored child has an up to date allocation for the
+ * current layout and scroll offsets.
+ */
+static void
+gtk_text_view_allocate_anchored_child (GtkTextView      *text_view,
+                                       GtkTextViewChild *child)
+{
+  GtkTextViewPrivate *priv = text_view->priv;
+  GtkTextIter child_loc;
+
+  gtk_text_buffer_get_iter_at_child_anchor (get_buffer (text_view),
+                                            &child_loc,
+                                            child->anchor);
+
+  /* Since anchored children are only ever allocated from
+   * gtk_text_layout_get_line_display() we have to make sure
+   * that the display line caching in the layout doesn't 
+   * get in the way. Invalidating the layout around the anchor
+   * achieves this.
+   */ 
+  if (_gtk_widget_get_alloc_needed (child->widget))
+    {
+      GtkTextIter end = child_loc;
+      gtk_text_iter_forward_char (&end);
+      gtk_text_layout_invalidate (priv->layout, &child_loc, &end);
+    }
+
+  /* We need to force-validate the regions containing
+   * children.
+   */
+  gtk_text_layout_validate_yrange (priv->layout,
+                                   &child_loc,
+                                   0, 1);
+
+  /* If the line was already valid, the child may still be positioned
+   * for an older layout or scroll offset, since we don't bother
+   * moving children while they are offscreen.
+   */
+  if (child->layout_stamp != priv->children_layout_stamp)
+    gtk_text_view_update_child_allocation (text_view, child);
+  else if (child->alloc_xoffset != priv->xoffset ||
+           child->alloc_yoffset != priv->yoffset)
+    {
+      adjust_allocation (child->widget,
+                         child->alloc_xoffset - priv->xoffset,
+                         child->alloc_yoffset - priv->yoffset);
+      child->alloc_xoffset = priv->xoffset;
+      child->alloc_yoffset = priv->yoffset;
+    }
+}
+
+static void
+gtk_text_view_set_child_onscreen (GtkTextView      *text_view,
+                                  GtkTextViewChild *child,
+                                  gboolean          onscreen)
+{
+  GtkTextViewPrivate *priv = text_view->priv;
+
+  if (child->onscreen == onscreen)
+    return;
+
+  child->onscreen = onscreen;
+
+  if (onscreen)
+    priv->onscreen_children = g_slist_prepend (priv->onscreen_children, child);
+  else
+    priv->onscreen_children = g_slist_remove (priv->onscreen_children, child);
+
+  gtk_widget_set_child_visible (child->widget, onscreen);
+}
+
+/* Maps the anchored children near the visible area and unmaps the
+ * ones that scrolled away, then brings the allocation of the mapped
+ * ones up to date. This keeps the cost of scrolling and allocating
+ * proportional to the number of visible children.
+ */
+static void
+gtk_text_view_update_visible_children (GtkTextView *text_view)
+{
+  GtkTextViewPrivate *priv = text_view->priv;
+  GSequenceIter *seq_iter;
+  GSequenceIter *seq_end;
+  GSList *tmp_list;
+  GSList *copy;
+  GtkWidget *focus_child;
+  GtkTextViewChild *focus_vc = NULL;
+
+  gtk_text_view_get_visible_children (text_view, &seq_iter, &seq_end);
+
+  /* The focus child stays mapped wherever it is, hiding it would
+   * move the focus away
+   */
+  focus_child = gtk_container_get_focus_child (GTK_CONTAINER (text_view));
+  if (focus_child)
+    focus_vc = g_object_get_data (G_OBJECT (focus_child), "gtk-text-view-child");
+  if (focus_vc && focus_vc->anchor)
+    gtk_text_view_set_child_onscreen (text_view, focus_vc, TRUE);
+
+  tmp_list = priv->onscreen_children;
+  while (tmp_list != NULL)
+    {
+      GtkTextViewChild *child = tmp_list->data;
+      GSList *next = tmp_list->next;
+
+      if (child != focus_vc &&
+          (g_sequence_iter_compare (child->seq_iter, seq_iter) < 0 ||
+           g_sequence_iter_compare (child->seq_iter, seq_end) >= 0))
+        {
+          priv->onscreen_children = g_slist_delete_link (priv->onscreen_children,
+                                                         tmp_list);
+          child->onscreen = FALSE;
+          gtk_widget_set_child_visible (child->widget, FALSE);
+        }
+
+      tmp_list = next;
+    }
+
+  while (seq_iter != seq_end)
+    {
+      gtk_text_view_set_child_onscreen (text_view, g_sequence_get (seq_iter), TRUE);
+
+      seq_iter = g_sequence_iter_next (seq_iter);
+    }
+
+  /* Validation may scroll, which gets us back in here */
+  copy = g_slist_copy (priv->onscreen_children);
+  tmp_list = copy;
+  while (tmp_list != NULL)
+    {
+      gtk_text_view_allocate_anchored_child (text_view, tmp_list->data);
+
+      tmp_list = g_slist_next (tmp_list);
+    }
+
+  g_slist_free (copy);
+}
+
 static void
 gtk_text_view_allocate_children (GtkTextView *text_view)
 {
@@ -3609,54 +3902,25 @@ gtk_text_view_allocate_children (GtkTextView *text_view)
   while (tmp_list != NULL)
     {
       GtkTextViewChild *child = tmp_list->data;
+      GtkAllocation allocation;
+      GtkRequisition child_req;
 
       g_assert (child != NULL);
-          
-      if (child->anchor)
-        {
-          /* We need to force-validate the regions containing
-           * children.
-           */
-          GtkTextIter child_loc;
-          gtk_text_buffer_get_iter_at_child_anchor (get_buffer (text_view),
-                                                    &child_loc,
-                                                    child->anchor);
-
-	  /* Since anchored children are only ever allocated from
-           * gtk_text_layout_get_line_display() we have to make sure
-	   * that the display line caching in the layout doesn't 
-           * get in the way. Invalidating the layout around the anchor
-           * achieves this.
-	   */ 
-	  if (_gtk_widget_get_alloc_needed (child->widget))
-	    {
-	      GtkTextIter end = child_loc;
-	      gtk_text_iter_forward_char (&end);
-	      gtk_text_layout_invalidate (text_view->priv->layout, &child_loc, &end);
-	    }
 
-          gtk_text_layout_validate_yrange (text_view->priv->layout,
-                                           &child_loc,
-                                           0, 1);
-        }
-      else
-        {
-          GtkAllocation allocation;
-          GtkRequisition child_req;
-             
-          allocation.x = child->x;
-          allocation.y = child->y;
+      allocation.x = child->x;
+      allocation.y = child->y;
 
-          gtk_widget_get_preferred_size (child->widget, &child_req, NULL);
+      gtk_widget_get_preferred_size (child->widget, &child_req, NULL);
 
-          allocation.width = child_req.width;
-          allocation.height = child_req.height;
+      allocation.width = child_req.width;
+      allocation.height = child_req.height;
           
-          gtk_widget_size_allocate (child->widget, &allocation);          
-        }
+      gtk_widget_size_allocate (child->widget, &allocation);          
 
       tmp_list = g_slist_next (tmp_list);
     }
+
+  gtk_text_view_update_visible_children (text_view);
 }
 
 static void
@@ -4019,6 +4283,30 @@ changed_handler (GtkTextLayout     *layout,
         redraw_rect.height = MAX (0, visible_rect.y + visible_rect.height - start_y);
       else
         redraw_rect.height = 0;
+
+      /* The pixel cache also holds some lines around the visible
+       * area, so invalidate it without clipping to the visible rect.
+       * A height change moves everything below start_y, even when
+       * it happens above the visible area.
+       */
+      if (old_height != new_height || old_height > 0)
+        {
+          cairo_rectangle_int_t cache_rect;
+          cairo_region_t *region;
+
+          cache_rect.x = 0;
+          cache_rect.y = start_y;
+          cache_rect.width = MAX (priv->width, visible_rect.x + visible_rect.width);
+          if (old_height == new_height)
+            cache_rect.height = old_height;
+          else
+            cache_rect.height = MAX (priv->height, visible_rect.y + visible_rect.height) +
+                                MAX (old_height, new_height) + visible_rect.height - start_y;
+
+          region = cairo_region_create_rectangle (&cache_rect);
+          _gtk_pixel_cache_invalidate (priv->pixel_cache, region);
+          cairo_region_destroy (region);
+        }
 	
       if (gdk_rectangle_intersect (&redraw_rect, &visible_rect, &redraw_rect))
         {
@@ -4079,15 +4367,17 @@ changed_handler (GtkTextLayout     *layout,
           gtk_adjustment_set_value (text_view->priv->vadjustment, priv->yoffset);
         }
 
-      /* FIXME be smarter about which anchored widgets we update */
+      /* Only update the anchored widgets that are mapped, the
+       * others get repositioned once they are scrolled into view.
+       */
+      priv->children_layout_stamp++;
 
-      tmp_list = priv->children;
+      tmp_list = priv->onscreen_children;
       while (tmp_list != NULL)
         {
           GtkTextViewChild *child = tmp_list->data;
 
-          if (child->anchor)
-            gtk_text_view_update_child_allocation (text_view, child);
+          gtk_text_view_update_child_allocation (text_view, child);
 
           tmp_list = g_slist_next (tmp_list);
         }
@@ -4122,6 +4412,7 @@ gtk_text_view_realize (GtkWidget *widget)
   GdkWindowAttr attributes;
   gint attributes_mask;
   GSList *tmp_list;
+  GSequenceIter *seq_iter;
 
   text_view = GTK_TEXT_VIEW (widget);
   priv = text_view->priv;
@@ -4187,6 +4478,16 @@ gtk_text_view_realize (GtkWidget *widget)
       tmp_list = tmp_list->next;
     }
 
+  seq_iter = g_sequence_get_begin_iter (priv->anchored_children);
+  while (!g_sequence_iter_is_end (seq_iter))
+    {
+      GtkTextViewChild *vc = g_sequence_get (seq_iter);
+
+      text_view_child_set_parent_window (text_view, vc);
+
+      seq_iter = g_sequence_iter_next (seq_iter);
+    }
+
   /* Ensure updating the spot location. */
   gtk_text_view_update_im_spot_location (text_view);
 
@@ -4219,6 +4520,10 @@ gtk_text_view_unrealize (GtkWidget *widget)
 
   text_window_unrealize (priv->text_window);
 
+  /* Nothing invalidates the cache while we are unrealized */
+  _gtk_pixel_cache_free (priv->pixel_cache);
+  priv->pixel_cache = _gtk_pixel_cache_new ();
+
   if (priv->left_window)
     text_window_unrealize (priv->left_window);
 
@@ -5215,6 +5520,97 @@ gtk_text_view_paint (GtkWidget      *widget,
   cairo_restore (cr);
 }
 
+/* Whether something is drawn below the text before ::draw reaches
+ * us, like the current line highlight of subclasses that chain up
+ * or ::draw handlers. That has to show through the cached text.
+ */
+static gboolean
+gtk_text_view_draws_below_text (GtkWidget *widget)
+{
+  static guint draw_signal_id = 0;
+
+  if (GTK_WIDGET_GET_CLASS (widget)->draw != gtk_text_view_draw)
+    return TRUE;
+
+  if (draw_signal_id == 0)
+    draw_signal_id = g_signal_lookup ("draw", GTK_TYPE_WIDGET);
+
+  return g_signal_has_handler_pending (widget, draw_signal_id, 0, FALSE);
+}
+
+static void
+draw_text (cairo_t  *cr,
+           gpointer  user_data)
+{
+  GtkWidget *widget = GTK_WIDGET (user_data);
+  GtkTextView *text_view = GTK_TEXT_VIEW (widget);
+  GtkStyleContext *context;
+  GdkRectangle bg_rect;
+
+  cairo_save (cr);
+
+  gtk_cairo_transform_to_window (cr, widget, text_view->priv->text_window->bin_window);
+
+  /* Unless something shows through, the cache surface is opaque
+   * and doesn't get the window background */
+  if (!gtk_text_view_draws_below_text (widget) &&
+      gdk_cairo_get_clip_rectangle (cr, &bg_rect))
+    {
+      context = gtk_widget_get_style_context (widget);
+
+      gtk_style_context_save (context);
+      gtk_style_context_add_class (context, GTK_STYLE_CLASS_VIEW);
+      gtk_render_background (context, cr,
+                             bg_rect.x, bg_rect.y,
+                             bg_rect.width, bg_rect.height);
+      gtk_style_context_restore (context);
+    }
+
+  gtk_text_view_paint (widget, cr);
+
+  cairo_restore (cr);
+}
+
+static void
+gtk_text_view_text_window_invalidate_handler (GdkWindow      *window,
+                                              cairo_region_t *region)
+{
+  gpointer widget;
+  GtkTextView *text_view;
+  GtkTextViewPrivate *priv;
+
+  gdk_window_get_user_data (window, &widget);
+  text_view = GTK_TEXT_VIEW (widget);
+  priv = text_view->priv;
+
+  /* Scrolling will invalidate the newly exposed area of the text
+     window, but we may already have it in the cache, so we can
+     ignore that */
+  if (priv->in_scroll)
+    return;
+
+  cairo_region_translate (region, priv->xoffset, priv->yoffset);
+  _gtk_pixel_cache_invalidate (priv->pixel_cache, region);
+  cairo_region_translate (region, -priv->xoffset, -priv->yoffset);
+}
+
+static void
+gtk_text_view_queue_draw_region (GtkWidget            *widget,
+                                 const cairo_region_t *region)
+{
+  GtkTextView *text_view = GTK_TEXT_VIEW (widget);
+
+  /* There is no way we can know if a region targets the
+     not-currently-visible but in pixel cache region, so we
+     always just invalidate the whole thing whenever the
+     text view gets a queue draw. This doesn't normally happen
+     in normal scrolling cases anyway. */
+  _gtk_pixel_cache_invalidate (text_view->priv->pixel_cache, NULL);
+
+  GTK_WIDGET_CLASS (gtk_text_view_parent_class)->queue_draw_region (widget,
+                                                                    region);
+}
+
 static gboolean
 gtk_text_view_draw (GtkWidget *widget,
                     cairo_t   *cr)
@@ -5242,15 +5638,37 @@ gtk_text_view_draw (GtkWidget *widget,
                                      GTK_TEXT_WINDOW_TEXT);
   if (gtk_cairo_should_draw_window (cr, window))
     {
+      GtkTextViewPrivate *priv = GTK_TEXT_VIEW (widget)->priv;
+      cairo_rectangle_int_t view_rect;
+      cairo_rectangle_int_t canvas_rect;
+
       DV(g_print (">Exposed ("G_STRLOC")\n"));
+
+      /* Validation may scroll, so do it before looking at the offsets */
+      while (priv->first_validate_idle != 0)
+        gtk_text_view_flush_first_validate (GTK_TEXT_VIEW (widget));
+
+      view_rect = priv->text_window->allocation;
+
+      /* The canvas is the buffer, in buffer coordinates */
+      canvas_rect.x = -priv->xoffset;
+      canvas_rect.y = -priv->yoffset;
+      canvas_rect.width = MAX (priv->width, view_rect.width);
+      canvas_rect.height = MAX (priv->height, view_rect.height);
+
+      /* Switching drops the cache surface, which is rare */
+      _gtk_pixel_cache_set_always_alpha (priv->pixel_cache,
+                                         gtk_text_view_draws_below_text (widget));
+
       cairo_save (cr);
-      gtk_cairo_transform_to_window (cr, widget, window);
-      gtk_text_view_paint (widget, cr);
+      _gtk_pixel_cache_draw (priv->pixel_cache, cr, window,
+                             &view_rect, &canvas_rect,
+                             draw_text, widget);
       cairo_restore (cr);
     }
 
-  /* Propagate exposes to all unanchored children. 
-   * Anchored children are handled in gtk_text_view_paint(). 
+  /* Propagate exposes to all children. Anchored children that
+   * aren't near the visible area are unmapped, so skip them.
    */
   tmp_list = GTK_TEXT_VIEW (widget)->priv->children;
   while (tmp_list != NULL)
@@ -5266,6 +5684,18 @@ gtk_text_view_draw (GtkWidget *widget,
       
       tmp_list = tmp_list->next;
     }
+
+  tmp_list = GTK_TEXT_VIEW (widget)->priv->onscreen_children;
+  while (tmp_list != NULL)
+    {
+      GtkTextViewChild *vc = tmp_list->data;
+
+      gtk_container_propagate_draw (GTK_CONTAINER (widget),
+                                    vc->widget,
+                                    cr);
+
+      tmp_list = tmp_list->next;
+    }
   
   return FALSE;
 }
@@ -5293,6 +5723,90 @@ gtk_text_view_draw_focus (GtkWidget *widget,
     }
 }
 
+/* Moves the focus to the first focusable anchored child that is
+ * unmapped because it is outside the visible area, in buffer order
+ * from the current focus child or the visible area. Those children
+ * are invisible to gtk_container_focus(), so without this keyboard
+ * navigation could not reach them.
+ */
+static gboolean
+gtk_text_view_focus_offscreen_child (GtkTextView      *text_view,
+                                     GtkDirectionType  direction)
+{
+  GtkTextViewPrivate *priv = text_view->priv;
+  GSequenceIter *seq_iter, *seq_begin, *seq_end;
+  GtkTextViewChild *focus_vc = NULL;
+  GtkWidget *focus_child;
+  gboolean forward;
+
+  if (priv->layout == NULL)
+    return FALSE;
+
+  switch (direction)
+    {
+    case GTK_DIR_TAB_FORWARD:
+    case GTK_DIR_DOWN:
+    case GTK_DIR_RIGHT:
+      forward = TRUE;
+      break;
+    default:
+      forward = FALSE;
+      break;
+    }
+
+  focus_child = gtk_container_get_focus_child (GTK_CONTAINER (text_view));
+  if (focus_child)
+    focus_vc = g_object_get_data (G_OBJECT (focus_child), "gtk-text-view-child");
+
+  gtk_text_view_get_visible_children (text_view, &seq_begin, &seq_end);
+
+  if (focus_vc && focus_vc->anchor)
+    seq_iter = forward ? g_sequence_iter_next (focus_vc->seq_iter) : focus_vc->seq_iter;
+  else
+    seq_iter = forward ? seq_end : seq_begin;
+
+  while (forward ? !g_sequence_iter_is_end (seq_iter) : !g_sequence_iter_is_begin (seq_iter))
+    {
+      GtkTextViewChild *child;
+
+      if (!forward)
+        seq_iter = g_sequence_iter_prev (seq_iter);
+
+      child = g_sequence_get (seq_iter);
+
+      if (!child->onscreen &&
+          gtk_widget_get_visible (child->widget) &&
+          gtk_widget_is_sensitive (child->widget) &&
+          (gtk_widget_get_can_focus (child->widget) || GTK_IS_CONTAINER (child->widget)))
+        {
+          /* Descendants are only focusable when they are drawable */
+          gtk_text_view_set_child_onscreen (text_view, child, TRUE);
+          gtk_text_view_allocate_anchored_child (text_view, child);
+
+          /* in case validating scrolled and unmapped it again */
+          gtk_text_view_set_child_onscreen (text_view, child, TRUE);
+
+          if (gtk_widget_child_focus (child->widget, direction))
+            {
+              GtkTextIter iter;
+
+              gtk_text_buffer_get_iter_at_child_anchor (get_buffer (text_view),
+                                                        &iter, child->anchor);
+              gtk_text_view_scroll_to_iter (text_view, &iter, 0.0, FALSE, 0.0, 0.0);
+
+              return TRUE;
+            }
+
+          gtk_text_view_set_child_onscreen (text_view, child, FALSE);
+        }
+
+      if (forward)
+        seq_iter = g_sequence_iter_next (seq_iter);
+    }
+
+  return FALSE;
+}
+
 static gboolean
 gtk_text_view_focus (GtkWidget        *widget,
                      GtkDirectionType  direction)
@@ -5325,10 +5839,49 @@ gtk_text_view_focus (GtkWidget        *widget,
       result = GTK_WIDGET_CLASS (gtk_text_view_parent_class)->focus (widget, direction);
       gtk_widget_set_can_focus (widget, can_focus);
 
+      /* GtkContainer only looks at mapped children */
+      if (!result)
+        result = gtk_text_view_focus_offscreen_child (GTK_TEXT_VIEW (widget), direction);
+
       return result;
     }
 }
 
+static void
+gtk_text_view_set_focus_child (GtkContainer *container,
+                               GtkWidget    *child)
+{
+  GtkTextView *text_view = GTK_TEXT_VIEW (container);
+  GtkTextViewChild *vc = NULL;
+  gboolean was_onscreen;
+
+  GTK_CONTAINER_CLASS (gtk_text_view_parent_class)->set_focus_child (container, child);
+
+  if (child)
+    vc = g_object_get_data (G_OBJECT (child), "gtk-text-view-child");
+
+  if (vc == NULL || vc->anchor == NULL)
+    return;
+
+  /* An anchored child that takes the focus while it is unmapped,
+   * e.g. through gtk_widget_grab_focus(), gets mapped and scrolled
+   * into view, so that the user can see what is focused.
+   */
+  was_onscreen = vc->onscreen;
+  gtk_text_view_set_child_onscreen (text_view, vc, TRUE);
+
+  if (!was_onscreen && text_view->priv->layout)
+    {
+      GtkTextIter iter;
+
+      gtk_text_view_allocate_anchored_child (text_view, vc);
+
+      gtk_text_buffer_get_iter_at_child_anchor (get_buffer (text_view),
+                                                &iter, vc->anchor);
+      gtk_text_view_scroll_to_iter (text_view, &iter, 0.0, FALSE, 0.0, 0.0);
+    }
+}
+
 /*
  * Container
  */
@@ -5351,27 +5904,24 @@ gtk_text_view_remove (GtkContainer *container,
   GtkTextView *text_view;
   GtkTextViewPrivate *priv;
   GtkTextViewChild *vc;
-  GSList *iter;
 
   text_view = GTK_TEXT_VIEW (container);
   priv = text_view->priv;
 
-  vc = NULL;
-  iter = priv->children;
+  vc = g_object_get_data (G_OBJECT (child), "gtk-text-view-child");
 
-  while (iter != NULL)
-    {
-      vc = iter->data;
+  g_assert (vc != NULL); /* be sure we had the child */
 
-      if (vc->widget == child)
-        break;
+  if (vc->anchor)
+    {
+      g_sequence_remove (vc->seq_iter);
+      vc->seq_iter = NULL;
 
-      iter = g_slist_next (iter);
+      if (vc->onscreen)
+        priv->onscreen_children = g_slist_remove (priv->onscreen_children, vc);
     }
-
-  g_assert (iter != NULL); /* be sure we had the child in the list */
-
-  priv->children = g_slist_remove (priv->children, vc);
+  else
+    priv->children = g_slist_remove (priv->children, vc);
 
   gtk_widget_unparent (vc->widget);
 
@@ -5387,6 +5937,7 @@ gtk_text_view_forall (GtkContainer *container,
   GSList *iter;
   GtkTextView *text_view;
   GSList *copy;
+  GSequenceIter *seq_iter;
 
   g_return_if_fail (GTK_IS_TEXT_VIEW (container));
   g_return_if_fail (callback != NULL);
@@ -5394,6 +5945,14 @@ gtk_text_view_forall (GtkContainer *container,
   text_view = GTK_TEXT_VIEW (container);
 
   copy = g_slist_copy (text_view->priv->children);
+
+  seq_iter = g_sequence_get_begin_iter (text_view->priv->anchored_children);
+  while (!g_sequence_iter_is_end (seq_iter))
+    {
+      copy = g_slist_prepend (copy, g_sequence_get (seq_iter));
+      seq_iter = g_sequence_iter_next (seq_iter);
+    }
+
   iter = copy;
 
   while (iter != NULL)
@@ -7036,7 +7595,7 @@ gtk_text_view_ensure_layout (GtkTextView *text_view)
     {
       GtkTextAttributes *style;
       PangoContext *ltr_context, *rtl_context;
-      GSList *tmp_list;
+      GSequenceIter *seq_iter;
 
       DV(g_print(G_STRLOC"\n"));
       
@@ -7102,19 +7661,14 @@ gtk_text_view_ensure_layout (GtkTextView *text_view)
 
       /* Set layout for all anchored children */
 
-      tmp_list = priv->children;
-      while (tmp_list != NULL)
+      seq_iter = g_sequence_get_begin_iter (priv->anchored_children);
+      while (!g_sequence_iter_is_end (seq_iter))
         {
-          GtkTextViewChild *vc = tmp_list->data;
+          GtkTextViewChild *vc = g_sequence_get (seq_iter);
 
-          if (vc->anchor)
-            {
-              gtk_text_anchored_child_set_layout (vc->widget,
-                                                  priv->layout);
-              /* vc may now be invalid! */
-            }
+          gtk_text_anchored_child_set_layout (vc->widget, priv->layout);
 
-          tmp_list = g_slist_next (tmp_list);
+          seq_iter = g_sequence_iter_next (seq_iter);
         }
     }
 }
@@ -7151,7 +7705,7 @@ gtk_text_view_destroy_layout (GtkTextView *text_view)
 
   if (priv->layout)
     {
-      GSList *tmp_list;
+      GSequenceIter *seq_iter;
 
       gtk_text_view_remove_validate_idles (text_view);
 
@@ -7163,18 +7717,14 @@ gtk_text_view_destroy_layout (GtkTextView *text_view)
 					    text_view);
 
       /* Remove layout from all anchored children */
-      tmp_list = priv->children;
-      while (tmp_list != NULL)
+      seq_iter = g_sequence_get_begin_iter (priv->anchored_children);
+      while (!g_sequence_iter_is_end (seq_iter))
         {
-          GtkTextViewChild *vc = tmp_list->data;
+          GtkTextViewChild *vc = g_sequence_get (seq_iter);
 
-          if (vc->anchor)
-            {
-              gtk_text_anchored_child_set_layout (vc->widget, NULL);
-              /* vc may now be invalid! */
-            }
+          gtk_text_anchored_child_set_layout (vc->widget, NULL);
 
-          tmp_list = g_slist_next (tmp_list);
+          seq_iter = g_sequence_iter_next (seq_iter);
         }
 
       gtk_text_view_stop_cursor_blink (text_view);
@@ -7990,6 +8540,8 @@ gtk_text_view_value_changed (GtkAdjustment *adjustment,
 	{
 	  if (gtk_widget_get_realized (GTK_WIDGET (text_view)))
 	    gdk_window_invalidate_rect (priv->text_window->bin_window, NULL, FALSE);
+
+	  _gtk_pixel_cache_invalidate (priv->pixel_cache, NULL);
 	  
 	  priv->width_changed = FALSE;
 	}
@@ -8011,8 +8563,6 @@ gtk_text_view_value_changed (GtkAdjustment *adjustment,
   
   if (dx != 0 || dy != 0)
     {
-      GSList *tmp_list;
-
       if (gtk_widget_get_realized (GTK_WIDGET (text_view)))
         {
           if (dy != 0)
@@ -8040,18 +8590,10 @@ gtk_text_view_value_changed (GtkAdjustment *adjustment,
         }
       
       /* Children are now "moved" in the text window, poke
-       * into widget->allocation for each child
+       * into widget->allocation for the ones that are near the
+       * visible area.
        */
-      tmp_list = priv->children;
-      while (tmp_list != NULL)
-        {
-          GtkTextViewChild *child = tmp_list->data;
-          
-          if (child->anchor)
-            adjust_allocation (child->widget, dx, dy);
-          
-          tmp_list = g_slist_next (tmp_list);
-        }
+      gtk_text_view_update_visible_children (text_view);
     }
 
   /* This could result in invalidation, which would install the
@@ -8945,6 +9487,9 @@ text_window_realize (GtkTextWindow *win,
       gtk_im_context_set_client_window (GTK_TEXT_VIEW (widget)->priv->im_context,
                                         win->window);
 
+      gdk_window_set_invalidate_handler (win->bin_window,
+                                         gtk_text_view_text_window_invalidate_handler);
+
       gtk_style_context_save (context);
       gtk_style_context_add_class (context, GTK_STYLE_CLASS_VIEW);
 
@@ -9014,7 +9559,10 @@ text_window_scroll        (GtkTextWindow *win,
     {
       if (priv->selection_bubble)
         _gtk_bubble_window_popdown (GTK_BUBBLE_WINDOW (priv->selection_bubble));
+
+      priv->in_scroll = win->type == GTK_TEXT_WINDOW_TEXT;
       gdk_window_scroll (win->bin_window, dx, dy);
+      priv->in_scroll = FALSE;
     }
 }
 
@@ -9039,6 +9587,17 @@ text_window_invalidate_rect (GtkTextWindow *win,
   switch (win->type)
     {
     case GTK_TEXT_WINDOW_TEXT:
+      {
+        cairo_region_t *region;
+
+        /* The pixel cache is in buffer coordinates too, and may
+         * hold @rect even if it's not inside the window.
+         */
+        region = cairo_region_create_rectangle (rect);
+        _gtk_pixel_cache_invalidate (GTK_TEXT_VIEW (win->widget)->priv->pixel_cache,
+                                     region);
+        cairo_region_destroy (region);
+      }
       break;
 
     case GTK_TEXT_WINDOW_LEFT:
@@ -9754,6 +10313,14 @@ text_view_child_new_anchored (GtkWidget          *child,
 
   vc->from_top_of_line = 0;
   vc->from_left_of_buffer = 0;
+
+  vc->seq_iter = NULL;
+  vc->alloc_xoffset = 0;
+  vc->alloc_yoffset = 0;
+  vc->layout_stamp = 0;
+  vc->requisition.width = -1;
+  vc->requisition.height = -1;
+  vc->onscreen = FALSE;
   
   g_object_ref (vc->widget);
   g_object_ref (vc->anchor);
@@ -9782,6 +10349,9 @@ text_view_child_new_window (GtkWidget          *child,
 
   vc->from_top_of_line = 0;
   vc->from_left_of_buffer = 0;
+
+  vc->seq_iter = NULL;
+  vc->onscreen = FALSE;
  
   g_object_ref (vc->widget);
 
@@ -9834,8 +10404,27 @@ static void
 add_child (GtkTextView      *text_view,
            GtkTextViewChild *vc)
 {
-  text_view->priv->children = g_slist_prepend (text_view->priv->children,
-                                               vc);
+  GtkTextViewPrivate *priv = text_view->priv;
+
+  if (vc->anchor)
+    {
+      GSequenceIter *before;
+      gint offset;
+
+      /* Keep children sharing an anchor in the order they were added */
+      offset = text_view_child_get_offset (text_view, vc);
+      before = gtk_text_view_search_anchored_child (text_view, offset + 1);
+
+      vc->seq_iter = g_sequence_insert_before (before, vc);
+      vc->layout_stamp = priv->children_layout_stamp - 1;
+
+      /* Stays unmapped until gtk_text_view_update_visible_children()
+       * finds it near the visible area.
+       */
+      gtk_widget_set_child_visible (vc->widget, FALSE);
+    }
+  else
+    priv->children = g_slist_prepend (priv->children, vc);
 
   if (gtk_widget_get_realized (GTK_WIDGET (text_view)))
     text_view_child_set_parent_window (text_view, vc);
@@ -7546,8 +7546,15 @@ static void
 gtk_widget_real_style_updated (GtkWidget *widget)
 {
   GtkWidgetPrivate *priv = widget->priv;
+  const GtkBitmask *changes = NULL;
 
-  gtk_widget_update_pango_context (widget);
+  if (priv->context)
+    changes = _gtk_style_context_get_changes (priv->context);
+
+  /* Transitions of colors, shadows or opacity happen every frame,
+   * don't reset the font every time for them. */
+  if (changes == NULL || _gtk_css_style_property_changes_affect_font (changes))
+    gtk_widget_update_pango_context (widget);
   gtk_widget_update_alpha (widget);
 
   G_GNUC_BEGIN_IGNORE_DEPRECATIONS;
@@ -7566,8 +7573,6 @@ gtk_widget_real_style_updated (GtkWidget *widget)
 
   if (widget->priv->context)
     {
-      const GtkBitmask *changes = _gtk_style_context_get_changes (widget->priv->context);
-
       if (gtk_widget_get_realized (widget) &&
           gtk_widget_get_has_window (widget) &&
           !gtk_widget_get_app_paintable (widget))
@@ -20,7 +20,7 @@
 #include <string.h>
 
 #include "gtkwidget.h"
-#include "gtkwidgetpath.h"
+#include "gtkwidgetpathprivate.h"
 #include "gtkstylecontextprivate.h"
 
 /**
@@ -85,6 +85,11 @@ G_DEFINE_BOXED_TYPE (GtkWidgetPath, gtk_widget_path,
 
 typedef struct GtkPathElement GtkPathElement;
 
+/* Copies of a path share the regions and classes of their elements
+ * until either of them gets modified, so copying paths (which happens
+ * a lot when computing widget paths and saving style contexts) only
+ * copies the element array itself.
+ */
 struct GtkPathElement
 {
   GType type;
@@ -93,6 +98,11 @@ struct GtkPathElement
   GArray *classes;
   GtkWidgetPath *siblings;
   guint sibling_index;
+
+  /* Number of elements using regions and classes, shared between them.
+   * Set once the element was written to, so copying never needs to
+   * touch the source element. */
+  volatile gint *users;
 };
 
 struct _GtkWidgetPath
@@ -100,6 +110,7 @@ struct _GtkWidgetPath
   volatile guint ref_count;
 
   GArray *elems; /* First element contains the described widget */
+  guint hash;    /* cached value for _gtk_widget_path_hash() or 0 */
 };
 
 /**
@@ -136,22 +147,79 @@ gtk_path_element_copy (GtkPathElement       *dest,
   dest->sibling_index = src->sibling_index;
 
   if (src->regions)
+    dest->regions = g_hash_table_ref (src->regions);
+
+  if (src->classes)
+    dest->classes = g_array_ref (src->classes);
+
+  dest->users = src->users;
+  if (dest->users)
+    g_atomic_int_inc (dest->users);
+}
+
+static void
+gtk_path_element_release_users (GtkPathElement *elem)
+{
+  if (elem->users && g_atomic_int_dec_and_test (elem->users))
+    g_slice_free (gint, (gint *) elem->users);
+
+  elem->users = NULL;
+}
+
+static void
+gtk_path_element_unshare (GtkPathElement *elem)
+{
+  if (elem->users == NULL ||
+      g_atomic_int_get (elem->users) == 1)
+    return;
+
+  if (elem->regions)
     {
+      GHashTable *regions = elem->regions;
       GHashTableIter iter;
       gpointer key, value;
 
-      g_hash_table_iter_init (&iter, src->regions);
-      dest->regions = g_hash_table_new (NULL, NULL);
+      elem->regions = g_hash_table_new (NULL, NULL);
 
+      g_hash_table_iter_init (&iter, regions);
       while (g_hash_table_iter_next (&iter, &key, &value))
-        g_hash_table_insert (dest->regions, key, value);
+        g_hash_table_insert (elem->regions, key, value);
+
+      g_hash_table_unref (regions);
     }
 
-  if (src->classes)
+  if (elem->classes)
     {
-      dest->classes = g_array_new (FALSE, FALSE, sizeof (GQuark));
-      g_array_append_vals (dest->classes, src->classes->data, src->classes->len);
+      GArray *classes = elem->classes;
+
+      elem->classes = g_array_new (FALSE, FALSE, sizeof (GQuark));
+      g_array_append_vals (elem->classes, classes->data, classes->len);
+
+      g_array_unref (classes);
     }
+
+  gtk_path_element_release_users (elem);
+}
+
+/* Returns the element at @pos for modification */
+static GtkPathElement *
+gtk_widget_path_get_elem_for_write (GtkWidgetPath *path,
+                                    gint           pos)
+{
+  GtkPathElement *elem;
+
+  path->hash = 0;
+
+  elem = &g_array_index (path->elems, GtkPathElement, pos);
+  gtk_path_element_unshare (elem);
+
+  if (elem->users == NULL)
+    {
+      elem->users = g_slice_new (gint);
+      *elem->users = 1;
+    }
+
+  return elem;
 }
 
 /**
@@ -186,6 +254,8 @@ gtk_widget_path_copy (const GtkWidgetPath *path)
       gtk_path_element_copy (dest, elem);
     }
 
+  new_path->hash = path->hash;
+
   return new_path;
 }
 
@@ -235,13 +305,15 @@ gtk_widget_path_unref (GtkWidgetPath *path)
       elem = &g_array_index (path->elems, GtkPathElement, i);
 
       if (elem->regions)
-        g_hash_table_destroy (elem->regions);
+        g_hash_table_unref (elem->regions);
 
       if (elem->classes)
-        g_array_free (elem->classes, TRUE);
+        g_array_unref (elem->classes);
 
       if (elem->siblings)
         gtk_widget_path_unref (elem->siblings);
+
+      gtk_path_element_release_users (elem);
     }
 
   g_array_free (path->elems, TRUE);
@@ -284,6 +356,147 @@ gtk_widget_path_length (const GtkWidgetPath *path)
   return path->elems->len;
 }
 
+static guint
+gtk_path_element_hash (const GtkPathElement *elem)
+{
+  guint hash, i;
+
+  hash = g_direct_hash (GSIZE_TO_POINTER (elem->type)) ^ elem->name;
+
+  if (elem->classes)
+    {
+      for (i = 0; i < elem->classes->len; i++)
+        hash = (hash << 5) - hash + g_array_index (elem->classes, GQuark, i);
+    }
+
+  if (elem->regions)
+    {
+      GHashTableIter iter;
+      gpointer key, value;
+
+      /* regions are unordered, so combine them in an order-independent way */
+      g_hash_table_iter_init (&iter, elem->regions);
+      while (g_hash_table_iter_next (&iter, &key, &value))
+        hash ^= (GPOINTER_TO_UINT (key) << 8) + GPOINTER_TO_UINT (value);
+    }
+
+  if (elem->siblings)
+    hash ^= (_gtk_widget_path_hash (elem->siblings) << 3) + elem->sibling_index;
+
+  return hash;
+}
+
+static gboolean
+gtk_path_element_equal (const GtkPathElement *elem1,
+                        const GtkPathElement *elem2)
+{
+  guint n_classes1, n_classes2, n_regions1, n_regions2;
+
+  if (elem1->type != elem2->type ||
+      elem1->name != elem2->name ||
+      elem1->sibling_index != elem2->sibling_index)
+    return FALSE;
+
+  /* classes are kept sorted */
+  n_classes1 = elem1->classes ? elem1->classes->len : 0;
+  n_classes2 = elem2->classes ? elem2->classes->len : 0;
+  if (n_classes1 != n_classes2)
+    return FALSE;
+  if (n_classes1 > 0 &&
+      memcmp (elem1->classes->data, elem2->classes->data, sizeof (GQuark) * n_classes1) != 0)
+    return FALSE;
+
+  n_regions1 = elem1->regions ? g_hash_table_size (elem1->regions) : 0;
+  n_regions2 = elem2->regions ? g_hash_table_size (elem2->regions) : 0;
+  if (n_regions1 != n_regions2)
+    return FALSE;
+  if (n_regions1 > 0)
+    {
+      GHashTableIter iter;
+      gpointer key, value, value2;
+
+      g_hash_table_iter_init (&iter, elem1->regions);
+      while (g_hash_table_iter_next (&iter, &key, &value))
+        {
+          if (!g_hash_table_lookup_extended (elem2->regions, key, NULL, &value2) ||
+              value != value2)
+            return FALSE;
+        }
+    }
+
+  if (elem1->siblings == elem2->siblings)
+    return TRUE;
+  if (elem1->siblings == NULL || elem2->siblings == NULL)
+    return FALSE;
+
+  return _gtk_widget_path_equal (elem1->siblings, elem2->siblings);
+}
+
+/*
+ * _gtk_widget_path_hash:
+ * @path: a #GtkWidgetPath
+ *
+ * Computes a hash value for @path that is consistent with
+ * _gtk_widget_path_equal(), so paths can be used as hash table keys.
+ * The value is cached until @path is modified.
+ *
+ * Returns: the hash value
+ */
+guint
+_gtk_widget_path_hash (const GtkWidgetPath *path)
+{
+  guint hash, i;
+
+  if (path->hash != 0)
+    return path->hash;
+
+  hash = path->elems->len;
+
+  for (i = 0; i < path->elems->len; i++)
+    hash = (hash << 5) - hash + gtk_path_element_hash (&g_array_index (path->elems, GtkPathElement, i));
+
+  /* 0 means not computed yet */
+  if (hash == 0)
+    hash = 1;
+
+  ((GtkWidgetPath *) path)->hash = hash;
+
+  return hash;
+}
+
+/*
+ * _gtk_widget_path_equal:
+ * @path1: a #GtkWidgetPath
+ * @path2: a #GtkWidgetPath
+ *
+ * Checks if two paths describe the same widget hierarchy, so that they
+ * are guaranteed to match the same CSS selectors.
+ *
+ * Returns: %TRUE if @path1 and @path2 are equal
+ */
+gboolean
+_gtk_widget_path_equal (const GtkWidgetPath *path1,
+                        const GtkWidgetPath *path2)
+{
+  guint i;
+
+  if (path1 == path2)
+    return TRUE;
+
+  if (path1->elems->len != path2->elems->len ||
+      _gtk_widget_path_hash (path1) != _gtk_widget_path_hash (path2))
+    return FALSE;
+
+  for (i = 0; i < path1->elems->len; i++)
+    {
+      if (!gtk_path_element_equal (&g_array_index (path1->elems, GtkPathElement, i),
+                                   &g_array_index (path2->elems, GtkPathElement, i)))
+        return FALSE;
+    }
+
+  return TRUE;
+}
+
 /**
  * gtk_widget_path_to_string:
  * @path: the path
@@ -396,6 +609,7 @@ gtk_widget_path_prepend_type (GtkWidgetPath *path,
 
   new.type = type;
   g_array_prepend_val (path->elems, new);
+  path->hash = 0;
 }
 
 /**
@@ -419,6 +633,7 @@ gtk_widget_path_append_type (GtkWidgetPath *path,
 
   new.type = type;
   g_array_append_val (path->elems, new);
+  path->hash = 0;
 
   return path->elems->len - 1;
 }
@@ -459,6 +674,7 @@ gtk_widget_path_append_with_siblings (GtkWidgetPath *path,
   new.siblings = gtk_widget_path_ref (siblings);
   new.sibling_index = sibling_index;
   g_array_append_val (path->elems, new);
+  path->hash = 0;
 
   return path->elems->len - 1;
 }
@@ -569,7 +785,7 @@ gtk_widget_path_iter_set_object_type (GtkWidgetPath *path,
   if (pos < 0 || pos >= path->elems->len)
     pos = path->elems->len - 1;
 
-  elem = &g_array_index (path->elems, GtkPathElement, pos);
+  elem = gtk_widget_path_get_elem_for_write (path, pos);
   elem->type = type;
 }
 
@@ -625,7 +841,7 @@ gtk_widget_path_iter_set_name (GtkWidgetPath *path,
   if (pos < 0 || pos >= path->elems->len)
     pos = path->elems->len - 1;
 
-  elem = &g_array_index (path->elems, GtkPathElement, pos);
+  elem = gtk_widget_path_get_elem_for_write (path, pos);
 
   elem->name = g_quark_from_string (name);
 }
@@ -725,7 +941,7 @@ gtk_widget_path_iter_add_class (GtkWidgetPath *path,
   if (pos < 0 || pos >= path->elems->len)
     pos = path->elems->len - 1;
 
-  elem = &g_array_index (path->elems, GtkPathElement, pos);
+  elem = gtk_widget_path_get_elem_for_write (path, pos);
   qname = g_quark_from_string (name);
 
   if (!elem->classes)
@@ -787,7 +1003,7 @@ gtk_widget_path_iter_remove_class (GtkWidgetPath *path,
   if (qname == 0)
     return;
 
-  elem = &g_array_index (path->elems, GtkPathElement, pos);
+  elem = gtk_widget_path_get_elem_for_write (path, pos);
 
   if (!elem->classes)
     return;
@@ -830,7 +1046,7 @@ gtk_widget_path_iter_clear_classes (GtkWidgetPath *path,
   if (pos < 0 || pos >= path->elems->len)
     pos = path->elems->len - 1;
 
-  elem = &g_array_index (path->elems, GtkPathElement, pos);
+  elem = gtk_widget_path_get_elem_for_write (path, pos);
 
   if (!elem->classes)
     return;
@@ -1000,7 +1216,7 @@ gtk_widget_path_iter_add_region (GtkWidgetPath  *path,
   if (pos < 0 || pos >= path->elems->len)
     pos = path->elems->len - 1;
 
-  elem = &g_array_index (path->elems, GtkPathElement, pos);
+  elem = gtk_widget_path_get_elem_for_write (path, pos);
   qname = g_quark_from_string (name);
 
   if (!elem->regions)
@@ -1042,7 +1258,7 @@ gtk_widget_path_iter_remove_region (GtkWidgetPath *path,
   if (qname == 0)
     return;
 
-  elem = &g_array_index (path->elems, GtkPathElement, pos);
+  elem = gtk_widget_path_get_elem_for_write (path, pos);
 
   if (elem->regions)
     g_hash_table_remove (elem->regions, GUINT_TO_POINTER (qname));
@@ -1070,7 +1286,7 @@ gtk_widget_path_iter_clear_regions (GtkWidgetPath *path,
   if (pos < 0 || pos >= path->elems->len)
     pos = path->elems->len - 1;
 
-  elem = &g_array_index (path->elems, GtkPathElement, pos);
+  elem = gtk_widget_path_get_elem_for_write (path, pos);
 
   if (elem->regions)
     g_hash_table_remove_all (elem->regions);
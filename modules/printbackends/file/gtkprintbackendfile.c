@@ -47,6 +47,9 @@ typedef struct _GtkPrintBackendFileClass GtkPrintBackendFileClass;
 
 #define _STREAM_MAX_CHUNK_SIZE 8192
 
+/* Granularity of GtkPrintJob:bytes-written updates */
+#define _STREAM_PROGRESS_STEP (64 * 1024)
+
 static GType print_backend_file_type = 0;
 
 struct _GtkPrintBackendFileClass
@@ -329,6 +332,216 @@ _cairo_write (void                *closure,
 }
 
 
+/* When possible, the print data is written directly to a
+ * hidden file next to the target while the pages are rendered,
+ * instead of being spooled to a temporary file and copied when
+ * the job is sent. Sending the job moves it over the target, and
+ * aborting it deletes it. This keeps finished pages out of the
+ * spool and lets GtkPrintJob:bytes-written report progress as
+ * pages are written.
+ */
+typedef struct {
+  GFile *file;
+  GFile *temp_file;
+  GOutputStream *target_io_stream;
+  GtkPrintJob *job;
+  guint64 bytes_written;
+  guint64 bytes_reported;
+  GError *error;
+  gboolean closed;
+} _OutputStreamData;
+
+static cairo_user_data_key_t output_stream_key;
+static GQuark print_job_quark = 0;
+static GQuark output_stream_quark = 0;
+
+static void
+output_stream_report_progress (_OutputStreamData *os)
+{
+  if (os->job == NULL || os->bytes_reported == os->bytes_written)
+    return;
+
+  os->bytes_reported = os->bytes_written;
+  gtk_print_job_set_bytes_written (os->job, os->bytes_written);
+}
+
+static gboolean
+output_stream_close (_OutputStreamData *os,
+                     gboolean           aborted)
+{
+  if (os->closed)
+    return os->error == NULL;
+
+  os->closed = TRUE;
+
+  g_output_stream_close (os->target_io_stream, NULL,
+                         aborted || os->error ? NULL : &os->error);
+
+  if (!aborted && os->error == NULL)
+    g_file_move (os->temp_file, os->file, G_FILE_COPY_OVERWRITE,
+                 NULL, NULL, NULL, &os->error);
+
+  /* Don't leave partial output behind */
+  if (aborted || os->error != NULL)
+    g_file_delete (os->temp_file, NULL, NULL);
+
+  if (!aborted)
+    output_stream_report_progress (os);
+
+  return os->error == NULL;
+}
+
+static void
+output_stream_data_free (gpointer data)
+{
+  _OutputStreamData *os = data;
+
+  /* The job was not sent, e.g. because it was cancelled */
+  output_stream_close (os, TRUE);
+
+  if (os->job)
+    {
+      g_object_set_qdata (G_OBJECT (os->job), output_stream_quark, NULL);
+      g_object_remove_weak_pointer (G_OBJECT (os->job), (gpointer *) &os->job);
+    }
+
+  g_object_unref (os->target_io_stream);
+  g_object_unref (os->temp_file);
+  g_object_unref (os->file);
+  g_clear_error (&os->error);
+  g_free (os);
+}
+
+static cairo_status_t
+_cairo_write_stream (void                *closure,
+                     const unsigned char *data,
+                     unsigned int         length)
+{
+  _OutputStreamData *os = closure;
+  gsize written = 0;
+
+  if (os->error != NULL)
+    return CAIRO_STATUS_WRITE_ERROR;
+
+  if (!g_output_stream_write_all (os->target_io_stream,
+                                  data, length, &written,
+                                  NULL, &os->error))
+    {
+      GTK_NOTE (PRINTING,
+                g_print ("FILE Backend: Error writing to target file, %s\n", os->error->message));
+
+      return CAIRO_STATUS_WRITE_ERROR;
+    }
+
+  os->bytes_written += written;
+
+  if (os->bytes_written - os->bytes_reported >= _STREAM_PROGRESS_STEP)
+    output_stream_report_progress (os);
+
+  return CAIRO_STATUS_SUCCESS;
+}
+
+/* Creates a new hidden file in the directory of @file */
+static GFileOutputStream *
+create_temp_file (GFile   *file,
+                  GFile  **temp_file,
+                  GError **error)
+{
+  GFileOutputStream *stream = NULL;
+  GError *local_error = NULL;
+  GFile *parent;
+  gchar *basename, *name;
+  gint i;
+
+  parent = g_file_get_parent (file);
+  if (parent == NULL)
+    {
+      g_set_error_literal (error, G_IO_ERROR, G_IO_ERROR_INVALID_FILENAME,
+                           "Target has no parent directory");
+      return NULL;
+    }
+
+  basename = g_file_get_basename (file);
+
+  for (i = 0; i < 100 && stream == NULL; i++)
+    {
+      name = g_strdup_printf (".%s.%06x", basename, g_random_int_range (0, 0xffffff));
+      *temp_file = g_file_get_child (parent, name);
+      g_free (name);
+
+      stream = g_file_create (*temp_file, G_FILE_CREATE_NONE, NULL, &local_error);
+      if (stream == NULL)
+        {
+          g_clear_object (temp_file);
+
+          if (!g_error_matches (local_error, G_IO_ERROR, G_IO_ERROR_EXISTS))
+            break;
+          g_clear_error (&local_error);
+        }
+    }
+
+  if (stream == NULL)
+    {
+      if (local_error)
+        g_propagate_error (error, local_error);
+      else
+        g_set_error_literal (error, G_IO_ERROR, G_IO_ERROR_EXISTS,
+                             "Can't create a temporary file");
+    }
+
+  g_free (basename);
+  g_object_unref (parent);
+
+  return stream;
+}
+
+static _OutputStreamData *
+output_stream_data_new (GtkPrintSettings *settings)
+{
+  _OutputStreamData *os;
+  GFileOutputStream *target_io_stream;
+  GtkPrintJob *job;
+  GError *error = NULL;
+  GFile *file, *temp_file = NULL;
+  gchar *uri;
+
+  /* Without a job, nobody would finish the stream */
+  job = print_job_quark ? g_object_get_qdata (G_OBJECT (settings), print_job_quark) : NULL;
+  if (job == NULL)
+    return NULL;
+
+  uri = output_file_from_settings (settings, NULL);
+  if (uri == NULL)
+    return NULL;
+
+  file = g_file_new_for_uri (uri);
+  g_free (uri);
+
+  target_io_stream = create_temp_file (file, &temp_file, &error);
+
+  if (target_io_stream == NULL)
+    {
+      /* Spool instead; the error is reported when sending the job */
+      GTK_NOTE (PRINTING,
+                g_print ("FILE Backend: Can't stream to target file, %s\n", error->message));
+      g_error_free (error);
+      g_object_unref (file);
+
+      return NULL;
+    }
+
+  os = g_new0 (_OutputStreamData, 1);
+  os->file = file;
+  os->temp_file = temp_file;
+  os->target_io_stream = G_OUTPUT_STREAM (target_io_stream);
+
+  os->job = job;
+  g_object_add_weak_pointer (G_OBJECT (os->job), (gpointer *) &os->job);
+  g_object_set_qdata (G_OBJECT (os->job), output_stream_quark, os);
+
+  return os;
+}
+
 static cairo_surface_t *
 file_printer_create_cairo_surface (GtkPrinter       *printer,
 				   GtkPrintSettings *settings,
@@ -340,20 +553,35 @@ file_printer_create_cairo_surface (GtkPrinter       *printer,
   OutputFormat format;
   const cairo_svg_version_t *versions;
   int num_versions = 0;
+  cairo_write_func_t write_func;
+  gpointer closure;
+  _OutputStreamData *os;
 
   format = format_from_settings (settings);
 
+  os = output_stream_data_new (settings);
+  if (os)
+    {
+      write_func = _cairo_write_stream;
+      closure = os;
+    }
+  else
+    {
+      write_func = _cairo_write;
+      closure = cache_io;
+    }
+
   switch (format)
     {
       default:
       case FORMAT_PDF:
-        surface = cairo_pdf_surface_create_for_stream (_cairo_write, cache_io, width, height);
+        surface = cairo_pdf_surface_create_for_stream (write_func, closure, width, height);
         break;
       case FORMAT_PS:
-        surface = cairo_ps_surface_create_for_stream (_cairo_write, cache_io, width, height);
+        surface = cairo_ps_surface_create_for_stream (write_func, closure, width, height);
         break;
       case FORMAT_SVG:
-        surface = cairo_svg_surface_create_for_stream (_cairo_write, cache_io, width, height);
+        surface = cairo_svg_surface_create_for_stream (write_func, closure, width, height);
         cairo_svg_get_versions (&versions, &num_versions);
         if (num_versions > 0)
           cairo_svg_surface_restrict_to_version (surface, versions[num_versions - 1]);
@@ -364,6 +592,11 @@ file_printer_create_cairo_surface (GtkPrinter       *printer,
                                          2.0 * gtk_print_settings_get_printer_lpi (settings),
                                          2.0 * gtk_print_settings_get_printer_lpi (settings));
 
+  if (os &&
+      cairo_surface_set_user_data (surface, &output_stream_key,
+                                   os, output_stream_data_free) != CAIRO_STATUS_SUCCESS)
+    output_stream_data_free (os);
+
   return surface;
 }
 
@@ -444,6 +677,9 @@ file_write (GIOChannel   *source,
                                  &bytes_written,
                                  NULL,
                                  &error);
+
+      gtk_print_job_set_bytes_written (ps->job,
+                                       gtk_print_job_get_bytes_written (ps->job) + bytes_written);
     }
 
   if (error != NULL || read_status == G_IO_STATUS_EOF)
@@ -480,6 +716,7 @@ gtk_print_backend_file_print_stream (GtkPrintBackend        *print_backend,
   GtkPrintSettings *settings;
   gchar *uri;
   GFile *file = NULL;
+  _OutputStreamData *os;
 
   settings = gtk_print_job_get_settings (job);
 
@@ -490,6 +727,19 @@ gtk_print_backend_file_print_stream (GtkPrintBackend        *print_backend,
   ps->job = g_object_ref (job);
   ps->backend = print_backend;
 
+  os = output_stream_quark ? g_object_get_qdata (G_OBJECT (job), output_stream_quark) : NULL;
+
+  if (os != NULL)
+    {
+      /* The data has already been streamed to the target file */
+      if (output_stream_close (os, FALSE))
+        file_print_cb_locked (GTK_PRINT_BACKEND_FILE (print_backend), NULL, ps);
+      else
+        file_print_cb_locked (GTK_PRINT_BACKEND_FILE (print_backend), os->error, ps);
+
+      return;
+    }
+
   internal_error = NULL;
   uri = output_file_from_settings (settings, NULL);
 
@@ -815,6 +1065,14 @@ file_printer_prepare_for_print (GtkPrinter       *printer,
 
   gtk_print_job_set_page_set (print_job, gtk_print_settings_get_page_set (settings));
 
+  /* Lets file_printer_create_cairo_surface() report progress on the job */
+  if (print_job_quark == 0)
+    {
+      print_job_quark = g_quark_from_static_string ("gtk-print-backend-file-job");
+      output_stream_quark = g_quark_from_static_string ("gtk-print-backend-file-output-stream");
+    }
+  g_object_set_qdata (G_OBJECT (settings), print_job_quark, print_job);
+
   format = format_from_settings (settings);
   switch (format)
     {
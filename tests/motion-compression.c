@@ -1,8 +1,26 @@
 #include <gtk/gtk.h>
 #include <math.h>
 
+#define MAX_TRAIL 200
+
+typedef struct {
+  double x, y;
+} TrailPoint;
+
 GtkAdjustment *adjustment;
 int cursor_x, cursor_y;
+GArray *trail;
+
+static void
+add_trail_point (double x,
+                 double y)
+{
+  TrailPoint point = { x, y };
+
+  g_array_append_val (trail, point);
+  if (trail->len > MAX_TRAIL)
+    g_array_remove_range (trail, 0, trail->len - MAX_TRAIL);
+}
 
 static void
 on_motion_notify (GtkWidget      *window,
@@ -11,7 +29,28 @@ on_motion_notify (GtkWidget      *window,
   if (event->window == gtk_widget_get_window (window))
     {
       float processing_ms = gtk_adjustment_get_value (adjustment);
+      GdkTimeCoord **history;
+      gint i, n_history;
+
       g_usleep (processing_ms * 1000);
+
+      /* Positions of the motion events that were compressed away */
+      if (gdk_event_get_motion_history ((GdkEvent *) event, &history, &n_history))
+        {
+          for (i = 0; i < n_history; i++)
+            {
+              gdouble x, y;
+
+              if (gdk_device_get_axis (event->device, history[i]->axes, GDK_AXIS_X, &x) &&
+                  gdk_device_get_axis (event->device, history[i]->axes, GDK_AXIS_Y, &y))
+                add_trail_point (x, y);
+            }
+
+          gdk_device_free_history (history, n_history);
+        }
+
+      add_trail_point (event->x, event->y);
+
       cursor_x = event->x;
       cursor_y = event->y;
       gtk_widget_queue_draw (window);
@@ -27,6 +66,19 @@ on_draw (GtkWidget *window,
 
   cairo_set_source_rgb (cr, 0, 0.5, 0.5);
 
+  if (trail->len > 0)
+    {
+      guint i;
+
+      /* One dot per received position, including the history */
+      for (i = 0; i < trail->len; i++)
+        {
+          TrailPoint *point = &g_array_index (trail, TrailPoint, i);
+          cairo_rectangle (cr, point->x - 1, point->y - 1, 2, 2);
+        }
+      cairo_fill (cr);
+    }
+
   cairo_arc (cr, cursor_x, cursor_y, 10, 0, 2 * M_PI);
   cairo_stroke (cr);
 }
@@ -41,6 +93,8 @@ main (int argc, char **argv)
 
   gtk_init (&argc, &argv);
 
+  trail = g_array_new (FALSE, FALSE, sizeof (TrailPoint));
+
   window = gtk_window_new (GTK_WINDOW_TOPLEVEL);
   gtk_window_set_default_size (GTK_WINDOW (window), 300, 300);
   gtk_widget_set_app_paintable (window, TRUE);
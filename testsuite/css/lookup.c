@@ -0,0 +1,142 @@
+/*
+ * Copyright (C) 2014 Red Hat Inc.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <gtk/gtk.h>
+
+static const char *css =
+  "* { color: blue; }\n"
+  ".one { margin: 3px; }\n"
+  ".two { background-color: red; border-style: solid; border-width: 2px; }\n";
+
+static GtkStyleContext *
+create_context (GtkCssProvider *provider,
+                const char     *style_class)
+{
+  GtkStyleContext *context;
+  GtkWidgetPath *path;
+
+  path = gtk_widget_path_new ();
+  gtk_widget_path_append_type (path, GTK_TYPE_WINDOW);
+  gtk_widget_path_append_type (path, GTK_TYPE_BUTTON);
+  gtk_widget_path_iter_add_class (path, -1, style_class);
+
+  context = gtk_style_context_new ();
+  gtk_style_context_set_path (context, path);
+  gtk_style_context_add_provider (context,
+                                  GTK_STYLE_PROVIDER (provider),
+                                  GTK_STYLE_PROVIDER_PRIORITY_APPLICATION);
+
+  gtk_widget_path_free (path);
+
+  return context;
+}
+
+static void
+check_context (GtkStyleContext *context,
+               gboolean         first)
+{
+  GdkRGBA color, background, border_color;
+  GtkBorder margin, border;
+
+  gtk_style_context_get_color (context, 0, &color);
+  gtk_style_context_get_background_color (context, 0, &background);
+  gtk_style_context_get_border_color (context, 0, &border_color);
+  gtk_style_context_get_margin (context, 0, &margin);
+  gtk_style_context_get_border (context, 0, &border);
+
+  g_assert_cmpfloat (color.blue, ==, 1.0);
+  /* border-color is currentColor unless set */
+  g_assert (gdk_rgba_equal (&color, &border_color));
+
+  if (first)
+    {
+      g_assert_cmpint (margin.top, ==, 3);
+      g_assert_cmpfloat (background.alpha, ==, 0.0);
+      g_assert_cmpint (border.top, ==, 0);
+    }
+  else
+    {
+      g_assert_cmpint (margin.top, ==, 0);
+      g_assert_cmpfloat (background.red, ==, 1.0);
+      g_assert_cmpint (border.top, ==, 2);
+    }
+}
+
+static void
+test_initial_values (void)
+{
+  GtkCssProvider *provider;
+  GtkStyleContext *one, *two;
+
+  provider = gtk_css_provider_new ();
+  gtk_css_provider_load_from_data (provider, css, -1, NULL);
+
+  one = create_context (provider, "one");
+  two = create_context (provider, "two");
+
+  /* Values not set by any rule must stay independent between contexts */
+  check_context (one, TRUE);
+  check_context (two, FALSE);
+  check_context (one, TRUE);
+
+  g_object_unref (one);
+  g_object_unref (two);
+  g_object_unref (provider);
+}
+
+static void
+test_performance (void)
+{
+  guint n = g_test_perf () ? 100000 : 100;
+  GtkCssProvider *provider;
+  GtkStyleContext *context;
+  GtkBorder margin;
+  double elapsed;
+  guint i;
+
+  provider = gtk_css_provider_new ();
+  gtk_css_provider_load_from_data (provider, css, -1, NULL);
+  context = create_context (provider, "one");
+
+  g_test_timer_start ();
+
+  for (i = 0; i < n; i++)
+    {
+      gtk_style_context_invalidate (context);
+      gtk_style_context_get_margin (context, 0, &margin);
+    }
+
+  elapsed = g_test_timer_elapsed ();
+  if (g_test_perf ())
+    g_test_minimized_result (elapsed, "computing %u styles: %gsec", n, elapsed);
+
+  g_assert_cmpint (margin.top, ==, 3);
+
+  g_object_unref (context);
+  g_object_unref (provider);
+}
+
+int
+main (int argc, char *argv[])
+{
+  gtk_test_init (&argc, &argv, NULL);
+
+  g_test_add_func ("/css/lookup/initial-values", test_initial_values);
+  g_test_add_func ("/css/lookup/performance", test_performance);
+
+  return g_test_run ();
+}
@@ -0,0 +1,206 @@
+/*
+ * Copyright (C) 2014 Red Hat Inc.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <gtk/gtk.h>
+#include "../../gtk/gtkcssproviderprivate.h"
+
+/* More paths than the provider keeps matches for */
+#define N_PATHS 600
+
+static GtkStyleContext *
+create_context (GtkCssProvider *provider,
+                guint           n)
+{
+  GtkStyleContext *context;
+  GtkWidgetPath *path;
+  gchar *name;
+
+  path = gtk_widget_path_new ();
+  gtk_widget_path_append_type (path, GTK_TYPE_WINDOW);
+  gtk_widget_path_append_type (path, GTK_TYPE_BOX);
+  gtk_widget_path_append_type (path, GTK_TYPE_BUTTON);
+
+  name = g_strdup_printf ("c%u", n % 7);
+  gtk_widget_path_iter_add_class (path, -1, name);
+  g_free (name);
+
+  name = g_strdup_printf ("button-%u", n);
+  gtk_widget_path_iter_set_name (path, -1, name);
+  g_free (name);
+
+  if (n % 3 == 0)
+    gtk_widget_path_iter_add_class (path, 1, "c2");
+
+  context = gtk_style_context_new ();
+  gtk_style_context_set_path (context, path);
+  gtk_style_context_add_provider (context,
+                                  GTK_STYLE_PROVIDER (provider),
+                                  GTK_STYLE_PROVIDER_PRIORITY_APPLICATION);
+
+  gtk_widget_path_free (path);
+
+  return context;
+}
+
+static GtkCssProvider *
+create_provider (const gchar *css)
+{
+  GtkCssProvider *provider;
+
+  provider = gtk_css_provider_new ();
+  gtk_css_provider_load_from_data (provider, css, -1, NULL);
+
+  return provider;
+}
+
+static gint
+get_margin (GtkStyleContext *context,
+            GtkStateFlags    state)
+{
+  GtkBorder margin;
+
+  /* Drop the style context's own cache, so the provider is asked */
+  gtk_style_context_invalidate (context);
+  gtk_style_context_get_margin (context, state, &margin);
+
+  return margin.top * 1000 + margin.left;
+}
+
+static const gchar *css =
+  "GtkButton { margin: 1px; }\n"
+  ".c1 { margin-top: 2px; }\n"
+  "GtkBox.c2 GtkButton { margin-left: 3px; }\n"
+  "GtkWindow > GtkBox GtkButton.c3 { margin-top: 4px; }\n"
+  "GtkButton:hover { margin-left: 5px; }\n"
+  "#button-5 { margin: 6px; }\n";
+
+static void
+test_hits (void)
+{
+  GtkCssProvider *provider;
+  GtkStyleContext *context;
+  guint hits, misses, hits_before, misses_before;
+  gint margin;
+  guint i;
+
+  provider = create_provider (css);
+  context = create_context (provider, 5);
+
+  _gtk_css_provider_get_match_cache_stats (provider, &hits_before, &misses_before);
+  margin = get_margin (context, 0);
+  _gtk_css_provider_get_match_cache_stats (provider, &hits, &misses);
+  g_assert_cmpint (misses, >, misses_before);
+  g_assert_cmpint (margin, ==, 6006);
+
+  hits_before = hits;
+  misses_before = misses;
+
+  for (i = 0; i < 10; i++)
+    g_assert_cmpint (get_margin (context, 0), ==, margin);
+
+  _gtk_css_provider_get_match_cache_stats (provider, &hits, &misses);
+  g_assert_cmpint (misses, ==, misses_before);
+  g_assert_cmpint (hits, >=, hits_before + 10);
+
+  /* Another state is another query */
+  g_assert_cmpint (get_margin (context, GTK_STATE_FLAG_PRELIGHT), ==, 6006);
+  _gtk_css_provider_get_match_cache_stats (provider, NULL, &misses);
+  g_assert_cmpint (misses, >, misses_before);
+
+  g_object_unref (context);
+  g_object_unref (provider);
+}
+
+static void
+test_invalidation (void)
+{
+  GtkCssProvider *provider;
+  GtkStyleContext *context;
+  guint misses, misses_before;
+
+  provider = create_provider (css);
+  context = create_context (provider, 1);
+
+  g_assert_cmpint (get_margin (context, 0), ==, 2001);
+  g_assert_cmpint (get_margin (context, 0), ==, 2001);
+
+  /* Loading new data replaces the rulesets the cache points into */
+  _gtk_css_provider_get_match_cache_stats (provider, NULL, &misses_before);
+  gtk_css_provider_load_from_data (provider, ".c1 { margin: 7px; }", -1, NULL);
+  g_assert_cmpint (get_margin (context, 0), ==, 7007);
+  _gtk_css_provider_get_match_cache_stats (provider, NULL, &misses);
+  g_assert_cmpint (misses, >, misses_before);
+
+  gtk_css_provider_load_from_data (provider, "", -1, NULL);
+  g_assert_cmpint (get_margin (context, 0), ==, 0);
+
+  g_object_unref (context);
+  g_object_unref (provider);
+}
+
+static void
+test_uncached (void)
+{
+  static const GtkStateFlags states[] = { 0, GTK_STATE_FLAG_PRELIGHT };
+  GtkCssProvider *provider;
+  GtkStyleContext *contexts[N_PATHS];
+  guint i, j, round;
+
+  provider = create_provider (css);
+
+  for (i = 0; i < N_PATHS; i++)
+    contexts[i] = create_context (provider, i);
+
+  /* Several rounds over more paths than fit into the cache, so the
+   * results come from hits, misses and evicted entries alike. Each
+   * is compared with a fresh provider that never saw the query.
+   */
+  for (round = 0; round < 3; round++)
+    {
+      for (i = 0; i < N_PATHS; i += round + 1)
+        for (j = 0; j < G_N_ELEMENTS (states); j++)
+          {
+            GtkCssProvider *fresh;
+            GtkStyleContext *uncached;
+
+            fresh = create_provider (css);
+            uncached = create_context (fresh, i);
+
+            g_assert_cmpint (get_margin (contexts[i], states[j]), ==,
+                             get_margin (uncached, states[j]));
+
+            g_object_unref (uncached);
+            g_object_unref (fresh);
+          }
+    }
+
+  for (i = 0; i < N_PATHS; i++)
+    g_object_unref (contexts[i]);
+  g_object_unref (provider);
+}
+
+int
+main (int argc, char *argv[])
+{
+  gtk_test_init (&argc, &argv, NULL);
+
+  g_test_add_func ("/css/match-cache/hits", test_hits);
+  g_test_add_func ("/css/match-cache/invalidation", test_invalidation);
+  g_test_add_func ("/css/match-cache/uncached", test_uncached);
+
+  return g_test_run ();
+}
@@ -0,0 +1,158 @@
+#include <gdk/gdk.h>
+
+#include "../../gdk/gdkeventqueueprivate.h"
+
+static void
+test_queue_order (void)
+{
+  GdkDisplay *display;
+  GdkEvent *event;
+  guint i;
+
+  display = gdk_display_get_default ();
+
+  for (i = 0; i < 10; i++)
+    {
+      event = gdk_event_new (GDK_DELETE);
+      event->any.send_event = i;
+      gdk_display_put_event (display, event);
+      gdk_event_free (event);
+    }
+
+  for (i = 0; i < 10; i++)
+    {
+      event = gdk_display_get_event (display);
+      g_assert (event != NULL);
+      g_assert_cmpint (event->type, ==, GDK_DELETE);
+      g_assert_cmpint (event->any.send_event, ==, i);
+      gdk_event_free (event);
+    }
+
+  g_assert (gdk_display_get_event (display) == NULL);
+}
+
+static void
+check_list (GList       *head,
+            GList       *tail,
+            const gchar *expected)
+{
+  GString *str;
+  GList *l;
+
+  g_assert (head == NULL || head->prev == NULL);
+  g_assert (tail == NULL || tail->next == NULL);
+  g_assert (g_list_last (head) == tail);
+
+  str = g_string_new (NULL);
+  for (l = head; l; l = l->next)
+    g_string_append_c (str, GPOINTER_TO_INT (l->data));
+  g_assert_cmpstr (str->str, ==, expected);
+
+  /* the links back have to agree */
+  g_string_truncate (str, 0);
+  for (l = tail; l; l = l->prev)
+    g_string_prepend_c (str, GPOINTER_TO_INT (l->data));
+  g_assert_cmpstr (str->str, ==, expected);
+
+  g_string_free (str, TRUE);
+}
+
+#define EV(c) GINT_TO_POINTER (c)
+
+static void
+test_queue_insert (void)
+{
+  GList *head = NULL, *tail = NULL;
+  GList *link;
+  const gchar *c;
+
+  for (c = "abc"; *c; c++)
+    _gdk_event_list_append (&head, &tail, EV (*c));
+  check_list (head, tail, "abc");
+
+  /* before the head, the middle and the tail */
+  link = _gdk_event_list_insert_before (&head, &tail, EV ('a'), EV ('1'));
+  g_assert (link == head && link->data == EV ('1'));
+  link = _gdk_event_list_insert_before (&head, &tail, EV ('b'), EV ('2'));
+  g_assert (link->data == EV ('2') && link->next->data == EV ('b'));
+  link = _gdk_event_list_insert_before (&head, &tail, EV ('c'), EV ('3'));
+  g_assert (link->data == EV ('3') && link->next == tail);
+  check_list (head, tail, "1a2b3c");
+
+  /* after the head, the middle and the tail */
+  link = _gdk_event_list_insert_after (&head, &tail, EV ('1'), EV ('4'));
+  g_assert (link->data == EV ('4') && link->prev == head);
+  link = _gdk_event_list_insert_after (&head, &tail, EV ('b'), EV ('5'));
+  g_assert (link->data == EV ('5') && link->prev->data == EV ('b'));
+  link = _gdk_event_list_insert_after (&head, &tail, EV ('c'), EV ('6'));
+  g_assert (link == tail && link->data == EV ('6'));
+  check_list (head, tail, "14a2b53c6");
+
+  /* siblings that aren't queued append */
+  link = _gdk_event_list_insert_before (&head, &tail, EV ('x'), EV ('7'));
+  g_assert (link == tail && link->data == EV ('7'));
+  link = _gdk_event_list_insert_after (&head, &tail, EV ('x'), EV ('8'));
+  g_assert (link == tail && link->data == EV ('8'));
+  check_list (head, tail, "14a2b53c678");
+
+  g_list_free (head);
+
+  /* and into an empty queue */
+  head = tail = NULL;
+  _gdk_event_list_insert_before (&head, &tail, EV ('x'), EV ('a'));
+  _gdk_event_list_insert_after (&head, &tail, EV ('a'), EV ('b'));
+  _gdk_event_list_insert_before (&head, &tail, EV ('a'), EV ('c'));
+  check_list (head, tail, "cab");
+
+  g_list_free (head);
+}
+
+static void
+test_queue_insert_performance (void)
+{
+  GList *head = NULL, *tail = NULL;
+  guint i, n_events;
+  gdouble elapsed;
+
+  if (!g_test_perf ())
+    return;
+
+  n_events = 100000;
+
+  _gdk_event_list_append (&head, &tail, EV (0));
+
+  g_test_timer_start ();
+
+  /* like crossing events synthesized around the event being
+   * processed, which is the last one queued
+   */
+  for (i = 1; i < n_events; i++)
+    {
+      if (i % 2)
+        _gdk_event_list_insert_before (&head, &tail, tail->data, EV (i));
+      else
+        _gdk_event_list_insert_after (&head, &tail, tail->prev->data, EV (i));
+    }
+
+  elapsed = g_test_timer_elapsed ();
+
+  g_assert_cmpuint (g_list_length (head), ==, n_events);
+
+  g_test_minimized_result (elapsed, "%u events inserted next to a queued event: %f s (%.0f events/s)",
+                           n_events, elapsed, n_events / elapsed);
+
+  g_list_free (head);
+}
+
+int
+main (int argc, char *argv[])
+{
+  g_test_init (&argc, &argv, NULL);
+  gdk_init (&argc, &argv);
+
+  g_test_add_func ("/events/queue/order", test_queue_order);
+  g_test_add_func ("/events/queue/insert", test_queue_insert);
+  g_test_add_func ("/events/queue/insert-performance", test_queue_insert_performance);
+
+  return g_test_run ();
+}
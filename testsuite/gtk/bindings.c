@@ -0,0 +1,223 @@
+/* bindings.c - test key binding dispatch
+ * Copyright (C) 2014 Red Hat, Inc.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library. If not, see <http://www.gnu.org/licenses/>.
+ */
+#include <gtk/gtk.h>
+#include "../../gtk/gtkbindingsprivate.h"
+
+typedef GtkLabel TestWidget;
+typedef GtkLabelClass TestWidgetClass;
+
+static GType test_widget_get_type (void);
+
+G_DEFINE_TYPE (TestWidget, test_widget, GTK_TYPE_LABEL)
+
+static gint last_action;
+
+static void
+test_widget_action (TestWidget *widget,
+                    gint        value)
+{
+  last_action = value;
+}
+
+static void
+test_widget_class_init (TestWidgetClass *class)
+{
+  GtkBindingSet *binding_set;
+
+  g_signal_new ("test-action",
+                G_TYPE_FROM_CLASS (class),
+                G_SIGNAL_RUN_LAST | G_SIGNAL_ACTION,
+                0,
+                NULL, NULL,
+                NULL,
+                G_TYPE_NONE, 1,
+                G_TYPE_INT);
+
+  binding_set = gtk_binding_set_by_class (class);
+  gtk_binding_entry_add_signal (binding_set, GDK_KEY_F5, 0,
+                                "test-action", 1,
+                                G_TYPE_INT, 1);
+}
+
+static void
+test_widget_init (TestWidget *widget)
+{
+  g_signal_connect (widget, "test-action", G_CALLBACK (test_widget_action), NULL);
+}
+
+static GtkWidget *
+create_widget (const gchar *name)
+{
+  GtkWidget *widget;
+
+  widget = g_object_new (test_widget_get_type (), NULL);
+  g_object_ref_sink (widget);
+  if (name)
+    gtk_widget_set_name (widget, name);
+
+  return widget;
+}
+
+/* Returns the value the binding for @keyval passed, 0 if there was
+ * none, and -1 if the binding didn't run an action */
+static gint
+activate (GtkWidget *widget,
+          guint      keyval)
+{
+  last_action = -1;
+
+  if (!gtk_bindings_activate (G_OBJECT (widget), keyval, 0))
+    return 0;
+
+  return last_action;
+}
+
+static void
+test_dispatch_hits (void)
+{
+  GtkWidget *widget;
+  guint hits, misses, hits_before, misses_before;
+  guint i;
+
+  widget = create_widget (NULL);
+
+  _gtk_bindings_get_dispatch_stats (&hits_before, &misses_before);
+  g_assert_cmpint (activate (widget, GDK_KEY_F5), ==, 1);
+  _gtk_bindings_get_dispatch_stats (&hits, &misses);
+  g_assert_cmpuint (misses, ==, misses_before + 1);
+
+  for (i = 0; i < 10; i++)
+    g_assert_cmpint (activate (widget, GDK_KEY_F5), ==, 1);
+
+  /* Keys without bindings are remembered as well */
+  g_assert_cmpint (activate (widget, GDK_KEY_F6), ==, 0);
+  g_assert_cmpint (activate (widget, GDK_KEY_F6), ==, 0);
+
+  _gtk_bindings_get_dispatch_stats (&hits, &misses);
+  g_assert_cmpuint (misses, ==, misses_before + 2);
+  g_assert_cmpuint (hits, ==, hits_before + 11);
+
+  /* Keymap changes drop the tables */
+  g_signal_emit_by_name (gdk_keymap_get_for_display (gtk_widget_get_display (widget)),
+                         "keys-changed");
+  g_assert_cmpint (activate (widget, GDK_KEY_F5), ==, 1);
+  _gtk_bindings_get_dispatch_stats (NULL, &misses);
+  g_assert_cmpuint (misses, ==, misses_before + 3);
+
+  g_object_unref (widget);
+}
+
+static void
+test_dispatch_css (void)
+{
+  GtkCssProvider *provider;
+  GtkWidget *widget, *plain;
+
+  provider = gtk_css_provider_new ();
+  gtk_css_provider_load_from_data (provider,
+                                   "@binding-set test-css {\n"
+                                   "  bind \"F5\" { \"test-action\" (2) };\n"
+                                   "}\n"
+                                   "#css-widget { gtk-key-bindings: test-css; }\n",
+                                   -1, NULL);
+  gtk_style_context_add_provider_for_screen (gdk_screen_get_default (),
+                                             GTK_STYLE_PROVIDER (provider),
+                                             GTK_STYLE_PROVIDER_PRIORITY_APPLICATION);
+
+  widget = create_widget ("css-widget");
+  plain = create_widget (NULL);
+
+  /* Bindings from CSS come before those of the class */
+  g_assert_cmpint (activate (widget, GDK_KEY_F5), ==, 2);
+  g_assert_cmpint (activate (plain, GDK_KEY_F5), ==, 1);
+  g_assert_cmpint (activate (widget, GDK_KEY_F5), ==, 2);
+
+  /* New CSS gives new tables */
+  gtk_css_provider_load_from_data (provider,
+                                   "@binding-set test-css2 {\n"
+                                   "  bind \"F5\" { \"test-action\" (3) };\n"
+                                   "}\n"
+                                   "#css-widget { gtk-key-bindings: test-css2; }\n",
+                                   -1, NULL);
+  gtk_widget_reset_style (widget);
+  g_assert_cmpint (activate (widget, GDK_KEY_F5), ==, 3);
+  g_assert_cmpint (activate (plain, GDK_KEY_F5), ==, 1);
+
+  /* Unbinding a key stops the lookup */
+  gtk_css_provider_load_from_data (provider,
+                                   "@binding-set test-css3 {\n"
+                                   "  unbind \"F5\";\n"
+                                   "}\n"
+                                   "#css-widget { gtk-key-bindings: test-css3; }\n",
+                                   -1, NULL);
+  gtk_widget_reset_style (widget);
+  g_assert_cmpint (activate (widget, GDK_KEY_F5), ==, 0);
+  g_assert_cmpint (activate (plain, GDK_KEY_F5), ==, 1);
+
+  gtk_style_context_remove_provider_for_screen (gdk_screen_get_default (),
+                                                GTK_STYLE_PROVIDER (provider));
+  gtk_widget_reset_style (widget);
+  g_assert_cmpint (activate (widget, GDK_KEY_F5), ==, 1);
+
+  g_object_unref (widget);
+  g_object_unref (plain);
+  g_object_unref (provider);
+}
+
+static void
+test_dispatch_entries (void)
+{
+  GtkBindingSet *binding_set;
+  GtkWidget *widget;
+
+  widget = create_widget (NULL);
+  binding_set = gtk_binding_set_by_class (G_OBJECT_GET_CLASS (widget));
+
+  g_assert_cmpint (activate (widget, GDK_KEY_F5), ==, 1);
+  g_assert_cmpint (activate (widget, GDK_KEY_F7), ==, 0);
+
+  /* Changed entries are picked up */
+  gtk_binding_entry_add_signal (binding_set, GDK_KEY_F7, 0,
+                                "test-action", 1,
+                                G_TYPE_INT, 4);
+  g_assert_cmpint (activate (widget, GDK_KEY_F7), ==, 4);
+
+  gtk_binding_entry_remove (binding_set, GDK_KEY_F7, 0);
+  g_assert_cmpint (activate (widget, GDK_KEY_F7), ==, 0);
+
+  gtk_binding_entry_remove (binding_set, GDK_KEY_F5, 0);
+  g_assert_cmpint (activate (widget, GDK_KEY_F5), ==, 0);
+
+  gtk_binding_entry_add_signal (binding_set, GDK_KEY_F5, 0,
+                                "test-action", 1,
+                                G_TYPE_INT, 1);
+  g_assert_cmpint (activate (widget, GDK_KEY_F5), ==, 1);
+
+  g_object_unref (widget);
+}
+
+int
+main (int argc, char *argv[])
+{
+  gtk_test_init (&argc, &argv);
+
+  g_test_add_func ("/bindings/dispatch/hits", test_dispatch_hits);
+  g_test_add_func ("/bindings/dispatch/css", test_dispatch_css);
+  g_test_add_func ("/bindings/dispatch/entries", test_dispatch_entries);
+
+  return g_test_run ();
+}
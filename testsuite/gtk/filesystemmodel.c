@@ -0,0 +1,323 @@
+/* GtkFileSystemModel sorting tests.
+ *
+ * Copyright (C) 2014 Red Hat, Inc.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <glib/gstdio.h>
+#include <gtk/gtk.h>
+#include "../../gtk/gtkfilesystemmodel.h"
+
+#define N_FILES 300
+
+static gboolean
+get_value (GtkFileSystemModel *model,
+           GFile              *file,
+           GFileInfo          *info,
+           int                 column,
+           GValue             *value,
+           gpointer            user_data)
+{
+  g_value_set_string (value, g_file_info_get_display_name (info));
+
+  return TRUE;
+}
+
+static gint
+compare_names (GtkTreeModel *model,
+               GtkTreeIter  *a,
+               GtkTreeIter  *b,
+               gpointer      user_data)
+{
+  gchar *name_a, *name_b;
+  gint result;
+
+  gtk_tree_model_get (model, a, 0, &name_a, -1);
+  gtk_tree_model_get (model, b, 0, &name_b, -1);
+
+  result = g_strcmp0 (name_a, name_b);
+
+  g_free (name_a);
+  g_free (name_b);
+
+  return result;
+}
+
+static GtkFileSystemModel *
+create_model (void)
+{
+  GtkFileSystemModel *model;
+
+  model = _gtk_file_system_model_new (get_value, NULL, 1, G_TYPE_STRING);
+  gtk_tree_sortable_set_sort_func (GTK_TREE_SORTABLE (model), 0,
+                                   compare_names, NULL, NULL);
+  gtk_tree_sortable_set_sort_column_id (GTK_TREE_SORTABLE (model), 0,
+                                        GTK_SORT_ASCENDING);
+
+  return model;
+}
+
+static GFile *
+get_file (guint n)
+{
+  GFile *file;
+  gchar *uri;
+
+  uri = g_strdup_printf ("file:///nonexistent/file-%u", n);
+  file = g_file_new_for_uri (uri);
+  g_free (uri);
+
+  return file;
+}
+
+/* Adds file number @n, or renames it if it is in @model already */
+static void
+set_file (GtkFileSystemModel *model,
+          guint               n,
+          const gchar        *display_name)
+{
+  GFileInfo *info;
+  GFile *file;
+
+  file = get_file (n);
+
+  info = g_file_info_new ();
+  g_file_info_set_name (info, display_name);
+  g_file_info_set_display_name (info, display_name);
+  g_file_info_set_file_type (info, G_FILE_TYPE_REGULAR);
+
+  _gtk_file_system_model_update_file (model, file, info);
+
+  g_object_unref (info);
+  g_object_unref (file);
+}
+
+/* Returns the names of all rows, in order */
+static GPtrArray *
+get_rows (GtkFileSystemModel *model)
+{
+  GPtrArray *rows;
+  GtkTreeIter iter;
+  gboolean valid;
+
+  rows = g_ptr_array_new_with_free_func (g_free);
+
+  for (valid = gtk_tree_model_get_iter_first (GTK_TREE_MODEL (model), &iter);
+       valid;
+       valid = gtk_tree_model_iter_next (GTK_TREE_MODEL (model), &iter))
+    {
+      gchar *name;
+
+      gtk_tree_model_get (GTK_TREE_MODEL (model), &iter, 0, &name, -1);
+      g_ptr_array_add (rows, name);
+    }
+
+  return rows;
+}
+
+/* Checks that the rows are what a full resort of @model gives */
+static void
+assert_sorted (GtkFileSystemModel *model,
+               guint               n_rows)
+{
+  GPtrArray *rows, *resorted;
+  guint i;
+
+  rows = get_rows (model);
+  g_assert_cmpuint (rows->len, ==, n_rows);
+
+  for (i = 1; i < rows->len; i++)
+    g_assert_cmpstr (rows->pdata[i - 1], <, rows->pdata[i]);
+
+  /* Changing the sort order sorts all nodes again */
+  gtk_tree_sortable_set_sort_column_id (GTK_TREE_SORTABLE (model), 0,
+                                        GTK_SORT_DESCENDING);
+  gtk_tree_sortable_set_sort_column_id (GTK_TREE_SORTABLE (model), 0,
+                                        GTK_SORT_ASCENDING);
+
+  resorted = get_rows (model);
+  g_assert_cmpuint (resorted->len, ==, rows->len);
+  for (i = 0; i < rows->len; i++)
+    g_assert_cmpstr (rows->pdata[i], ==, resorted->pdata[i]);
+
+  g_ptr_array_unref (resorted);
+  g_ptr_array_unref (rows);
+}
+
+/* Returns a name for file @n, in an order that is not that of @n */
+static gchar *
+get_name (guint n,
+          guint generation)
+{
+  return g_strdup_printf ("name-%05u-%u", (n * 7919) % 10007, generation);
+}
+
+static void
+test_merge_added (void)
+{
+  GtkFileSystemModel *model;
+  guint i;
+
+  model = create_model ();
+
+  /* Every file added is merged into the sorted ones */
+  for (i = 0; i < N_FILES; i++)
+    {
+      gchar *name = get_name (i, 0);
+
+      set_file (model, i, name);
+      g_free (name);
+
+      if (i % 37 == 0)
+        assert_sorted (model, i + 1);
+    }
+
+  assert_sorted (model, N_FILES);
+
+  g_object_unref (model);
+}
+
+static void
+test_merge_updated (void)
+{
+  GtkFileSystemModel *model;
+  guint i, n_files;
+
+  model = create_model ();
+
+  for (i = 0; i < N_FILES; i++)
+    {
+      gchar *name = get_name (i, 0);
+
+      set_file (model, i, name);
+      g_free (name);
+    }
+
+  /* Updates leave the files after the first changed one to be sorted
+   * again, and the next added file merges them with the sorted ones */
+  n_files = N_FILES;
+  for (i = 0; i < N_FILES; i += 23)
+    {
+      gchar *name;
+      guint j;
+
+      for (j = i; j < N_FILES; j += 41)
+        {
+          name = get_name (N_FILES - j, i + 1);
+          set_file (model, j, name);
+          g_free (name);
+        }
+
+      name = get_name (n_files, 0);
+      set_file (model, n_files, name);
+      g_free (name);
+      n_files++;
+
+      assert_sorted (model, n_files);
+    }
+
+  g_object_unref (model);
+}
+
+static void
+loading_finished (GtkFileSystemModel *model,
+                  GError             *error,
+                  gpointer            user_data)
+{
+  g_assert_no_error (error);
+
+  g_main_loop_quit (user_data);
+}
+
+static void
+test_merge_loaded (void)
+{
+  GtkFileSystemModel *model;
+  GMainLoop *loop;
+  gchar *dirname;
+  GFile *dir;
+  guint i;
+
+  dirname = g_dir_make_tmp ("filesystemmodel-XXXXXX", NULL);
+  g_assert (dirname != NULL);
+
+  for (i = 0; i < N_FILES; i++)
+    {
+      gchar *name, *filename;
+
+      name = get_name (i, 0);
+      filename = g_build_filename (dirname, name, NULL);
+      g_assert (g_file_set_contents (filename, "", 0, NULL));
+      g_free (filename);
+      g_free (name);
+    }
+
+  dir = g_file_new_for_path (dirname);
+  model = _gtk_file_system_model_new_for_directory (dir,
+                                                    G_FILE_ATTRIBUTE_STANDARD_NAME ","
+                                                    G_FILE_ATTRIBUTE_STANDARD_DISPLAY_NAME ","
+                                                    G_FILE_ATTRIBUTE_STANDARD_TYPE,
+                                                    get_value, NULL, 1, G_TYPE_STRING);
+  gtk_tree_sortable_set_sort_func (GTK_TREE_SORTABLE (model), 0,
+                                   compare_names, NULL, NULL);
+  gtk_tree_sortable_set_sort_column_id (GTK_TREE_SORTABLE (model), 0,
+                                        GTK_SORT_ASCENDING);
+
+  loop = g_main_loop_new (NULL, FALSE);
+  g_signal_connect (model, "finished-loading", G_CALLBACK (loading_finished), loop);
+  g_main_loop_run (loop);
+  g_main_loop_unref (loop);
+
+  assert_sorted (model, N_FILES);
+
+  /* Files added after loading are merged with the loaded ones */
+  for (i = 0; i < N_FILES; i += 7)
+    {
+      gchar *name = get_name (N_FILES + i, 0);
+
+      set_file (model, N_FILES + i, name);
+      g_free (name);
+    }
+
+  assert_sorted (model, N_FILES + (N_FILES + 6) / 7);
+
+  g_object_unref (model);
+  g_object_unref (dir);
+
+  for (i = 0; i < N_FILES; i++)
+    {
+      gchar *name, *filename;
+
+      name = get_name (i, 0);
+      filename = g_build_filename (dirname, name, NULL);
+      g_unlink (filename);
+      g_free (filename);
+      g_free (name);
+    }
+  g_rmdir (dirname);
+  g_free (dirname);
+}
+
+int
+main (int argc, char *argv[])
+{
+  gtk_test_init (&argc, &argv);
+
+  g_test_add_func ("/filesystemmodel/merge/added", test_merge_added);
+  g_test_add_func ("/filesystemmodel/merge/updated", test_merge_updated);
+  g_test_add_func ("/filesystemmodel/merge/loaded", test_merge_loaded);
+
+  return g_test_run ();
+}
@@ -0,0 +1,206 @@
+/* GtkIconHelper surface cache tests.
+ *
+ * Copyright (C) 2014 Red Hat, Inc.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <gtk/gtk.h>
+#include "../../gtk/gtkiconhelperprivate.h"
+
+#define ICON_SIZE 256
+#define N_ICONS 40
+
+/* Adds a builtin icon of @size, which no theme has */
+static gchar *
+add_icon (guint n,
+          gint  size)
+{
+  GdkPixbuf *pixbuf;
+  gchar *name;
+
+  name = g_strdup_printf ("gtk-test-icon-helper-%u-%d", n, size);
+
+  pixbuf = gdk_pixbuf_new (GDK_COLORSPACE_RGB, TRUE, 8, size, size);
+  gdk_pixbuf_fill (pixbuf, 0x336699ff + n);
+
+  G_GNUC_BEGIN_IGNORE_DEPRECATIONS;
+  gtk_icon_theme_add_builtin_icon (name, size, pixbuf);
+  G_GNUC_END_IGNORE_DEPRECATIONS;
+
+  g_object_unref (pixbuf);
+
+  return name;
+}
+
+static GtkIconHelper *
+create_helper (const gchar *icon_name,
+               gint         size)
+{
+  GtkIconHelper *helper;
+
+  helper = _gtk_icon_helper_new ();
+  _gtk_icon_helper_set_icon_name (helper, icon_name, GTK_ICON_SIZE_INVALID);
+  _gtk_icon_helper_set_pixel_size (helper, size);
+
+  return helper;
+}
+
+/* Returns the surface @helper draws, which stays alive as long
+ * as the cache or another helper has it */
+static cairo_surface_t *
+get_surface (GtkStyleContext *context,
+             const gchar     *icon_name,
+             gint             size)
+{
+  GtkIconHelper *helper;
+  cairo_surface_t *surface;
+
+  helper = create_helper (icon_name, size);
+  surface = _gtk_icon_helper_ensure_surface (helper, context);
+  g_assert (surface != NULL);
+  g_object_unref (helper);
+
+  cairo_surface_destroy (surface);
+
+  return surface;
+}
+
+static GtkStyleContext *
+create_context (void)
+{
+  GtkStyleContext *context;
+  GtkWidgetPath *path;
+
+  context = gtk_style_context_new ();
+  path = gtk_widget_path_new ();
+  gtk_widget_path_append_type (path, GTK_TYPE_IMAGE);
+  gtk_style_context_set_path (context, path);
+  gtk_widget_path_unref (path);
+
+  return context;
+}
+
+static void
+test_surface_cache_shared (void)
+{
+  GtkStyleContext *context;
+  GtkIconHelper *helpers[10];
+  cairo_surface_t *surface, *first;
+  guint hits, misses, hits_before, misses_before, i;
+  gchar *name;
+
+  context = create_context ();
+  name = add_icon (0, 16);
+
+  _gtk_icon_helper_get_surface_cache_stats (&hits_before, &misses_before, NULL, NULL);
+
+  /* All helpers showing the same icon share one surface */
+  first = NULL;
+  for (i = 0; i < G_N_ELEMENTS (helpers); i++)
+    {
+      helpers[i] = create_helper (name, 16);
+      surface = _gtk_icon_helper_ensure_surface (helpers[i], context);
+      g_assert (surface != NULL);
+
+      if (first == NULL)
+        first = surface;
+      g_assert (surface == first);
+
+      cairo_surface_destroy (surface);
+    }
+
+  _gtk_icon_helper_get_surface_cache_stats (&hits, &misses, NULL, NULL);
+  g_assert_cmpuint (misses, ==, misses_before + 1);
+  g_assert_cmpuint (hits, ==, hits_before + G_N_ELEMENTS (helpers) - 1);
+
+  /* The helpers keep their surface without asking again */
+  for (i = 0; i < G_N_ELEMENTS (helpers); i++)
+    {
+      surface = _gtk_icon_helper_ensure_surface (helpers[i], context);
+      g_assert (surface == first);
+      cairo_surface_destroy (surface);
+    }
+
+  _gtk_icon_helper_get_surface_cache_stats (&hits, &misses, NULL, NULL);
+  g_assert_cmpuint (misses, ==, misses_before + 1);
+  g_assert_cmpuint (hits, ==, hits_before + G_N_ELEMENTS (helpers) - 1);
+
+  for (i = 0; i < G_N_ELEMENTS (helpers); i++)
+    g_object_unref (helpers[i]);
+
+  /* Other sizes get their own surface */
+  surface = get_surface (context, name, 24);
+  g_assert (surface != first);
+  _gtk_icon_helper_get_surface_cache_stats (NULL, &misses, NULL, NULL);
+  g_assert_cmpuint (misses, ==, misses_before + 2);
+
+  g_free (name);
+  g_object_unref (context);
+}
+
+static void
+test_surface_cache_eviction (void)
+{
+  GtkStyleContext *context;
+  gchar *names[N_ICONS];
+  guint misses, misses_before, n_entries, i;
+  gsize size, max_size;
+
+  context = create_context ();
+
+  for (i = 0; i < N_ICONS; i++)
+    names[i] = add_icon (i + 1, ICON_SIZE);
+
+  /* The surfaces and the pixbufs kept for them count */
+  max_size = 0;
+  for (i = 0; i < N_ICONS; i++)
+    {
+      get_surface (context, names[i], ICON_SIZE);
+
+      _gtk_icon_helper_get_surface_cache_stats (NULL, NULL, &n_entries, &size);
+      g_assert_cmpuint (size, >=, (gsize) n_entries * ICON_SIZE * ICON_SIZE * 4 * 2);
+      max_size = MAX (max_size, size);
+    }
+
+  /* The cache filled up and stayed in its budget, dropping the
+   * least recently used surfaces */
+  _gtk_icon_helper_get_surface_cache_stats (NULL, &misses_before, &n_entries, &size);
+  g_assert_cmpuint (n_entries, <, N_ICONS);
+  g_assert_cmpuint (size, <=, max_size);
+
+  get_surface (context, names[N_ICONS - 1], ICON_SIZE);
+  _gtk_icon_helper_get_surface_cache_stats (NULL, &misses, NULL, NULL);
+  g_assert_cmpuint (misses, ==, misses_before);
+
+  get_surface (context, names[0], ICON_SIZE);
+  _gtk_icon_helper_get_surface_cache_stats (NULL, &misses, NULL, &size);
+  g_assert_cmpuint (misses, ==, misses_before + 1);
+  g_assert_cmpuint (size, <=, max_size);
+
+  for (i = 0; i < N_ICONS; i++)
+    g_free (names[i]);
+  g_object_unref (context);
+}
+
+int
+main (int argc, char *argv[])
+{
+  gtk_test_init (&argc, &argv);
+
+  g_test_add_func ("/iconhelper/surface-cache/shared", test_surface_cache_shared);
+  g_test_add_func ("/iconhelper/surface-cache/eviction", test_surface_cache_eviction);
+
+  return g_test_run ();
+}
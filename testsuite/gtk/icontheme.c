@@ -0,0 +1,208 @@
+/* GtkIconTheme tests.
+ *
+ * Copyright (C) 2014 Red Hat, Inc.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <glib/gstdio.h>
+#include <gtk/gtk.h>
+
+#define THEME_NAME "gtk-test-theme"
+
+static const gchar *subdirs[] = { "16x16/apps", "32x32/apps", "48x48/apps" };
+static const gint sizes[] = { 16, 32, 48 };
+
+static const gchar index_theme[] =
+  "[Icon Theme]\n"
+  "Name=Test\n"
+  "Directories=16x16/apps,32x32/apps,48x48/apps\n"
+  "\n"
+  "[16x16/apps]\n"
+  "Size=16\n"
+  "Type=Fixed\n"
+  "\n"
+  "[32x32/apps]\n"
+  "Size=32\n"
+  "Type=Fixed\n"
+  "\n"
+  "[48x48/apps]\n"
+  "Size=48\n"
+  "Type=Fixed\n";
+
+/* Creates a theme without an icon-theme.cache, with one icon
+ * named "test-icon-<size>" in each directory */
+static gchar *
+create_theme (void)
+{
+  gchar *basedir, *themedir, *filename;
+  guint i;
+
+  basedir = g_dir_make_tmp ("icontheme-XXXXXX", NULL);
+  g_assert (basedir != NULL);
+
+  themedir = g_build_filename (basedir, THEME_NAME, NULL);
+  g_assert (g_mkdir (themedir, 0755) == 0);
+
+  filename = g_build_filename (themedir, "index.theme", NULL);
+  g_assert (g_file_set_contents (filename, index_theme, -1, NULL));
+  g_free (filename);
+
+  for (i = 0; i < G_N_ELEMENTS (subdirs); i++)
+    {
+      GdkPixbuf *pixbuf;
+      gchar *dirname, *name;
+
+      dirname = g_build_filename (themedir, subdirs[i], NULL);
+      g_assert (g_mkdir_with_parents (dirname, 0755) == 0);
+
+      name = g_strdup_printf ("test-icon-%d.png", sizes[i]);
+      filename = g_build_filename (dirname, name, NULL);
+
+      pixbuf = gdk_pixbuf_new (GDK_COLORSPACE_RGB, TRUE, 8, sizes[i], sizes[i]);
+      gdk_pixbuf_fill (pixbuf, 0);
+      g_assert (gdk_pixbuf_save (pixbuf, filename, "png", NULL, NULL));
+      g_object_unref (pixbuf);
+
+      g_free (filename);
+      g_free (name);
+      g_free (dirname);
+    }
+
+  g_free (themedir);
+
+  return basedir;
+}
+
+static void
+remove_theme (gchar *basedir)
+{
+  gchar *themedir, *filename;
+  guint i;
+
+  themedir = g_build_filename (basedir, THEME_NAME, NULL);
+
+  for (i = 0; i < G_N_ELEMENTS (subdirs); i++)
+    {
+      gchar *dirname, *name, *parent;
+
+      dirname = g_build_filename (themedir, subdirs[i], NULL);
+      name = g_strdup_printf ("test-icon-%d.png", sizes[i]);
+      filename = g_build_filename (dirname, name, NULL);
+      g_unlink (filename);
+      g_rmdir (dirname);
+
+      parent = g_path_get_dirname (dirname);
+      g_rmdir (parent);
+
+      g_free (parent);
+      g_free (filename);
+      g_free (name);
+      g_free (dirname);
+    }
+
+  filename = g_build_filename (themedir, "index.theme", NULL);
+  g_unlink (filename);
+  g_free (filename);
+
+  g_rmdir (themedir);
+  g_rmdir (basedir);
+
+  g_free (themedir);
+  g_free (basedir);
+}
+
+static void
+test_has_icon_scans (void)
+{
+  GtkIconTheme *icon_theme;
+  gchar *basedir;
+  guint scans;
+
+  basedir = create_theme ();
+
+  icon_theme = gtk_icon_theme_new ();
+  gtk_icon_theme_set_search_path (icon_theme, (const gchar **) &basedir, 1);
+  gtk_icon_theme_set_custom_theme (icon_theme, THEME_NAME);
+
+  /* Loading the theme doesn't read the directories */
+  scans = _gtk_icon_theme_get_n_directory_scans ();
+  g_assert (!gtk_icon_theme_has_icon (icon_theme, "test-icon-missing"));
+
+  /* The first question reads every directory once */
+  g_assert_cmpuint (_gtk_icon_theme_get_n_directory_scans (), ==, scans + G_N_ELEMENTS (subdirs));
+  scans = _gtk_icon_theme_get_n_directory_scans ();
+
+  g_assert (gtk_icon_theme_has_icon (icon_theme, "test-icon-16"));
+  g_assert (gtk_icon_theme_has_icon (icon_theme, "test-icon-48"));
+
+  /* And misses don't read them again */
+  g_assert (!gtk_icon_theme_has_icon (icon_theme, "test-icon-missing"));
+  g_assert (!gtk_icon_theme_has_icon (icon_theme, "test-icon-also-missing"));
+  g_assert_cmpuint (_gtk_icon_theme_get_n_directory_scans (), ==, scans);
+
+  g_object_unref (icon_theme);
+  remove_theme (basedir);
+}
+
+static void
+test_lookup_scans (void)
+{
+  GtkIconTheme *icon_theme;
+  GtkIconInfo *info;
+  gchar *basedir;
+  guint scans;
+
+  basedir = create_theme ();
+
+  icon_theme = gtk_icon_theme_new ();
+  gtk_icon_theme_set_search_path (icon_theme, (const gchar **) &basedir, 1);
+  gtk_icon_theme_set_custom_theme (icon_theme, THEME_NAME);
+
+  scans = _gtk_icon_theme_get_n_directory_scans ();
+
+  /* Looking up an icon reads the directories it is searched in
+   * at most once */
+  info = gtk_icon_theme_lookup_icon (icon_theme, "test-icon-32", 32, 0);
+  g_assert (info != NULL);
+  g_object_unref (info);
+  g_assert_cmpuint (_gtk_icon_theme_get_n_directory_scans (), <=, scans + G_N_ELEMENTS (subdirs));
+  scans = _gtk_icon_theme_get_n_directory_scans ();
+
+  info = gtk_icon_theme_lookup_icon (icon_theme, "test-icon-missing", 32, 0);
+  g_assert (info == NULL);
+  g_assert (gtk_icon_theme_has_icon (icon_theme, "test-icon-16"));
+  g_assert (!gtk_icon_theme_has_icon (icon_theme, "test-icon-missing"));
+  g_assert_cmpuint (_gtk_icon_theme_get_n_directory_scans (), <=, scans + G_N_ELEMENTS (subdirs));
+  scans = _gtk_icon_theme_get_n_directory_scans ();
+
+  info = gtk_icon_theme_lookup_icon (icon_theme, "test-icon-missing", 16, 0);
+  g_assert (info == NULL);
+  g_assert (!gtk_icon_theme_has_icon (icon_theme, "test-icon-missing"));
+  g_assert_cmpuint (_gtk_icon_theme_get_n_directory_scans (), ==, scans);
+
+  g_object_unref (icon_theme);
+  remove_theme (basedir);
+}
+
+int
+main (int argc, char *argv[])
+{
+  gtk_test_init (&argc, &argv);
+
+  g_test_add_func ("/icontheme/has-icon/scans", test_has_icon_scans);
+  g_test_add_func ("/icontheme/lookup/scans", test_lookup_scans);
+
+  return g_test_run ();
+}
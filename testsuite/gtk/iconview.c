@@ -0,0 +1,230 @@
+/* GtkIconView tests.
+ *
+ * Copyright (C) 2014 Red Hat, Inc.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <gtk/gtk.h>
+
+#define N_ITEMS 120
+
+/* A text renderer counting how often it gets measured */
+typedef GtkCellRendererText CountingRenderer;
+typedef GtkCellRendererTextClass CountingRendererClass;
+
+static GType counting_renderer_get_type (void);
+
+G_DEFINE_TYPE (CountingRenderer, counting_renderer, GTK_TYPE_CELL_RENDERER_TEXT)
+
+static guint n_width_requests;
+static guint n_height_requests;
+
+static void
+counting_renderer_get_preferred_width (GtkCellRenderer *cell,
+                                       GtkWidget       *widget,
+                                       gint            *minimum,
+                                       gint            *natural)
+{
+  n_width_requests++;
+
+  GTK_CELL_RENDERER_CLASS (counting_renderer_parent_class)->get_preferred_width (cell, widget, minimum, natural);
+}
+
+static void
+counting_renderer_get_preferred_height_for_width (GtkCellRenderer *cell,
+                                                  GtkWidget       *widget,
+                                                  gint             width,
+                                                  gint            *minimum,
+                                                  gint            *natural)
+{
+  n_height_requests++;
+
+  GTK_CELL_RENDERER_CLASS (counting_renderer_parent_class)->get_preferred_height_for_width (cell, widget, width, minimum, natural);
+}
+
+static void
+counting_renderer_class_init (CountingRendererClass *class)
+{
+  GtkCellRendererClass *cell_class = GTK_CELL_RENDERER_CLASS (class);
+
+  cell_class->get_preferred_width = counting_renderer_get_preferred_width;
+  cell_class->get_preferred_height_for_width = counting_renderer_get_preferred_height_for_width;
+}
+
+static void
+counting_renderer_init (CountingRenderer *renderer)
+{
+}
+
+static GtkListStore *
+create_model (void)
+{
+  GtkListStore *store;
+  guint i;
+
+  store = gtk_list_store_new (1, G_TYPE_STRING);
+
+  for (i = 0; i < N_ITEMS; i++)
+    {
+      gchar *text = g_strdup_printf ("item %u", i);
+
+      gtk_list_store_insert_with_values (store, NULL, i, 0, text, -1);
+      g_free (text);
+    }
+
+  return store;
+}
+
+static GtkWidget *
+create_icon_view (GtkTreeModel *model)
+{
+  GtkWidget *icon_view;
+  GtkCellRenderer *cell;
+
+  icon_view = gtk_icon_view_new_with_model (model);
+  g_object_ref_sink (icon_view);
+
+  cell = g_object_new (counting_renderer_get_type (), NULL);
+  gtk_cell_layout_pack_start (GTK_CELL_LAYOUT (icon_view), cell, TRUE);
+  gtk_cell_layout_add_attribute (GTK_CELL_LAYOUT (icon_view), cell, "text", 0);
+
+  gtk_widget_show (icon_view);
+
+  return icon_view;
+}
+
+static void
+layout (GtkWidget *icon_view,
+        gint       width)
+{
+  GtkAllocation allocation;
+  gint minimum, natural, height;
+
+  gtk_widget_get_preferred_width (icon_view, &minimum, &natural);
+  gtk_widget_get_preferred_height_for_width (icon_view, MAX (width, minimum), &height, NULL);
+
+  allocation.x = 0;
+  allocation.y = 0;
+  allocation.width = MAX (width, minimum);
+  allocation.height = height;
+  gtk_widget_size_allocate (icon_view, &allocation);
+}
+
+/* Checks that @icon_view has the same layout as a new icon view */
+static void
+assert_layout_is_fresh (GtkWidget *icon_view,
+                        gint       width)
+{
+  GtkTreeModel *model;
+  GtkWidget *fresh;
+  guint i;
+
+  model = gtk_icon_view_get_model (GTK_ICON_VIEW (icon_view));
+  fresh = create_icon_view (model);
+  layout (fresh, width);
+
+  for (i = 0; i < N_ITEMS; i++)
+    {
+      GdkRectangle rect, fresh_rect;
+      GtkTreePath *path;
+
+      path = gtk_tree_path_new_from_indices (i, -1);
+      g_assert (gtk_icon_view_get_cell_rect (GTK_ICON_VIEW (icon_view), path, NULL, &rect));
+      g_assert (gtk_icon_view_get_cell_rect (GTK_ICON_VIEW (fresh), path, NULL, &fresh_rect));
+      gtk_tree_path_free (path);
+
+      g_assert_cmpint (rect.x, ==, fresh_rect.x);
+      g_assert_cmpint (rect.y, ==, fresh_rect.y);
+      g_assert_cmpint (rect.width, ==, fresh_rect.width);
+      g_assert_cmpint (rect.height, ==, fresh_rect.height);
+    }
+
+  g_object_unref (fresh);
+}
+
+static void
+test_layout_cached (void)
+{
+  GtkListStore *store;
+  GtkWidget *icon_view;
+
+  store = create_model ();
+  icon_view = create_icon_view (GTK_TREE_MODEL (store));
+
+  layout (icon_view, 400);
+
+  /* Allocating the same size again measures nothing */
+  n_width_requests = n_height_requests = 0;
+  layout (icon_view, 400);
+  g_assert_cmpuint (n_width_requests, ==, 0);
+  g_assert_cmpuint (n_height_requests, ==, 0);
+
+  /* A different width measures all rows again */
+  layout (icon_view, 250);
+  g_assert_cmpuint (n_height_requests, >=, N_ITEMS);
+  assert_layout_is_fresh (icon_view, 250);
+
+  g_object_unref (icon_view);
+  g_object_unref (store);
+}
+
+static void
+test_layout_row_changed (void)
+{
+  GtkListStore *store;
+  GtkWidget *icon_view;
+  GtkTreeIter iter;
+
+  store = create_model ();
+  icon_view = create_icon_view (GTK_TREE_MODEL (store));
+
+  layout (icon_view, 400);
+
+  /* A taller item changes the height of its row and moves all
+   * items after it, but only it and its row get measured */
+  gtk_tree_model_iter_nth_child (GTK_TREE_MODEL (store), &iter, NULL, N_ITEMS / 2);
+
+  n_width_requests = n_height_requests = 0;
+  gtk_list_store_set (store, &iter, 0, "item\nwith\nmore\nlines", -1);
+  layout (icon_view, 400);
+
+  g_assert_cmpuint (n_width_requests, >, 0);
+  g_assert_cmpuint (n_width_requests, <, N_ITEMS / 4);
+  g_assert_cmpuint (n_height_requests, >, 0);
+  g_assert_cmpuint (n_height_requests, <, N_ITEMS / 4);
+
+  assert_layout_is_fresh (icon_view, 400);
+
+  /* A wider item changes the width of all items */
+  gtk_tree_model_iter_nth_child (GTK_TREE_MODEL (store), &iter, NULL, 3);
+  gtk_list_store_set (store, &iter, 0, "a much longer item than all the others", -1);
+  layout (icon_view, 400);
+
+  assert_layout_is_fresh (icon_view, 400);
+
+  g_object_unref (icon_view);
+  g_object_unref (store);
+}
+
+int
+main (int argc, char *argv[])
+{
+  gtk_test_init (&argc, &argv);
+
+  g_test_add_func ("/iconview/layout/cached", test_layout_cached);
+  g_test_add_func ("/iconview/layout/row-changed", test_layout_row_changed);
+
+  return g_test_run ();
+}
@@ -0,0 +1,200 @@
+/* Layout extents cache tests.
+ *
+ * Copyright (C) 2014 Red Hat, Inc.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <gtk/gtk.h>
+#include "../../gtk/gtkpango.h"
+
+#ifdef GDK_WINDOWING_X11
+#include <pango/pangofc-fontmap.h>
+#endif
+
+static const gchar *texts[] = {
+  "",
+  "Hello",
+  "Hello World",
+  "A somewhat longer paragraph of text that wraps at narrow widths",
+  "Two\nlines",
+  "עברית and English"
+};
+
+static const gint widths[] = { -1, 50, 200 };
+
+static PangoLayout *
+create_layout (PangoContext *context,
+               const gchar  *text,
+               gint          width)
+{
+  PangoLayout *layout;
+
+  layout = pango_layout_new (context);
+  pango_layout_set_text (layout, text, -1);
+  pango_layout_set_width (layout, width < 0 ? -1 : width * PANGO_SCALE);
+  pango_layout_set_wrap (layout, PANGO_WRAP_WORD_CHAR);
+
+  return layout;
+}
+
+/* Checks that the cached extents of a new layout are those
+ * Pango computes for it */
+static void
+assert_extents (PangoContext *context,
+                const gchar  *text,
+                gint          width)
+{
+  PangoLayout *layout, *reference;
+  PangoRectangle rect, reference_rect;
+  gint baseline;
+
+  layout = create_layout (context, text, width);
+  _gtk_pango_layout_get_cached_extents (layout, &rect, &baseline);
+
+  reference = create_layout (context, text, width);
+  pango_layout_get_extents (reference, NULL, &reference_rect);
+
+  g_assert_cmpint (rect.x, ==, reference_rect.x);
+  g_assert_cmpint (rect.y, ==, reference_rect.y);
+  g_assert_cmpint (rect.width, ==, reference_rect.width);
+  g_assert_cmpint (rect.height, ==, reference_rect.height);
+  g_assert_cmpint (baseline, ==, pango_layout_get_baseline (reference));
+
+  g_object_unref (reference);
+  g_object_unref (layout);
+}
+
+static PangoContext *
+create_context (PangoFontMap *font_map)
+{
+  PangoContext *context;
+  PangoFontDescription *desc;
+
+  context = pango_font_map_create_context (font_map);
+  desc = pango_font_description_from_string ("Sans 10");
+  pango_context_set_font_description (context, desc);
+  pango_font_description_free (desc);
+
+  return context;
+}
+
+static void
+test_layout_cache_extents (void)
+{
+  PangoContext *context;
+  PangoFontDescription *desc;
+  guint hits, misses, hits_before, misses_before, i, j;
+
+  context = create_context (pango_cairo_font_map_get_default ());
+
+  _gtk_pango_layout_cache_get_stats (&hits_before, &misses_before);
+
+  /* Both the first and the cached answers are right */
+  for (i = 0; i < G_N_ELEMENTS (texts); i++)
+    for (j = 0; j < G_N_ELEMENTS (widths); j++)
+      {
+        assert_extents (context, texts[i], widths[j]);
+        assert_extents (context, texts[i], widths[j]);
+      }
+
+  _gtk_pango_layout_cache_get_stats (&hits, &misses);
+  g_assert_cmpuint (hits - hits_before, >=, G_N_ELEMENTS (texts) * G_N_ELEMENTS (widths));
+
+  /* Another font is another key */
+  desc = pango_font_description_from_string ("Serif Bold 17");
+  pango_context_set_font_description (context, desc);
+  pango_font_description_free (desc);
+
+  _gtk_pango_layout_cache_get_stats (NULL, &misses_before);
+  assert_extents (context, texts[2], -1);
+  _gtk_pango_layout_cache_get_stats (NULL, &misses);
+  g_assert_cmpuint (misses, ==, misses_before + 1);
+
+  g_object_unref (context);
+}
+
+static void
+test_layout_cache_clear (void)
+{
+  PangoContext *context;
+  guint misses, misses_before;
+
+  context = create_context (pango_cairo_font_map_get_default ());
+
+  assert_extents (context, texts[1], -1);
+
+  /* Clearing the cache, as done when fontconfig changed, measures again */
+  _gtk_pango_layout_cache_get_stats (NULL, &misses_before);
+  _gtk_pango_layout_cache_clear ();
+  assert_extents (context, texts[1], -1);
+  _gtk_pango_layout_cache_get_stats (NULL, &misses);
+  g_assert_cmpuint (misses, ==, misses_before + 1);
+
+  assert_extents (context, texts[1], -1);
+  _gtk_pango_layout_cache_get_stats (NULL, &misses);
+  g_assert_cmpuint (misses, ==, misses_before + 1);
+
+  g_object_unref (context);
+}
+
+static void
+test_layout_cache_font_map (void)
+{
+  PangoFontMap *font_map;
+  PangoContext *context, *default_context;
+  guint misses, misses_before;
+
+  font_map = pango_cairo_font_map_new ();
+  context = create_context (font_map);
+
+  /* Layouts with other font maps aren't mixed up with these */
+  default_context = create_context (pango_cairo_font_map_get_default ());
+  assert_extents (default_context, texts[2], -1);
+  g_object_unref (default_context);
+
+  _gtk_pango_layout_cache_get_stats (NULL, &misses_before);
+  assert_extents (context, texts[2], -1);
+  assert_extents (context, texts[2], -1);
+  _gtk_pango_layout_cache_get_stats (NULL, &misses);
+  g_assert_cmpuint (misses, ==, misses_before + 1);
+  misses_before = misses;
+
+#ifdef GDK_WINDOWING_X11
+  /* Resetting the font map measures again */
+  if (PANGO_IS_FC_FONT_MAP (font_map))
+    {
+      pango_fc_font_map_cache_clear (PANGO_FC_FONT_MAP (font_map));
+
+      assert_extents (context, texts[2], -1);
+      _gtk_pango_layout_cache_get_stats (NULL, &misses);
+      g_assert_cmpuint (misses, ==, misses_before + 1);
+    }
+#endif
+
+  g_object_unref (context);
+  g_object_unref (font_map);
+}
+
+int
+main (int argc, char *argv[])
+{
+  gtk_test_init (&argc, &argv);
+
+  g_test_add_func ("/pango/layout-cache/extents", test_layout_cache_extents);
+  g_test_add_func ("/pango/layout-cache/clear", test_layout_cache_clear);
+  g_test_add_func ("/pango/layout-cache/font-map", test_layout_cache_font_map);
+
+  return g_test_run ();
+}
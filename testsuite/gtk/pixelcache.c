@@ -0,0 +1,265 @@
+/* GtkPixelCache tests.
+ *
+ * Copyright (C) 2014 Red Hat, Inc.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <gtk/gtk.h>
+#include "../../gtk/gtkpixelcacheprivate.h"
+
+#define VIEW_SIZE 1000
+#define CANVAS_SIZE 20000
+#define MAX_CACHES 1000
+
+static void
+count_render (cairo_t  *cr,
+              gpointer  user_data)
+{
+  guint *n_renders = user_data;
+
+  (*n_renders)++;
+}
+
+/* Draws @cache for a view scrolled down by @scroll_y and returns
+ * how often the contents had to be rendered */
+static guint
+draw_cache (GtkPixelCache *cache,
+            GdkWindow     *window,
+            gint           scroll_y)
+{
+  cairo_rectangle_int_t view_rect = { 0, 0, VIEW_SIZE, VIEW_SIZE };
+  cairo_rectangle_int_t canvas_rect = { 0, 0, VIEW_SIZE, CANVAS_SIZE };
+  cairo_surface_t *surface;
+  guint n_renders = 0;
+  cairo_t *cr;
+
+  canvas_rect.y = -scroll_y;
+
+  surface = cairo_image_surface_create (CAIRO_FORMAT_ARGB32, VIEW_SIZE, VIEW_SIZE);
+  cr = cairo_create (surface);
+
+  _gtk_pixel_cache_draw (cache, cr, window, &view_rect, &canvas_rect,
+                         count_render, &n_renders);
+
+  cairo_destroy (cr);
+  cairo_surface_destroy (surface);
+
+  return n_renders;
+}
+
+/* Lets the frame clock of @window finish a frame, so that the
+ * caches drawn so far aren't part of the current one anymore */
+static void
+next_frame (GdkWindow *window)
+{
+  GdkFrameClock *frame_clock;
+  gint64 frame_counter;
+
+  frame_clock = gdk_window_get_frame_clock (window);
+  frame_counter = gdk_frame_clock_get_frame_counter (frame_clock);
+
+  gdk_frame_clock_request_phase (frame_clock, GDK_FRAME_CLOCK_PHASE_PAINT);
+  while (gdk_frame_clock_get_frame_counter (frame_clock) == frame_counter)
+    g_main_context_iteration (NULL, TRUE);
+}
+
+static GtkWidget *
+create_window (void)
+{
+  GtkWidget *window;
+
+  window = gtk_offscreen_window_new ();
+  gtk_widget_set_size_request (window, VIEW_SIZE, VIEW_SIZE);
+  gtk_widget_show (window);
+
+  return window;
+}
+
+static GtkPixelCache *
+add_cache (GPtrArray *caches)
+{
+  GtkPixelCache *cache;
+
+  g_assert_cmpuint (caches->len, <, MAX_CACHES);
+
+  cache = _gtk_pixel_cache_new ();
+  g_ptr_array_add (caches, cache);
+
+  return cache;
+}
+
+static void
+test_eviction (void)
+{
+  GtkWidget *window;
+  GdkWindow *gdk_window;
+  GPtrArray *caches;
+  GtkPixelCacheStats before, stats;
+
+  window = create_window ();
+  gdk_window = gtk_widget_get_window (window);
+  caches = g_ptr_array_new_with_free_func ((GDestroyNotify) _gtk_pixel_cache_free);
+
+  _gtk_pixel_cache_get_stats (&before);
+
+  /* Caches drawn in frames of their own stay within the budget,
+   * going past it drops the least recently drawn ones */
+  do
+    {
+      next_frame (gdk_window);
+      g_assert_cmpuint (draw_cache (add_cache (caches), gdk_window, 0), >, 0);
+
+      _gtk_pixel_cache_get_stats (&stats);
+      g_assert_cmpuint (stats.bytes, <=, stats.budget);
+    }
+  while (stats.n_evictions == before.n_evictions);
+
+  g_assert_cmpuint (stats.n_surfaces, <, before.n_surfaces + caches->len);
+
+  /* The most recently drawn cache still has its contents, the
+   * first one has to render them again */
+  next_frame (gdk_window);
+  g_assert_cmpuint (draw_cache (g_ptr_array_index (caches, caches->len - 1), gdk_window, 0), ==, 0);
+
+  next_frame (gdk_window);
+  g_assert_cmpuint (draw_cache (g_ptr_array_index (caches, 0), gdk_window, 0), >, 0);
+
+  _gtk_pixel_cache_get_stats (&stats);
+  g_assert_cmpuint (stats.bytes, <=, stats.budget);
+
+  g_ptr_array_unref (caches);
+
+  _gtk_pixel_cache_get_stats (&stats);
+  g_assert_cmpuint (stats.n_surfaces, ==, before.n_surfaces);
+  g_assert_cmpuint (stats.bytes, ==, before.bytes);
+
+  gtk_widget_destroy (window);
+}
+
+static void
+test_eviction_current_frame (void)
+{
+  GtkWidget *window;
+  GdkWindow *gdk_window;
+  GPtrArray *caches;
+  GtkPixelCacheStats before, stats;
+  guint i;
+
+  window = create_window ();
+  gdk_window = gtk_widget_get_window (window);
+  caches = g_ptr_array_new_with_free_func ((GDestroyNotify) _gtk_pixel_cache_free);
+
+  _gtk_pixel_cache_get_stats (&before);
+
+  /* Caches drawn in the same frame are all kept, even when they
+   * don't fit the budget */
+  next_frame (gdk_window);
+  do
+    {
+      g_assert_cmpuint (draw_cache (add_cache (caches), gdk_window, 0), >, 0);
+      _gtk_pixel_cache_get_stats (&stats);
+    }
+  while (stats.bytes <= stats.budget);
+
+  g_assert_cmpuint (stats.n_evictions, ==, before.n_evictions);
+  g_assert_cmpuint (stats.n_surfaces, ==, before.n_surfaces + caches->len);
+
+  for (i = 0; i < caches->len; i++)
+    g_assert_cmpuint (draw_cache (g_ptr_array_index (caches, i), gdk_window, 0), ==, 0);
+
+  /* Once the frame is done they are fair game */
+  next_frame (gdk_window);
+  g_assert_cmpuint (draw_cache (add_cache (caches), gdk_window, 0), >, 0);
+
+  _gtk_pixel_cache_get_stats (&stats);
+  g_assert_cmpuint (stats.n_evictions, >, before.n_evictions);
+  g_assert_cmpuint (stats.bytes, <=, stats.budget);
+
+  g_ptr_array_unref (caches);
+  gtk_widget_destroy (window);
+}
+
+static void
+test_overscan (void)
+{
+  GtkWidget *window;
+  GdkWindow *gdk_window;
+  GtkPixelCache *cache;
+  GtkPixelCacheStats before, stats;
+  gsize bytes;
+  gint scroll_y, i;
+
+  window = create_window ();
+  gdk_window = gtk_widget_get_window (window);
+  cache = _gtk_pixel_cache_new ();
+
+  _gtk_pixel_cache_get_stats (&before);
+
+  scroll_y = 0;
+  draw_cache (cache, gdk_window, scroll_y);
+  _gtk_pixel_cache_get_stats (&stats);
+  bytes = stats.bytes - before.bytes;
+  g_assert_cmpuint (bytes, >=, (gsize) VIEW_SIZE * VIEW_SIZE * 4);
+
+  /* Scrolling slowly keeps the minimum overscan */
+  for (i = 0; i < 10; i++)
+    {
+      g_usleep (G_USEC_PER_SEC / 50);
+      scroll_y += 1;
+      draw_cache (cache, gdk_window, scroll_y);
+    }
+
+  _gtk_pixel_cache_get_stats (&stats);
+  g_assert_cmpuint (stats.bytes - before.bytes, ==, bytes);
+
+  /* A fast flick grows it */
+  for (i = 0; i < 10; i++)
+    {
+      g_usleep (G_USEC_PER_SEC / 100);
+      scroll_y += 200;
+      draw_cache (cache, gdk_window, scroll_y);
+    }
+
+  _gtk_pixel_cache_get_stats (&stats);
+  g_assert_cmpuint (stats.bytes - before.bytes, >, bytes);
+  bytes = stats.bytes - before.bytes;
+
+  /* And slowing down doesn't shrink it again right away, which
+   * would only cost another surface */
+  for (i = 0; i < 10; i++)
+    {
+      g_usleep (G_USEC_PER_SEC / 50);
+      scroll_y += 1;
+      draw_cache (cache, gdk_window, scroll_y);
+    }
+
+  _gtk_pixel_cache_get_stats (&stats);
+  g_assert_cmpuint (stats.bytes - before.bytes, >=, bytes);
+
+  _gtk_pixel_cache_free (cache);
+  gtk_widget_destroy (window);
+}
+
+int
+main (int argc, char *argv[])
+{
+  gtk_test_init (&argc, &argv);
+
+  g_test_add_func ("/pixelcache/eviction", test_eviction);
+  g_test_add_func ("/pixelcache/eviction/current-frame", test_eviction_current_frame);
+  g_test_add_func ("/pixelcache/overscan", test_overscan);
+
+  return g_test_run ();
+}
@@ -0,0 +1,240 @@
+/* GtkPrintJob tests.
+ *
+ * Copyright (C) 2014 Red Hat, Inc.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <string.h>
+#include <glib/gstdio.h>
+#include <gtk/gtk.h>
+#include <gtk/gtkunixprint.h>
+
+#define N_PAGES 8
+#define IMAGE_SIZE 256
+
+static gboolean
+find_file_printer (GtkPrinter *printer,
+                   gpointer    data)
+{
+  GtkPrinter **file_printer = data;
+  GObject *backend;
+  gboolean found;
+
+  g_object_get (printer, "backend", &backend, NULL);
+  found = backend != NULL && strcmp (G_OBJECT_TYPE_NAME (backend), "GtkPrintBackendFile") == 0;
+  if (backend)
+    g_object_unref (backend);
+
+  if (found)
+    *file_printer = g_object_ref (printer);
+
+  return found;
+}
+
+/* Returns the printer of the file backend, or NULL if the print
+ * backends are not available */
+static GtkPrinter *
+get_file_printer (void)
+{
+  GtkPrinter *printer = NULL;
+
+  gtk_enumerate_printers (find_file_printer, &printer, NULL, TRUE);
+
+  if (printer == NULL)
+    g_test_message ("The file print backend is not available");
+
+  return printer;
+}
+
+static GtkPrintJob *
+create_job (GtkPrinter  *printer,
+            const gchar *filename)
+{
+  GtkPrintSettings *settings;
+  GtkPageSetup *page_setup;
+  GtkPrintJob *job;
+  gchar *uri;
+
+  uri = g_filename_to_uri (filename, NULL, NULL);
+  settings = gtk_print_settings_new ();
+  gtk_print_settings_set (settings, GTK_PRINT_SETTINGS_OUTPUT_URI, uri);
+  gtk_print_settings_set (settings, GTK_PRINT_SETTINGS_OUTPUT_FILE_FORMAT, "pdf");
+  page_setup = gtk_page_setup_new ();
+
+  job = gtk_print_job_new ("printjob test", printer, settings, page_setup);
+
+  g_object_unref (page_setup);
+  g_object_unref (settings);
+  g_free (uri);
+
+  return job;
+}
+
+/* Draws pages of noise, which doesn't compress, so that the job
+ * writes enough data to report progress along the way */
+static void
+draw_pages (GtkPrintJob *job)
+{
+  cairo_surface_t *surface, *image;
+  GError *error = NULL;
+  GRand *rand;
+  cairo_t *cr;
+  guchar *data;
+  gint page, i;
+
+  surface = gtk_print_job_get_surface (job, &error);
+  g_assert_no_error (error);
+  cr = cairo_create (surface);
+
+  rand = g_rand_new_with_seed (42);
+  image = cairo_image_surface_create (CAIRO_FORMAT_RGB24, IMAGE_SIZE, IMAGE_SIZE);
+
+  for (page = 0; page < N_PAGES; page++)
+    {
+      cairo_surface_flush (image);
+      data = cairo_image_surface_get_data (image);
+      for (i = 0; i < cairo_image_surface_get_stride (image) * IMAGE_SIZE; i++)
+        data[i] = g_rand_int_range (rand, 0, 256);
+      cairo_surface_mark_dirty (image);
+
+      cairo_set_source_surface (cr, image, 0, 0);
+      cairo_paint (cr);
+      cairo_show_page (cr);
+    }
+
+  cairo_surface_destroy (image);
+  g_rand_free (rand);
+
+  cairo_destroy (cr);
+  cairo_surface_finish (surface);
+}
+
+static void
+bytes_written_changed (GObject    *object,
+                       GParamSpec *pspec,
+                       guint      *n_changes)
+{
+  (*n_changes)++;
+}
+
+static void
+job_complete (GtkPrintJob  *job,
+              gpointer      user_data,
+              const GError *error)
+{
+  g_assert_no_error ((GError *) error);
+
+  g_main_loop_quit (user_data);
+}
+
+static void
+test_bytes_written (void)
+{
+  GtkPrinter *printer;
+  GtkPrintJob *job;
+  GMainLoop *loop;
+  gchar *dirname, *filename;
+  guint n_changes;
+  GStatBuf buf;
+
+  printer = get_file_printer ();
+  if (printer == NULL)
+    return;
+
+  dirname = g_dir_make_tmp ("printjob-XXXXXX", NULL);
+  g_assert (dirname != NULL);
+  filename = g_build_filename (dirname, "output.pdf", NULL);
+
+  job = create_job (printer, filename);
+  g_assert_cmpuint (gtk_print_job_get_bytes_written (job), ==, 0);
+
+  n_changes = 0;
+  g_signal_connect (job, "notify::bytes-written",
+                    G_CALLBACK (bytes_written_changed), &n_changes);
+
+  draw_pages (job);
+
+  loop = g_main_loop_new (NULL, FALSE);
+  gtk_print_job_send (job, job_complete, loop, NULL);
+  g_main_loop_run (loop);
+  g_main_loop_unref (loop);
+
+  /* Progress was reported more than once, and ends with the
+   * size of the file */
+  g_assert (g_stat (filename, &buf) == 0);
+  g_assert_cmpuint (buf.st_size, >, N_PAGES * IMAGE_SIZE * IMAGE_SIZE);
+  g_assert_cmpuint (gtk_print_job_get_bytes_written (job), ==, buf.st_size);
+  g_assert_cmpuint (n_changes, >, 1);
+
+  g_object_unref (job);
+  g_object_unref (printer);
+
+  g_unlink (filename);
+  g_rmdir (dirname);
+  g_free (filename);
+  g_free (dirname);
+}
+
+static void
+test_aborted (void)
+{
+  GtkPrinter *printer;
+  GtkPrintJob *job;
+  gchar *dirname, *filename, *contents;
+  GDir *dir;
+
+  printer = get_file_printer ();
+  if (printer == NULL)
+    return;
+
+  dirname = g_dir_make_tmp ("printjob-XXXXXX", NULL);
+  g_assert (dirname != NULL);
+  filename = g_build_filename (dirname, "output.pdf", NULL);
+  g_assert (g_file_set_contents (filename, "old", -1, NULL));
+
+  /* A job that is never sent leaves the target alone, and no
+   * temporary files behind */
+  job = create_job (printer, filename);
+  draw_pages (job);
+  g_object_unref (job);
+
+  dir = g_dir_open (dirname, 0, NULL);
+  g_assert (dir != NULL);
+  g_assert_cmpstr (g_dir_read_name (dir), ==, "output.pdf");
+  g_assert (g_dir_read_name (dir) == NULL);
+  g_dir_close (dir);
+
+  g_assert (g_file_get_contents (filename, &contents, NULL, NULL));
+  g_assert_cmpstr (contents, ==, "old");
+  g_free (contents);
+
+  g_object_unref (printer);
+
+  g_unlink (filename);
+  g_rmdir (dirname);
+  g_free (filename);
+  g_free (dirname);
+}
+
+int
+main (int argc, char *argv[])
+{
+  gtk_test_init (&argc, &argv);
+
+  g_test_add_func ("/printjob/bytes-written", test_bytes_written);
+  g_test_add_func ("/printjob/aborted", test_aborted);
+
+  return g_test_run ();
+}
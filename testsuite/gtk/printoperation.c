@@ -0,0 +1,276 @@
+/* GtkPrintOperation tests.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <gtk/gtk.h>
+#include <glib/gstdio.h>
+#include <string.h>
+
+#define N_PAGES 50
+
+static gint drawn[N_PAGES];
+
+static void
+draw_page (GtkPrintOperation *op,
+           GtkPrintContext   *context,
+           gint               page_nr)
+{
+  PangoLayout *layout;
+  cairo_t *cr;
+  gchar *text;
+
+  cr = gtk_print_context_get_cairo_context (context);
+
+  layout = gtk_print_context_create_pango_layout (context);
+  text = g_strdup_printf ("Page %d", page_nr + 1);
+  pango_layout_set_text (layout, text, -1);
+  cairo_move_to (cr, 10, 30);
+  pango_cairo_show_layout (cr, layout);
+  g_free (text);
+  g_object_unref (layout);
+
+  /* A color per page, to tell the pages apart in the output */
+  cairo_set_source_rgb (cr, (page_nr + 1) / 100.0, 0.5, 0.25);
+  cairo_rectangle (cr, 10, 10, gtk_print_context_get_width (context) - 20, 10 + page_nr);
+  cairo_fill (cr);
+
+  g_atomic_int_inc (&drawn[page_nr]);
+}
+
+static void
+bytes_written_changed (GObject    *object,
+                       GParamSpec *pspec,
+                       guint64    *bytes_written)
+{
+  guint64 value;
+
+  /* Progress only ever goes forward while exporting */
+  value = gtk_print_operation_get_bytes_written (GTK_PRINT_OPERATION (object));
+  g_assert_cmpuint (value, >=, *bytes_written);
+
+  *bytes_written = value;
+}
+
+/* Exports N_PAGES pages to a new PDF file and returns its name */
+static gchar *
+export_pages (gboolean threaded)
+{
+  GtkPrintOperation *op;
+  GtkPrintOperationResult result;
+  GError *error = NULL;
+  gchar *filename;
+  GStatBuf buf;
+  guint64 bytes_written;
+  gint fd, i;
+
+  fd = g_file_open_tmp ("printoperation-XXXXXX.pdf", &filename, &error);
+  g_assert_no_error (error);
+  g_close (fd, NULL);
+
+  for (i = 0; i < N_PAGES; i++)
+    drawn[i] = 0;
+
+  op = gtk_print_operation_new ();
+  gtk_print_operation_set_n_pages (op, N_PAGES);
+  gtk_print_operation_set_export_filename (op, filename);
+  gtk_print_operation_set_threaded_drawing (op, threaded);
+  g_assert (gtk_print_operation_get_threaded_drawing (op) == threaded);
+  g_signal_connect (op, "draw-page", G_CALLBACK (draw_page), NULL);
+
+  bytes_written = 0;
+  g_signal_connect (op, "notify::bytes-written",
+                    G_CALLBACK (bytes_written_changed), &bytes_written);
+
+  result = gtk_print_operation_run (op, GTK_PRINT_OPERATION_ACTION_EXPORT, NULL, &error);
+  g_assert_no_error (error);
+  g_assert_cmpint (result, ==, GTK_PRINT_OPERATION_RESULT_APPLY);
+  g_assert_cmpint (gtk_print_operation_get_status (op), ==, GTK_PRINT_STATUS_FINISHED);
+
+  for (i = 0; i < N_PAGES; i++)
+    g_assert_cmpint (drawn[i], ==, 1);
+
+  g_assert (g_stat (filename, &buf) == 0);
+  g_assert_cmpint (buf.st_size, >, 0);
+
+  /* The progress reports end with the size of the file */
+  g_assert_cmpuint (bytes_written, ==, buf.st_size);
+  g_assert_cmpuint (gtk_print_operation_get_bytes_written (op), ==, buf.st_size);
+
+  g_object_unref (op);
+
+  return filename;
+}
+
+/* Inflates a compressed PDF stream, returns NULL if it isn't one */
+static gchar *
+inflate_stream (const gchar *data,
+                gsize        length)
+{
+  GConverter *converter;
+  GInputStream *memory, *stream;
+  GString *result;
+  gchar buffer[4096];
+  gssize n_read;
+
+  converter = G_CONVERTER (g_zlib_decompressor_new (G_ZLIB_COMPRESSOR_FORMAT_ZLIB));
+  memory = g_memory_input_stream_new_from_data (data, length, NULL);
+  stream = g_converter_input_stream_new (memory, converter);
+
+  result = g_string_new (NULL);
+  while ((n_read = g_input_stream_read (stream, buffer, sizeof (buffer), NULL, NULL)) > 0)
+    g_string_append_len (result, buffer, n_read);
+
+  g_object_unref (stream);
+  g_object_unref (memory);
+  g_object_unref (converter);
+
+  if (n_read < 0)
+    {
+      g_string_free (result, TRUE);
+      return NULL;
+    }
+
+  return g_string_free (result, FALSE);
+}
+
+/* Adds the operands of all "rg" operators in @content to @colors */
+static void
+add_fill_colors (const gchar *content,
+                 GPtrArray   *colors)
+{
+  gchar **tokens;
+  guint i;
+
+  tokens = g_strsplit_set (content, " \r\n", -1);
+
+  for (i = 3; tokens[i] != NULL; i++)
+    {
+      if (strcmp (tokens[i], "rg") == 0)
+        g_ptr_array_add (colors, g_strjoin (" ", tokens[i - 3], tokens[i - 2], tokens[i - 1], NULL));
+    }
+
+  g_strfreev (tokens);
+}
+
+static gint
+compare_strings (gconstpointer a,
+                 gconstpointer b)
+{
+  return strcmp (*(const gchar **) a, *(const gchar **) b);
+}
+
+/* Returns the sorted fill colors used in the PDF @filename, and
+ * its number of pages in @n_pages */
+static GPtrArray *
+get_pdf_contents (const gchar *filename,
+                  guint       *n_pages)
+{
+  GPtrArray *colors;
+  GError *error = NULL;
+  gchar *contents, *end, *p, *stream_end, *inflated;
+  gsize length;
+
+  g_file_get_contents (filename, &contents, &length, &error);
+  g_assert_no_error (error);
+  end = contents + length;
+
+  *n_pages = 0;
+  for (p = contents; (p = g_strstr_len (p, end - p, "/Type /Page")) != NULL; p++)
+    {
+      if (p + 11 < end && p[11] != 's')
+        (*n_pages)++;
+    }
+
+  colors = g_ptr_array_new_with_free_func (g_free);
+  for (p = contents; (p = g_strstr_len (p, end - p, "stream\n")) != NULL; p = stream_end)
+    {
+      p += strlen ("stream\n");
+      stream_end = g_strstr_len (p, end - p, "endstream");
+      g_assert (stream_end != NULL);
+
+      inflated = inflate_stream (p, stream_end - p);
+      if (inflated)
+        add_fill_colors (inflated, colors);
+      g_free (inflated);
+    }
+
+  g_ptr_array_sort (colors, compare_strings);
+  g_free (contents);
+
+  return colors;
+}
+
+static void
+test_export (void)
+{
+  gchar *filename;
+
+  filename = export_pages (FALSE);
+  g_unlink (filename);
+  g_free (filename);
+}
+
+static void
+test_export_threaded (void)
+{
+  gchar *filename;
+
+  filename = export_pages (TRUE);
+  g_unlink (filename);
+  g_free (filename);
+}
+
+static void
+test_export_threaded_matches (void)
+{
+  gchar *filename, *threaded_filename;
+  GPtrArray *colors, *threaded_colors;
+  guint n_pages, threaded_n_pages, i;
+
+  filename = export_pages (FALSE);
+  threaded_filename = export_pages (TRUE);
+
+  colors = get_pdf_contents (filename, &n_pages);
+  threaded_colors = get_pdf_contents (threaded_filename, &threaded_n_pages);
+
+  /* Both have the same pages, with the same drawing on them */
+  g_assert_cmpuint (n_pages, ==, N_PAGES);
+  g_assert_cmpuint (threaded_n_pages, ==, n_pages);
+
+  g_assert_cmpuint (colors->len, >=, N_PAGES);
+  g_assert_cmpuint (threaded_colors->len, ==, colors->len);
+  for (i = 0; i < colors->len; i++)
+    g_assert_cmpstr (threaded_colors->pdata[i], ==, colors->pdata[i]);
+
+  g_ptr_array_unref (threaded_colors);
+  g_ptr_array_unref (colors);
+
+  g_unlink (threaded_filename);
+  g_unlink (filename);
+  g_free (threaded_filename);
+  g_free (filename);
+}
+
+int
+main (int argc, char *argv[])
+{
+  gtk_test_init (&argc, &argv);
+
+  g_test_add_func ("/printoperation/export", test_export);
+  g_test_add_func ("/printoperation/export-threaded", test_export_threaded);
+  g_test_add_func ("/printoperation/export-threaded/matches", test_export_threaded_matches);
+
+  return g_test_run ();
+}
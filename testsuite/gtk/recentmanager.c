@@ -294,6 +294,89 @@ recent_manager_purge (void)
   g_assert (n == 1);
 }
 
+static gboolean
+wait_timeout (gpointer data)
+{
+  gboolean *timed_out = data;
+
+  *timed_out = TRUE;
+
+  return G_SOURCE_REMOVE;
+}
+
+/* Runs the main loop until @manager knows about @item_uri */
+static void
+wait_for_item (GtkRecentManager *manager,
+               const gchar      *item_uri)
+{
+  gboolean timed_out = FALSE;
+  guint id;
+
+  id = g_timeout_add_seconds (10, wait_timeout, &timed_out);
+
+  while (!gtk_recent_manager_has_item (manager, item_uri) && !timed_out)
+    g_main_context_iteration (NULL, TRUE);
+
+  g_assert (!timed_out);
+  g_source_remove (id);
+}
+
+static void
+recent_manager_two_managers (void)
+{
+  const gchar *filename = "recently-used-shared.xbel";
+  GtkRecentManager *manager_a, *manager_b;
+  GtkRecentData data = { 0, };
+  gint i, j;
+
+  g_unlink (filename);
+
+  manager_a = g_object_new (GTK_TYPE_RECENT_MANAGER, "filename", filename, NULL);
+  manager_b = g_object_new (GTK_TYPE_RECENT_MANAGER, "filename", filename, NULL);
+
+  data.mime_type = "text/plain";
+  data.app_name = "testrecentchooser";
+  data.app_exec = "testrecentchooser %u";
+
+  /* Each manager writes the file in turn, and has to pick up what
+   * the other one wrote instead of taking it for its own write */
+  for (i = 0; i < 5; i++)
+    {
+      gchar *uri_a, *uri_b;
+
+      uri_a = g_strdup_printf ("file:///doesnotexist-a-%d.txt", i);
+      gtk_recent_manager_add_full (manager_a, uri_a, &data);
+      wait_for_item (manager_b, uri_a);
+
+      uri_b = g_strdup_printf ("file:///doesnotexist-b-%d.txt", i);
+      gtk_recent_manager_add_full (manager_b, uri_b, &data);
+      wait_for_item (manager_a, uri_b);
+
+      for (j = 0; j <= i; j++)
+        {
+          gchar *uri_j;
+
+          uri_j = g_strdup_printf ("file:///doesnotexist-a-%d.txt", j);
+          g_assert (gtk_recent_manager_has_item (manager_a, uri_j));
+          g_assert (gtk_recent_manager_has_item (manager_b, uri_j));
+          g_free (uri_j);
+
+          uri_j = g_strdup_printf ("file:///doesnotexist-b-%d.txt", j);
+          g_assert (gtk_recent_manager_has_item (manager_a, uri_j));
+          g_assert (gtk_recent_manager_has_item (manager_b, uri_j));
+          g_free (uri_j);
+        }
+
+      g_free (uri_a);
+      g_free (uri_b);
+    }
+
+  g_object_unref (manager_a);
+  g_object_unref (manager_b);
+
+  g_assert_cmpint (g_unlink (filename), ==, 0);
+}
+
 int
 main (int    argc,
       char **argv)
@@ -308,6 +391,7 @@ main (int    argc,
   g_test_add_func ("/recent-manager/lookup-item", recent_manager_lookup_item);
   g_test_add_func ("/recent-manager/remove-item", recent_manager_remove_item);
   g_test_add_func ("/recent-manager/purge", recent_manager_purge);
+  g_test_add_func ("/recent-manager/two-managers", recent_manager_two_managers);
 
   return g_test_run ();
 }
@@ -1319,6 +1319,326 @@ test_tag (void)
   g_object_unref (buffer);
 }
 
+static void
+check_same_tags_everywhere (GtkTextBuffer *buffer1,
+                            GtkTextBuffer *buffer2)
+{
+  GtkTextIter iter1, iter2;
+  GSList *tags1, *tags2, *l1, *l2;
+
+  gtk_text_buffer_get_start_iter (buffer1, &iter1);
+  gtk_text_buffer_get_start_iter (buffer2, &iter2);
+
+  do
+    {
+      g_assert_cmpint (gtk_text_iter_get_offset (&iter1), ==, gtk_text_iter_get_offset (&iter2));
+
+      tags1 = gtk_text_iter_get_tags (&iter1);
+      tags2 = gtk_text_iter_get_tags (&iter2);
+
+      for (l1 = tags1, l2 = tags2; l1 && l2; l1 = l1->next, l2 = l2->next)
+        g_assert (l1->data == l2->data);
+      g_assert (l1 == NULL && l2 == NULL);
+
+      g_slist_free (tags1);
+      g_slist_free (tags2);
+    }
+  while (gtk_text_iter_forward_char (&iter1) && gtk_text_iter_forward_char (&iter2));
+}
+
+static void
+test_tag_ranges (void)
+{
+  GtkTextTagTable *table;
+  GtkTextBuffer *buffer1, *buffer2;
+  GtkTextIter start, end;
+  GtkTextTag *tags[30];
+  GString *text;
+  gint offsets[20];
+  gint n_chars, i;
+  guint j;
+
+  table = gtk_text_tag_table_new ();
+  buffer1 = gtk_text_buffer_new (table);
+  buffer2 = gtk_text_buffer_new (table);
+
+  text = g_string_new (NULL);
+  for (i = 0; i < 200; i++)
+    g_string_append_printf (text, "line %d\n", i);
+  gtk_text_buffer_set_text (buffer1, text->str, -1);
+  gtk_text_buffer_set_text (buffer2, text->str, -1);
+  g_string_free (text, TRUE);
+
+  n_chars = gtk_text_buffer_get_char_count (buffer1);
+
+  /* More tags than fit into an unindexed node summary */
+  for (i = 0; i < 30; i++)
+    {
+      GtkTextTag *tag;
+
+      tag = tags[i] = gtk_text_buffer_create_tag (buffer1, NULL, NULL);
+
+      for (j = 0; j < G_N_ELEMENTS (offsets); j++)
+        offsets[j] = g_test_rand_int_range (0, n_chars + 1);
+
+      gtk_text_buffer_apply_tag_to_ranges (buffer1, tag, offsets, G_N_ELEMENTS (offsets));
+
+      for (j = 0; j < G_N_ELEMENTS (offsets); j += 2)
+        {
+          gtk_text_buffer_get_iter_at_offset (buffer2, &start, offsets[j]);
+          gtk_text_buffer_get_iter_at_offset (buffer2, &end, offsets[j + 1]);
+          gtk_text_buffer_apply_tag (buffer2, tag, &start, &end);
+        }
+    }
+
+  check_same_tags_everywhere (buffer1, buffer2);
+
+  /* Punch holes into some of the tags again */
+  for (i = 0; i < 10; i++)
+    {
+      GtkTextTag *tag;
+
+      tag = tags[i * 3];
+
+      for (j = 0; j < G_N_ELEMENTS (offsets); j++)
+        offsets[j] = g_test_rand_int_range (0, n_chars + 1);
+
+      gtk_text_buffer_remove_tag_from_ranges (buffer1, tag, offsets, G_N_ELEMENTS (offsets));
+
+      for (j = 0; j < G_N_ELEMENTS (offsets); j += 2)
+        {
+          gtk_text_buffer_get_iter_at_offset (buffer2, &start, offsets[j]);
+          gtk_text_buffer_get_iter_at_offset (buffer2, &end, offsets[j + 1]);
+          gtk_text_buffer_remove_tag (buffer2, tag, &start, &end);
+        }
+    }
+
+  check_same_tags_everywhere (buffer1, buffer2);
+
+  gtk_text_buffer_get_iter_at_offset (buffer1, &start, n_chars / 3);
+  gtk_text_buffer_get_iter_at_offset (buffer1, &end, 2 * n_chars / 3);
+  gtk_text_buffer_remove_all_tags (buffer1, &start, &end);
+  gtk_text_buffer_get_iter_at_offset (buffer2, &start, n_chars / 3);
+  gtk_text_buffer_get_iter_at_offset (buffer2, &end, 2 * n_chars / 3);
+  gtk_text_buffer_remove_all_tags (buffer2, &start, &end);
+
+  check_same_tags_everywhere (buffer1, buffer2);
+
+  g_object_unref (buffer1);
+  g_object_unref (buffer2);
+  g_object_unref (table);
+}
+
+static void
+test_tag_ranges_performance (void)
+{
+  GtkTextBuffer *buffer;
+  GtkTextTag *tag;
+  GtkTextIter start, end;
+  GString *text;
+  guint flags;
+  gint *offsets;
+  gint n_ranges, i;
+  gdouble elapsed_single, elapsed_ranges;
+
+  if (!g_test_perf ())
+    return;
+
+  /* The consistency checks would dominate the timings */
+  flags = gtk_get_debug_flags ();
+  gtk_set_debug_flags (flags & ~GTK_DEBUG_TEXT);
+
+  n_ranges = 20000;
+
+  buffer = gtk_text_buffer_new (NULL);
+
+  text = g_string_new (NULL);
+  for (i = 0; i < n_ranges; i++)
+    g_string_append (text, "if (x) return y;\n");
+  gtk_text_buffer_set_text (buffer, text->str, -1);
+  g_string_free (text, TRUE);
+
+  /* the "if" and the "return" of every line, like a highlighter would */
+  offsets = g_new (gint, 4 * n_ranges);
+  for (i = 0; i < n_ranges; i++)
+    {
+      offsets[4 * i] = 17 * i;
+      offsets[4 * i + 1] = 17 * i + 2;
+      offsets[4 * i + 2] = 17 * i + 7;
+      offsets[4 * i + 3] = 17 * i + 13;
+    }
+
+  tag = gtk_text_buffer_create_tag (buffer, NULL, "weight", PANGO_WEIGHT_BOLD, NULL);
+
+  g_test_timer_start ();
+  for (i = 0; i < 2 * n_ranges; i++)
+    {
+      gtk_text_buffer_get_iter_at_offset (buffer, &start, offsets[2 * i]);
+      gtk_text_buffer_get_iter_at_offset (buffer, &end, offsets[2 * i + 1]);
+      gtk_text_buffer_apply_tag (buffer, tag, &start, &end);
+    }
+  elapsed_single = g_test_timer_elapsed ();
+
+  gtk_text_buffer_get_bounds (buffer, &start, &end);
+  gtk_text_buffer_remove_tag (buffer, tag, &start, &end);
+
+  g_test_timer_start ();
+  gtk_text_buffer_apply_tag_to_ranges (buffer, tag, offsets, 4 * n_ranges);
+  elapsed_ranges = g_test_timer_elapsed ();
+
+  g_test_message ("gtk_text_buffer_apply_tag() for %d ranges: %f s", 2 * n_ranges, elapsed_single);
+  g_test_minimized_result (elapsed_ranges, "gtk_text_buffer_apply_tag_to_ranges() for %d ranges: %f s",
+                           2 * n_ranges, elapsed_ranges);
+
+  g_free (offsets);
+  g_object_unref (buffer);
+
+  gtk_set_debug_flags (flags);
+}
+
+static void
+check_same_tags (GtkTextBuffer *buffer1,
+                 GtkTextBuffer *buffer2,
+                 gint           offset)
+{
+  GtkTextIter iter1, iter2;
+  GSList *tags1, *tags2, *l1, *l2;
+
+  gtk_text_buffer_get_iter_at_offset (buffer1, &iter1, offset);
+  gtk_text_buffer_get_iter_at_offset (buffer2, &iter2, offset);
+
+  tags1 = gtk_text_iter_get_tags (&iter1);
+  tags2 = gtk_text_iter_get_tags (&iter2);
+
+  g_assert_cmpint (g_slist_length (tags1), ==, g_slist_length (tags2));
+
+  for (l1 = tags1, l2 = tags2; l1 && l2; l1 = l1->next, l2 = l2->next)
+    {
+      gchar *name1, *name2;
+      gint weight1, weight2;
+
+      g_object_get (l1->data, "name", &name1, "weight", &weight1, NULL);
+      g_object_get (l2->data, "name", &name2, "weight", &weight2, NULL);
+
+      g_assert_cmpstr (name1, ==, name2);
+      g_assert_cmpint (weight1, ==, weight2);
+
+      g_free (name1);
+      g_free (name2);
+    }
+
+  g_slist_free (tags1);
+  g_slist_free (tags2);
+}
+
+static void
+test_serialize_stream (void)
+{
+  GtkTextBuffer *buffer, *copy;
+  GtkTextTag *light;
+  GtkTextIter start, end;
+  GOutputStream *output;
+  GInputStream *input;
+  GdkPixbuf *pixbuf;
+  GString *text;
+  gchar *slice1, *slice2;
+  GError *error = NULL;
+  gboolean res;
+  gint i;
+
+  buffer = gtk_text_buffer_new (NULL);
+  gtk_text_buffer_create_tag (buffer, "bold", "weight", PANGO_WEIGHT_BOLD, NULL);
+  light = gtk_text_buffer_create_tag (buffer, NULL, "weight", PANGO_WEIGHT_LIGHT, NULL);
+
+  /* Enough text to be split into several chunks */
+  text = g_string_new (NULL);
+  for (i = 0; i < 5000; i++)
+    g_string_append_printf (text, "line %d \xe2\x82\xac\n", i);
+  gtk_text_buffer_set_text (buffer, text->str, text->len);
+  g_string_free (text, TRUE);
+
+  gtk_text_buffer_get_iter_at_offset (buffer, &start, 10);
+  gtk_text_buffer_get_iter_at_offset (buffer, &end, 40000);
+  gtk_text_buffer_apply_tag_by_name (buffer, "bold", &start, &end);
+
+  gtk_text_buffer_get_iter_at_offset (buffer, &start, 20000);
+  gtk_text_buffer_get_iter_at_offset (buffer, &end, 50000);
+  gtk_text_buffer_apply_tag (buffer, light, &start, &end);
+
+  pixbuf = gdk_pixbuf_new (GDK_COLORSPACE_RGB, FALSE, 8, 7, 5);
+  gdk_pixbuf_fill (pixbuf, 0xff0000ff);
+  gtk_text_buffer_get_iter_at_offset (buffer, &start, 30000);
+  gtk_text_buffer_insert_pixbuf (buffer, &start, pixbuf);
+  g_object_unref (pixbuf);
+
+  output = g_memory_output_stream_new (NULL, 0, g_realloc, g_free);
+  gtk_text_buffer_get_bounds (buffer, &start, &end);
+  res = gtk_text_buffer_serialize_to_stream (buffer, &start, &end, output, NULL, &error);
+  g_assert_no_error (error);
+  g_assert (res);
+  g_output_stream_close (output, NULL, NULL);
+
+  input = g_memory_input_stream_new_from_data (g_memory_output_stream_get_data (G_MEMORY_OUTPUT_STREAM (output)),
+                                               g_memory_output_stream_get_data_size (G_MEMORY_OUTPUT_STREAM (output)),
+                                               NULL);
+
+  copy = gtk_text_buffer_new (NULL);
+  gtk_text_buffer_get_start_iter (copy, &start);
+  res = gtk_text_buffer_deserialize_from_stream (copy, &start, input, TRUE, NULL, &error);
+  g_assert_no_error (error);
+  g_assert (res);
+  g_object_unref (input);
+
+  g_assert_cmpint (gtk_text_buffer_get_char_count (buffer), ==, gtk_text_buffer_get_char_count (copy));
+
+  gtk_text_buffer_get_bounds (buffer, &start, &end);
+  slice1 = gtk_text_buffer_get_slice (buffer, &start, &end, TRUE);
+  gtk_text_buffer_get_bounds (copy, &start, &end);
+  slice2 = gtk_text_buffer_get_slice (copy, &start, &end, TRUE);
+  g_assert_cmpstr (slice1, ==, slice2);
+  g_free (slice1);
+  g_free (slice2);
+
+  gtk_text_buffer_get_iter_at_offset (copy, &start, 30000);
+  pixbuf = gtk_text_iter_get_pixbuf (&start);
+  g_assert (GDK_IS_PIXBUF (pixbuf));
+  g_assert_cmpint (gdk_pixbuf_get_width (pixbuf), ==, 7);
+  g_assert_cmpint (gdk_pixbuf_get_height (pixbuf), ==, 5);
+
+  for (i = 0; i < gtk_text_buffer_get_char_count (buffer); i += 997)
+    check_same_tags (buffer, copy, i);
+  check_same_tags (buffer, copy, 9);
+  check_same_tags (buffer, copy, 10);
+  check_same_tags (buffer, copy, 40000);
+  check_same_tags (buffer, copy, 50000);
+
+  /* Anonymous tags can't be looked up */
+  input = g_memory_input_stream_new_from_data (g_memory_output_stream_get_data (G_MEMORY_OUTPUT_STREAM (output)),
+                                               g_memory_output_stream_get_data_size (G_MEMORY_OUTPUT_STREAM (output)),
+                                               NULL);
+  gtk_text_buffer_get_end_iter (copy, &start);
+  res = gtk_text_buffer_deserialize_from_stream (copy, &start, input, FALSE, NULL, &error);
+  g_assert_error (error, G_IO_ERROR, G_IO_ERROR_INVALID_DATA);
+  g_assert (!res);
+  g_clear_error (&error);
+  g_object_unref (input);
+
+  /* Truncated data */
+  input = g_memory_input_stream_new_from_data (g_memory_output_stream_get_data (G_MEMORY_OUTPUT_STREAM (output)),
+                                               g_memory_output_stream_get_data_size (G_MEMORY_OUTPUT_STREAM (output)) / 2,
+                                               NULL);
+  gtk_text_buffer_get_end_iter (copy, &start);
+  res = gtk_text_buffer_deserialize_from_stream (copy, &start, input, TRUE, NULL, &error);
+  g_assert_error (error, G_IO_ERROR, G_IO_ERROR_INVALID_DATA);
+  g_assert (!res);
+  g_clear_error (&error);
+  g_object_unref (input);
+
+  g_object_unref (output);
+  g_object_unref (copy);
+  g_object_unref (buffer);
+}
+
 int
 main (int argc, char** argv)
 {
@@ -1336,6 +1656,9 @@ main (int argc, char** argv)
   g_test_add_func ("/TextBuffer/Get and Set", test_get_set);
   g_test_add_func ("/TextBuffer/Fill and Empty", test_fill_empty);
   g_test_add_func ("/TextBuffer/Tag", test_tag);
+  g_test_add_func ("/TextBuffer/Tag ranges", test_tag_ranges);
+  g_test_add_func ("/TextBuffer/Tag ranges performance", test_tag_ranges_performance);
+  g_test_add_func ("/TextBuffer/Serialize stream", test_serialize_stream);
   
   return g_test_run();
 }
@@ -0,0 +1,456 @@
+/* GtkTextView tests.
+ *
+ * Copyright (C) 2013 Red Hat, Inc.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <gtk/gtk.h>
+
+#define N_CHILDREN 500
+
+typedef struct
+{
+  GtkWidget *window;
+  GtkWidget *text_view;
+  GtkTextBuffer *buffer;
+  GtkTextChildAnchor *anchors[N_CHILDREN];
+  GtkWidget *children[N_CHILDREN];
+} AnchorFixture;
+
+static void
+anchor_fixture_setup (AnchorFixture *fixture,
+                      gconstpointer  test_data)
+{
+  GtkWidget *sw;
+  GtkTextIter iter;
+  gint i;
+
+  fixture->window = gtk_window_new (GTK_WINDOW_TOPLEVEL);
+  gtk_window_set_default_size (GTK_WINDOW (fixture->window), 300, 300);
+
+  sw = gtk_scrolled_window_new (NULL, NULL);
+  gtk_container_add (GTK_CONTAINER (fixture->window), sw);
+
+  fixture->text_view = gtk_text_view_new ();
+  gtk_container_add (GTK_CONTAINER (sw), fixture->text_view);
+
+  fixture->buffer = gtk_text_view_get_buffer (GTK_TEXT_VIEW (fixture->text_view));
+
+  for (i = 0; i < N_CHILDREN; i++)
+    {
+      gchar *label;
+
+      gtk_text_buffer_get_end_iter (fixture->buffer, &iter);
+      gtk_text_buffer_insert (fixture->buffer, &iter, "Line with a button ", -1);
+      fixture->anchors[i] = gtk_text_buffer_create_child_anchor (fixture->buffer, &iter);
+      gtk_text_buffer_insert (fixture->buffer, &iter, "\n", -1);
+
+      label = g_strdup_printf ("Button %d", i);
+      fixture->children[i] = gtk_button_new_with_label (label);
+      g_free (label);
+
+      gtk_text_view_add_child_at_anchor (GTK_TEXT_VIEW (fixture->text_view),
+                                         fixture->children[i],
+                                         fixture->anchors[i]);
+    }
+
+  gtk_widget_show_all (fixture->window);
+  gtk_test_widget_wait_for_draw (fixture->window);
+}
+
+static void
+anchor_fixture_teardown (AnchorFixture *fixture,
+                         gconstpointer  test_data)
+{
+  gtk_widget_destroy (fixture->window);
+}
+
+static void
+scroll_to_child (AnchorFixture *fixture,
+                 gint           n)
+{
+  GtkTextIter iter;
+
+  gtk_text_buffer_get_iter_at_child_anchor (fixture->buffer, &iter,
+                                            fixture->anchors[n]);
+  gtk_text_view_scroll_to_iter (GTK_TEXT_VIEW (fixture->text_view),
+                                &iter, 0.0, TRUE, 0.0, 0.5);
+  gtk_test_widget_wait_for_draw (fixture->window);
+}
+
+static void
+assert_child_in_view (AnchorFixture *fixture,
+                      GtkWidget     *child)
+{
+  GtkAllocation allocation;
+  gint x, y;
+
+  g_assert (gtk_widget_get_mapped (child));
+
+  gtk_widget_get_allocation (fixture->text_view, &allocation);
+  g_assert (gtk_widget_translate_coordinates (child, fixture->text_view,
+                                              0, 0, &x, &y));
+  g_assert_cmpint (y, >=, 0);
+  g_assert_cmpint (y, <, allocation.height);
+}
+
+static void
+test_anchor_mapping (AnchorFixture *fixture,
+                     gconstpointer  test_data)
+{
+  g_assert (gtk_widget_get_mapped (fixture->children[0]));
+  g_assert (!gtk_widget_get_mapped (fixture->children[N_CHILDREN - 1]));
+
+  scroll_to_child (fixture, N_CHILDREN - 1);
+
+  assert_child_in_view (fixture, fixture->children[N_CHILDREN - 1]);
+  g_assert (!gtk_widget_get_mapped (fixture->children[0]));
+
+  scroll_to_child (fixture, N_CHILDREN / 2);
+
+  assert_child_in_view (fixture, fixture->children[N_CHILDREN / 2]);
+  g_assert (!gtk_widget_get_mapped (fixture->children[N_CHILDREN - 1]));
+}
+
+static void
+test_anchor_grab_focus (AnchorFixture *fixture,
+                        gconstpointer  test_data)
+{
+  GtkWidget *child = fixture->children[N_CHILDREN - 1];
+
+  g_assert (!gtk_widget_get_mapped (child));
+
+  gtk_widget_grab_focus (child);
+  gtk_test_widget_wait_for_draw (fixture->window);
+
+  g_assert (gtk_widget_has_focus (child));
+  assert_child_in_view (fixture, child);
+
+  /* Stays mapped while focused, wherever the view is scrolled to */
+  scroll_to_child (fixture, 0);
+  g_assert (gtk_widget_get_mapped (child));
+  g_assert (gtk_widget_has_focus (child));
+}
+
+static void
+test_anchor_focus_navigation (AnchorFixture *fixture,
+                              gconstpointer  test_data)
+{
+  GtkWidget *focus;
+  gint i;
+
+  gtk_widget_grab_focus (fixture->children[0]);
+
+  /* Tabbing through the buttons has to reach the offscreen ones */
+  for (i = 1; i < N_CHILDREN; i++)
+    {
+      g_assert (gtk_widget_child_focus (fixture->text_view, GTK_DIR_TAB_FORWARD));
+
+      focus = gtk_window_get_focus (GTK_WINDOW (fixture->window));
+      g_assert (focus == fixture->children[i]);
+      g_assert (gtk_widget_get_mapped (focus));
+    }
+
+  gtk_test_widget_wait_for_draw (fixture->window);
+  assert_child_in_view (fixture, fixture->children[N_CHILDREN - 1]);
+
+  for (i = N_CHILDREN - 2; i >= N_CHILDREN - 50; i--)
+    {
+      g_assert (gtk_widget_child_focus (fixture->text_view, GTK_DIR_TAB_BACKWARD));
+
+      focus = gtk_window_get_focus (GTK_WINDOW (fixture->window));
+      g_assert (focus == fixture->children[i]);
+    }
+}
+
+static void
+test_anchor_resize_offscreen (AnchorFixture *fixture,
+                              gconstpointer  test_data)
+{
+  GtkAdjustment *vadjustment;
+  GtkWidget *child = fixture->children[N_CHILDREN - 1];
+  gdouble upper;
+
+  /* Make sure all lines are measured */
+  scroll_to_child (fixture, N_CHILDREN - 1);
+  scroll_to_child (fixture, 0);
+
+  vadjustment = gtk_scrollable_get_vadjustment (GTK_SCROLLABLE (fixture->text_view));
+  upper = gtk_adjustment_get_upper (vadjustment);
+
+  g_assert (!gtk_widget_get_mapped (child));
+  gtk_widget_set_size_request (child, -1, 500);
+  gtk_test_widget_wait_for_draw (fixture->window);
+
+  g_assert_cmpfloat (gtk_adjustment_get_upper (vadjustment), >=, upper + 400);
+}
+
+static void
+test_anchor_removal (AnchorFixture *fixture,
+                     gconstpointer  test_data)
+{
+  GtkWidget *near = fixture->children[0];
+  GtkWidget *far = fixture->children[N_CHILDREN - 1];
+  GtkTextIter start, end;
+
+  g_object_ref (near);
+  g_object_ref (far);
+
+  g_assert (gtk_widget_get_parent (near) == fixture->text_view);
+  g_assert (gtk_widget_get_parent (far) == fixture->text_view);
+
+  /* Deleting the anchor text removes both mapped and unmapped children */
+  gtk_text_buffer_get_iter_at_line (fixture->buffer, &start, 0);
+  gtk_text_buffer_get_iter_at_line (fixture->buffer, &end, 1);
+  gtk_text_buffer_delete (fixture->buffer, &start, &end);
+
+  gtk_text_buffer_get_iter_at_line (fixture->buffer, &start, N_CHILDREN - 2);
+  gtk_text_buffer_get_end_iter (fixture->buffer, &end);
+  gtk_text_buffer_delete (fixture->buffer, &start, &end);
+
+  g_assert (gtk_widget_get_parent (near) == NULL);
+  g_assert (gtk_widget_get_parent (far) == NULL);
+
+  gtk_test_widget_wait_for_draw (fixture->window);
+  g_assert (gtk_widget_get_mapped (fixture->children[1]));
+
+  g_object_unref (near);
+  g_object_unref (far);
+}
+
+/* Emulates a subclass drawing below the text before chaining up */
+static gboolean
+draw_below_text (GtkWidget *widget,
+                 cairo_t   *cr,
+                 gpointer   data)
+{
+  GdkWindow *window;
+
+  window = gtk_text_view_get_window (GTK_TEXT_VIEW (widget),
+                                     GTK_TEXT_WINDOW_TEXT);
+  if (gtk_cairo_should_draw_window (cr, window))
+    {
+      cairo_save (cr);
+      gtk_cairo_transform_to_window (cr, widget, window);
+      cairo_rectangle (cr, 0, 0,
+                       gdk_window_get_width (window),
+                       gdk_window_get_height (window));
+      cairo_set_source_rgb (cr, 0.0, 1.0, 0.0);
+      cairo_fill (cr);
+      cairo_restore (cr);
+    }
+
+  return FALSE;
+}
+
+/* Draws into a surface similar to the window one, as the
+ * pixel cache is only used for those
+ */
+static cairo_surface_t *
+snapshot_widget (GtkWidget *widget)
+{
+  cairo_surface_t *surface, *image;
+  cairo_t *cr;
+  gint width, height;
+
+  width = gtk_widget_get_allocated_width (widget);
+  height = gtk_widget_get_allocated_height (widget);
+
+  surface = gdk_window_create_similar_surface (gtk_widget_get_window (widget),
+                                               CAIRO_CONTENT_COLOR,
+                                               width, height);
+  cr = cairo_create (surface);
+  gtk_widget_draw (widget, cr);
+  cairo_destroy (cr);
+
+  image = cairo_image_surface_create (CAIRO_FORMAT_RGB24, width, height);
+  cr = cairo_create (image);
+  cairo_set_source_surface (cr, surface, 0, 0);
+  cairo_paint (cr);
+  cairo_destroy (cr);
+  cairo_surface_destroy (surface);
+
+  cairo_surface_flush (image);
+
+  return image;
+}
+
+static guint32
+get_pixel (cairo_surface_t *image,
+           gint             x,
+           gint             y)
+{
+  guchar *data;
+
+  data = cairo_image_surface_get_data (image);
+  data += y * cairo_image_surface_get_stride (image);
+
+  return ((guint32 *) data)[x] & 0xffffff;
+}
+
+/* Scrolls a text view through the pixel cache, with @data telling
+ * whether something is drawn below the text or the view background
+ * shows there
+ */
+static void
+test_pixel_cache_scrolling (gconstpointer data)
+{
+  gboolean draw_below = GPOINTER_TO_INT (data);
+  GdkRGBA red = { 1.0, 0.0, 0.0, 1.0 };
+  guint32 below;
+  GtkWidget *window, *sw, *text_view;
+  GtkTextBuffer *buffer;
+  GtkAdjustment *vadjustment;
+  GtkTextIter iter, end;
+  GtkTextTag *tag;
+  gdouble value;
+  gint i;
+
+  g_object_set (gtk_settings_get_default (), "gtk-cursor-blink", FALSE, NULL);
+
+  window = gtk_window_new (GTK_WINDOW_TOPLEVEL);
+  gtk_window_set_default_size (GTK_WINDOW (window), 300, 300);
+
+  sw = gtk_scrolled_window_new (NULL, NULL);
+  gtk_container_add (GTK_CONTAINER (window), sw);
+
+  text_view = gtk_text_view_new ();
+  if (draw_below)
+    {
+      g_signal_connect (text_view, "draw", G_CALLBACK (draw_below_text), NULL);
+      below = 0x00ff00;
+    }
+  else
+    {
+      gtk_widget_override_background_color (text_view, GTK_STATE_FLAG_NORMAL, &red);
+      below = 0xff0000;
+    }
+  gtk_container_add (GTK_CONTAINER (sw), text_view);
+
+  buffer = gtk_text_view_get_buffer (GTK_TEXT_VIEW (text_view));
+  tag = gtk_text_buffer_create_tag (buffer, "blue",
+                                    "paragraph-background", "#0000ff",
+                                    NULL);
+
+  for (i = 0; i < 300; i++)
+    {
+      gchar *text;
+
+      text = g_strdup_printf ("Line %d\n", i);
+      gtk_text_buffer_get_end_iter (buffer, &iter);
+      gtk_text_buffer_insert (buffer, &iter, text, -1);
+      g_free (text);
+    }
+
+  for (i = 0; i < 300; i += 3)
+    {
+      gtk_text_buffer_get_iter_at_line (buffer, &iter, i);
+      end = iter;
+      gtk_text_iter_forward_to_line_end (&end);
+      gtk_text_buffer_apply_tag (buffer, tag, &iter, &end);
+    }
+
+  /* A selection and the cursor, within lines so they don't reach
+   * the right edge we look at
+   */
+  gtk_text_buffer_get_iter_at_line_offset (buffer, &iter, 50, 0);
+  gtk_text_buffer_get_iter_at_line_offset (buffer, &end, 50, 4);
+  gtk_text_buffer_select_range (buffer, &iter, &end);
+  gtk_text_buffer_get_iter_at_line_offset (buffer, &iter, 100, 2);
+  gtk_text_buffer_place_cursor (buffer, &iter);
+
+  gtk_widget_show_all (window);
+  gtk_widget_grab_focus (text_view);
+  gtk_test_widget_wait_for_draw (window);
+
+  vadjustment = gtk_scrollable_get_vadjustment (GTK_SCROLLABLE (text_view));
+
+  /* Small steps, so most of each frame is blitted from the cache */
+  for (value = 0;
+       value <= gtk_adjustment_get_upper (vadjustment) - gtk_adjustment_get_page_size (vadjustment);
+       value += 7)
+    {
+      GdkRectangle visible;
+      cairo_surface_t *image;
+
+      gtk_adjustment_set_value (vadjustment, value);
+      gtk_test_widget_wait_for_draw (window);
+
+      gtk_text_view_get_visible_rect (GTK_TEXT_VIEW (text_view), &visible);
+      image = snapshot_widget (text_view);
+
+      gtk_text_view_get_line_at_y (GTK_TEXT_VIEW (text_view), &iter, visible.y, NULL);
+      while (TRUE)
+        {
+          gint line_y, line_height;
+          gint x, y, wx, wy;
+
+          gtk_text_view_get_line_yrange (GTK_TEXT_VIEW (text_view), &iter,
+                                         &line_y, &line_height);
+          if (line_y + line_height > visible.y + visible.height)
+            break;
+
+          x = visible.x + visible.width - 4;
+          y = line_y + line_height / 2;
+          if (y >= visible.y)
+            {
+              gtk_text_view_buffer_to_window_coords (GTK_TEXT_VIEW (text_view),
+                                                     GTK_TEXT_WINDOW_WIDGET,
+                                                     x, y, &wx, &wy);
+
+              /* The cached text must not cover what is below it */
+              if (gtk_text_iter_get_line (&iter) % 3 == 0)
+                g_assert_cmphex (get_pixel (image, wx, wy), ==, 0x0000ff);
+              else
+                g_assert_cmphex (get_pixel (image, wx, wy), ==, below);
+            }
+
+          if (!gtk_text_iter_forward_line (&iter))
+            break;
+        }
+
+      cairo_surface_destroy (image);
+    }
+
+  gtk_widget_destroy (window);
+}
+
+int
+main (int argc, char **argv)
+{
+  gtk_test_init (&argc, &argv);
+
+  g_test_add ("/TextView/Anchors/mapping", AnchorFixture, NULL,
+              anchor_fixture_setup, test_anchor_mapping,
+              anchor_fixture_teardown);
+  g_test_add ("/TextView/Anchors/grab-focus", AnchorFixture, NULL,
+              anchor_fixture_setup, test_anchor_grab_focus,
+              anchor_fixture_teardown);
+  g_test_add ("/TextView/Anchors/focus-navigation", AnchorFixture, NULL,
+              anchor_fixture_setup, test_anchor_focus_navigation,
+              anchor_fixture_teardown);
+  g_test_add ("/TextView/Anchors/resize-offscreen", AnchorFixture, NULL,
+              anchor_fixture_setup, test_anchor_resize_offscreen,
+              anchor_fixture_teardown);
+  g_test_add ("/TextView/Anchors/removal", AnchorFixture, NULL,
+              anchor_fixture_setup, test_anchor_removal,
+              anchor_fixture_teardown);
+  g_test_add_data_func ("/TextView/PixelCache/scrolling",
+                        GINT_TO_POINTER (FALSE), test_pixel_cache_scrolling);
+  g_test_add_data_func ("/TextView/PixelCache/scrolling-draw-below",
+                        GINT_TO_POINTER (TRUE), test_pixel_cache_scrolling);
+
+  return g_test_run ();
+}
@@ -0,0 +1,167 @@
+/* GtkWidgetPath tests.
+ *
+ * Copyright (C) 2013 Red Hat, Inc.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <gtk/gtk.h>
+
+static GtkWidgetPath *
+create_path (void)
+{
+  GtkWidgetPath *path;
+
+  path = gtk_widget_path_new ();
+  gtk_widget_path_append_type (path, GTK_TYPE_WINDOW);
+  gtk_widget_path_iter_add_class (path, -1, "background");
+  gtk_widget_path_append_type (path, GTK_TYPE_NOTEBOOK);
+  gtk_widget_path_iter_add_region (path, -1, GTK_STYLE_REGION_TAB,
+                                   GTK_REGION_EVEN | GTK_REGION_FIRST);
+  gtk_widget_path_iter_add_class (path, -1, "notebook");
+  gtk_widget_path_append_type (path, GTK_TYPE_LABEL);
+  gtk_widget_path_iter_add_class (path, -1, "label");
+  gtk_widget_path_iter_add_class (path, -1, "dim-label");
+  gtk_widget_path_iter_set_name (path, -1, "tab-label");
+
+  return path;
+}
+
+static void
+assert_path_is (const GtkWidgetPath *path,
+                const gchar         *expected)
+{
+  gchar *str;
+
+  str = gtk_widget_path_to_string (path);
+  g_assert_cmpstr (str, ==, expected);
+  g_free (str);
+}
+
+static void
+test_copy_unshares (void)
+{
+  GtkWidgetPath *path, *copy;
+  gchar *original;
+  GtkRegionFlags flags;
+
+  path = create_path ();
+  original = gtk_widget_path_to_string (path);
+
+  copy = gtk_widget_path_copy (path);
+  assert_path_is (copy, original);
+
+  /* Modifying the copy leaves the original alone */
+  gtk_widget_path_iter_add_class (copy, 1, "changed");
+  gtk_widget_path_iter_remove_class (copy, 2, "dim-label");
+  gtk_widget_path_iter_add_region (copy, 1, GTK_STYLE_REGION_ROW, GTK_REGION_ODD);
+  gtk_widget_path_iter_remove_region (copy, 1, GTK_STYLE_REGION_TAB);
+
+  assert_path_is (path, original);
+  g_assert (!gtk_widget_path_iter_has_class (path, 1, "changed"));
+  g_assert (gtk_widget_path_iter_has_class (path, 2, "dim-label"));
+  g_assert (gtk_widget_path_iter_has_region (path, 1, GTK_STYLE_REGION_TAB, &flags));
+  g_assert_cmpint (flags, ==, GTK_REGION_EVEN | GTK_REGION_FIRST);
+  g_assert (!gtk_widget_path_iter_has_region (path, 1, GTK_STYLE_REGION_ROW, NULL));
+
+  g_assert (gtk_widget_path_iter_has_class (copy, 1, "changed"));
+  g_assert (!gtk_widget_path_iter_has_class (copy, 2, "dim-label"));
+  g_assert (gtk_widget_path_iter_has_class (copy, 2, "label"));
+  g_assert (!gtk_widget_path_iter_has_region (copy, 1, GTK_STYLE_REGION_TAB, NULL));
+  g_assert (gtk_widget_path_iter_has_region (copy, 1, GTK_STYLE_REGION_ROW, &flags));
+  g_assert_cmpint (flags, ==, GTK_REGION_ODD);
+
+  gtk_widget_path_unref (copy);
+
+  /* The original can still be modified after its copy is gone */
+  gtk_widget_path_iter_clear_classes (path, 0);
+  g_assert (!gtk_widget_path_iter_has_class (path, 0, "background"));
+
+  gtk_widget_path_unref (path);
+  g_free (original);
+}
+
+static void
+test_original_unshares (void)
+{
+  GtkWidgetPath *path, *copy, *copy2;
+  gchar *original;
+
+  path = create_path ();
+  original = gtk_widget_path_to_string (path);
+
+  copy = gtk_widget_path_copy (path);
+  copy2 = gtk_widget_path_copy (copy);
+
+  /* Modifying the original leaves all copies alone */
+  gtk_widget_path_iter_clear_classes (path, 2);
+  gtk_widget_path_iter_clear_regions (path, 1);
+  g_assert (!gtk_widget_path_iter_has_class (path, 2, "label"));
+
+  assert_path_is (copy, original);
+  assert_path_is (copy2, original);
+
+  /* And a copy of a copy doesn't affect the copy */
+  gtk_widget_path_iter_add_class (copy2, 2, "changed");
+  assert_path_is (copy, original);
+  g_assert (gtk_widget_path_iter_has_class (copy2, 2, "changed"));
+  g_assert (!gtk_widget_path_iter_has_class (path, 2, "changed"));
+
+  gtk_widget_path_unref (path);
+  gtk_widget_path_unref (copy2);
+
+  /* The last user can modify in place */
+  gtk_widget_path_iter_add_class (copy, 2, "last");
+  g_assert (gtk_widget_path_iter_has_class (copy, 2, "last"));
+
+  gtk_widget_path_unref (copy);
+  g_free (original);
+}
+
+static void
+test_siblings_unshare (void)
+{
+  GtkWidgetPath *siblings, *path;
+
+  siblings = gtk_widget_path_new ();
+  gtk_widget_path_append_type (siblings, GTK_TYPE_BUTTON);
+  gtk_widget_path_iter_add_class (siblings, 0, "first");
+  gtk_widget_path_append_type (siblings, GTK_TYPE_BUTTON);
+
+  path = gtk_widget_path_new ();
+  gtk_widget_path_append_type (path, GTK_TYPE_BOX);
+  gtk_widget_path_append_with_siblings (path, siblings, 0);
+
+  /* The element was copied from the siblings path */
+  gtk_widget_path_iter_add_class (path, 1, "changed");
+  g_assert (gtk_widget_path_iter_has_class (path, 1, "first"));
+  g_assert (!gtk_widget_path_iter_has_class (siblings, 0, "changed"));
+  g_assert (!gtk_widget_path_iter_has_class (gtk_widget_path_iter_get_siblings (path, 1),
+                                             0, "changed"));
+
+  gtk_widget_path_unref (siblings);
+  gtk_widget_path_unref (path);
+}
+
+int
+main (int argc, char *argv[])
+{
+  gtk_test_init (&argc, &argv);
+
+  g_test_add_func ("/widgetpath/copy-unshares", test_copy_unshares);
+  g_test_add_func ("/widgetpath/original-unshares", test_original_unshares);
+  g_test_add_func ("/widgetpath/siblings-unshare", test_siblings_unshare);
+
+  return g_test_run ();
+}